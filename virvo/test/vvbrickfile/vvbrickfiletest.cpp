@@ -0,0 +1,104 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+// Writes a small volume with a transfer function to a brick file, reads it
+// back and compares voxels and widgets. Returns non-zero on mismatch.
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "vvbrickfile.h"
+#include "vvtfwidget.h"
+#include "vvvoldesc.h"
+
+using namespace std;
+
+static string tfString(const vvTransFunc& tf)
+{
+  string result;
+  for (size_t i = 0; i < tf._widgets.size(); ++i)
+    result += tf._widgets[i]->toString();
+  return result;
+}
+
+int main(int, char**)
+{
+  const char* filename = "vvbrickfiletest.bvf";
+
+  const size_t w = 20, h = 17, s = 9;
+  uint8_t* raw = new uint8_t[w * h * s];
+  for (size_t i = 0; i < w * h * s; ++i)
+    raw[i] = static_cast< uint8_t >((i * 7) % 251);
+  vvVolDesc* vd = new vvVolDesc("brickfiletest", w, h, s, 1, 1, 1, &raw, vvVolDesc::ARRAY_DELETE);
+
+  vd->tf[0]._widgets.clear();
+  vd->tf[0]._widgets.push_back(new vvTFPyramid(vvColor(1.0f, 0.5f, 0.25f), false, 0.8f, 0.3f, 0.4f, 0.1f));
+  vvTFCustom* custom = new vvTFCustom(0.6f, 0.3f);
+  custom->setName("custom");
+  custom->addPoint(0.55f)->_opacity = 0.7f;
+  custom->addPoint(0.65f)->_opacity = 0.2f;
+  vd->tf[0]._widgets.push_back(custom);
+
+  int result = 0;
+  if (!virvo::BrickFile::write(filename, vd, virvo::BrickFile::CODEC_RLE, 8))
+  {
+    cerr << "Cannot write " << filename << endl;
+    delete vd;
+    return 1;
+  }
+
+  virvo::BrickFile file;
+  if (!file.open(filename))
+  {
+    cerr << "Cannot open " << filename << endl;
+    result = 1;
+  }
+  else
+  {
+    vvVolDesc* loaded = new vvVolDesc();
+    file.getAttributes(loaded);
+
+    if (loaded->tf.size() != vd->tf.size() || tfString(loaded->tf[0]) != tfString(vd->tf[0]))
+    {
+      cerr << "Transfer function mismatch:" << endl << tfString(vd->tf[0])
+           << "read back as:" << endl << (loaded->tf.empty() ? string() : tfString(loaded->tf[0]));
+      result = 1;
+    }
+
+    vector< uint8_t > data(vd->getFrameBytes());
+    if (!file.readFrame(0, 0, &data[0]) || memcmp(&data[0], raw, data.size()) != 0)
+    {
+      cerr << "Voxel data mismatch" << endl;
+      result = 1;
+    }
+
+    delete loaded;
+  }
+
+  file.close();
+  remove(filename);
+  delete vd;
+
+  if (result == 0)
+    cerr << "Passed" << endl;
+  return result;
+}
@@ -0,0 +1,166 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+// Measures encode and decode throughput of the codecs for volume frames
+// (RLE as used by XVF, RVF and the brick files, and Snappy if available)
+// on the frames of real volume files:
+//
+//   vvcodecbench <volume file> [<volume file> ...]
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "vvbrickfile.h"
+#include "vvclock.h"
+#include "vvfileio.h"
+#include "vvtoolshed.h"
+#include "vvvoldesc.h"
+#include "private/vvcompress.h"
+
+using namespace std;
+
+namespace
+{
+
+const int NUM_RUNS = 5;                           // best of NUM_RUNS is reported
+
+struct Result
+{
+  double encodeTime;
+  double decodeTime;
+  size_t encodedBytes;
+  bool ok;
+
+  Result() : encodeTime(0.0), decodeTime(0.0), encodedBytes(0), ok(true) {}
+};
+
+Result benchRLE(const uint8_t* raw, size_t bytes, size_t bpv)
+{
+  Result r;
+  vector<uint8_t> encoded(bytes);
+  vector<uint8_t> decoded(bytes);
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    size_t encodedSize = 0;
+    double t0 = vvClock::getTime();
+    if (vvToolshed::encodeRLE(&encoded[0], raw, bytes, bpv, bytes, &encodedSize) != vvToolshed::VV_OK)
+    {
+      // incompressible frames are stored unencoded
+      r.encodedBytes = bytes;
+      return r;
+    }
+    double t1 = vvClock::getTime();
+    size_t outsize = 0;
+    r.ok &= vvToolshed::decodeRLE(&decoded[0], &encoded[0], encodedSize, bpv, bytes, &outsize) == vvToolshed::VV_OK;
+    double t2 = vvClock::getTime();
+    r.ok &= outsize == bytes && std::equal(decoded.begin(), decoded.end(), raw);
+    r.encodeTime = run==0 ? t1 - t0 : std::min(r.encodeTime, t1 - t0);
+    r.decodeTime = run==0 ? t2 - t1 : std::min(r.decodeTime, t2 - t1);
+    r.encodedBytes = encodedSize;
+  }
+  return r;
+}
+
+Result benchSnappy(const uint8_t* raw, size_t bytes)
+{
+  Result r;
+  vector<uint8_t> encoded;
+  vector<uint8_t> decoded(bytes);
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double t0 = vvClock::getTime();
+    r.ok &= virvo::encodeSnappy(raw, bytes, encoded);
+    double t1 = vvClock::getTime();
+    r.ok &= virvo::decodeSnappy(&encoded[0], encoded.size(), &decoded[0], bytes);
+    double t2 = vvClock::getTime();
+    r.ok &= std::equal(decoded.begin(), decoded.end(), raw);
+    r.encodeTime = run==0 ? t1 - t0 : std::min(r.encodeTime, t1 - t0);
+    r.decodeTime = run==0 ? t2 - t1 : std::min(r.decodeTime, t2 - t1);
+    r.encodedBytes = encoded.size();
+  }
+  return r;
+}
+
+void print(const char* codec, size_t bytes, const Result& r)
+{
+  const double mb = double(bytes) / (1024.0 * 1024.0);
+  cout << "  " << setw(8) << left << codec << right
+       << "  ratio " << setw(6) << fixed << setprecision(3) << double(r.encodedBytes) / double(bytes)
+       << "  encode " << setw(8) << setprecision(1) << (r.encodeTime > 0.0 ? mb / r.encodeTime : 0.0) << " MB/s"
+       << "  decode " << setw(8) << (r.decodeTime > 0.0 ? mb / r.decodeTime : 0.0) << " MB/s"
+       << (r.ok ? "" : "  FAILED") << endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: vvcodecbench <volume file> [<volume file> ...]" << endl;
+    return 1;
+  }
+
+  bool ok = true;
+  for (int i=1; i<argc; ++i)
+  {
+    vvVolDesc vd(argv[i]);
+    vvFileIO fio;
+    if (fio.loadVolumeData(&vd) != vvFileIO::OK)
+    {
+      cerr << "Cannot load file: " << argv[i] << endl;
+      ok = false;
+      continue;
+    }
+
+    // Accumulate over all frames:
+    const size_t bytes = vd.getFrameBytes();
+    Result rle, snappy;
+    for (size_t f=0; f<vd.getStoredFrames(); ++f)
+    {
+      const uint8_t* raw = vd.getConstRaw(f);
+      Result r = benchRLE(raw, bytes, vd.getBPV());
+      rle.encodeTime += r.encodeTime;
+      rle.decodeTime += r.decodeTime;
+      rle.encodedBytes += r.encodedBytes;
+      rle.ok &= r.ok;
+      if (virvo::BrickFile::isCodecAvailable(virvo::BrickFile::CODEC_SNAPPY))
+      {
+        r = benchSnappy(raw, bytes);
+        snappy.encodeTime += r.encodeTime;
+        snappy.decodeTime += r.decodeTime;
+        snappy.encodedBytes += r.encodedBytes;
+        snappy.ok &= r.ok;
+      }
+    }
+
+    const size_t total = bytes * vd.getStoredFrames();
+    cout << argv[i] << ": " << vd.vox[0] << "x" << vd.vox[1] << "x" << vd.vox[2]
+         << ", " << vd.getStoredFrames() << " frame(s), " << vd.getBPV() << " byte(s) per voxel" << endl;
+    print("RLE", total, rle);
+    if (virvo::BrickFile::isCodecAvailable(virvo::BrickFile::CODEC_SNAPPY))
+      print("Snappy", total, snappy);
+    ok &= rle.ok && snappy.ok;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+// Measures the software warp of the shear-warp renderers (vvSoftImg::warp)
+// against the previous serial implementation, for an affine and a
+// perspective warp matrix of a synthetic intermediate image:
+//
+//   vvwarpbench [<width> <height>]
+//
+// The destination image is twice as large as the intermediate image in
+// both directions.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "math/math.h"
+#include "vvclock.h"
+#include "private/vvwarp.h"
+
+using namespace std;
+using virvo::mat4;
+
+namespace
+{
+
+const int NUM_RUNS = 5;                           // best of NUM_RUNS is reported
+const int PIXEL_SIZE = 4;
+
+// The serial nearest neighbor warp vvSoftImg used before, for comparison
+void warpReference(uint8_t* dst, int width, int height, const uint8_t* src, int srcWidth, int srcHeight, mat4 const& inv)
+{
+  for (int j=0; j<height; ++j)
+  {
+    const float yd = (float)j;
+    for (int i=0; i<width; ++i)
+    {
+      const float xd = (float)i;
+      const float pc = xd * inv(3, 0) + yd * inv(3, 1) + inv(3, 3);
+      const int xs = (int)((xd * inv(0, 0) + yd * inv(0, 1) + inv(0, 3)) / pc);
+      const int ys = (int)((xd * inv(1, 0) + yd * inv(1, 1) + inv(1, 3)) / pc);
+      if (xs>srcWidth-1 || ys>srcHeight-1 || xs<0 || ys<0)
+        memset(dst + PIXEL_SIZE * (i + j * width), '\0', PIXEL_SIZE);
+      else
+        memcpy(dst + PIXEL_SIZE * (i + j * width), src + PIXEL_SIZE * (xs + ys * srcWidth), PIXEL_SIZE);
+    }
+  }
+}
+
+// Smooth color ramps with some sharp edges, alpha as in a composited image
+vector<uint8_t> makeImage(int width, int height)
+{
+  vector<uint8_t> img(size_t(width) * height * PIXEL_SIZE);
+  for (int y=0; y<height; ++y)
+    for (int x=0; x<width; ++x)
+    {
+      uint8_t* p = &img[(size_t(y) * width + x) * PIXEL_SIZE];
+      const bool edge = ((x / 16) + (y / 16)) % 2 == 0;
+      p[0] = uint8_t(255 * x / width);
+      p[1] = uint8_t(255 * y / height);
+      p[2] = edge ? 200 : 40;
+      p[3] = uint8_t(edge ? 255 : 128);
+    }
+  return img;
+}
+
+// Rotate, scale and shear the intermediate image into the middle of the destination
+mat4 makeWarp(int srcWidth, int srcHeight, bool perspective)
+{
+  const float a = 0.3f;
+  const float s = 1.7f;
+  mat4 w = mat4::identity();
+  w(0, 0) = s * cosf(a);
+  w(0, 1) = -s * sinf(a) + 0.2f;
+  w(1, 0) = s * sinf(a);
+  w(1, 1) = s * cosf(a);
+  w(0, 3) = srcWidth * (1.0f - 0.5f * (w(0, 0) + w(0, 1)));
+  w(1, 3) = srcHeight * (1.0f - 0.5f * (w(1, 0) + w(1, 1)));
+  if (perspective)
+  {
+    w(3, 0) = 0.2f / srcWidth;
+    w(3, 1) = 0.1f / srcHeight;
+  }
+  return w;
+}
+
+struct Result
+{
+  double time;
+  size_t mismatches;                              // pixels that differ from the reference
+};
+
+template <typename Func>
+Result bench(Func func, const vector<uint8_t>& dst, const vector<uint8_t>& ref)
+{
+  Result r;
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double t0 = vvClock::getTime();
+    func();
+    double t = vvClock::getTime() - t0;
+    r.time = run==0 ? t : std::min(r.time, t);
+  }
+  r.mismatches = 0;
+  for (size_t i=0; i<ref.size(); i+=PIXEL_SIZE)
+    r.mismatches += memcmp(&dst[i], &ref[i], PIXEL_SIZE) != 0;
+  return r;
+}
+
+void print(const char* name, size_t pixels, const Result& r, double refTime, bool compare)
+{
+  cout << "  " << setw(18) << left << name << right
+       << fixed << setprecision(2) << setw(9) << r.time * 1000.0 << " ms"
+       << setw(9) << setprecision(1) << double(pixels) / r.time / 1.0e6 << " Mpixels/s"
+       << setw(8) << setprecision(2) << refTime / r.time << "x";
+  if (compare)
+    cout << "  " << setprecision(4) << 100.0 * double(r.mismatches) / double(pixels) << "% pixels differ";
+  cout << endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  int srcWidth = 512;
+  int srcHeight = 512;
+  if (argc == 3)
+  {
+    srcWidth = atoi(argv[1]);
+    srcHeight = atoi(argv[2]);
+  }
+  if (srcWidth <= 0 || srcHeight <= 0 || (argc != 1 && argc != 3))
+  {
+    cerr << "Usage: vvwarpbench [<width> <height>]" << endl;
+    return 1;
+  }
+
+  const int width = 2 * srcWidth;
+  const int height = 2 * srcHeight;
+  const size_t pixels = size_t(width) * height;
+  const vector<uint8_t> src = makeImage(srcWidth, srcHeight);
+  vector<uint8_t> ref(pixels * PIXEL_SIZE);
+  vector<uint8_t> dst(pixels * PIXEL_SIZE);
+
+  bool ok = true;
+  for (int perspective=0; perspective<2; ++perspective)
+  {
+    const mat4 inv = inverse(makeWarp(srcWidth, srcHeight, perspective != 0));
+
+    cout << (perspective ? "Perspective" : "Affine") << " warp, " << srcWidth << "x" << srcHeight
+         << " to " << width << "x" << height << ":" << endl;
+
+    Result r = bench([&]() { warpReference(&ref[0], width, height, &src[0], srcWidth, srcHeight, inv); }, ref, ref);
+    const double refTime = r.time;
+    print("previous", pixels, r, refTime, false);
+
+    r = bench([&]() { virvo::warpImage(&dst[0], width, height, &src[0], srcWidth, srcHeight, inv, false, false); }, dst, ref);
+    print("nearest, serial", pixels, r, refTime, true);
+    // Only coordinates that round differently may select another pixel
+    ok &= r.mismatches * 1000 <= pixels;
+
+    r = bench([&]() { virvo::warpImage(&dst[0], width, height, &src[0], srcWidth, srcHeight, inv, false); }, dst, ref);
+    print("nearest", pixels, r, refTime, true);
+    ok &= r.mismatches * 1000 <= pixels;
+
+    r = bench([&]() { virvo::warpImage(&dst[0], width, height, &src[0], srcWidth, srcHeight, inv, true, false); }, dst, ref);
+    print("bilinear, serial", pixels, r, refTime, false);
+
+    r = bench([&]() { virvo::warpImage(&dst[0], width, height, &src[0], srcWidth, srcHeight, inv, true); }, dst, ref);
+    print("bilinear", pixels, r, refTime, false);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -97,6 +97,10 @@ vvConv::vvConv()
     , dicomRename(false)
     , leicaRename(false)
     , compression(true)
+    , brickCodec(virvo::BrickFile::CODEC_RLE)
+    , brickSize(int(virvo::BrickFile::DEFAULT_BRICK_SIZE))
+    , brickLevels(1)
+    , xvfCodec(virvo::BrickFile::CODEC_RLE)
     , animTime(0.0f)
     , deinterlace(false)
     , zoomData(false)
@@ -554,6 +558,7 @@ bool vvConv::readVolumeData()
     cerr << "Loading file " << (file+1) << ": " << filename << endl;
     vvVolDesc* newVD = new vvVolDesc(filename);
     newVD->setEntry(entry);
+    bool cropped = false;
     if (loadRaw)
     {
       error = fio->loadRawFile(newVD, rawWidth, rawHeight, rawSlices, rawBPC, rawCh, rawSkip);
@@ -571,6 +576,15 @@ bool vvConv::readVolumeData()
       newVD->computeVolume(makeVolume, makeVolumeSize[0], makeVolumeSize[1], makeVolumeSize[2]);
       error = vvFileIO::OK;
     }
+    else if (crop)
+    {
+      // only read the crop region from disk where the format supports it
+      virvo::vector<3, ssize_t> first(cropPos[0], cropPos[1], cropPos[2]);
+      virvo::vector<3, ssize_t> size(cropSize[0], cropSize[1], cropSize[2]);
+      error = fio->loadVolumeData(newVD, virvo::basic_aabb<ssize_t>(first, first + size),
+                                  virvo::vector<3, ssize_t>(ssize_t(1)));
+      cropped = (error == vvFileIO::OK);
+    }
     else error = fio->loadVolumeData(newVD);
     
     if (error != vvFileIO::OK)
@@ -585,13 +599,13 @@ bool vvConv::readVolumeData()
     newVD->printInfoLine("Loaded: ");
 
     // Make data modifications for each input file:
-    modifyInputFile(newVD);
+    modifyInputFile(newVD, cropped);
 
     if (vd)
     {
       size_t sz = newVD->getFrameBytes();
       uint8_t *frame = new uint8_t[sz];
-      memcpy(frame, newVD->getRaw(), sz);
+      memcpy(frame, newVD->getConstRaw(), sz);
       vd->addFrame(frame, vvVolDesc::ARRAY_DELETE);
       ++vd->frames;
       delete newVD;
@@ -665,11 +679,12 @@ bool vvConv::readVolumeData()
   This covers mostly the modifications which could considerably
   change the volume data size and thus should be done as early
   as possible in the conversion process.
-  @param v volume description to which to apply the modifications
+  @param v       volume description to which to apply the modifications
+  @param cropped  true if only the crop region was loaded
 */
-void vvConv::modifyInputFile(vvVolDesc* v)
+void vvConv::modifyInputFile(vvVolDesc* v, bool cropped)
 {
-  if (crop)
+  if (crop && !cropped)
   {
     cerr << "Cropping data." << endl;
     v->crop(cropPos[0], cropPos[1], cropPos[2], cropSize[0], cropSize[1], cropSize[2]);
@@ -899,7 +914,7 @@ void vvConv::modifyOutputFile(vvVolDesc* v)
     else
     {  
       v->iconSize = ts_min(iconVD->vox[0], iconVD->vox[1]);
-      uint8_t* raw = iconVD->getRaw();
+      uint8_t* raw = const_cast<uint8_t*>(iconVD->getConstRaw());
       delete[] v->iconData;
       v->iconData = new uint8_t[v->iconSize * v->iconSize * vvVolDesc::ICON_BPP];
       vvToolshed::resample(raw, iconVD->vox[0], iconVD->vox[1], iconVD->bpc * iconVD->getChan(), 
@@ -1087,6 +1102,8 @@ bool vvConv::writeVolumeData()
   vd->printInfoLine("Writing: ");
   fio = new vvFileIO();
   fio->setCompression(compression);
+  fio->setBrickOptions(brickCodec, brickSize, brickLevels);
+  fio->setXVFCodec(xvfCodec);
   switch (fio->saveVolumeData(vd, overwrite))
   {
     case vvFileIO::OK:
@@ -1290,6 +1307,51 @@ bool vvConv::parseCommandLine(int argc, char** argv)
       }
     }
 
+    else if (vvToolshed::strCompare(argv[arg], "-bricks")==0)
+    {
+      if ((++arg)>=argc) 
+      {
+        cerr << "Brick codec missing." << endl;
+        return false;
+      }
+      if (vvToolshed::strCompare(argv[arg], "none")==0) brickCodec = virvo::BrickFile::CODEC_NONE;
+      else if (vvToolshed::strCompare(argv[arg], "rle")==0) brickCodec = virvo::BrickFile::CODEC_RLE;
+      else if (vvToolshed::strCompare(argv[arg], "snappy")==0) brickCodec = virvo::BrickFile::CODEC_SNAPPY;
+      else if (vvToolshed::strCompare(argv[arg], "zlib")==0) brickCodec = virvo::BrickFile::CODEC_ZLIB;
+      else
+      {
+        cerr << "Invalid brick codec." << endl;
+        return false;
+      }
+      if (!virvo::BrickFile::isCodecAvailable(brickCodec))
+      {
+        cerr << "Brick codec not available in this build." << endl;
+        return false;
+      }
+      if ((++arg)>=argc) 
+      {
+        cerr << "Brick size missing." << endl;
+        return false;
+      }
+      brickSize = atoi(argv[arg]);
+      if (brickSize<1 || brickSize>1024)
+      {
+        cerr << "Brick size must be between 1 and 1024." << endl;
+        return false;
+      }
+      if ((++arg)>=argc) 
+      {
+        cerr << "Number of LOD levels missing." << endl;
+        return false;
+      }
+      brickLevels = atoi(argv[arg]);
+      if (brickLevels<1)
+      {
+        cerr << "Number of LOD levels must be at least 1." << endl;
+        return false;
+      }
+    }
+
     else if (vvToolshed::strCompare(argv[arg], "-makesphere")==0)
     {
       sphere = true;
@@ -1432,6 +1494,9 @@ bool vvConv::parseCommandLine(int argc, char** argv)
       {
         case 'n': ipt = vvVolDesc::NEAREST; break;
         case 't': ipt = vvVolDesc::TRILINEAR; break;
+        case 'b': ipt = vvVolDesc::BOX; break;
+        case 'l': ipt = vvVolDesc::LANCZOS; break;
+        case 'm': ipt = vvVolDesc::MAXIMUM; break;
         default: cerr << "Invalid interpolation type." << endl; return false;
       }
     }
@@ -1843,6 +1908,27 @@ bool vvConv::parseCommandLine(int argc, char** argv)
       removeTF = true;
     }
 
+    else if (vvToolshed::strCompare(argv[arg], "-xvfcodec")==0)
+    {
+      if ((++arg)>=argc) 
+      {
+        cerr << "XVF codec missing." << endl;
+        return false;
+      }
+      if (vvToolshed::strCompare(argv[arg], "rle")==0) xvfCodec = virvo::BrickFile::CODEC_RLE;
+      else if (vvToolshed::strCompare(argv[arg], "snappy")==0) xvfCodec = virvo::BrickFile::CODEC_SNAPPY;
+      else
+      {
+        cerr << "Invalid XVF codec." << endl;
+        return false;
+      }
+      if (!virvo::BrickFile::isCodecAvailable(xvfCodec))
+      {
+        cerr << "XVF codec not available in this build." << endl;
+        return false;
+      }
+    }
+
     else if (vvToolshed::strCompare(argv[arg], "-zoomdata")==0)
     {
       zoomData = true;
@@ -2089,6 +2175,7 @@ void vvConv::displayHelpInfo()
   stream << "The following file types are accepted:" << endl;
   stream << "rvf                = Raw Volume File (2 x 3 byte header, 8 bit per voxel)" << endl;
   stream << "xvf                = Extended Volume File" << endl;
+  stream << "bvf                = Brick-compressed Volume File" << endl;
   stream << "avf                = ASCII Volume File" << endl;
   stream << "tif, tiff          = 2D/3D TIF File" << endl;
   stream << "dat                = Raw volume data (no header) - automatic format detection" << endl;
@@ -2111,6 +2198,7 @@ void vvConv::displayHelpInfo()
   stream << "The following file types are accepted:" << endl;
   stream << "rvf                = Raw Volume File (2 x 3 byte header, 8 bit per voxel)" << endl;
   stream << "xvf                = Extended Raw Volume File" << endl;
+  stream << "bvf                = Brick-compressed Volume File (see -bricks)" << endl;
   stream << "avf                = ASCII Volume File" << endl;
   stream << "dat                = Raw volume data (no header)" << endl;
   stream << "tif                = 2D TIF File" << endl;
@@ -2154,6 +2242,15 @@ void vvConv::displayHelpInfo()
   stream << " mapping them to [0..1]. Float values are converted to integer by linearly" << endl;
   stream << " mapping them to [0..maxint] bounded by the min and max float values." << endl;
   stream << endl;
+  stream << "-bricks <codec> <size> <levels>" << endl;
+  stream << " Layout of bvf files (brick-compressed volume files) to be written." << endl;
+  stream << " The volume is divided into bricks of <size>^3 voxels, which are compressed" << endl;
+  stream << " independently with <codec>: 'none', 'rle', 'snappy' or 'zlib' (the latter two" << endl;
+  stream << " only if available). <levels> is the number of level of detail levels to store," << endl;
+  stream << " 1 stores the full resolution volume only. Bricks of bvf files can be read" << endl;
+  stream << " individually and are decoded in parallel." << endl;
+  stream << " Default: -bricks rle 64 1" << endl;
+  stream << endl;
   stream << "-channels <num_channels>" << endl;
   stream << " Change the number of channels to <num_channels>." << endl;
   stream << " If more than the current number of channels are requested, the new channel" << endl;
@@ -2262,9 +2359,13 @@ void vvConv::displayHelpInfo()
   stream << " No conversion is done, even if according parameters are passed." << endl;
   stream << " This command is automatically executed if only one file parameter is passed." << endl;
   stream << endl;
-  stream << "-interpolation <n|t>" << endl;
+  stream << "-interpolation <n|t|b|l|m>" << endl;
   stream << " Define the type of interpolation to use whenever resampling is necessary." << endl;
-  stream << " The available types are: n=nearest neighbor (default), t=trilinear." << endl;
+  stream << " The available types are: n=nearest neighbor (default), t=trilinear," << endl;
+  stream << " b=box (average), l=Lanczos, m=maximum." << endl;
+  stream << " Box, Lanczos, and maximum filter all source voxels covered by a new voxel," << endl;
+  stream << " use them for downsampling. The sphere operation uses trilinear interpolation" << endl;
+  stream << " for all types but nearest neighbor." << endl;
   stream << " This parameter affects the resize, scale, and sphere operations." << endl;
   stream << endl;
   stream << "-invertorder" << endl;
@@ -2320,7 +2421,7 @@ void vvConv::displayHelpInfo()
   stream << " 'anim':   make an animation (each file is a time step)" << endl;
   stream << endl;
   stream << "-nocompress" << endl;
-  stream << " Suppress data compression when writing xvf files." << endl;
+  stream << " Suppress data compression when writing xvf and bvf files." << endl;
   stream << endl;
   stream << "-over (-o)" << endl;
   stream << " Overwrite destination files." << endl;
@@ -2385,6 +2486,11 @@ void vvConv::displayHelpInfo()
   stream << "-transfunc <filename.xvf>" << endl;
   stream << " Import the transfer functions from a file." << endl;
   stream << endl;
+  stream << "-xvfcodec <codec>" << endl;
+  stream << " Compression of the frames of xvf files to be written: 'rle' or 'snappy'" << endl;
+  stream << " (only if available). Snappy compressed files load faster, but cannot be" << endl;
+  stream << " read by older versions of Virvo. Default: -xvfcodec rle" << endl;
+  stream << endl;
   stream << "-zoomdata <channel> <low> <high>" << endl;
   stream << " Zoom the data of <channel> to the range between the <low> and <high> data" << endl;
   stream << " values. Example: -zoomdata 1 10 80" << endl;
@@ -2434,6 +2540,7 @@ int vvConv::run(int argc, char** argv)
     cerr << "-bitshift <bits>                   shift voxel data" << endl;
     cerr << "-blend <filename> <type>           blend two files together" << endl;
     cerr << "-bpc <bytes>                       set bytes per channel" << endl;
+    cerr << "-bricks <codec> <size> <levels>    brick layout of bvf files" << endl;
     cerr << "-channels <num_ch>                 change the number of channels" << endl;
     cerr << "-crop <x> <y> <z> <w> <h> <s>      crop volume" << endl;
     cerr << "-croptime <first_step> <num_steps> crop a sequence of time steps" << endl;
@@ -2455,7 +2562,8 @@ int vvConv::run(int argc, char** argv)
     cerr << "-hist <type>                       create histogram" << endl;
     cerr << "-increment <num>                   increment for -files" << endl;
     cerr << "-info                              display information about volume" << endl;
-    cerr << "-interpolation <n|t>               set interpolation type (n: nearest neighbour, t: trilinear)" << endl;
+    cerr << "-interpolation <n|t|b|l|m>         set interpolation type (n: nearest neighbour, t: trilinear," << endl;
+    cerr << "                                   b: box, l: Lanczos, m: maximum)" << endl;
     cerr << "-invertorder                       invert voxel order" << endl;
     cerr << "-loadraw <w> <h> <s> <bc> <c> <sk> load raw volume data from file" << endl;
     cerr << "-signed                            interpret raw as signed data" << endl;
@@ -2483,6 +2591,7 @@ int vvConv::run(int argc, char** argv)
 		cerr << "-swapchannels <ch1> <ch2>          swap two channels in each voxel" << endl;
     cerr << "-time <dt>                         set animation time per frame" << endl;
     cerr << "-transfunc <filename.xvf>          import transfer functions from file" << endl;
+    cerr << "-xvfcodec <codec>                  frame compression of xvf files" << endl;
     cerr << "-zoomdata <channel> <low> <high>   zoom data range" << endl;
     cerr << endl;
 
@@ -22,6 +22,7 @@
 #define VVCONV_H
 
 #include <virvo/math/forward.h>
+#include <virvo/vvbrickfile.h>
 #include <virvo/vvvoldesc.h>
 
 /** Command line volume file format converter.
@@ -102,6 +103,10 @@ class vvConv
     bool  dicomRename;  ///< true = rename DICOM files
     bool  leicaRename;  ///< true = rename Leica files
     bool  compression;  ///< true = compress data if allowed by file format
+    virvo::BrickFile::Codec brickCodec; ///< brick codec for bvf files
+    int   brickSize;    ///< brick edge length for bvf files [voxels]
+    int   brickLevels;  ///< number of LOD levels stored in bvf files
+    virvo::BrickFile::Codec xvfCodec; ///< frame codec for xvf files
     float animTime;     ///< time that each animation frame is to be displayed [seconds], 0=no change
     bool  deinterlace;  ///< true = deinterlace slices
     bool  zoomData;     ///< true = zoom data range
@@ -160,7 +165,7 @@ class vvConv
     bool writeVolumeData();
     void displayHelpInfo();
     bool parseCommandLine(int, char**);
-    void modifyInputFile(vvVolDesc*);
+    void modifyInputFile(vvVolDesc*, bool);
     void modifyOutputFile(vvVolDesc*);
     int  renameDicomFiles();
 
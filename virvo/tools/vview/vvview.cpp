@@ -156,6 +156,8 @@ vvView::vvView()
   clipBuffer            = NULL;
   framebufferDump       = NULL;
   benchmark             = false;
+  sparseMode            = false;
+  lazyMode              = false;
   testSuiteFileName     = NULL;
   showBricks            = false;
   recordMode            = false;
@@ -215,6 +217,7 @@ void vvView::mainLoop(int argc, char *argv[])
   }
 
   vvFileIO fio;
+  fio.setLazyFrames(lazyMode);
   if (fio.loadVolumeData(vd) != vvFileIO::OK)
   {
     cerr << "Error loading volume file" << endl;
@@ -224,6 +227,11 @@ void vvView::mainLoop(int argc, char *argv[])
   }
   else vd->printInfoLine();
 
+  if (sparseMode)
+  {
+    vd->makeSparse(virvo::SparseFrame::DEFAULT_BLOCK_SIZE, NULL, true);
+  }
+
   // Set default color scheme if no TF present:
   if (vd->tf[0].isEmpty())
   {
@@ -2497,6 +2505,14 @@ void vvView::displayHelpInfo()
   cerr << "-benchmark" << endl;
   cerr << " Time 3 half rotations and exit" << endl;
   cerr << endl;
+  cerr << "-sparse" << endl;
+  cerr << " Keep the volume in sparse block storage, only blocks that are not" << endl;
+  cerr << " empty are stored" << endl;
+  cerr << endl;
+  cerr << "-lazy" << endl;
+  cerr << " Read the frames of XVF and raw NRRD files from disk when they are" << endl;
+  cerr << " displayed instead of loading all of them up front" << endl;
+  cerr << endl;
   cerr << endl;
   cerr << "-isecttype <num>" << endl;
   cerr << " Select proxy geometry generator:" << endl;
@@ -2754,6 +2770,14 @@ bool vvView::parseCommandLine(int argc, char** argv)
     {
       benchmark = true;
     }
+    else if (vvToolshed::strCompare(argv[arg], "-sparse")==0)
+    {
+      sparseMode = true;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-lazy")==0)
+    {
+      lazyMode = true;
+    }
     else if (vvToolshed::strCompare(argv[arg], "-isecttype")==0)
     {
       if ((++arg)>=argc)
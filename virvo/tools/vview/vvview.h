@@ -151,6 +151,8 @@ class vvView
     std::vector<int> ports;
     std::vector<vvSocket*> sockets;
     bool benchmark;                             ///< don't run interactively, just perform timed rendering and exit
+    bool sparseMode;                            ///< true = keep volume frames in sparse block storage
+    bool lazyMode;                              ///< true = read frames from disk when they are displayed
     std::vector<std::string> serverFileNames;   ///< a list with file names where remote servers can find the appropriate volume data
     const char* testSuiteFileName;
     bool showBricks;                            ///< show brick outlines when brick renderer is used
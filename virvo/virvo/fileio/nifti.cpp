@@ -33,13 +33,14 @@
 #include <nifti1_io.h>
 
 #include <virvo/vvvoldesc.h>
+#include <virvo/private/vvregionio.h>
 
 #include "exceptions.h"
 #include "nifti.h"
 
 namespace virvo { namespace nifti {
 
-void load(vvVolDesc* vd)
+void load(vvVolDesc* vd, basic_aabb<ssize_t> const* region, vector<3, ssize_t> const* stride)
 {
     bool verbose = true;
 
@@ -132,17 +133,58 @@ void load(vvVolDesc* vd)
 
     // read image data ------------------------------------
 
-    nifti_image* data_section = nifti_image_read(vd->getFilename(), 1);
+    if (region != NULL)
+    {
+        const vector<3, ssize_t> vox = vd->vox;
+        const size_t bpv = vd->getBPV();
+        ReadRegion r(*region, *stride, vox);
+        r.applyTo(vd);
+        uint8_t* raw = new uint8_t[vd->getFrameBytes()];
 
+        if (!nifti_is_gzfile(header->iname))
+        {
+            // read the region directly from the image file
+            PositionedFile file(header->iname);
+            if (!readRegion(file, header->iname_offset, vox, bpv, r, raw))
+            {
+                delete[] raw;
+                throw fileio::exception();
+            }
 
-    if (!data_section)
-    {
-        throw fileio::exception();
+            if (header->byteorder != nifti_short_order() && header->swapsize > 1)
+            {
+                nifti_swap_Nbytes(vd->getFrameBytes() / header->swapsize, header->swapsize, raw);
+            }
+        }
+        else
+        {
+            // compressed files cannot be read partially
+            nifti_image* data_section = nifti_image_read(vd->getFilename(), 1);
+            if (!data_section)
+            {
+                delete[] raw;
+                throw fileio::exception();
+            }
+            copyRegion(static_cast<uint8_t*>(data_section->data), vox, bpv, r, raw);
+            nifti_image_free(data_section);
+        }
+
+        vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
     }
+    else
+    {
+        nifti_image* data_section = nifti_image_read(vd->getFilename(), 1);
 
-    uint8_t* raw = new uint8_t[vd->getFrameBytes()];
-    memcpy(raw, static_cast<uint8_t*>(data_section->data), vd->getFrameBytes());
-    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+
+        if (!data_section)
+        {
+            throw fileio::exception();
+        }
+
+        uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+        memcpy(raw, static_cast<uint8_t*>(data_section->data), vd->getFrameBytes());
+        vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+    }
 
 
     float slope = header->scl_slope;
@@ -248,7 +290,7 @@ void save(const vvVolDesc* vd)
     img->dy = vd->getDist()[1];
     img->dz = vd->getDist()[2];
 
-    img->data = vd->getRaw();
+    img->data = const_cast<uint8_t*>(vd->getConstRaw());
 
     nifti_image_write(img);
 }
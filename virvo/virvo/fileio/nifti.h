@@ -27,11 +27,16 @@
 
 #if VV_HAVE_NIFTI
 
+#include <virvo/math/forward.h>
+#include <virvo/vvinttypes.h>
+
 class vvVolDesc;
 
 namespace virvo { namespace nifti {
 
-void load(vvVolDesc* vd);
+// Load every stride'th voxel of the sub-box region only, if region is not NULL.
+// Uncompressed files only read the region from disk.
+void load(vvVolDesc* vd, basic_aabb<ssize_t> const* region = NULL, vector<3, ssize_t> const* stride = NULL);
 void save(const vvVolDesc* vd);
 
 }} // namespace virvo::nifti
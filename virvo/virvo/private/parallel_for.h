@@ -0,0 +1,99 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_PRIVATE_PARALLEL_FOR_H
+#define VV_PRIVATE_PARALLEL_FOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vvtoolshed.h"
+
+namespace virvo
+{
+
+// Returns the number of worker threads to use for CPU-side volume
+// processing. Honors the VV_NUM_THREADS environment variable, like the
+// ray casting renderer does.
+inline unsigned numWorkerThreads()
+{
+    char* num_threads = getenv("VV_NUM_THREADS");
+    if (num_threads != NULL)
+    {
+        int n = std::atoi(num_threads);
+        if (n > 0)
+            return static_cast<unsigned>(n);
+    }
+
+    int n = vvToolshed::getNumProcessors();
+    return n > 0 ? static_cast<unsigned>(n) : 1U;
+}
+
+// Splits [first, last) into contiguous ranges and calls func(begin, end)
+// for each range on its own thread. The calling thread processes the
+// last range itself. Ranges are never smaller than grain, so small
+// problems are handled serially without spawning any threads.
+template <typename Func>
+void parallel_for(size_t first, size_t last, Func func, size_t grain = 1)
+{
+    if (last <= first)
+        return;
+
+    size_t count = last - first;
+    size_t num_chunks = numWorkerThreads();
+
+    if (grain == 0)
+        grain = 1;
+
+    if (num_chunks > count / grain)
+        num_chunks = count / grain;
+
+    if (num_chunks <= 1)
+    {
+        func(first, last);
+        return;
+    }
+
+    size_t chunk_size = count / num_chunks;
+    size_t remainder = count % num_chunks;
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_chunks - 1);
+
+    size_t begin = first;
+    for (size_t i = 0; i < num_chunks - 1; ++i)
+    {
+        size_t end = begin + chunk_size + (i < remainder ? 1 : 0);
+        threads.push_back(std::thread(func, begin, end));
+        begin = end;
+    }
+
+    func(begin, last);
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+}
+
+} // namespace virvo
+
+#endif // VV_PRIVATE_PARALLEL_FOR_H
@@ -0,0 +1,476 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include "vvaxiscache.h"
+#include "parallel_for.h"
+
+#include "vvtoolshed.h"
+#include "vvvoldesc.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <future>
+#include <list>
+#include <system_error>
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+// Offset of voxel (x,y,z) in the copy for an axis: origin + dot(stride, xyz)
+struct Layout
+{
+    ptrdiff_t origin;
+    ptrdiff_t stride[3];
+};
+
+Layout makeLayout(int axis, const ptrdiff_t vox[3])
+{
+    Layout l;
+    switch (axis)
+    {
+    case 0: // slices: x descending, lines: z, columns: y descending
+        l.origin = (vox[0] - 1) * vox[2] * vox[1] + vox[1] - 1;
+        l.stride[0] = -vox[2] * vox[1];
+        l.stride[1] = -1;
+        l.stride[2] = vox[1];
+        break;
+    case 1: // slices: y, lines: x descending, columns: z descending
+        l.origin = (vox[0] - 1) * vox[2] + vox[2] - 1;
+        l.stride[0] = -vox[2];
+        l.stride[1] = vox[0] * vox[2];
+        l.stride[2] = -1;
+        break;
+    default: // the voxel order of the volume
+        l.origin = 0;
+        l.stride[0] = 1;
+        l.stride[1] = vox[0];
+        l.stride[2] = vox[0] * vox[1];
+        break;
+    }
+    return l;
+}
+
+// Voxel (x,y,z) at column c, line l and slice s of the copy for an axis
+void toVolume(int axis, const ptrdiff_t vox[3], ptrdiff_t c, ptrdiff_t l, ptrdiff_t s, ptrdiff_t xyz[3])
+{
+    switch (axis)
+    {
+    case 0:
+        xyz[0] = vox[0] - 1 - s;
+        xyz[1] = vox[1] - 1 - c;
+        xyz[2] = l;
+        break;
+    case 1:
+        xyz[0] = vox[0] - 1 - l;
+        xyz[1] = s;
+        xyz[2] = vox[2] - 1 - c;
+        break;
+    default:
+        xyz[0] = c;
+        xyz[1] = l;
+        xyz[2] = s;
+        break;
+    }
+}
+
+// Line length, number of lines and number of slices of the copy for an axis
+void permutedSize(int axis, const ptrdiff_t vox[3], ptrdiff_t len[3])
+{
+    len[0] = vox[(axis + 1) % 3];
+    len[1] = vox[(axis + 2) % 3];
+    len[2] = vox[axis];
+}
+
+// Read voxels of the first channel of 8 bit data
+struct Read8
+{
+    const uint8_t* data;
+    size_t bpv;
+
+    uint8_t operator()(ptrdiff_t i) const { return data[i * bpv]; }
+};
+
+// Map data values to LUT entries like vvVolDesc::rescaleVoxel(): clamp to the
+// data range, then scale linearly or find the HDR bin
+struct Quantize
+{
+    const vvVolDesc* vd;
+    float rangeMin;
+    float rangeMax;
+    float scale;
+    int lutSize;
+
+    explicit Quantize(const vvVolDesc* v)
+        : vd(v)
+        , rangeMin(v->range(0)[0])
+        , rangeMax(v->range(0)[1])
+        , scale(0.0f)
+        , lutSize(AxisCache::getLUTSize(v))
+    {
+        if (rangeMax > rangeMin)
+            scale = float(lutSize) / (rangeMax - rangeMin);
+    }
+
+    uint16_t operator()(float value) const
+    {
+        value = ts_clamp(value, rangeMin, rangeMax);
+        if (vd->_binning != vvVolDesc::LINEAR)
+            return uint16_t(vd->findHDRBin(value));
+        return uint16_t(ts_clamp(int((value - rangeMin) * scale), 0, lutSize - 1));
+    }
+};
+
+// Read voxels of the first channel of 16 bit data, mapped to LUT entries by a table
+struct Read16
+{
+    const uint8_t* data;
+    size_t bpv;
+    const uint16_t* table;
+
+    uint16_t operator()(ptrdiff_t i) const
+    {
+        uint16_t value;
+        std::memcpy(&value, data + i * bpv, sizeof(value));
+        return table[value];
+    }
+};
+
+// Read voxels of the first channel of float data, mapped to LUT entries
+struct ReadFloat
+{
+    const uint8_t* data;
+    size_t bpv;
+    const Quantize* quantize;
+
+    uint16_t operator()(ptrdiff_t i) const
+    {
+        float value;
+        std::memcpy(&value, data + i * bpv, sizeof(value));
+        return (*quantize)(value);
+    }
+};
+
+// Read voxels of another copy
+template <typename T>
+struct ReadCopy
+{
+    const T* data;
+
+    T operator()(ptrdiff_t i) const { return data[i]; }
+};
+
+template <typename Dst, typename Read>
+void permuteSlices(Dst* dst, int axis, const ptrdiff_t vox[3], Layout const& src, Read read,
+        ptrdiff_t first, ptrdiff_t last)
+{
+    ptrdiff_t len[3];
+    permutedSize(axis, vox, len);
+
+    for (ptrdiff_t s = first; s < last; ++s)
+    {
+        for (ptrdiff_t l = 0; l < len[1]; ++l)
+        {
+            // The source offset is linear in the column index
+            ptrdiff_t xyz0[3];
+            ptrdiff_t xyz1[3];
+            toVolume(axis, vox, 0, l, s, xyz0);
+            toVolume(axis, vox, 1, l, s, xyz1);
+
+            ptrdiff_t offset = src.origin;
+            ptrdiff_t step = 0;
+            for (int i = 0; i < 3; ++i)
+            {
+                offset += src.stride[i] * xyz0[i];
+                step += src.stride[i] * (xyz1[i] - xyz0[i]);
+            }
+
+            Dst* d = dst + (s * len[1] + l) * len[0];
+            for (ptrdiff_t c = 0; c < len[0]; ++c, offset += step)
+                d[c] = read(offset);
+        }
+    }
+}
+
+template <typename Dst, typename Read>
+void permute(Dst* dst, int axis, const ptrdiff_t vox[3], Layout const& src, Read read, bool parallel)
+{
+    if (parallel)
+    {
+        parallel_for(0, vox[axis], [&](size_t first, size_t last)
+        {
+            permuteSlices(dst, axis, vox, src, read, ptrdiff_t(first), ptrdiff_t(last));
+        }, 4);
+    }
+    else
+    {
+        permuteSlices(dst, axis, vox, src, read, 0, vox[axis]);
+    }
+}
+
+// Build the copy for an axis from the current frame of vd, on all worker threads
+void buildFromFrame(uint8_t* dst, int axis, const vvVolDesc* vd)
+{
+    const ptrdiff_t vox[3] = { vd->vox[0], vd->vox[1], vd->vox[2] };
+    const Layout src = makeLayout(2, vox);
+    const uint8_t* data = vd->getConstRaw();
+    const size_t bpv = vd->getBPV();
+
+    switch (vd->bpc)
+    {
+    case 1:
+        {
+            Read8 read = { data, bpv };
+            permute(dst, axis, vox, src, read, true);
+        }
+        break;
+    case 2:
+        {
+            // 16 bit values are mapped to the data values first, see vvVolDesc::rescaleVoxel()
+            const Quantize quantize(vd);
+            const float mapMin = vd->mapping(0)[0];
+            const float mapMax = vd->mapping(0)[1];
+            std::vector< uint16_t > table(65536);
+            for (size_t v = 0; v < table.size(); ++v)
+                table[v] = quantize(mapMin + (mapMax - mapMin) * (float(v) / 65535.0f));
+
+            Read16 read = { data, bpv, &table[0] };
+            permute(reinterpret_cast< uint16_t* >(dst), axis, vox, src, read, true);
+        }
+        break;
+    default:
+        {
+            const Quantize quantize(vd);
+            ReadFloat read = { data, bpv, &quantize };
+            permute(reinterpret_cast< uint16_t* >(dst), axis, vox, src, read, true);
+        }
+        break;
+    }
+}
+
+// Build the copy for an axis from the copy for another axis, serially
+void buildFromCopy(uint8_t* dst, int axis, const uint8_t* data, int srcAxis, const ptrdiff_t vox[3], size_t bpv)
+{
+    const Layout src = makeLayout(srcAxis, vox);
+
+    if (bpv == 1)
+    {
+        ReadCopy< uint8_t > read = { data };
+        permute(dst, axis, vox, src, read, false);
+    }
+    else
+    {
+        ReadCopy< uint16_t > read = { reinterpret_cast< const uint16_t* >(data) };
+        permute(reinterpret_cast< uint16_t* >(dst), axis, vox, src, read, false);
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// AxisCache
+//
+
+bool AxisCache::Key::operator==(Key const& rhs) const
+{
+    return revision == rhs.revision
+        && std::equal(vox, vox + 3, rhs.vox)
+        && bpc == rhs.bpc && chan == rhs.chan
+        && range[0] == rhs.range[0] && range[1] == rhs.range[1]
+        && mapping[0] == rhs.mapping[0] && mapping[1] == rhs.mapping[1]
+        && binning == rhs.binning;
+}
+
+AxisCache::AxisCache()
+    : cache_(3)
+    , nextSerial_(1)
+{
+    std::memset(&key_, 0, sizeof(key_));
+}
+
+const uint8_t* AxisCache::get(const vvVolDesc* vd, int axis)
+{
+    assert(axis >= 0 && axis < 3);
+
+    validate(vd);
+
+    boost::shared_ptr< Entry > e = cache_.find(axis);
+
+    // The revision stays the same if only the storage of the frame changes,
+    // e.g. when it is compressed: an alias must still refer to the frame data
+    if (e && e->data.empty() && e->voxels != NULL && e->voxels != vd->getConstRaw())
+        e.reset();
+
+    if (!e)
+    {
+        e.reset(new Entry);
+        e->serial = nextSerial_++;
+
+        if (axis == 2 && vd->bpc == 1 && vd->getChan() == 1 && !vd->isCompressed() && !vd->isLazy())
+        {
+            // The frame data already is in the right order
+            e->voxels = vd->getConstRaw();
+        }
+        else
+        {
+            e->data.resize(vd->getFrameVoxels() * getBPV(vd));
+            e->voxels = e->data.empty() ? NULL : &e->data[0];
+            if (e->voxels != NULL)
+                buildFromFrame(&e->data[0], axis, vd);
+        }
+
+        cache_.insert(axis, e);
+    }
+
+    if (e->pending.valid())
+        e->pending.get();
+
+    const uint8_t* voxels = e->voxels;
+
+    cache_.touch(axis);
+
+    return voxels;
+}
+
+void AxisCache::prefetch(const vvVolDesc* vd, int axis)
+{
+    assert(axis >= 0 && axis < 3);
+
+    validate(vd);
+
+    // Keep the most recently requested copy
+    if (cache_.find(axis) || cache_.getCapacity() < 2)
+        return;
+
+    // Only copies owned by the cache are safe to read from another thread
+    boost::shared_ptr< Entry > src;
+    int srcAxis = -1;
+    for (std::list< int >::const_iterator it = cache_.recent().begin(); it != cache_.recent().end(); ++it)
+    {
+        boost::shared_ptr< Entry > s = cache_.find(*it);
+        if (!s->data.empty() && !s->pending.valid())
+        {
+            src = s;
+            srcAxis = *it;
+            break;
+        }
+    }
+
+    if (!src)
+        return;
+
+    boost::shared_ptr< Entry > e(new Entry);
+    e->data.resize(src->data.size());
+    e->voxels = &e->data[0];
+    e->serial = nextSerial_++;
+
+    const ptrdiff_t vox[3] = { vd->vox[0], vd->vox[1], vd->vox[2] };
+    const size_t bpv = getBPV(vd);
+    uint8_t* dst = &e->data[0];
+
+    try
+    {
+        // src keeps the source copy alive, even if it is released meanwhile
+        e->pending = std::async(std::launch::async, [=]() { buildFromCopy(dst, axis, src->voxels, srcAxis, vox, bpv); });
+    }
+    catch (std::system_error&)
+    {
+        // No thread available, get() builds the copy on demand
+        return;
+    }
+
+    // Insert behind the most recently requested copy
+    cache_.insert(axis, e);
+    cache_.touch(axis, false);
+}
+
+void AxisCache::setCapacity(size_t num)
+{
+    cache_.setCapacity(std::min(std::max(num, size_t(1)), size_t(3)));
+}
+
+void AxisCache::clear()
+{
+    cache_.clear();
+}
+
+size_t AxisCache::getSerial(int axis) const
+{
+    assert(axis >= 0 && axis < 3);
+    boost::shared_ptr< Entry > e = cache_.find(axis);
+    return e ? e->serial : 0;
+}
+
+size_t AxisCache::getBytes() const
+{
+    return cache_.getBytes();
+}
+
+int AxisCache::getLUTSize(const vvVolDesc* vd)
+{
+    if (vd->bpc == 1)
+        return 256;
+    // With HDR binning, the LUT entries are the bins
+    return (vd->_binning == vvVolDesc::LINEAR) ? 4096 : int(vvVolDesc::NUM_HDR_BINS);
+}
+
+size_t AxisCache::getBPV(const vvVolDesc* vd)
+{
+    return (vd->bpc == 1) ? 1 : 2;
+}
+
+void AxisCache::validate(const vvVolDesc* vd)
+{
+    Key key;
+    std::memset(&key, 0, sizeof(key));
+    key.revision = vd->getRevision();
+    for (int i = 0; i < 3; ++i)
+        key.vox[i] = size_t(vd->vox[i]);
+    key.bpc = vd->bpc;
+    key.chan = size_t(vd->getChan());
+    if (vd->bpc != 1)
+    {
+        // 16 bit and float data are quantized with the data range and binning,
+        // 16 bit data are mapped to data values first
+        key.range[0] = vd->range(0)[0];
+        key.range[1] = vd->range(0)[1];
+        key.binning = int(vd->_binning);
+        if (vd->bpc == 2)
+        {
+            key.mapping[0] = vd->mapping(0)[0];
+            key.mapping[1] = vd->mapping(0)[1];
+        }
+    }
+
+    if (!(key == key_))
+    {
+        clear();
+        key_ = key;
+    }
+}
+
+
+} // namespace virvo
@@ -0,0 +1,128 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_AXISCACHE_H
+#define VV_AXISCACHE_H
+
+
+#include <cstddef>
+
+#include "vvbuffercache.h"
+#include "vvinttypes.h"
+
+
+class vvVolDesc;
+
+
+namespace virvo
+{
+
+
+// Permuted copies of the current animation frame, as used by the shear-warp
+// renderers, one per principal viewing axis (0=x, 1=y, 2=z).
+//
+// The first channel of the frame is converted to lookup table indices:
+// 8 bit data is kept as is, 16 bit and float data are mapped to
+// getLUTSize() entries like vvVolDesc::rescaleVoxel() does, using the value
+// mapping, data range and binning, and stored with two bytes per voxel. The
+// voxels are stored slice by slice along the axis, the permutations are
+// those documented for vvSoftVR.
+//
+// Copies are built when they are first requested, and the most recently
+// requested getCapacity() copies are kept. The z axis copy of dense 8 bit
+// single channel data is not a copy at all, it refers to the frame data.
+// All copies are released when the revision of the current frame (see
+// vvVolDesc::getRevision()), the data layout or, for 16 bit and float data,
+// the mapping, range or binning of the volume changes. After the voxel data
+// were modified without getting a new revision, clear() must be called.
+//
+// Like BufferCache, the cache must only be used by the thread that owns the
+// volume. It may be shared by several renderers of the same volume.
+class AxisCache
+{
+public:
+    AxisCache();
+
+    // Return the copy for an axis of the current frame of vd. Waits if the
+    // copy is being built in the background and builds it now, on all
+    // worker threads, if it is not cached.
+    const uint8_t* get(const vvVolDesc* vd, int axis);
+
+    // Start building the copy for an axis in the background unless it is
+    // cached. Only done if the cache can hold another copy, and only from
+    // a copy owned by the cache, never from the volume data.
+    void prefetch(const vvVolDesc* vd, int axis);
+
+    // Set the number of copies that are kept [1..3]
+    void setCapacity(size_t num);
+
+    size_t getCapacity() const { return cache_.getCapacity(); }
+
+    // Release all copies
+    void clear();
+
+    // Identifies the data returned by get(): differs for every copy that
+    // was built. 0 if the axis is not cached.
+    size_t getSerial(int axis) const;
+
+    // Memory occupied by the copies, including copies being built [bytes]
+    size_t getBytes() const;
+
+    // Number of lookup table entries the voxels are converted to
+    static int getLUTSize(const vvVolDesc* vd);
+
+    // Bytes per voxel of the copies
+    static size_t getBPV(const vvVolDesc* vd);
+
+private:
+    struct Key
+    {
+        size_t revision;
+        size_t vox[3];
+        size_t bpc;
+        size_t chan;
+        float range[2];
+        float mapping[2];
+        int binning;
+
+        bool operator==(Key const& rhs) const;
+    };
+
+    // pending is valid while the copy is built in the background
+    struct Entry : CacheBuffer< void >
+    {
+        // Points into data, or to the volume data if the copy is an alias
+        const uint8_t* voxels;
+        size_t serial;
+    };
+
+    // All copies are listed, by axis
+    BufferCache< int, Entry > cache_;
+    Key key_;
+    size_t nextSerial_;
+
+    void validate(const vvVolDesc* vd);
+};
+
+
+} // namespace virvo
+
+
+#endif // VV_AXISCACHE_H
@@ -0,0 +1,193 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_BUFFERCACHE_H
+#define VV_BUFFERCACHE_H
+
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+// A buffer that is filled on demand or on a background thread
+template < typename Result >
+struct CacheBuffer
+{
+    std::vector< uint8_t > data;
+    // Valid while the buffer is filled in the background.
+    // Declared after data, so that it is destroyed (and waited for) first.
+    std::future< Result > pending;
+};
+
+
+// Buffers derived from volume data, e.g. decompressed frames, identified by
+// a key. Entry must be derived from CacheBuffer.
+//
+// Entries are either listed as recently used, of which the getCapacity()
+// most recent ones are kept, or unlisted, which are kept until they are
+// erased. Entries are shared pointers, so a background job may keep its
+// input alive after the entry was released.
+//
+// The cache is not thread safe, it must only be used by the thread that
+// owns the volume.
+template < typename Key, typename Entry >
+class BufferCache
+{
+public:
+    typedef boost::shared_ptr< Entry > EntryPtr;
+    typedef std::map< Key, EntryPtr > Entries;
+
+    explicit BufferCache(size_t capacity)
+        : capacity_(capacity)
+    {
+    }
+
+    // Waits for all background work
+    ~BufferCache()
+    {
+        clear();
+    }
+
+    // Return the entry for key, or NULL if there is none
+    EntryPtr find(Key const& key) const
+    {
+        typename Entries::const_iterator it = entries_.find(key);
+        return it != entries_.end() ? it->second : EntryPtr();
+    }
+
+    // Store an entry, replacing the previous one for key. The entry is
+    // unlisted until it is touched.
+    void insert(Key const& key, EntryPtr const& e)
+    {
+        unlist(key);
+        entries_[key] = e;
+    }
+
+    // Mark an entry as the most recently used one, or as the second most
+    // recently used one if first is false, and release the least recently
+    // used entries beyond the capacity
+    void touch(Key const& key, bool first = true)
+    {
+        unlist(key);
+
+        typename std::list< Key >::iterator pos = recent_.begin();
+        if (!first && pos != recent_.end())
+            ++pos;
+        recent_.insert(pos, key);
+
+        trim();
+    }
+
+    // Remove an entry from the recently used ones, it is kept until it is erased
+    void unlist(Key const& key)
+    {
+        recent_.remove(key);
+    }
+
+    bool isListed(Key const& key) const
+    {
+        return std::find(recent_.begin(), recent_.end(), key) != recent_.end();
+    }
+
+    // Keys of the recently used entries, most recently used first
+    std::list< Key > const& recent() const { return recent_; }
+
+    Entries const& entries() const { return entries_; }
+
+    // Release an entry
+    void erase(Key const& key)
+    {
+        entries_.erase(key);
+        recent_.remove(key);
+    }
+
+    // Release the unlisted entries for which pred returns false
+    template < typename Pred >
+    void retainUnlisted(Pred pred)
+    {
+        typename Entries::iterator it = entries_.begin();
+        while (it != entries_.end())
+        {
+            if (pred(it->first) || isListed(it->first))
+                ++it;
+            else
+                entries_.erase(it++);
+        }
+    }
+
+    // Release all entries
+    void clear()
+    {
+        entries_.clear();
+        recent_.clear();
+    }
+
+    // Set the number of recently used entries that are kept
+    void setCapacity(size_t num)
+    {
+        capacity_ = num;
+        trim();
+    }
+
+    size_t getCapacity() const { return capacity_; }
+
+    // Memory occupied by the buffers, including buffers being filled [bytes]
+    size_t getBytes() const
+    {
+        size_t bytes = 0;
+        for (typename Entries::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+            bytes += it->second->data.size();
+        return bytes;
+    }
+
+private:
+    Entries entries_;
+    // Listed entries, most recently used first
+    std::list< Key > recent_;
+    size_t capacity_;
+
+    void trim()
+    {
+        while (recent_.size() > capacity_)
+        {
+            entries_.erase(recent_.back());
+            recent_.pop_back();
+        }
+    }
+};
+
+
+} // namespace virvo
+
+
+#endif // VV_BUFFERCACHE_H
@@ -0,0 +1,569 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvcompiledtf.h"
+
+#include "math/math.h"
+#include "vvtfwidget.h"
+#include "vvtoolshed.h"
+
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+//--------------------------------------------------------------------------------------------------
+// Lane helpers, the widget evaluators are written once for float and simd::float4
+//
+
+inline float select(bool m, float a, float b)
+{
+    return m ? a : b;
+}
+
+inline float vmax(float a, float b)
+{
+    return ts_max(a, b);
+}
+
+inline float vmin(float a, float b)
+{
+    return ts_min(a, b);
+}
+
+template <typename F>
+F loadLanes(const float* p);
+
+template <>
+inline float loadLanes<float>(const float* p)
+{
+    return *p;
+}
+
+inline void storeLanes(float* p, float v)
+{
+    *p = v;
+}
+
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+
+inline simd::float4 vmax(simd::float4 const& a, simd::float4 const& b)
+{
+    return simd::max(a, b);
+}
+
+inline simd::float4 vmin(simd::float4 const& a, simd::float4 const& b)
+{
+    return simd::min(a, b);
+}
+
+template <>
+inline simd::float4 loadLanes<simd::float4>(const float* p)
+{
+    return _mm_loadu_ps(p);
+}
+
+inline void storeLanes(float* p, simd::float4 const& v)
+{
+    _mm_storeu_ps(p, v);
+}
+
+#endif
+
+// Call op.run<F>(i) for lanes [0..n), four lanes at a time where possible
+template <typename Op>
+void forEachLane(Op const& op, size_t n)
+{
+    size_t i = 0;
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    for (; i + 4 <= n; i += 4)
+        op.template run<simd::float4>(i);
+#endif
+    for (; i < n; ++i)
+        op.template run<float>(i);
+}
+
+// Number of TF entries evaluated at once
+const size_t BATCH_SIZE = 64;
+
+// Per-lane results of a batch
+struct Batch
+{
+    const float* x;                             // opacity coordinates
+    float xc[BATCH_SIZE];                       // color coordinates (differ with discrete colors)
+    float opacity[BATCH_SIZE];
+    float color[3][BATCH_SIZE];
+    float own[BATCH_SIZE];                      // 1 if a widget with its own color covers the lane
+    float skip[BATCH_SIZE];                     // 1 if a skip widget covers the lane
+    float tmp[BATCH_SIZE];
+};
+
+// vvToolshed::interpolateLinear() with the x values already sorted
+template <typename F, typename I>
+F interpolate(I const& i, F x)
+{
+    if (i.x1 == i.x2)
+        return F(ts_max(i.y1, i.y2));
+    return (F(i.y2 - i.y1) * (x - F(i.x1))) / F(i.x2 - i.x1) + F(i.y1);
+}
+
+// Add a widget color to the lanes where inside is set
+template <typename F, typename M>
+void addColor(Batch& b, size_t i, M const& inside, const float* color)
+{
+    for (int c = 0; c < 3; ++c)
+    {
+        F col = loadLanes<F>(b.color[c] + i);
+        storeLanes(b.color[c] + i, select(inside, vmax(col, F(color[c])), col));
+    }
+    storeLanes(b.own + i, select(inside, F(1.0f), loadLanes<F>(b.own + i)));
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Widget evaluators, same arithmetic as the getOpacity() and getColor()
+// functions of the widgets
+//
+
+template <typename W>
+struct WidgetOp
+{
+    W const& w;
+    Batch& b;
+    size_t dim;
+
+    WidgetOp(W const& widget, Batch& batch, size_t d) : w(widget), b(batch), dim(d) {}
+};
+
+struct PyramidOp : WidgetOp< CompiledTF::Pyramid >
+{
+    bool yInner, zInner;                        // row within the plateau
+    float yFactor;                              // 2D: factor of the flank along y
+
+    PyramidOp(CompiledTF::Pyramid const& p, Batch& batch, size_t d, float y, float z)
+        : WidgetOp< CompiledTF::Pyramid >(p, batch, d)
+    {
+        yInner = y >= p.inMin[1] && y <= p.inMax[1];
+        zInner = z >= p.inMin[2] && z <= p.inMax[2];
+        yFactor = 1.0f;
+        if (y > p.pos[1] && y > p.inMax[1])
+            yFactor = (y - p.outMax[1]) / (p.inMax[1] - p.outMax[1]);
+        else if (y <= p.pos[1] && y < p.inMin[1])
+            yFactor = (y - p.outMin[1]) / (p.inMin[1] - p.outMin[1]);
+    }
+
+    template <typename F>
+    void run(size_t i) const
+    {
+        F x = loadLanes<F>(b.x + i);
+        auto outside = (x < F(w.outMin[0])) | (x > F(w.outMax[0]));
+        auto xInner = (x >= F(w.inMin[0])) & (x <= F(w.inMax[0]));
+
+        F v(0.0f);
+        if (dim == 1)
+        {
+            v = select(x < F(w.inMin[0]), interpolate(w.left, x),
+                    select(x > F(w.inMax[0]), interpolate(w.right, x), F(0.0f)));
+            v = select(xInner, F(w.opacity), v);
+        }
+        else if (dim == 2)
+        {
+            F r2 = select(x > F(w.pos[0]),
+                    select(x > F(w.inMax[0]), (F(w.outMax[0]) - x) / F(w.outMax[0] - w.inMax[0]), F(1.0f)),
+                    select(x < F(w.inMin[0]), (F(w.outMin[0]) - x) / F(w.outMin[0] - w.inMin[0]), F(1.0f)));
+            v = F(yFactor) * r2;
+            if (yInner)
+                v = select(xInner, F(w.opacity), v);
+        }
+        else if (yInner && zInner)
+        {
+            v = select(xInner, F(w.opacity), F(0.0f));
+        }
+
+        v = select(outside, F(0.0f), v);
+        storeLanes(b.opacity + i, vmax(loadLanes<F>(b.opacity + i), v));
+
+        if (w.ownColor)
+        {
+            F xc = loadLanes<F>(b.xc + i);
+            addColor<F>(b, i, (xc >= F(w.outMin[0])) & (xc <= F(w.outMax[0])), w.color);
+        }
+    }
+};
+
+struct BellOp : WidgetOp< CompiledTF::Bell >
+{
+    float rowExponent[2];                       // exponent terms of y and z
+
+    BellOp(CompiledTF::Bell const& bell, Batch& batch, size_t d, float y, float z)
+        : WidgetOp< CompiledTF::Bell >(bell, batch, d)
+    {
+        rowExponent[0] = (y - bell.pos[1]) * (y - bell.pos[1]) / bell.denom[1];
+        rowExponent[1] = (z - bell.pos[2]) * (z - bell.pos[2]) / bell.denom[2];
+    }
+
+    // Exponent of the Gaussian, or -1 outside of the bell
+    template <typename F>
+    void run(size_t i) const
+    {
+        F x = loadLanes<F>(b.x + i);
+        F d = x - F(w.pos[0]);
+        F e = d * d / F(w.denom[0]);
+        if (dim > 1) e = e + F(rowExponent[0]);
+        if (dim > 2) e = e + F(rowExponent[1]);
+        storeLanes(b.tmp + i, select((x < F(w.bMin[0])) | (x > F(w.bMax[0])), F(-1.0f), e));
+
+        if (w.ownColor)
+        {
+            F xc = loadLanes<F>(b.xc + i);
+            addColor<F>(b, i, (xc >= F(w.bMin[0])) & (xc <= F(w.bMax[0])), w.color);
+        }
+    }
+};
+
+struct SkipOp : WidgetOp< CompiledTF::Box >
+{
+    SkipOp(CompiledTF::Box const& box, Batch& batch, size_t d)
+        : WidgetOp< CompiledTF::Box >(box, batch, d)
+    {
+    }
+
+    template <typename F>
+    void run(size_t i) const
+    {
+        F x = loadLanes<F>(b.x + i);
+        storeLanes(b.skip + i, select((x >= F(w.min[0])) & (x <= F(w.max[0])), F(1.0f), loadLanes<F>(b.skip + i)));
+    }
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// CompiledTF
+//
+
+CompiledTF::CompiledTF(std::vector< vvTFWidget* > const& widgets, int discreteColors)
+    : discreteColors_(discreteColors)
+{
+    for (std::vector< vvTFWidget* >::const_iterator it = widgets.begin(); it != widgets.end(); ++it)
+    {
+        vvTFWidget* w = *it;
+        const std::type_info& type = typeid(*w);
+
+        // Background colors come from all color widgets, including derived types
+        if (vvTFColor* cw = dynamic_cast< vvTFColor* >(w))
+        {
+            ColorPin pin;
+            pin.pos = cw->_pos[0];
+            for (int c = 0; c < 3; ++c)
+                pin.color[c] = cw->_col[c];
+            pins_.push_back(pin);
+        }
+
+        if (type == typeid(vvTFPyramid))
+        {
+            vvTFPyramid* pw = static_cast< vvTFPyramid* >(w);
+            Pyramid p;
+            for (int i = 0; i < 3; ++i)
+            {
+                p.pos[i] = pw->_pos[i];
+                p.outMin[i] = pw->_pos[i] - pw->_bottom[i] / 2.0f;
+                p.outMax[i] = pw->_pos[i] + pw->_bottom[i] / 2.0f;
+                p.inMin[i] = pw->_pos[i] - pw->_top[i] / 2.0f;
+                p.inMax[i] = pw->_pos[i] + pw->_top[i] / 2.0f;
+            }
+            p.opacity = pw->_opacity;
+            Interval left = { p.outMin[0], 0.0f, p.inMin[0], p.opacity };
+            Interval right = { p.inMax[0], p.opacity, p.outMax[0], 0.0f };
+            if (left.x1 > left.x2) { std::swap(left.x1, left.x2); std::swap(left.y1, left.y2); }
+            if (right.x1 > right.x2) { std::swap(right.x1, right.x2); std::swap(right.y1, right.y2); }
+            p.left = left;
+            p.right = right;
+            p.ownColor = pw->hasOwnColor();
+            for (int c = 0; c < 3; ++c)
+                p.color[c] = pw->_col[c];
+            pyramids_.push_back(p);
+        }
+        else if (type == typeid(vvTFBell))
+        {
+            vvTFBell* bw = static_cast< vvTFBell* >(w);
+            const float WIDTH_ADJUST = 5.0f;
+            const float HEIGHT_ADJUST = 0.1f;
+            const float sqrt2pi = sqrtf(2.0f * TS_PI);
+            Bell bell;
+            float factor = 1.0f;
+            for (int i = 0; i < 3; ++i)
+            {
+                bell.pos[i] = bw->_pos[i];
+                bell.bMin[i] = bw->_pos[i] - bw->_size[i] / 2.0f;
+                bell.bMax[i] = bw->_pos[i] + bw->_size[i] / 2.0f;
+                float stdev = bw->_size[i] / WIDTH_ADJUST;
+                bell.denom[i] = 2.0f * stdev * stdev;
+                factor *= sqrt2pi * stdev;
+                bell.factor[i] = factor;
+            }
+            bell.height = HEIGHT_ADJUST * bw->_opacity;
+            bell.ownColor = bw->hasOwnColor();
+            for (int c = 0; c < 3; ++c)
+                bell.color[c] = bw->_col[c];
+            bells_.push_back(bell);
+        }
+        else if (type == typeid(vvTFSkip) || type == typeid(vvTFCustom))
+        {
+            vec3 size = type == typeid(vvTFSkip) ? static_cast< vvTFSkip* >(w)->_size
+                                                 : static_cast< vvTFCustom* >(w)->_size;
+            Box box;
+            for (int i = 0; i < 3; ++i)
+            {
+                box.min[i] = w->_pos[i] - size[i] / 2.0f;
+                box.max[i] = w->_pos[i] + size[i] / 2.0f;
+            }
+            box.pos = w->_pos[0];
+            box.halfSize = size[0] / 2.0f;
+            box.firstPoint = pointPos_.size();
+            box.numPoints = 0;
+            if (type == typeid(vvTFSkip))
+            {
+                skips_.push_back(box);
+            }
+            else
+            {
+                std::list< vvTFPoint* > const& points = static_cast< vvTFCustom* >(w)->_points;
+                for (std::list< vvTFPoint* >::const_iterator p = points.begin(); p != points.end(); ++p)
+                {
+                    pointPos_.push_back((*p)->_pos[0]);
+                    pointOpacity_.push_back((*p)->_opacity);
+                }
+                box.numPoints = points.size();
+                customs_.push_back(box);
+            }
+        }
+        else if (type != typeid(vvTFColor) && type != typeid(vvTFWidget))
+        {
+            // vvTFColor and the base class have no opacity and no own color
+            generic_.push_back(w);
+        }
+    }
+
+    // Stable, so that the first of several pins at the same position is used
+    std::stable_sort(pins_.begin(), pins_.end(), [](ColorPin const& a, ColorPin const& b) { return a.pos < b.pos; });
+}
+
+void CompiledTF::evaluate(const float* x, size_t n, float y, float z, float* rgba) const
+{
+    // Determine dimensionality of transfer function:
+    size_t dim = 1;
+    if (z > -1.0f) dim = 3;
+    else if (y > -1.0f) dim = 2;
+
+    // Widgets that do not overlap the row contribute nothing
+    auto overlaps = [&](const float* min, const float* max)
+    {
+        return (dim < 2 || (y >= min[1] && y <= max[1])) && (dim < 3 || (z >= min[2] && z <= max[2]));
+    };
+
+    std::vector< const Pyramid* > pyramids;
+    for (size_t i = 0; i < pyramids_.size(); ++i)
+    {
+        if (overlaps(pyramids_[i].outMin, pyramids_[i].outMax))
+            pyramids.push_back(&pyramids_[i]);
+    }
+
+    std::vector< const Bell* > bells;
+    for (size_t i = 0; i < bells_.size(); ++i)
+    {
+        if (overlaps(bells_[i].bMin, bells_[i].bMax))
+            bells.push_back(&bells_[i]);
+    }
+
+    std::vector< const Box* > skips;
+    for (size_t i = 0; i < skips_.size(); ++i)
+    {
+        if (overlaps(skips_[i].min, skips_[i].max))
+            skips.push_back(&skips_[i]);
+    }
+
+    std::vector< const Box* > customs;
+    for (size_t i = 0; i < customs_.size(); ++i)
+    {
+        if (overlaps(customs_[i].min, customs_[i].max) && customs_[i].numPoints > 0)
+            customs.push_back(&customs_[i]);
+    }
+
+    Batch b;
+    for (size_t first = 0; first < n; first += BATCH_SIZE)
+    {
+        const size_t m = std::min(BATCH_SIZE, n - first);
+        b.x = x + first;
+
+        for (size_t i = 0; i < m; ++i)
+        {
+            float xc = b.x[i];
+            if (discreteColors_ > 0)
+            {
+                float rangeWidth = 1.0f / discreteColors_;
+                int currentRange = int(xc * discreteColors_);
+                if (currentRange >= discreteColors_)   // constrain range to valid ranges
+                    currentRange = discreteColors_ - 1;
+                xc = currentRange * rangeWidth + (rangeWidth / 2.0f);
+            }
+            b.xc[i] = xc;
+        }
+
+        std::fill(b.opacity, b.opacity + m, 0.0f);
+        for (int c = 0; c < 3; ++c)
+            std::fill(b.color[c], b.color[c] + m, 0.0f);
+        std::fill(b.own, b.own + m, 0.0f);
+        std::fill(b.skip, b.skip + m, 0.0f);
+
+        for (size_t w = 0; w < pyramids.size(); ++w)
+            forEachLane(PyramidOp(*pyramids[w], b, dim, y, z), m);
+
+        for (size_t w = 0; w < bells.size(); ++w)
+        {
+            const Bell& bell = *bells[w];
+            forEachLane(BellOp(bell, b, dim, y, z), m);
+            for (size_t i = 0; i < m; ++i)
+            {
+                if (b.tmp[i] >= 0.0f)
+                    b.opacity[i] = ts_max(b.opacity[i], ts_min(bell.height * expf(-b.tmp[i]) / bell.factor[dim - 1], 1.0f));
+            }
+        }
+
+        for (size_t w = 0; w < skips.size(); ++w)
+            forEachLane(SkipOp(*skips[w], b, dim), m);
+
+        for (size_t w = 0; w < customs.size(); ++w)
+        {
+            const Box& box = *customs[w];
+            const float* pos = &pointPos_[box.firstPoint];
+            const float* opacity = &pointOpacity_[box.firstPoint];
+            for (size_t i = 0; i < m; ++i)
+            {
+                if (b.x[i] < box.min[0] || b.x[i] > box.max[0])
+                    continue;
+
+                float xTF = b.x[i] - box.pos;     // x in widget space
+                size_t p = 0;
+                while (p < box.numPoints && xTF >= pos[p])
+                    ++p;
+
+                float v;
+                if (p == 0)                       // between left edge and first control point
+                    v = vvToolshed::interpolateLinear(-box.halfSize, 0.0f, pos[0], opacity[0], xTF);
+                else if (p < box.numPoints)       // between two control points
+                    v = vvToolshed::interpolateLinear(pos[p - 1], opacity[p - 1], pos[p], opacity[p], xTF);
+                else                              // between last control point and right edge
+                    v = vvToolshed::interpolateLinear(pos[p - 1], opacity[p - 1], box.halfSize, 0.0f, xTF);
+                b.opacity[i] = ts_max(b.opacity[i], v);
+            }
+        }
+
+        // Other widget types, dispatched like vvTransFunc::computeOpacity() and computeColor()
+        for (size_t w = 0; w < generic_.size(); ++w)
+        {
+            vvTFWidget* widget = generic_[w];
+            const bool isSkip = dynamic_cast< vvTFSkip* >(widget) != NULL;
+            bool ownColor = false;
+            if (vvTFPyramid* pw = dynamic_cast< vvTFPyramid* >(widget)) ownColor = pw->hasOwnColor();
+            else if (vvTFBell* bw = dynamic_cast< vvTFBell* >(widget)) ownColor = bw->hasOwnColor();
+            else if (vvTFCustom2D* cw = dynamic_cast< vvTFCustom2D* >(widget)) ownColor = cw->hasOwnColor();
+            else if (vvTFCustomMap* cmw = dynamic_cast< vvTFCustomMap* >(widget)) ownColor = cmw->hasOwnColor();
+
+            for (size_t i = 0; i < m; ++i)
+            {
+                float v = widget->getOpacity(b.x[i], y, z);
+                if (isSkip && v == 0.0f) b.skip[i] = 1.0f;
+                else b.opacity[i] = ts_max(b.opacity[i], v);
+
+                vvColor col;
+                if (ownColor && widget->getColor(col, b.xc[i], y, z))
+                {
+                    for (int c = 0; c < 3; ++c)
+                        b.color[c][i] = ts_max(b.color[c][i], col[c]);
+                    b.own[i] = 1.0f;
+                }
+            }
+        }
+
+        float* out = rgba + first * 4;
+        for (size_t i = 0; i < m; ++i)
+        {
+            if (b.own[i] != 0.0f)
+            {
+                for (int c = 0; c < 3; ++c)
+                    out[i * 4 + c] = b.color[c][i];
+            }
+            else
+            {
+                background(b.xc[i], out + i * 4);
+            }
+            out[i * 4 + 3] = b.skip[i] != 0.0f ? 0.0f : b.opacity[i];
+        }
+    }
+}
+
+// Same as vvTransFunc::computeBGColor()
+void CompiledTF::background(float x, float* color) const
+{
+    if (pins_.empty())
+    {
+        vvColor col;
+        for (int c = 0; c < 3; ++c)
+            color[c] = col[c];
+        return;
+    }
+
+    auto less = [](ColorPin const& a, ColorPin const& b) { return a.pos < b.pos; };
+    ColorPin probe;
+    probe.pos = x;
+
+    // First pin after x, and first pin at the largest position <= x
+    std::vector< ColorPin >::const_iterator after = std::upper_bound(pins_.begin(), pins_.end(), probe, less);
+    std::vector< ColorPin >::const_iterator before = pins_.end();
+    if (after != pins_.begin())
+        before = std::lower_bound(pins_.begin(), after, *(after - 1), less);
+
+    if (before == pins_.end())
+    {
+        std::copy(after->color, after->color + 3, color);
+    }
+    else if (after == pins_.end())
+    {
+        std::copy(before->color, before->color + 3, color);
+    }
+    else
+    {
+        for (int c = 0; c < 3; ++c)
+            color[c] = vvToolshed::interpolateLinear(before->pos, before->color[c], after->pos, after->color[c], x);
+    }
+}
+
+
+} // namespace virvo
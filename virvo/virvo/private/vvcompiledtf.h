@@ -0,0 +1,123 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_COMPILEDTF_H
+#define VV_COMPILEDTF_H
+
+
+#include <cstddef>
+#include <vector>
+
+#include "vvinttypes.h"
+
+
+class vvTFWidget;
+
+
+namespace virvo
+{
+
+
+// Transfer function widgets flattened into plain parameter arrays, one
+// array per widget type, to evaluate whole rows of transfer function space.
+//
+// Results are the same as with vvTransFunc::computeColor() and
+// vvTransFunc::computeOpacity(). Points are evaluated in rows with the same
+// y and z coordinates: widgets that do not overlap the row are skipped, the
+// built-in widget types are evaluated along x in SIMD batches without any
+// virtual calls or casts. Widgets of other types (e.g. vvTFCustom2D and
+// vvTFCustomMap) are evaluated through their virtual functions.
+//
+// A CompiledTF is a snapshot of the widgets, it must be rebuilt after the
+// transfer function was edited and must not outlive the widgets.
+class CompiledTF
+{
+public:
+    CompiledTF(std::vector< vvTFWidget* > const& widgets, int discreteColors);
+
+    // Evaluate the n points (x[i], y, z) and store RGBA tuples to rgba.
+    // y and z are -1 for lower-dimensional transfer functions.
+    void evaluate(const float* x, size_t n, float y, float z, float* rgba) const;
+
+    // False if evaluate() calls widgets whose functions are not thread
+    // safe, then rows must not be evaluated concurrently
+    bool isThreadSafe() const { return generic_.empty(); }
+
+    // Widget parameters, precomputed as far as the results stay the same
+    struct Interval
+    {
+        float x1, y1, x2, y2;                   // sorted by x, constant max(y1, y2) if x1 == x2
+    };
+
+    struct Pyramid
+    {
+        float pos[3];
+        float outMin[3], outMax[3];
+        float inMin[3], inMax[3];
+        float opacity;
+        Interval left, right;                   // 1D flanks
+        bool ownColor;
+        float color[3];
+    };
+
+    struct Bell
+    {
+        float pos[3];
+        float bMin[3], bMax[3];
+        float denom[3];                         // 2 * stdev^2
+        float height;                           // HEIGHT_ADJUST * opacity
+        float factor[3];                        // normalization for 1, 2 and 3 dimensions
+        bool ownColor;
+        float color[3];
+    };
+
+    struct Box                                  // skip and custom widgets
+    {
+        float min[3], max[3];
+        float pos;
+        float halfSize;
+        size_t firstPoint, numPoints;           // control points of custom widgets
+    };
+
+    struct ColorPin
+    {
+        float pos;
+        float color[3];
+    };
+
+private:
+    std::vector< Pyramid > pyramids_;
+    std::vector< Bell > bells_;
+    std::vector< Box > skips_;
+    std::vector< Box > customs_;
+    std::vector< float > pointPos_;             // control points of all custom widgets
+    std::vector< float > pointOpacity_;
+    std::vector< ColorPin > pins_;              // color widgets, sorted by position
+    std::vector< vvTFWidget* > generic_;
+    int discreteColors_;
+
+    void background(float x, float* color) const;
+};
+
+
+} // namespace virvo
+
+
+#endif // VV_COMPILEDTF_H
@@ -26,6 +26,7 @@
 #include "vvexport.h"
 #include "../vvpixelformat.h"
 
+#include <cstddef>
 #include <vector>
 
 
@@ -40,13 +41,21 @@ class CompressedVector;
 // Snappy
 //--------------------------------------------------------------------------------------------------
 
-VVAPI bool encodeSnappy(std::vector<unsigned char>& data);
+// The Snappy codec is part of virvo_fileio, so that vvVolDesc can use it
 
-VVAPI bool decodeSnappy(std::vector<unsigned char>& data);
+VVFILEIOAPI bool encodeSnappy(std::vector<unsigned char>& data);
 
-VVAPI bool encodeSnappy(CompressedVector& data);
+VVFILEIOAPI bool decodeSnappy(std::vector<unsigned char>& data);
 
-VVAPI bool decodeSnappy(CompressedVector& data);
+VVFILEIOAPI bool encodeSnappy(CompressedVector& data);
+
+VVFILEIOAPI bool decodeSnappy(CompressedVector& data);
+
+// Compress len bytes starting at data into compressed
+VVFILEIOAPI bool encodeSnappy(unsigned char const* data, size_t len, std::vector<unsigned char>& compressed);
+
+// Decompress size bytes starting at data into dst, which must hold exactly len bytes
+VVFILEIOAPI bool decodeSnappy(unsigned char const* data, size_t size, unsigned char* dst, size_t len);
 
 
 //--------------------------------------------------------------------------------------------------
@@ -73,6 +73,31 @@ bool virvo::decodeSnappy(std::vector<unsigned char>& data)
 }
 
 
+bool virvo::encodeSnappy(unsigned char const* data, size_t len, std::vector<unsigned char>& compressed)
+{
+    compressed.resize(snappy::MaxCompressedLength(len));
+
+    size_t clen = 0;
+
+    snappy::RawCompress((char const*)data, len, (char*)&compressed[0], &clen);
+
+    compressed.resize(clen);
+
+    return true;
+}
+
+
+bool virvo::decodeSnappy(unsigned char const* data, size_t size, unsigned char* dst, size_t len)
+{
+    size_t ulen = 0;
+
+    if (!snappy::GetUncompressedLength((char const*)data, size, &ulen) || ulen != len)
+        return false;
+
+    return snappy::RawUncompress((char const*)data, size, (char*)dst);
+}
+
+
 #else // HAVE_SNAPPY
 
 
@@ -88,6 +113,18 @@ bool virvo::decodeSnappy(std::vector<unsigned char>& /*data*/)
 }
 
 
+bool virvo::encodeSnappy(unsigned char const* /*data*/, size_t /*len*/, std::vector<unsigned char>& /*compressed*/)
+{
+    return false;
+}
+
+
+bool virvo::decodeSnappy(unsigned char const* /*data*/, size_t /*size*/, unsigned char* /*dst*/, size_t /*len*/)
+{
+    return false;
+}
+
+
 #endif // !HAVE_SNAPPY
 
 
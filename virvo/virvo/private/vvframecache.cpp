@@ -0,0 +1,325 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include "vvframecache.h"
+#include "vvcompress.h"
+#include "parallel_for.h"
+
+#include "vvtoolshed.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <system_error>
+
+
+namespace virvo
+{
+
+
+//--------------------------------------------------------------------------------------------------
+// CompressedFrame
+//
+
+const size_t CompressedFrame::DEFAULT_BRICK_BYTES;
+
+CompressedFrame::CompressedFrame(const uint8_t* data,
+        size_t frameBytes,
+        size_t sliceBytes,
+        size_t brickBytes)
+    : frameBytes_(frameBytes)
+{
+    // Round the brick size to whole slices
+    if (sliceBytes == 0 || sliceBytes > frameBytes)
+        sliceBytes = std::max(frameBytes, size_t(1));
+
+    brickBytes_ = std::max(brickBytes / sliceBytes, size_t(1)) * sliceBytes;
+
+    const size_t numBricks = (frameBytes_ + brickBytes_ - 1) / brickBytes_;
+
+    std::vector< std::vector< unsigned char > > bricks(numBricks);
+    compressed_.resize(numBricks);
+
+    parallel_for(0, numBricks, [&](size_t first, size_t last)
+    {
+        for (size_t b = first; b < last; ++b)
+        {
+            const uint8_t* src = data + b * brickBytes_;
+            const size_t len = std::min(brickBytes_, frameBytes_ - b * brickBytes_);
+
+            // Keep bricks verbatim if they do not compress (or Snappy is not available)
+            if (encodeSnappy(src, len, bricks[b]) && bricks[b].size() < len)
+            {
+                compressed_[b] = 1;
+            }
+            else
+            {
+                bricks[b].assign(src, src + len);
+                compressed_[b] = 0;
+            }
+        }
+    });
+
+    offsets_.resize(numBricks + 1);
+    offsets_[0] = 0;
+    for (size_t b = 0; b < numBricks; ++b)
+        offsets_[b + 1] = offsets_[b] + bricks[b].size();
+
+    data_.resize(offsets_[numBricks]);
+    for (size_t b = 0; b < numBricks; ++b)
+    {
+        if (!bricks[b].empty())
+            std::memcpy(&data_[offsets_[b]], &bricks[b][0], bricks[b].size());
+    }
+}
+
+bool CompressedFrame::decompress(uint8_t* dst, bool parallel) const
+{
+    const size_t numBricks = compressed_.size();
+
+    if (!parallel)
+    {
+        for (size_t b = 0; b < numBricks; ++b)
+        {
+            if (!decompressBrick(b, dst + b * brickBytes_))
+                return false;
+        }
+        return true;
+    }
+
+    std::atomic<bool> ok(true);
+
+    parallel_for(0, numBricks, [&](size_t first, size_t last)
+    {
+        for (size_t b = first; b < last; ++b)
+        {
+            if (!decompressBrick(b, dst + b * brickBytes_))
+                ok = false;
+        }
+    });
+
+    return ok;
+}
+
+size_t CompressedFrame::getBytes() const
+{
+    return data_.size() + offsets_.size() * sizeof(size_t) + compressed_.size();
+}
+
+bool CompressedFrame::decompressBrick(size_t brick, uint8_t* dst) const
+{
+    const unsigned char* src = &data_[0] + offsets_[brick];
+    const size_t size = offsets_[brick + 1] - offsets_[brick];
+    const size_t len = std::min(brickBytes_, frameBytes_ - brick * brickBytes_);
+
+    if (compressed_[brick])
+        return decodeSnappy(src, size, dst, len);
+
+    assert(size == len);
+    std::memcpy(dst, src, len);
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// FileFrame
+//
+
+FileFrame::FileFrame(std::string const& filename,
+        uint64_t offset,
+        size_t encodedSize,
+        Encoding encoding,
+        size_t frameBytes,
+        size_t bpv,
+        size_t swapBPC)
+    : filename_(filename)
+    , offset_(offset)
+    , encodedSize_(encoding == ENCODING_RAW ? frameBytes : encodedSize)
+    , encoding_(encoding)
+    , frameBytes_(frameBytes)
+    , bpv_(bpv)
+    , swapBPC_(swapBPC)
+{
+}
+
+bool FileFrame::decompress(uint8_t* dst, bool /*parallel*/) const
+{
+    // Each call uses its own stream, frames may be read concurrently
+    std::ifstream file(filename_.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.seekg(static_cast< std::streamoff >(offset_), file.beg);
+
+    if (encoding_ == ENCODING_RAW)
+    {
+        file.read(reinterpret_cast< char* >(dst), frameBytes_);
+        if (static_cast< size_t >(file.gcount()) != frameBytes_)
+            return false;
+    }
+    else
+    {
+        std::vector< uint8_t > encoded(encodedSize_);
+        if (!encoded.empty())
+            file.read(reinterpret_cast< char* >(&encoded[0]), encoded.size());
+        if (encoded.empty() || static_cast< size_t >(file.gcount()) != encoded.size())
+            return false;
+
+        if (encoding_ == ENCODING_SNAPPY)
+        {
+            if (!decodeSnappy(&encoded[0], encoded.size(), dst, frameBytes_))
+                return false;
+        }
+        else
+        {
+            size_t outsize = 0;
+            if (vvToolshed::decodeRLE(dst, &encoded[0], encoded.size(), bpv_, frameBytes_, &outsize) != vvToolshed::VV_OK)
+                return false;
+        }
+    }
+
+    if (swapBPC_ == 2 || swapBPC_ == 4)
+    {
+        for (size_t i = 0; i + swapBPC_ <= frameBytes_; i += swapBPC_)
+            std::reverse(dst + i, dst + i + swapBPC_);
+    }
+
+    return true;
+}
+
+size_t FileFrame::getBytes() const
+{
+    return sizeof(FileFrame) + filename_.size();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// FrameCache
+//
+
+FrameCache::FrameCache()
+    : cache_(1)
+{
+}
+
+const uint8_t* FrameCache::get(size_t frame, const FrameSource* src)
+{
+    boost::shared_ptr< Entry > e = cache_.find(frame);
+
+    if (!e || e->source != src)
+    {
+        e.reset(new Entry);
+        e->source = src;
+        e->data.resize(src->getFrameBytes());
+        e->ok = !e->data.empty() && src->decompress(&e->data[0]);
+        cache_.insert(frame, e);
+    }
+
+    if (e->pending.valid())
+        e->ok = e->pending.get();
+
+    if (!e->ok)
+    {
+        // Do not keep frames that could not be read, the next access tries again
+        release(frame);
+        return NULL;
+    }
+
+    const uint8_t* data = &e->data[0];
+
+    if (!inWindow(frame))
+        cache_.touch(frame);
+
+    return data;
+}
+
+void FrameCache::setWindow(std::vector< size_t > const& frames)
+{
+    window_ = frames;
+
+    // Frames that moved into the window are no longer recent frames
+    for (size_t i = 0; i < window_.size(); ++i)
+        cache_.unlist(window_[i]);
+
+    cache_.retainUnlisted([this](size_t frame) { return inWindow(frame); });
+}
+
+void FrameCache::prefetch(size_t frame, const FrameSource* src)
+{
+    boost::shared_ptr< Entry > found = cache_.find(frame);
+
+    if (found && found->source == src)
+        return;
+
+    if (src->getFrameBytes() == 0)
+        return;
+
+    boost::shared_ptr< Entry > e(new Entry);
+    e->source = src;
+    e->data.resize(src->getFrameBytes());
+    e->ok = false;
+
+    // Decode serially, the window frames are decoded concurrently
+    uint8_t* dst = &e->data[0];
+
+    try
+    {
+        e->pending = std::async(std::launch::async, [src, dst]() { return src->decompress(dst, false); });
+    }
+    catch (std::system_error&)
+    {
+        // No thread available, get() decodes the frame on demand
+        return;
+    }
+
+    cache_.insert(frame, e);
+}
+
+void FrameCache::setCapacity(size_t num)
+{
+    cache_.setCapacity(std::max(num, size_t(1)));
+}
+
+void FrameCache::release(size_t frame)
+{
+    cache_.erase(frame);
+}
+
+void FrameCache::clear()
+{
+    cache_.clear();
+    window_.clear();
+}
+
+size_t FrameCache::getBytes() const
+{
+    return cache_.getBytes();
+}
+
+bool FrameCache::inWindow(size_t frame) const
+{
+    return std::find(window_.begin(), window_.end(), frame) != window_.end();
+}
+
+
+} // namespace virvo
@@ -0,0 +1,211 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_FRAMECACHE_H
+#define VV_FRAMECACHE_H
+
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "vvbuffercache.h"
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+// Storage of one animation frame that is not kept as dense voxel data.
+// Implementations must be immutable, decompress() is called concurrently
+// from background threads.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    // Decode the frame into dst, which must hold getFrameBytes() bytes.
+    // Work is spread over all worker threads if parallel is true.
+    virtual bool decompress(uint8_t* dst, bool parallel = true) const = 0;
+
+    // Size of the dense frame [bytes]
+    virtual size_t getFrameBytes() const = 0;
+
+    // Memory occupied by the source [bytes]
+    virtual size_t getBytes() const = 0;
+
+    // True if the frame data is read from a file on access
+    virtual bool isLazy() const { return false; }
+};
+
+
+// One animation frame, compressed with Snappy in independent bricks.
+//
+// A brick is a slab of whole slices, so each brick decodes into a contiguous
+// range of the dense frame and all bricks can be decoded in parallel straight
+// into the destination. Bricks that do not get smaller are stored verbatim.
+// Instances are immutable and may be shared between volumes.
+class CompressedFrame : public FrameSource
+{
+public:
+    // Default size of the uncompressed bricks [bytes]
+    static const size_t DEFAULT_BRICK_BYTES = 256 * 1024;
+
+    // Compress frameBytes bytes of voxel data, brick boundaries are aligned
+    // to sliceBytes
+    CompressedFrame(const uint8_t* data,
+            size_t frameBytes,
+            size_t sliceBytes,
+            size_t brickBytes = DEFAULT_BRICK_BYTES);
+
+    // Decode the frame into dst, which must hold getFrameBytes() bytes.
+    // Bricks are decoded on all worker threads if parallel is true.
+    bool decompress(uint8_t* dst, bool parallel = true) const;
+
+    // Size of the dense frame [bytes]
+    size_t getFrameBytes() const { return frameBytes_; }
+
+    // Memory occupied by the compressed frame [bytes]
+    size_t getBytes() const;
+
+private:
+    size_t frameBytes_;
+    size_t brickBytes_;
+    // Per brick: start of its data in data_, plus the end of the last brick
+    std::vector< size_t > offsets_;
+    // Per brick: 1 if the brick is Snappy compressed, 0 if stored verbatim
+    std::vector< uint8_t > compressed_;
+    std::vector< unsigned char > data_;
+
+    bool decompressBrick(size_t brick, uint8_t* dst) const;
+};
+
+
+// One animation frame that stays in a volume file until it is accessed.
+//
+// Only the location of the frame in the file is kept in memory, the frame
+// is read (and decoded) from the file whenever it is decompressed. The file
+// must not change while the frame is in use.
+class FileFrame : public FrameSource
+{
+public:
+    enum Encoding
+    {
+        ENCODING_RAW,                              // voxel data stored verbatim
+        ENCODING_RLE,                              // vvToolshed::encodeRLE() with bpv byte symbols
+        ENCODING_SNAPPY                            // a single Snappy block
+    };
+
+    // encodedSize is the number of bytes stored in the file, swapBPC is
+    // the number of bytes per channel if the byte order of the file differs
+    // from the host byte order, else 0
+    FileFrame(std::string const& filename,
+            uint64_t offset,
+            size_t encodedSize,
+            Encoding encoding,
+            size_t frameBytes,
+            size_t bpv,
+            size_t swapBPC = 0);
+
+    bool decompress(uint8_t* dst, bool parallel = true) const;
+
+    size_t getFrameBytes() const { return frameBytes_; }
+
+    size_t getBytes() const;
+
+    bool isLazy() const { return true; }
+
+private:
+    std::string filename_;
+    uint64_t offset_;
+    size_t encodedSize_;
+    Encoding encoding_;
+    size_t frameBytes_;
+    size_t bpv_;
+    size_t swapBPC_;
+};
+
+
+// Decompressed copies of the compressed or lazily loaded frames of a volume.
+//
+// The cache holds the frames of a window, typically the current animation
+// frame and the next few frames, which are decoded ahead of time on
+// background threads. In addition, the most recently requested frames outside
+// the window are kept, up to getCapacity() frames. Pointers to such a frame
+// stay valid until getCapacity() other frames outside the window were
+// requested.
+//
+// Like BufferCache, the cache must only be used by the thread that owns the
+// volume. Frame sources must not be deleted before their cache entries are
+// released.
+class FrameCache
+{
+public:
+    FrameCache();
+
+    // Return the decompressed data of a frame. Waits if the frame is being
+    // decoded in the background and decodes it now if it is not cached.
+    // Returns NULL if the compressed data is corrupt or cannot be read,
+    // the frame is decoded again on the next call.
+    const uint8_t* get(size_t frame, const FrameSource* src);
+
+    // Set the window and release all frames outside of it
+    void setWindow(std::vector< size_t > const& frames);
+
+    // Start decoding a window frame in the background unless it is cached
+    void prefetch(size_t frame, const FrameSource* src);
+
+    // Set the number of recently requested frames outside the window that
+    // are kept (at least 1)
+    void setCapacity(size_t num);
+
+    size_t getCapacity() const { return cache_.getCapacity(); }
+
+    // Release a frame, e.g. after it was modified
+    void release(size_t frame);
+
+    // Release all frames
+    void clear();
+
+    // Memory occupied by decompressed frames, including frames being decoded [bytes]
+    size_t getBytes() const;
+
+private:
+    // pending is valid while the frame is decoded in the background
+    struct Entry : CacheBuffer< bool >
+    {
+        const FrameSource* source;
+        bool ok;
+    };
+
+    // Window frames are unlisted, the recently requested frames outside the
+    // window are listed
+    BufferCache< size_t, Entry > cache_;
+    std::vector< size_t > window_;
+
+    bool inWindow(size_t frame) const;
+};
+
+
+} // namespace virvo
+
+
+#endif // VV_FRAMECACHE_H
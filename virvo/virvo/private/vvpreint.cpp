@@ -0,0 +1,319 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvpreint.h"
+
+#include "math/math.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+// Calls func(row) for all rows. Rows are interleaved between the threads
+// because the cost of a row depends on its position in the table.
+template <typename Func>
+void forEachRow(int width, Func func)
+{
+    const int numThreads = std::max(1, std::min(int(numWorkerThreads()), width));
+    parallel_for(size_t(0), size_t(numThreads), [&](size_t begin, size_t end)
+    {
+        for (size_t t = begin; t < end; ++t)
+        {
+            for (int row = int(t); row < width; row += numThreads)
+                func(row);
+        }
+    }, 1);
+}
+
+// True if an entry that depends on the transfer function entries [lo..hi]
+// is affected by changes to the entries [first..last]
+inline bool affected(int lo, int hi, int first, int last)
+{
+    return lo <= last && hi >= first;
+}
+
+// Table entry for front sample sf and back sample sb, integrated numerically
+void correctEntry(const float* rgba, int sf, int sb, float thickness, uint8_t* entry)
+{
+    const int minLookupSteps = 2;
+    const int addLookupSteps = 1;
+
+    int n=minLookupSteps+addLookupSteps*abs(sb-sf);
+    double stepWidth = 1./n;
+    double r=0., g=0., b=0., tau=0.;
+    for (int i=0;i<n;i++)
+    {
+        const double s = sf+(sb-sf)*(double)i/n;
+        const int is = (int)s;
+        const double fract_s = s-floor(s);
+        const double tauc = thickness*stepWidth*(rgba[is*4+3]*fract_s+rgba[(is+1)*4+3]*(1.0-fract_s));
+        const double e_tau = exp(-tau);
+#ifdef STANDARD
+        /* standard optical model: r,g,b densities are multiplied with opacity density */
+        const double rc = e_tau*tauc*(rgba[is*4+0]*fract_s+rgba[(is+1)*4+0]*(1.0-fract_s));
+        const double gc = e_tau*tauc*(rgba[is*4+1]*fract_s+rgba[(is+1)*4+1]*(1.0-fract_s));
+        const double bc = e_tau*tauc*(rgba[is*4+2]*fract_s+rgba[(is+1)*4+2]*(1.0-fract_s));
+#else
+        /* Willhelms, Van Gelder optical model: r,g,b densities are not multiplied */
+        const double rc = e_tau*stepWidth*(rgba[is*4+0]*fract_s+rgba[(is+1)*4+0]*(1.0-fract_s));
+        const double gc = e_tau*stepWidth*(rgba[is*4+1]*fract_s+rgba[(is+1)*4+1]*(1.0-fract_s));
+        const double bc = e_tau*stepWidth*(rgba[is*4+2]*fract_s+rgba[(is+1)*4+2]*(1.0-fract_s));
+#endif
+
+        r = r+rc;
+        g = g+gc;
+        b = b+bc;
+        tau = tau + tauc;
+    }
+    if (r>1.)
+        r = 1.;
+    entry[0] = uint8_t(r*255.99);
+    if (g>1.)
+        g = 1.;
+    entry[1] = uint8_t(g*255.99);
+    if (b>1.)
+        b = 1.;
+    entry[2] = uint8_t(b*255.99);
+    entry[3] = uint8_t((1.- exp(-tau))*255.99);
+}
+
+// Averages of the prefix sums between row r and all columns c:
+// (sums[max(r, c)] - sums[min(r, c)]) / |c - r|, undefined for c == r
+void segmentAverages(const float* sums, int width, int r, float* averages)
+{
+    int c = 0;
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    simd::float4 row = simd::float4(float(r));
+    simd::float4 rowSum = simd::float4(sums[r]);
+    for (; c + 4 <= width; c += 4)
+    {
+        simd::float4 column(float(c), float(c + 1), float(c + 2), float(c + 3));
+        simd::float4 columnSum = _mm_loadu_ps(sums + c);
+        simd::mask4 after = column > row;
+        simd::float4 diff = select(after, columnSum - rowSum, rowSum - columnSum);
+        simd::float4 dist = select(after, column - row, row - column);
+        _mm_storeu_ps(averages + c, diff * (simd::float4(1.0f) / dist));
+    }
+#endif
+    for (; c < width; ++c)
+    {
+        int sf = std::min(r, c);
+        int sb = std::max(r, c);
+        averages[c] = (sums[sb] - sums[sf]) * (1.f / (sb - sf));
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Table builders
+//
+
+void makePreintTableCorrect(const float* rgba, int width, float thickness, uint8_t* table,
+        int first, int last)
+{
+    // The repeated last entry changes along with entry width - 1
+    if (last == width - 1)
+        last = width;
+
+    forEachRow(width, [&](int sf)
+    {
+        for (int sb = 0; sb < width; ++sb)
+        {
+            if (affected(std::min(sf, sb), std::max(sf, sb) + 1, first, last))
+                correctEntry(rgba, sf, sb, thickness, table + (sf * width + sb) * 4);
+        }
+    });
+}
+
+void makePreintTableOptimized(const float* rgba, int width, float thickness, uint8_t* table,
+        int first, int last)
+{
+    if (width <= 0)
+        return;
+
+    // Prefix sums and diagonal of the table
+    std::vector< float > sums[4];
+    for (int i = 0; i < 4; ++i)
+        sums[i].resize(width);
+    std::vector< uint8_t > diagonal(width * 4);
+
+    float* rInt = &sums[0][0];
+    float* gInt = &sums[1][0];
+    float* bInt = &sums[2][0];
+    float* aInt = &sums[3][0];
+    int rcol=0, gcol=0, bcol=0, acol=0;
+    rInt[0] = 0.f;
+    gInt[0] = 0.f;
+    bInt[0] = 0.f;
+    aInt[0] = 0.f;
+    diagonal[0] = int(rgba[0]);
+    diagonal[1] = int(rgba[1]);
+    diagonal[2] = int(rgba[2]);
+    diagonal[3] = int((1.f - expf(-rgba[3]*thickness)) * 255.99f);
+    for (int i=1;i<width;i++)
+    {
+#ifdef STANDARD
+        /* standard optical model: r,g,b densities are multiplied with opacity density */
+        // accumulated values
+        float tauc = (int(rgba[(i-1)*4+3]) + int(rgba[i*4+3])) * .5f;
+        rInt[i] = rInt[i-1] + (int(255.99f*rgba[(i-1)*4+0]) + int(255.99f*rgba[i*4+0])) * .5f * tauc;
+        gInt[i] = gInt[i-1] + (int(255.99f*rgba[(i-1)*4+1]) + int(255.99f*rgba[i*4+1])) * .5f * tauc;
+        bInt[i] = bInt[i-1] + (int(255.99f*rgba[(i-1)*4+2]) + int(255.99f*rgba[i*4+2])) * .5f * tauc;
+        aInt[i] = aInt[i-1] + tauc;
+
+        // diagonal for lookup texture
+        rcol = int(rgba[i*4+0] * rgba[i*4+3] * thickness * 255.99f);
+        gcol = int(rgba[i*4+1] * rgba[i*4+3] * thickness * 255.99f);
+        bcol = int(rgba[i*4+2] * rgba[i*4+3] * thickness * 255.99f);
+        acol = int((1.f - expf(- rgba[i*4+3] * thickness)) * 255.99f);
+#else
+        /* Willhelms, Van Gelder optical model: r,g,b densities are not multiplied */
+        // accumulated values
+        rInt[i] = rInt[i-1] + (rgba[(i-1)*4+0] + rgba[i*4+0]) * .5f * 255;
+        gInt[i] = gInt[i-1] + (rgba[(i-1)*4+1] + rgba[i*4+1]) * .5f * 255;
+        bInt[i] = bInt[i-1] + (rgba[(i-1)*4+2] + rgba[i*4+2]) * .5f * 255;
+        aInt[i] = aInt[i-1] + (rgba[(i-1)*4+3] + rgba[i*4+3]) * .5f;
+
+        // diagonal for lookup texture
+        rcol = int(255.99f*rgba[i*4+0]);
+        gcol = int(255.99f*rgba[i*4+1]);
+        bcol = int(255.99f*rgba[i*4+2]);
+        acol = int((1.f - expf(-rgba[i*4+3] * thickness)) * 255.99f);
+#endif
+        diagonal[i*4+0] = uint8_t(rcol);
+        diagonal[i*4+1] = uint8_t(gcol);
+        diagonal[i*4+2] = uint8_t(bcol);
+        diagonal[i*4+3] = uint8_t(acol);
+    }
+
+    // Segments containing an opaque sample take the color of the opaque
+    // sample closest to the front
+    std::vector< int > prevOpaque(width);       // last opaque sample <= i, or -1
+    std::vector< int > nextOpaque(width);       // first opaque sample >= i, or width
+    for (int i = 0, prev = -1; i < width; ++i)
+    {
+        if (rgba[i*4+3] >= .996f)
+            prev = i;
+        prevOpaque[i] = prev;
+    }
+    for (int i = width - 1, next = width; i >= 0; --i)
+    {
+        if (rgba[i*4+3] >= .996f)
+            next = i;
+        nextOpaque[i] = next;
+    }
+
+    forEachRow(width, [&](int r)
+    {
+        std::vector< float > averages(width * 4);
+        for (int i = 0; i < 4; ++i)
+            segmentAverages(&sums[i][0], width, r, &averages[i * width]);
+
+        for (int c = 0; c < width; ++c)
+        {
+            if (!affected(std::min(r, c), std::max(r, c), first, last))
+                continue;
+
+            uint8_t* entry = table + (r * width + c) * 4;
+            int opaque = c > r ? prevOpaque[c] : nextOpaque[c];
+            if (c == r)
+            {
+                std::copy(&diagonal[r * 4], &diagonal[r * 4] + 4, entry);
+            }
+            else if ((c > r && opaque >= r) || (c < r && opaque <= r))
+            {
+                entry[0] = uint8_t(int(rgba[opaque*4+0]*255.99f));
+                entry[1] = uint8_t(int(rgba[opaque*4+1]*255.99f));
+                entry[2] = uint8_t(int(rgba[opaque*4+2]*255.99f));
+                entry[3] = uint8_t(255);
+            }
+            else
+            {
+                int rcol = int(averages[c]);
+                int gcol = int(averages[width + c]);
+                int bcol = int(averages[2 * width + c]);
+                int acol = int((1.f - expf(-averages[3 * width + c] * thickness)) * 255.99f);
+                entry[0] = uint8_t(std::min(rcol, 255));
+                entry[1] = uint8_t(std::min(gcol, 255));
+                entry[2] = uint8_t(std::min(bcol, 255));
+                entry[3] = uint8_t(std::min(acol, 255));
+            }
+        }
+    });
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// PreintCache
+//
+
+PreintCache::PreintCache()
+    : width_(0)
+    , thickness_(0.0f)
+    , method_(CORRECT)
+    , table_(NULL)
+{
+}
+
+bool PreintCache::update(Method method, const float* rgba, int width, float thickness, const uint8_t* table,
+        int& first, int& last)
+{
+    first = 0;
+    last = width - 1;
+
+    if (table == table_ && width == width_ && thickness == thickness_ && method == method_)
+    {
+        while (first <= last && memcmp(&rgba_[first * 4], rgba + first * 4, 4 * sizeof(float)) == 0)
+            ++first;
+        while (last >= first && memcmp(&rgba_[last * 4], rgba + last * 4, 4 * sizeof(float)) == 0)
+            --last;
+        if (first > last)
+            return false;
+    }
+
+    rgba_.assign(rgba, rgba + width * 4);
+    width_ = width;
+    thickness_ = thickness;
+    method_ = method;
+    table_ = table;
+    return true;
+}
+
+void PreintCache::invalidate()
+{
+    table_ = NULL;
+    rgba_.clear();
+}
+
+
+} // namespace virvo
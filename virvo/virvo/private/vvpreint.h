@@ -0,0 +1,91 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_PREINT_H
+#define VV_PREINT_H
+
+
+#include <vector>
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+// Pre-integration tables for a 1D transfer function, computed on the CPU.
+//
+// rgba holds width RGBA entries of the transfer function (width + 1 for
+// makePreintTableCorrect(), the last entry repeats entry width - 1). table
+// holds width x width RGBA entries, row index is the front sample and
+// column index the back sample. Only the entries that depend on the
+// transfer function entries [first..last] are computed, all others are
+// left unchanged. Rows are computed concurrently.
+
+// Numerical integration of each segment, see vvTransFunc::makePreintLUTCorrect()
+void makePreintTableCorrect(const float* rgba, int width, float thickness, uint8_t* table,
+        int first, int last);
+
+// Integration based on prefix sums of the transfer function, see
+// vvTransFunc::makePreintLUTOptimized()
+void makePreintTableOptimized(const float* rgba, int width, float thickness, uint8_t* table,
+        int first, int last);
+
+
+// Remembers the transfer function a pre-integration table was last computed
+// from, so that only the entries affected by an edit must be recomputed.
+// Owned by whoever owns the table.
+class VIRVO_TRANSFUNCEXPORT PreintCache
+{
+public:
+    enum Method
+    {
+        CORRECT,
+        OPTIMIZED
+    };
+
+    PreintCache();
+
+    // Store the parameters of a table update and determine the range of
+    // transfer function entries that changed since the last update of the
+    // same table with the same parameters, [0..width-1] otherwise.
+    // Returns false if nothing changed and the table is up to date.
+    bool update(Method method, const float* rgba, int width, float thickness, const uint8_t* table,
+            int& first, int& last);
+
+    // The next update() will recompute the whole table
+    void invalidate();
+
+private:
+    std::vector< float > rgba_;
+    int width_;
+    float thickness_;
+    Method method_;
+    const uint8_t* table_;
+};
+
+
+} // namespace virvo
+
+
+#endif // VV_PREINT_H
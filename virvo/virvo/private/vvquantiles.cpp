@@ -0,0 +1,635 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvquantiles.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+// Number of histogram buckets in the selection pass, one for each value of
+// the upper 16 bits of the sort key
+const size_t NUM_BUCKETS = 1 << 16;
+
+// Minimum number of values per work item
+const size_t MIN_CHUNK_SIZE = 1 << 16;
+
+size_t numChunks(size_t n)
+{
+    return std::max(size_t(1), std::min(size_t(numWorkerThreads()), n / MIN_CHUNK_SIZE));
+}
+
+size_t chunkBegin(size_t k, size_t n, size_t num_chunks)
+{
+    return k * n / num_chunks;
+}
+
+// Map floats to unsigned integers with the same order
+inline uint32_t floatToKey(float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000U) ? ~u : (u | 0x80000000U);
+}
+
+inline float keyToFloat(uint32_t k)
+{
+    uint32_t u = (k & 0x80000000U) ? (k & 0x7FFFFFFFU) : ~k;
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+inline double weightOf(QuantileWeight const& weight, float v)
+{
+    return weight ? static_cast<double>(weight(v)) : 1.0;
+}
+
+// A target that falls into a key range with more than one distinct value,
+// and the weight it still needs within the range
+struct Pending
+{
+    size_t target;
+    double residual;
+};
+
+// Keys k with (k >> (shift + 8)) == prefix, for the digit at shift that is
+// refined next. Ranges are sorted by prefix.
+struct KeyRange
+{
+    uint32_t prefix;
+    std::vector<Pending> pending;
+};
+
+// Refine key ranges by the 8 bit digit at shift (8 or 0): one parallel pass
+// over the data sums up the weights per digit of the values in the ranges,
+// then the pending targets are located in the digits. Afterwards, ranges
+// holds the ranges of the next digit, or, after the last digit, the results
+// are stored.
+void refineQuantiles(const float* data,
+        size_t n,
+        QuantileFilter const& filter,
+        QuantileWeight const& weight,
+        std::vector<float> const& extra,
+        unsigned shift,
+        std::vector<KeyRange>& ranges,
+        std::vector<float>& results)
+{
+    const size_t num_ranges = ranges.size();
+    const unsigned prefixShift = shift + 8;
+
+    // First range for each value of the upper 16 key bits, ranges with the
+    // same upper bits are adjacent
+    std::vector<int> first(NUM_BUCKETS, -1);
+    for (size_t r = num_ranges; r-- > 0; )
+        first[ranges[r].prefix >> (16 - prefixShift)] = static_cast<int>(r);
+
+    auto findRange = [&](uint32_t key) -> int
+    {
+        int r = first[key >> 16];
+        if (r < 0)
+            return -1;
+        const uint32_t p = key >> prefixShift;
+        for (; r < static_cast<int>(num_ranges) && (ranges[r].prefix >> (16 - prefixShift)) == (key >> 16); ++r)
+        {
+            if (ranges[r].prefix == p)
+                return r;
+        }
+        return -1;
+    };
+
+    const size_t num_chunks = numChunks(n);
+    std::vector< std::vector<double> > weights(num_chunks);
+    std::vector< std::vector<size_t> > counts(num_chunks);
+
+    parallel_for(0, num_chunks, [&](size_t firstChunk, size_t lastChunk)
+    {
+        for (size_t k = firstChunk; k < lastChunk; ++k)
+        {
+            weights[k].assign(num_ranges * 256, 0.0);
+            counts[k].assign(num_ranges * 256, 0);
+            for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+            {
+                float v = data[i];
+                uint32_t key = floatToKey(v);
+                int r = findRange(key);
+                if (r >= 0 && filter.accept(v))
+                {
+                    size_t d = r * 256 + ((key >> shift) & 0xFF);
+                    weights[k][d] += weightOf(weight, v);
+                    ++counts[k][d];
+                }
+            }
+        }
+    });
+
+    std::vector<double>& w = weights[0];
+    std::vector<size_t>& c = counts[0];
+    for (size_t k = 1; k < num_chunks; ++k)
+    {
+        for (size_t d = 0; d < w.size(); ++d)
+        {
+            w[d] += weights[k][d];
+            c[d] += counts[k][d];
+        }
+        std::vector<double>().swap(weights[k]);
+        std::vector<size_t>().swap(counts[k]);
+    }
+
+    for (size_t i = 0; i < extra.size(); ++i)
+    {
+        uint32_t key = floatToKey(extra[i]);
+        int r = findRange(key);
+        if (r >= 0 && filter.accept(extra[i]))
+        {
+            size_t d = r * 256 + ((key >> shift) & 0xFF);
+            w[d] += weightOf(weight, extra[i]);
+            ++c[d];
+        }
+    }
+
+    std::vector<KeyRange> next;
+    for (size_t r = 0; r < num_ranges; ++r)
+    {
+        const double* rw = &w[r * 256];
+        const size_t* rc = &c[r * 256];
+
+        size_t lastDigit = 255;
+        while (lastDigit > 0 && rc[lastDigit] == 0)
+            --lastDigit;
+
+        // Targets are ascending, walk the digits once
+        double cum = 0.0;
+        size_t d = 0;
+        std::vector<Pending> const& p = ranges[r].pending;
+        for (size_t j = 0; j < p.size(); ++j)
+        {
+            while (d < 256 && cum + rw[d] <= p[j].residual)
+            {
+                cum += rw[d];
+                ++d;
+            }
+
+            // Rounding: target beyond the weight of the range, select its largest value
+            const uint32_t prefix = (ranges[r].prefix << 8) | static_cast<uint32_t>(std::min(d, lastDigit));
+
+            if (shift == 0)
+            {
+                results[p[j].target] = keyToFloat(prefix);
+                continue;
+            }
+
+            if (next.empty() || next.back().prefix != prefix)
+            {
+                next.push_back(KeyRange());
+                next.back().prefix = prefix;
+            }
+            Pending np = { p[j].target, p[j].residual - cum };
+            next.back().pending.push_back(np);
+        }
+    }
+
+    ranges.swap(next);
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Building blocks
+//
+
+void radixSort(float* data, size_t n)
+{
+    if (n < 2)
+        return;
+
+    const size_t num_chunks = numChunks(n);
+
+    // Convert to sort keys in place, then only access the buffer as keys
+    parallel_for(0, n, [&](size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            uint32_t k = floatToKey(data[i]);
+            std::memcpy(&data[i], &k, sizeof(k));
+        }
+    }, MIN_CHUNK_SIZE);
+
+    std::vector<uint32_t> tmp(n);
+    uint32_t* src = reinterpret_cast<uint32_t*>(data);
+    uint32_t* dst = &tmp[0];
+
+    // Four passes over 8 bit digits, the result ends up in data again
+    std::vector<size_t> offsets(num_chunks * 256);
+    for (unsigned shift = 0; shift < 32; shift += 8)
+    {
+        parallel_for(0, num_chunks, [&](size_t first, size_t last)
+        {
+            for (size_t k = first; k < last; ++k)
+            {
+                size_t* hist = &offsets[k * 256];
+                std::fill(hist, hist + 256, size_t(0));
+                for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+                    ++hist[(src[i] >> shift) & 0xFF];
+            }
+        });
+
+        // Exclusive prefix sum, digit major, so that the sort stays stable
+        size_t sum = 0;
+        for (size_t d = 0; d < 256; ++d)
+        {
+            for (size_t k = 0; k < num_chunks; ++k)
+            {
+                size_t c = offsets[k * 256 + d];
+                offsets[k * 256 + d] = sum;
+                sum += c;
+            }
+        }
+
+        parallel_for(0, num_chunks, [&](size_t first, size_t last)
+        {
+            for (size_t k = first; k < last; ++k)
+            {
+                size_t* off = &offsets[k * 256];
+                for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+                {
+                    uint32_t v = src[i];
+                    dst[off[(v >> shift) & 0xFF]++] = v;
+                }
+            }
+        });
+
+        std::swap(src, dst);
+    }
+
+    parallel_for(0, n, [&](size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            uint32_t k;
+            std::memcpy(&k, &data[i], sizeof(k));
+            data[i] = keyToFloat(k);
+        }
+    }, MIN_CHUNK_SIZE);
+}
+
+void gatherFiltered(const float* data, size_t n, QuantileFilter const& filter, std::vector<float>& out)
+{
+    const size_t num_chunks = numChunks(n);
+
+    std::vector<size_t> counts(num_chunks + 1, 0);
+    parallel_for(0, num_chunks, [&](size_t first, size_t last)
+    {
+        for (size_t k = first; k < last; ++k)
+        {
+            size_t c = 0;
+            for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+            {
+                if (filter.accept(data[i]))
+                    ++c;
+            }
+            counts[k + 1] = c;
+        }
+    });
+
+    for (size_t k = 0; k < num_chunks; ++k)
+        counts[k + 1] += counts[k];
+
+    out.resize(counts[num_chunks]);
+    if (out.empty())
+        return;
+
+    parallel_for(0, num_chunks, [&](size_t first, size_t last)
+    {
+        for (size_t k = first; k < last; ++k)
+        {
+            float* dst = &out[0] + counts[k];
+            for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+            {
+                if (filter.accept(data[i]))
+                    *dst++ = data[i];
+            }
+        }
+    });
+}
+
+void reservoirSample(const float* data, size_t n, size_t k, float* out, unsigned seed)
+{
+    if (k >= n)
+    {
+        std::copy(data, data + n, out);
+        return;
+    }
+
+    const size_t num_chunks = numChunks(n);
+
+    // Reservoir size of each chunk, proportional to the chunk size
+    std::vector<size_t> quota(num_chunks);
+    std::vector<size_t> offset(num_chunks + 1, 0);
+    size_t assigned = 0;
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        size_t len = chunkBegin(c + 1, n, num_chunks) - chunkBegin(c, n, num_chunks);
+        quota[c] = std::min(len, static_cast<size_t>(static_cast<double>(k) * len / n));
+        assigned += quota[c];
+    }
+    for (size_t c = 0; assigned < k; c = (c + 1) % num_chunks)
+    {
+        size_t len = chunkBegin(c + 1, n, num_chunks) - chunkBegin(c, n, num_chunks);
+        if (quota[c] < len)
+        {
+            ++quota[c];
+            ++assigned;
+        }
+    }
+    for (size_t c = 0; c < num_chunks; ++c)
+        offset[c + 1] = offset[c] + quota[c];
+
+    parallel_for(0, num_chunks, [&](size_t first, size_t last)
+    {
+        for (size_t c = first; c < last; ++c)
+        {
+            const float* src = data + chunkBegin(c, n, num_chunks);
+            size_t len = chunkBegin(c + 1, n, num_chunks) - chunkBegin(c, n, num_chunks);
+            size_t q = quota[c];
+            float* res = out + offset[c];
+
+            if (q == 0)
+                continue;
+
+            std::minstd_rand rng(seed + static_cast<unsigned>(c) * 7919U + 1U);
+            std::copy(src, src + q, res);
+            for (size_t i = q; i < len; ++i)
+            {
+                size_t j = std::uniform_int_distribution<size_t>(0, i)(rng);
+                if (j < q)
+                    res[j] = src[i];
+            }
+        }
+    });
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Quantile selection
+//
+
+QuantileResult selectQuantiles(const float* data,
+        size_t n,
+        QuantileFilter const& filter,
+        std::vector<double> const& targets,
+        bool relative,
+        std::vector<float>& results,
+        QuantileWeight const& weight,
+        std::vector<float> const& extra)
+{
+    struct Histogram
+    {
+        std::vector<double> weight;
+        std::vector<uint32_t> minKey;
+        std::vector<uint32_t> maxKey;
+        size_t count;
+
+        void init()
+        {
+            weight.assign(NUM_BUCKETS, 0.0);
+            minKey.assign(NUM_BUCKETS, std::numeric_limits<uint32_t>::max());
+            maxKey.assign(NUM_BUCKETS, 0);
+            count = 0;
+        }
+
+        void add(float v, double w)
+        {
+            uint32_t key = floatToKey(v);
+            size_t b = key >> 16;
+            weight[b] += w;
+            minKey[b] = std::min(minKey[b], key);
+            maxKey[b] = std::max(maxKey[b], key);
+            ++count;
+        }
+    };
+
+    QuantileResult result;
+    result.min = 0.0f;
+    result.max = 0.0f;
+    result.count = 0;
+    result.totalWeight = 0.0;
+
+    results.assign(targets.size(), 0.0f);
+
+
+    //--- Pass 1: histogram over the upper 16 key bits ----
+
+    const size_t num_chunks = numChunks(n);
+    std::vector<Histogram> local(num_chunks);
+
+    parallel_for(0, num_chunks, [&](size_t first, size_t last)
+    {
+        for (size_t k = first; k < last; ++k)
+        {
+            Histogram& h = local[k];
+            h.init();
+            for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+            {
+                float v = data[i];
+                if (filter.accept(v))
+                    h.add(v, weightOf(weight, v));
+            }
+        }
+    });
+
+    Histogram& hist = local[0];
+    for (size_t k = 1; k < num_chunks; ++k)
+    {
+        for (size_t b = 0; b < NUM_BUCKETS; ++b)
+        {
+            hist.weight[b] += local[k].weight[b];
+            hist.minKey[b] = std::min(hist.minKey[b], local[k].minKey[b]);
+            hist.maxKey[b] = std::max(hist.maxKey[b], local[k].maxKey[b]);
+        }
+        hist.count += local[k].count;
+        local[k] = Histogram();
+    }
+
+    for (size_t i = 0; i < extra.size(); ++i)
+    {
+        if (filter.accept(extra[i]))
+            hist.add(extra[i], weightOf(weight, extra[i]));
+    }
+
+    if (hist.count == 0)
+        return result;
+
+    size_t firstBucket = 0;
+    while (hist.minKey[firstBucket] > hist.maxKey[firstBucket])
+        ++firstBucket;
+    size_t lastBucket = NUM_BUCKETS - 1;
+    while (hist.minKey[lastBucket] > hist.maxKey[lastBucket])
+        --lastBucket;
+
+    result.count = hist.count;
+    result.min = keyToFloat(hist.minKey[firstBucket]);
+    result.max = keyToFloat(hist.maxKey[lastBucket]);
+    for (size_t b = 0; b < NUM_BUCKETS; ++b)
+        result.totalWeight += hist.weight[b];
+
+
+    //--- Locate the bucket of each target ----------------
+
+    std::vector<KeyRange> ranges;
+
+    double cum = 0.0;
+    size_t b = firstBucket;
+    for (size_t t = 0; t < targets.size(); ++t)
+    {
+        double target = relative ? targets[t] * result.totalWeight : targets[t];
+
+        while (b <= lastBucket && cum + hist.weight[b] <= target)
+        {
+            cum += hist.weight[b];
+            ++b;
+        }
+
+        if (b > lastBucket)                 // rounding: target beyond the total weight
+        {
+            results[t] = result.max;
+            continue;
+        }
+
+        if (hist.minKey[b] == hist.maxKey[b])
+        {
+            results[t] = keyToFloat(hist.minKey[b]);
+        }
+        else
+        {
+            if (ranges.empty() || ranges.back().prefix != b)
+            {
+                ranges.push_back(KeyRange());
+                ranges.back().prefix = static_cast<uint32_t>(b);
+            }
+            Pending p = { t, target - cum };
+            ranges.back().pending.push_back(p);
+        }
+    }
+
+
+    //--- Passes 2 and 3: histograms over the lower key bits of the target buckets
+
+    // No values are copied or sorted, even if most of the data falls into one
+    // bucket. Each pass only weights the values of the target ranges.
+    if (!ranges.empty())
+        refineQuantiles(data, n, filter, weight, extra, 8, ranges, results);
+    if (!ranges.empty())
+        refineQuantiles(data, n, filter, weight, extra, 0, ranges, results);
+
+    return result;
+}
+
+
+QuantileResult selectQuantilesSorted(const float* data,
+        size_t n,
+        std::vector<double> const& targets,
+        bool relative,
+        std::vector<float>& results,
+        QuantileWeight const& weight)
+{
+    QuantileResult result;
+    result.min = n > 0 ? data[0] : 0.0f;
+    result.max = n > 0 ? data[n - 1] : 0.0f;
+    result.count = n;
+    result.totalWeight = 0.0;
+
+    results.assign(targets.size(), 0.0f);
+
+    if (n == 0)
+        return result;
+
+    // Weight of each chunk, so that only the chunks containing targets have
+    // to be walked value by value
+    const size_t num_chunks = numChunks(n);
+    std::vector<double> chunkWeight(num_chunks, 0.0);
+
+    parallel_for(0, num_chunks, [&](size_t first, size_t last)
+    {
+        for (size_t k = first; k < last; ++k)
+        {
+            if (!weight)
+            {
+                chunkWeight[k] = static_cast<double>(chunkBegin(k + 1, n, num_chunks) - chunkBegin(k, n, num_chunks));
+                continue;
+            }
+
+            double w = 0.0;
+            for (size_t i = chunkBegin(k, n, num_chunks); i < chunkBegin(k + 1, n, num_chunks); ++i)
+                w += weight(data[i]);
+            chunkWeight[k] = w;
+        }
+    });
+
+    for (size_t k = 0; k < num_chunks; ++k)
+        result.totalWeight += chunkWeight[k];
+
+    double cum = 0.0;
+    size_t k = 0;
+    size_t i = 0;
+    for (size_t t = 0; t < targets.size(); ++t)
+    {
+        double target = relative ? targets[t] * result.totalWeight : targets[t];
+
+        // Skip whole chunks
+        while (k < num_chunks && i == chunkBegin(k, n, num_chunks) && cum + chunkWeight[k] <= target)
+        {
+            cum += chunkWeight[k];
+            ++k;
+            i = chunkBegin(k, n, num_chunks);
+        }
+
+        // Walk values
+        while (i < n && cum + weightOf(weight, data[i]) <= target)
+        {
+            cum += weightOf(weight, data[i]);
+            ++i;
+            if (k < num_chunks && i == chunkBegin(k + 1, n, num_chunks))
+                ++k;
+        }
+
+        results[t] = data[std::min(i, n - 1)];
+    }
+
+    return result;
+}
+
+
+} // namespace virvo
@@ -0,0 +1,146 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_QUANTILES_H
+#define VV_QUANTILES_H
+
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+
+namespace virvo
+{
+
+
+//--------------------------------------------------------------------------------------------------
+// Value filter
+//
+
+// Selects the values that take part in a quantile computation.
+// NaNs are always rejected.
+struct QuantileFilter
+{
+    QuantileFilter()
+        : clamp(false)
+        , lo(0.0f)
+        , hi(0.0f)
+    {
+    }
+
+    // Reject values outside of [lo, hi]
+    bool clamp;
+    float lo;
+    float hi;
+
+    // Reject values inside of any of the half-open intervals [first, second)
+    std::vector< std::pair<float, float> > exclude;
+
+    bool accept(float v) const
+    {
+        if (v != v)
+            return false;
+
+        if (clamp && (v < lo || v > hi))
+            return false;
+
+        for (size_t i = 0; i < exclude.size(); ++i)
+        {
+            if (v >= exclude[i].first && v < exclude[i].second)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Building blocks
+//
+
+// Sort n floats in ascending order with a parallel LSD radix sort.
+// Needs a temporary buffer of n floats.
+void radixSort(float* data, size_t n);
+
+// Copy all values that pass the filter to out, preserving their order.
+void gatherFiltered(const float* data, size_t n, QuantileFilter const& filter, std::vector<float>& out);
+
+// Draw a uniform random sample of k out of n values without replacement.
+// Each thread runs reservoir sampling on its part of the data, with a
+// reservoir size proportional to the part's size.
+void reservoirSample(const float* data, size_t n, size_t k, float* out, unsigned seed = 0);
+
+
+//--------------------------------------------------------------------------------------------------
+// Quantile selection
+//
+
+// Weight of a value, e.g. its opacity. A NULL function weights all values with 1.
+typedef std::function<float (float)> QuantileWeight;
+
+struct QuantileResult
+{
+    // Smallest and largest value that passed the filter
+    float min;
+    float max;
+
+    // Number of values that passed the filter, and their total weight
+    size_t count;
+    double totalWeight;
+};
+
+// Find the values at the given cumulative weights, i.e. for each target t the
+// smallest value v for which the total weight of all values <= v exceeds t.
+// With the default weight, target k selects the k-th smallest value (counting
+// from 0). Targets beyond the total weight select the largest value.
+//
+// Works without sorting or copying the data: one parallel pass builds a
+// histogram over the upper 16 bits of the values. Two more passes build
+// histograms over the next 8 bits and the last 8 bits, but only of the few
+// buckets that contain a target.
+//
+// targets must be sorted in ascending order, fractions of the total weight
+// if relative is true. extra values are treated as if they were part of data.
+QuantileResult selectQuantiles(const float* data,
+        size_t n,
+        QuantileFilter const& filter,
+        std::vector<double> const& targets,
+        bool relative,
+        std::vector<float>& results,
+        QuantileWeight const& weight = QuantileWeight(),
+        std::vector<float> const& extra = std::vector<float>());
+
+// Same as selectQuantiles(), but for data that is already sorted and filtered.
+QuantileResult selectQuantilesSorted(const float* data,
+        size_t n,
+        std::vector<double> const& targets,
+        bool relative,
+        std::vector<float>& results,
+        QuantileWeight const& weight = QuantileWeight());
+
+
+} // namespace virvo
+
+
+#endif // VV_QUANTILES_H
@@ -0,0 +1,256 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <climits>
+#include <cstring> // memcpy
+#include <vector>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "vvregionio.h"
+#include "vvvoldesc.h"
+
+
+namespace virvo
+{
+
+
+//-------------------------------------------------------------------------------------------------
+// ReadRegion
+//
+
+ReadRegion::ReadRegion()
+    : first(ssize_t(0))
+    , size(ssize_t(0))
+    , stride(ssize_t(1))
+{
+}
+
+ReadRegion::ReadRegion(basic_aabb< ssize_t > const& box, vector< 3, ssize_t > const& s,
+        vector< 3, ssize_t > const& vox)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        stride[i] = std::max(s[i], ssize_t(1));
+        first[i] = std::max(box.min[i], ssize_t(0));
+        ssize_t last = std::min(box.max[i], vox[i]);
+        size[i] = last > first[i] ? (last - first[i] + stride[i] - 1) / stride[i] : 0;
+    }
+}
+
+size_t ReadRegion::getFrameBytes(size_t bpv) const
+{
+    return empty() ? 0 : size_t(size[0]) * size_t(size[1]) * size_t(size[2]) * bpv;
+}
+
+void ReadRegion::applyTo(vvVolDesc* vd) const
+{
+    vec3 dist = vd->getDist();
+    for (int i = 0; i < 3; ++i)
+    {
+        // same convention as vvVolDesc::crop()
+        float center = 0.5f * dist[i] * (first[i] + first[i] + (size[i] - 1) * stride[i] - vd->vox[i]);
+        vd->pos[i] += i == 0 ? center : -center;
+        dist[i] *= float(stride[i]);
+        vd->vox[i] = size[i];
+    }
+    vd->setDist(dist);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// PositionedFile
+//
+
+PositionedFile::PositionedFile()
+    : fd_(-1)
+{
+}
+
+PositionedFile::PositionedFile(const char* filename)
+    : fd_(-1)
+{
+    open(filename);
+}
+
+PositionedFile::~PositionedFile()
+{
+    close();
+}
+
+bool PositionedFile::open(const char* filename)
+{
+    close();
+#ifdef _WIN32
+    fd_ = _open(filename, _O_RDONLY | _O_BINARY);
+#else
+    fd_ = ::open(filename, O_RDONLY);
+#endif
+    return fd_ >= 0;
+}
+
+void PositionedFile::close()
+{
+    if (fd_ < 0)
+        return;
+#ifdef _WIN32
+    _close(fd_);
+#else
+    ::close(fd_);
+#endif
+    fd_ = -1;
+}
+
+bool PositionedFile::isOpen() const
+{
+    return fd_ >= 0;
+}
+
+bool PositionedFile::read(int64_t offset, uint8_t* dst, size_t len)
+{
+    if (fd_ < 0 || offset < 0)
+        return false;
+
+#ifdef _WIN32
+    std::lock_guard< std::mutex > lock(mutex_);
+    if (_lseeki64(fd_, offset, SEEK_SET) != offset)
+        return false;
+#endif
+
+    while (len > 0)
+    {
+        // large reads are split, some systems do not read more than 2 GB at once
+        size_t chunk = std::min(len, size_t(INT_MAX / 2));
+#ifdef _WIN32
+        int n = _read(fd_, dst, static_cast< unsigned >(chunk));
+#else
+        ssize_t n = pread(fd_, dst, chunk, static_cast< off_t >(offset));
+#endif
+        if (n <= 0)
+            return false;
+        dst += n;
+        len -= size_t(n);
+        offset += n;
+    }
+
+    return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Region reads
+//
+
+bool readRegion(PositionedFile& file, int64_t offset, vector< 3, ssize_t > const& vox, size_t bpv,
+        ReadRegion const& region, uint8_t* dst)
+{
+    if (region.empty())
+        return true;
+
+    const int64_t lineBytes = int64_t(vox[0]) * int64_t(bpv);
+    const int64_t sliceBytes = lineBytes * int64_t(vox[1]);
+    const size_t rowBytes = size_t(region.size[0]) * bpv;
+
+    const bool wholeLines = region.first[0] == 0 && region.size[0] == vox[0] && region.stride[0] == 1;
+    const bool wholeSlices = wholeLines && region.first[1] == 0 && region.size[1] == vox[1] && region.stride[1] == 1;
+
+    // Contiguous slab of slices
+    if (wholeSlices && region.stride[2] == 1)
+    {
+        return file.read(offset + region.first[2] * sliceBytes, dst, size_t(region.size[2] * sliceBytes));
+    }
+
+    // Rows that are read as a whole, every stride'th voxel is picked from them
+    std::vector< uint8_t > span;
+    if (region.stride[0] > 1)
+        span.resize(size_t((region.size[0] - 1) * region.stride[0] + 1) * bpv);
+
+    for (ssize_t k = 0; k < region.size[2]; ++k)
+    {
+        const int64_t slice = offset + (region.first[2] + k * region.stride[2]) * sliceBytes;
+
+        // Contiguous block of lines
+        if (wholeLines && region.stride[1] == 1)
+        {
+            if (!file.read(slice + region.first[1] * lineBytes, dst, size_t(region.size[1]) * rowBytes))
+                return false;
+            dst += size_t(region.size[1]) * rowBytes;
+            continue;
+        }
+
+        for (ssize_t j = 0; j < region.size[1]; ++j)
+        {
+            const int64_t line = slice + (region.first[1] + j * region.stride[1]) * lineBytes
+                               + region.first[0] * int64_t(bpv);
+
+            if (span.empty())
+            {
+                if (!file.read(line, dst, rowBytes))
+                    return false;
+            }
+            else
+            {
+                if (!file.read(line, &span[0], span.size()))
+                    return false;
+                for (ssize_t i = 0; i < region.size[0]; ++i)
+                    memcpy(dst + i * bpv, &span[i * region.stride[0] * bpv], bpv);
+            }
+            dst += rowBytes;
+        }
+    }
+
+    return true;
+}
+
+void copyRegion(const uint8_t* src, vector< 3, ssize_t > const& vox, size_t bpv,
+        ReadRegion const& region, uint8_t* dst)
+{
+    const size_t lineBytes = size_t(vox[0]) * bpv;
+    const size_t sliceBytes = lineBytes * size_t(vox[1]);
+
+    for (ssize_t k = 0; k < region.size[2]; ++k)
+    {
+        const uint8_t* slice = src + size_t(region.first[2] + k * region.stride[2]) * sliceBytes;
+        for (ssize_t j = 0; j < region.size[1]; ++j)
+        {
+            const uint8_t* line = slice + size_t(region.first[1] + j * region.stride[1]) * lineBytes
+                                + size_t(region.first[0]) * bpv;
+            if (region.stride[0] == 1)
+            {
+                memcpy(dst, line, size_t(region.size[0]) * bpv);
+                dst += size_t(region.size[0]) * bpv;
+            }
+            else
+            {
+                for (ssize_t i = 0; i < region.size[0]; ++i, dst += bpv)
+                    memcpy(dst, line + size_t(i * region.stride[0]) * bpv, bpv);
+            }
+        }
+    }
+}
+
+
+} // namespace virvo
@@ -0,0 +1,107 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_REGIONIO_H
+#define VV_REGIONIO_H
+
+
+#include <cstddef>
+#include <mutex>
+
+#include "math/math.h"
+#include "vvinttypes.h"
+
+
+class vvVolDesc;
+
+
+namespace virvo
+{
+
+
+// Sub-box of a volume that is sampled with a stride: voxels first,
+// first+stride, ... up to first+(size-1)*stride in each dimension.
+struct ReadRegion
+{
+    vector< 3, ssize_t > first;
+    vector< 3, ssize_t > size;
+    vector< 3, ssize_t > stride;
+
+    ReadRegion();
+
+    // Clamp box [min,max) to a volume with vox voxels, strides < 1 are
+    // treated as 1. The region is empty if the box does not overlap the volume.
+    ReadRegion(basic_aabb< ssize_t > const& box, vector< 3, ssize_t > const& stride,
+            vector< 3, ssize_t > const& vox);
+
+    bool empty() const { return size[0] <= 0 || size[1] <= 0 || size[2] <= 0; }
+
+    // Size of one frame of the region [bytes]
+    size_t getFrameBytes(size_t bpv) const;
+
+    // Set voxel count, distance and position of vd, which must still
+    // describe the whole volume, to those of the region (as vvVolDesc::crop()).
+    void applyTo(vvVolDesc* vd) const;
+};
+
+
+// File that is read with positioned reads, so that several threads can
+// read from it at the same time.
+class PositionedFile
+{
+public:
+    PositionedFile();
+    explicit PositionedFile(const char* filename);
+   ~PositionedFile();
+
+    bool open(const char* filename);
+    void close();
+    bool isOpen() const;
+
+    // Read exactly len bytes at offset, false on error or end of file
+    bool read(int64_t offset, uint8_t* dst, size_t len);
+
+private:
+    int fd_;
+#ifdef _WIN32
+    std::mutex mutex_;
+#endif
+
+    PositionedFile(PositionedFile const&);
+    PositionedFile& operator=(PositionedFile const&);
+};
+
+
+// Read the region of a frame with vox voxels of bpv bytes that is stored
+// uncompressed at offset in file. Reads whole slabs or slices where the region
+// spans them and single rows otherwise, so that only the region is read.
+// dst must hold region.getFrameBytes(bpv) bytes.
+bool readRegion(PositionedFile& file, int64_t offset, vector< 3, ssize_t > const& vox, size_t bpv,
+        ReadRegion const& region, uint8_t* dst);
+
+// Copy the region of a frame in memory
+void copyRegion(const uint8_t* src, vector< 3, ssize_t > const& vox, size_t bpv,
+        ReadRegion const& region, uint8_t* dst);
+
+
+} // namespace virvo
+
+
+#endif // VV_REGIONIO_H
@@ -0,0 +1,444 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvresample.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+//--------------------------------------------------------------------------------------------------
+// Filter kernels
+//
+
+// Weights of a 1D resampling pass, destination sample x is computed from the
+// count[x] source samples starting at first[x]. first is ascending.
+struct Kernel
+{
+    size_t taps;                                // max. taps per sample, stride of weights
+    std::vector<ssize_t> first;
+    std::vector<size_t> count;
+    std::vector<float> weights;
+    bool identity;                              // pass can be skipped
+};
+
+double lanczos3(double t)
+{
+    const double a = 3.0;
+
+    t = std::fabs(t);
+    if (t < 1e-8)
+        return 1.0;
+    if (t >= a)
+        return 0.0;
+
+    double pt = M_PI * t;
+    return a * std::sin(pt) * std::sin(pt / a) / (pt * pt);
+}
+
+Kernel makeKernel(ssize_t srcN, ssize_t dstN, ResampleFilter filter)
+{
+    std::vector< std::vector<float> > w(dstN);
+    std::vector<ssize_t> first(dstN);
+
+    const double scale = double(srcN) / double(dstN);
+
+    for (ssize_t x = 0; x < dstN; ++x)
+    {
+        switch (filter)
+        {
+        case RESAMPLE_NEAREST:
+        {
+            first[x] = dstN > 1 ? x * (srcN - 1) / (dstN - 1) : 0;
+            w[x].assign(1, 1.0f);
+            break;
+        }
+        case RESAMPLE_TRILINEAR:
+        {
+            if (srcN < 2)
+            {
+                first[x] = 0;
+                w[x].assign(1, 1.0f);
+                break;
+            }
+            double pos = dstN > 1 ? double(x) * double(srcN - 1) / double(dstN - 1) : 0.0;
+            ssize_t i0 = std::min(ssize_t(pos), srcN - 2);
+            float frac = float(pos - double(i0));
+            first[x] = i0;
+            w[x].push_back(1.0f - frac);
+            w[x].push_back(frac);
+            break;
+        }
+        case RESAMPLE_BOX:
+        case RESAMPLE_MAX:
+        {
+            double a = double(x) * scale;
+            double b = double(x + 1) * scale;
+            ssize_t i0 = std::min(ssize_t(std::floor(a)), srcN - 1);
+            ssize_t i1 = std::max(i0, std::min(ssize_t(std::ceil(b)) - 1, srcN - 1));
+            first[x] = i0;
+            for (ssize_t i = i0; i <= i1; ++i)
+            {
+                if (filter == RESAMPLE_MAX)
+                    w[x].push_back(1.0f);
+                else
+                    w[x].push_back(float(std::max(0.0, std::min(b, double(i + 1)) - std::max(a, double(i))) / scale));
+            }
+            break;
+        }
+        case RESAMPLE_LANCZOS:
+        {
+            // Widen the filter when downsampling, replicate edge voxels
+            double fs = std::max(scale, 1.0);
+            double center = (double(x) + 0.5) * scale - 0.5;
+            ssize_t a = ssize_t(std::ceil(center - 3.0 * fs));
+            ssize_t b = ssize_t(std::floor(center + 3.0 * fs));
+            ssize_t lo = std::max(ssize_t(0), std::min(a, srcN - 1));
+            ssize_t hi = std::max(ssize_t(0), std::min(b, srcN - 1));
+            first[x] = lo;
+            w[x].assign(hi - lo + 1, 0.0f);
+            double sum = 0.0;
+            for (ssize_t i = a; i <= b; ++i)
+            {
+                double l = lanczos3((double(i) - center) / fs);
+                w[x][std::max(lo, std::min(i, hi)) - lo] += float(l);
+                sum += l;
+            }
+            for (size_t i = 0; i < w[x].size(); ++i)
+                w[x][i] = sum != 0.0 ? float(w[x][i] / sum) : 0.0f;
+            break;
+        }
+        }
+    }
+
+    Kernel k;
+    k.taps = 1;
+    for (ssize_t x = 0; x < dstN; ++x)
+        k.taps = std::max(k.taps, w[x].size());
+
+    k.first = first;
+    k.count.resize(dstN);
+    k.weights.assign(dstN * k.taps, 0.0f);
+    k.identity = srcN == dstN;
+    for (ssize_t x = 0; x < dstN; ++x)
+    {
+        k.count[x] = w[x].size();
+        std::copy(w[x].begin(), w[x].end(), k.weights.begin() + x * k.taps);
+        k.identity = k.identity && k.count[x] == 1 && first[x] == x && w[x][0] == 1.0f;
+    }
+
+    return k;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Row kernels, vectorized along the rows
+//
+
+// acc[i] = 0 or -inf
+void clearRow(float* acc, size_t n, bool isMax)
+{
+    std::fill(acc, acc + n, isMax ? -std::numeric_limits<float>::infinity() : 0.0f);
+}
+
+// acc[i] += w * src[i]
+void accumulateRow(float* acc, const float* src, float w, size_t n)
+{
+    size_t i = 0;
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    simd::float4 w4(w);
+    for (; i + 4 <= n; i += 4)
+    {
+        simd::float4 a = _mm_loadu_ps(acc + i);
+        simd::float4 s = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(acc + i, a + w4 * s);
+    }
+#endif
+    for (; i < n; ++i)
+        acc[i] += w * src[i];
+}
+
+// acc[i] = max(acc[i], src[i])
+void maxRow(float* acc, const float* src, size_t n)
+{
+    size_t i = 0;
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    for (; i + 4 <= n; i += 4)
+    {
+        simd::float4 a = _mm_loadu_ps(acc + i);
+        simd::float4 s = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(acc + i, simd::max(a, s));
+    }
+#endif
+    for (; i < n; ++i)
+        acc[i] = std::max(acc[i], src[i]);
+}
+
+// Filter rows of length n: dst row x = sum of weighted src rows
+// (src rows are stride apart)
+void filterRows(float* dst, const float* src, size_t n, size_t stride, Kernel const& k, ssize_t dstN, bool isMax)
+{
+    for (ssize_t x = 0; x < dstN; ++x)
+    {
+        float* acc = dst + x * n;
+        const float* w = &k.weights[x * k.taps];
+        clearRow(acc, n, isMax);
+        for (size_t t = 0; t < k.count[x]; ++t)
+        {
+            const float* row = src + (k.first[x] + t) * stride;
+            if (isMax)
+                maxRow(acc, row, n);
+            else
+                accumulateRow(acc, row, w[t], n);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Voxel conversion
+//
+
+template <typename T>
+void decodeRow(const uint8_t* src, float* dst, size_t n)
+{
+    const T* s = reinterpret_cast<const T*>(src);
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = static_cast<float>(s[i]);
+}
+
+void decodeRow(const uint8_t* src, float* dst, size_t n, size_t bpc)
+{
+    switch (bpc)
+    {
+    case 1: decodeRow<uint8_t>(src, dst, n); break;
+    case 2: decodeRow<uint16_t>(src, dst, n); break;
+    case 4: std::memcpy(dst, src, n * sizeof(float)); break;
+    default: assert(0); break;
+    }
+}
+
+template <typename T>
+void encodeRow(const float* src, uint8_t* dst, size_t n)
+{
+    const float hi = static_cast<float>(std::numeric_limits<T>::max());
+    T* d = reinterpret_cast<T*>(dst);
+    for (size_t i = 0; i < n; ++i)
+        d[i] = static_cast<T>(std::max(0.0f, std::min(src[i] + 0.5f, hi)));
+}
+
+void encodeRow(const float* src, uint8_t* dst, size_t n, size_t bpc)
+{
+    switch (bpc)
+    {
+    case 1: encodeRow<uint8_t>(src, dst, n); break;
+    case 2: encodeRow<uint16_t>(src, dst, n); break;
+    case 4: std::memcpy(dst, src, n * sizeof(float)); break;
+    default: assert(0); break;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Nearest neighbor, copies voxels without conversion
+//
+
+void resampleNearest(const uint8_t* src,
+        vector< 3, ssize_t > const& srcVox,
+        uint8_t* dst,
+        vector< 3, ssize_t > const& dstVox,
+        size_t bpv)
+{
+    Kernel kx = makeKernel(srcVox[0], dstVox[0], RESAMPLE_NEAREST);
+    Kernel ky = makeKernel(srcVox[1], dstVox[1], RESAMPLE_NEAREST);
+    Kernel kz = makeKernel(srcVox[2], dstVox[2], RESAMPLE_NEAREST);
+
+    const size_t srcLine = srcVox[0] * bpv;
+    const size_t srcSlice = srcLine * srcVox[1];
+    const size_t dstLine = dstVox[0] * bpv;
+    const size_t dstSlice = dstLine * dstVox[1];
+
+    parallel_for(0, dstVox[2], [&](size_t first, size_t last)
+    {
+        for (size_t z = first; z < last; ++z)
+        {
+            for (ssize_t y = 0; y < dstVox[1]; ++y)
+            {
+                const uint8_t* s = src + kz.first[z] * srcSlice + ky.first[y] * srcLine;
+                uint8_t* d = dst + z * dstSlice + y * dstLine;
+                if (kx.identity)
+                {
+                    std::memcpy(d, s, dstLine);
+                    continue;
+                }
+                for (ssize_t x = 0; x < dstVox[0]; ++x)
+                    std::memcpy(d + x * bpv, s + kx.first[x] * bpv, bpv);
+            }
+        }
+    });
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Interface
+//
+
+void resample(const uint8_t* src,
+        vector< 3, ssize_t > const& srcVox,
+        uint8_t* dst,
+        vector< 3, ssize_t > const& dstVox,
+        size_t bpc,
+        size_t numChan,
+        ResampleFilter filter)
+{
+    if (filter == RESAMPLE_NEAREST)
+    {
+        resampleNearest(src, srcVox, dst, dstVox, bpc * numChan);
+        return;
+    }
+
+    const bool isMax = filter == RESAMPLE_MAX;
+
+    Kernel kx = makeKernel(srcVox[0], dstVox[0], filter);
+    Kernel ky = makeKernel(srcVox[1], dstVox[1], filter);
+    Kernel kz = makeKernel(srcVox[2], dstVox[2], filter);
+
+    const size_t srcRow = srcVox[0] * numChan;  // values per source row
+    const size_t row = dstVox[0] * numChan;     // values per row after the x pass
+    const size_t slice = row * dstVox[1];       // values per slice after the y pass
+
+    // Source slices filtered in x and y, in a ring buffer: source slice z is
+    // kept in ring slot z % ringSize. The ring holds the footprint of at
+    // least one destination slice, plus room for a few destination slices
+    // per worker thread so that the z pass can run in parallel.
+    const size_t scale = (srcVox[2] + dstVox[2] - 1) / dstVox[2];
+    const size_t ringSize = std::min(size_t(srcVox[2]), kz.taps + numWorkerThreads() * scale);
+    std::vector<float> ring(slice * ringSize);
+
+    // x and y passes for source slices [first, last)
+    auto filterXY = [&](size_t first, size_t last)
+    {
+        std::vector<float> in(srcRow);
+        std::vector<float> xpass(row * srcVox[1]);
+
+        for (size_t z = first; z < last; ++z)
+        {
+            const uint8_t* s = src + z * srcRow * srcVox[1] * bpc;
+            float* xy = &ring[(z % ringSize) * slice];
+
+            for (ssize_t y = 0; y < srcVox[1]; ++y)
+            {
+                float* out = &xpass[y * row];
+                decodeRow(s + y * srcRow * bpc, kx.identity ? out : &in[0], srcRow, bpc);
+                if (kx.identity)
+                    continue;
+
+                for (ssize_t x = 0; x < dstVox[0]; ++x)
+                {
+                    const float* w = &kx.weights[x * kx.taps];
+                    const float* v = &in[kx.first[x] * numChan];
+                    for (size_t c = 0; c < numChan; ++c)
+                    {
+                        float acc = isMax ? v[c] : w[0] * v[c];
+                        for (size_t t = 1; t < kx.count[x]; ++t)
+                        {
+                            float val = v[t * numChan + c];
+                            acc = isMax ? std::max(acc, val) : acc + w[t] * val;
+                        }
+                        out[x * numChan + c] = acc;
+                    }
+                }
+            }
+
+            if (ky.identity)
+                std::copy(xpass.begin(), xpass.end(), xy);
+            else
+                filterRows(xy, &xpass[0], row, row, ky, dstVox[1], isMax);
+        }
+    };
+
+    // z pass for destination slices [first, last), their footprints must be
+    // in the ring
+    auto filterZ = [&](size_t first, size_t last)
+    {
+        std::vector<float> out(slice);
+
+        for (size_t z = first; z < last; ++z)
+        {
+            const float* w = &kz.weights[z * kz.taps];
+            clearRow(&out[0], slice, isMax);
+            for (size_t t = 0; t < kz.count[z]; ++t)
+            {
+                const float* in = &ring[((kz.first[z] + t) % ringSize) * slice];
+                if (isMax)
+                    maxRow(&out[0], in, slice);
+                else
+                    accumulateRow(&out[0], in, w[t], slice);
+            }
+            encodeRow(&out[0], dst + z * slice * bpc, slice, bpc);
+        }
+    };
+
+
+    //--- blocks of destination slices whose footprints fit into the ring ---
+
+    // Source slices [0, filtered) have been filtered in x and y
+    size_t filtered = 0;
+
+    for (size_t z = 0; z < size_t(dstVox[2]); )
+    {
+        // Footprints start in ascending order
+        const size_t begin = kz.first[z];
+        size_t end = begin + kz.count[z];
+        size_t zEnd = z + 1;
+        while (zEnd < size_t(dstVox[2]) && std::max(end, kz.first[zEnd] + kz.count[zEnd]) - begin <= ringSize)
+        {
+            end = std::max(end, kz.first[zEnd] + kz.count[zEnd]);
+            ++zEnd;
+        }
+
+        if (end > filtered)
+        {
+            parallel_for(std::max(begin, filtered), end, filterXY, 1);
+            filtered = end;
+        }
+
+        parallel_for(z, zEnd, filterZ);
+        z = zEnd;
+    }
+}
+
+
+} // namespace virvo
@@ -0,0 +1,69 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_RESAMPLE_H
+#define VV_RESAMPLE_H
+
+
+#include <cstddef>
+
+#include "math/math.h"
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+enum ResampleFilter
+{
+    // Point sampling, source voxels are addressed with corner aligned
+    // coordinates (the first and last voxels of each axis map to each other)
+    RESAMPLE_NEAREST,
+    RESAMPLE_TRILINEAR,
+
+    // Filters over the footprint of the destination voxels, with center
+    // aligned coordinates. These also filter properly when downsampling.
+    RESAMPLE_BOX,                               // area weighted average
+    RESAMPLE_LANCZOS,                           // Lanczos windowed sinc, a = 3
+    RESAMPLE_MAX                                // maximum of the footprint
+};
+
+// Resample one volume frame from srcVox to dstVox voxels.
+//
+// The volume is filtered with three separable 1D passes with precomputed
+// weights: x within each source slice, y within each slice, and z over whole
+// slices. Only the source slices that the z pass currently needs are kept
+// filtered in x and y, as float. Slices are processed in parallel, the y and
+// z passes are vectorized along the rows. Voxels are bpc bytes per channel in
+// the vvVolDesc layout, integer results are rounded and clamped.
+void resample(const uint8_t* src,
+        vector< 3, ssize_t > const& srcVox,
+        uint8_t* dst,
+        vector< 3, ssize_t > const& dstVox,
+        size_t bpc,
+        size_t numChan,
+        ResampleFilter filter);
+
+
+} // namespace virvo
+
+
+#endif // VV_RESAMPLE_H
@@ -0,0 +1,425 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvstencil.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+//--------------------------------------------------------------------------------------------------
+// Voxel conversion
+//
+
+template <typename T>
+struct Normalize
+{
+    static float scale() { return 1.0f; }
+};
+
+template <>
+struct Normalize<uint8_t>
+{
+    static float scale() { return 1.0f / 255.0f; }
+};
+
+template <>
+struct Normalize<uint16_t>
+{
+    static float scale() { return 1.0f / 65535.0f; }
+};
+
+// Decode one channel of n voxels that are stride bytes apart
+template <typename T, typename Acc>
+void decodeChannel(const uint8_t* src, size_t n, size_t stride, Acc* dst)
+{
+    const Acc scale = Acc(Normalize<T>::scale());
+    for (size_t i = 0; i < n; ++i, src += stride)
+    {
+        T v;
+        std::memcpy(&v, src, sizeof(T));
+        dst[i] = Acc(v) * scale;
+    }
+}
+
+// Store a value from [0..1]
+template <typename T>
+inline void storeUnit(uint8_t* dst, float v)
+{
+    const float hi = float(std::numeric_limits<T>::max());
+    T t = T(int(std::max(0.0f, std::min(v, 1.0f)) * hi));
+    std::memcpy(dst, &t, sizeof(T));
+}
+
+template <>
+inline void storeUnit<float>(uint8_t* dst, float v)
+{
+    std::memcpy(dst, &v, sizeof(float));
+}
+
+// Store a value from [-1..1]
+template <typename T>
+inline void storeSigned(uint8_t* dst, float v)
+{
+    const float hi = float(std::numeric_limits<T>::max());
+    T t = T(ts_clamp(int((v + 1.0f) * hi * 0.5f), 0, int(hi)));
+    std::memcpy(dst, &t, sizeof(T));
+}
+
+template <>
+inline void storeSigned<float>(uint8_t* dst, float v)
+{
+    std::memcpy(dst, &v, sizeof(float));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Gradients
+//
+
+// Central differences of the interior voxels x = 1..w-2 of a row. c is the row,
+// up/down are the neighbor rows in y, prev/next the neighbor rows in z.
+// Magnitudes are only computed if mag != NULL.
+void differences(const float* c, const float* up, const float* down, const float* prev, const float* next,
+        size_t w, float* gx, float* gy, float* gz, float* mag)
+{
+    const float invSqrt3 = 1.0f / std::sqrt(3.0f);
+
+    size_t x = 1;
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    const simd::float4 s4(invSqrt3);
+    for (; x + 4 < w; x += 4)
+    {
+        simd::float4 dx = simd::float4(_mm_loadu_ps(c + x + 1)) - simd::float4(_mm_loadu_ps(c + x - 1));
+        simd::float4 dy = simd::float4(_mm_loadu_ps(down + x)) - simd::float4(_mm_loadu_ps(up + x));
+        simd::float4 dz = simd::float4(_mm_loadu_ps(next + x)) - simd::float4(_mm_loadu_ps(prev + x));
+        _mm_storeu_ps(gx + x, dx);
+        _mm_storeu_ps(gy + x, dy);
+        _mm_storeu_ps(gz + x, dz);
+        if (mag != NULL)
+            _mm_storeu_ps(mag + x, simd::float4(_mm_sqrt_ps(dx * dx + dy * dy + dz * dz)) * s4);
+    }
+#endif
+    for (; x + 1 < w; ++x)
+    {
+        gx[x] = c[x + 1] - c[x - 1];
+        gy[x] = down[x] - up[x];
+        gz[x] = next[x] - prev[x];
+        if (mag != NULL)
+            mag[x] = std::sqrt(gx[x] * gx[x] + gy[x] * gy[x] + gz[x] * gz[x]) * invSqrt3;
+    }
+}
+
+template <typename T>
+void gradients(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan,
+        bool magnitude,
+        float& minMag,
+        float& maxMag)
+{
+    const size_t w = vox[0];
+    const size_t h = vox[1];
+    const size_t d = vox[2];
+    if (w < 3 || h < 3 || d < 3)
+        return;
+
+    const size_t bpv = sizeof(T) * numChan;
+    const size_t sliceVoxels = w * h;
+    const uint8_t* src = data + srcChan * sizeof(T);
+    uint8_t* dst = data + dstChan * sizeof(T);
+
+    std::mutex mutex;
+
+    parallel_for(1, d - 1, [&](size_t first, size_t last)
+    {
+        // Decoded source slices z-1, z, z+1
+        std::vector<float> ring(3 * sliceVoxels);
+        float* slice[3] = { &ring[0], &ring[sliceVoxels], &ring[2 * sliceVoxels] };
+
+        std::vector<float> gx(w), gy(w), gz(w), mag(w);
+        float localMin = 1.0f;
+        float localMax = 0.0f;
+
+        decodeChannel<T>(src + (first - 1) * sliceVoxels * bpv, sliceVoxels, bpv, slice[0]);
+        decodeChannel<T>(src + first * sliceVoxels * bpv, sliceVoxels, bpv, slice[1]);
+
+        for (size_t z = first; z < last; ++z)
+        {
+            decodeChannel<T>(src + (z + 1) * sliceVoxels * bpv, sliceVoxels, bpv, slice[2]);
+
+            for (size_t y = 1; y + 1 < h; ++y)
+            {
+                const float* c = slice[1] + y * w;
+                differences(c, c - w, c + w, slice[0] + y * w, slice[2] + y * w, w,
+                        &gx[0], &gy[0], &gz[0], magnitude ? &mag[0] : NULL);
+
+                uint8_t* out = dst + (z * sliceVoxels + y * w) * bpv;
+                if (magnitude)
+                {
+                    for (size_t x = 1; x + 1 < w; ++x)
+                    {
+                        float m = std::min(mag[x], 1.0f);
+                        storeUnit<T>(out + x * bpv, m);
+                        localMin = std::min(localMin, m);
+                        localMax = std::max(localMax, m);
+                    }
+                }
+                else
+                {
+                    for (size_t x = 1; x + 1 < w; ++x)
+                    {
+                        storeSigned<T>(out + x * bpv, gx[x]);
+                        storeSigned<T>(out + x * bpv + sizeof(T), gy[x]);
+                        storeSigned<T>(out + x * bpv + 2 * sizeof(T), gz[x]);
+                    }
+                }
+            }
+
+            std::rotate(slice, slice + 1, slice + 3);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        minMag = std::min(minMag, localMin);
+        maxMag = std::max(maxMag, localMax);
+    });
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Variance
+//
+
+// 3x3 box sums of a slice of values v, and of their squares
+template <typename Acc>
+void boxSums(const Acc* v, size_t w, size_t h, Acc* sum, Acc* sumSq, Acc* tmp, Acc* tmpSq)
+{
+    // Sums along x
+    for (size_t y = 0; y < h; ++y)
+    {
+        const Acc* r = v + y * w;
+        Acc* t = tmp + y * w;
+        Acc* q = tmpSq + y * w;
+
+        t[0] = r[0] + (w > 1 ? r[1] : Acc(0));
+        q[0] = r[0] * r[0] + (w > 1 ? r[1] * r[1] : Acc(0));
+        for (size_t x = 1; x + 1 < w; ++x)
+        {
+            t[x] = r[x - 1] + r[x] + r[x + 1];
+            q[x] = r[x - 1] * r[x - 1] + r[x] * r[x] + r[x + 1] * r[x + 1];
+        }
+        if (w > 1)
+        {
+            t[w - 1] = r[w - 2] + r[w - 1];
+            q[w - 1] = r[w - 2] * r[w - 2] + r[w - 1] * r[w - 1];
+        }
+    }
+
+    // Sums along y, whole rows at once
+    for (size_t y = 0; y < h; ++y)
+    {
+        const Acc* t = tmp + y * w;
+        const Acc* q = tmpSq + y * w;
+        const Acc* tu = y > 0 ? t - w : NULL;
+        const Acc* qu = y > 0 ? q - w : NULL;
+        const Acc* td = y + 1 < h ? t + w : NULL;
+        const Acc* qd = y + 1 < h ? q + w : NULL;
+        Acc* s = sum + y * w;
+        Acc* s2 = sumSq + y * w;
+
+        for (size_t x = 0; x < w; ++x)
+        {
+            s[x] = t[x];
+            s2[x] = q[x];
+        }
+        if (tu != NULL)
+        {
+            for (size_t x = 0; x < w; ++x)
+            {
+                s[x] += tu[x];
+                s2[x] += qu[x];
+            }
+        }
+        if (td != NULL)
+        {
+            for (size_t x = 0; x < w; ++x)
+            {
+                s[x] += td[x];
+                s2[x] += qd[x];
+            }
+        }
+    }
+}
+
+// Number of neighbors inside the volume along one axis
+inline size_t neighbors(size_t i, size_t n)
+{
+    return 1 + (i > 0 ? 1 : 0) + (i + 1 < n ? 1 : 0);
+}
+
+template <typename T, typename Acc>
+void variance(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan)
+{
+    const size_t w = vox[0];
+    const size_t h = vox[1];
+    const size_t d = vox[2];
+    if (w == 0 || h == 0 || d == 0)
+        return;
+
+    const size_t bpv = sizeof(T) * numChan;
+    const size_t sliceVoxels = w * h;
+    const uint8_t* src = data + srcChan * sizeof(T);
+    uint8_t* dst = data + dstChan * sizeof(T);
+
+    // Neighbor counts in the x/y plane
+    std::vector<Acc> count(sliceVoxels);
+    for (size_t y = 0; y < h; ++y)
+        for (size_t x = 0; x < w; ++x)
+            count[y * w + x] = Acc(neighbors(x, w) * neighbors(y, h));
+
+    parallel_for(0, d, [&](size_t first, size_t last)
+    {
+        // Box sums of slices z-1, z, z+1, zero outside of the volume
+        std::vector<Acc> ring(6 * sliceVoxels, Acc(0));
+        Acc* sum[3] = { &ring[0], &ring[sliceVoxels], &ring[2 * sliceVoxels] };
+        Acc* sumSq[3] = { &ring[3 * sliceVoxels], &ring[4 * sliceVoxels], &ring[5 * sliceVoxels] };
+
+        std::vector<Acc> values(sliceVoxels), tmp(sliceVoxels), tmpSq(sliceVoxels);
+
+        auto load = [&](size_t z, Acc* s, Acc* s2)
+        {
+            if (z >= d)
+            {
+                std::fill(s, s + sliceVoxels, Acc(0));
+                std::fill(s2, s2 + sliceVoxels, Acc(0));
+                return;
+            }
+            decodeChannel<T>(src + z * sliceVoxels * bpv, sliceVoxels, bpv, &values[0]);
+            boxSums(&values[0], w, h, s, s2, &tmp[0], &tmpSq[0]);
+        };
+
+        if (first > 0)
+            load(first - 1, sum[0], sumSq[0]);
+        load(first, sum[1], sumSq[1]);
+
+        for (size_t z = first; z < last; ++z)
+        {
+            load(z + 1, sum[2], sumSq[2]);
+
+            const Acc nz = Acc(neighbors(z, d));
+            uint8_t* out = dst + z * sliceVoxels * bpv;
+            for (size_t i = 0; i < sliceVoxels; ++i)
+            {
+                Acc n = count[i] * nz;
+                Acc mean = (sum[0][i] + sum[1][i] + sum[2][i]) / n;
+                Acc var = (sumSq[0][i] + sumSq[1][i] + sumSq[2][i]) / n - mean * mean;
+                storeUnit<T>(out + i * bpv, float(std::max(var, Acc(0))));
+            }
+
+            std::rotate(sum, sum + 1, sum + 3);
+            std::rotate(sumSq, sumSq + 1, sumSq + 3);
+        }
+    });
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Interface
+//
+
+void computeGradientMagnitudes(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t bpc,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan,
+        float& minMag,
+        float& maxMag)
+{
+    switch (bpc)
+    {
+    case 1: gradients<uint8_t>(data, vox, numChan, srcChan, dstChan, true, minMag, maxMag); break;
+    case 2: gradients<uint16_t>(data, vox, numChan, srcChan, dstChan, true, minMag, maxMag); break;
+    case 4: gradients<float>(data, vox, numChan, srcChan, dstChan, true, minMag, maxMag); break;
+    default: assert(0); break;
+    }
+}
+
+void computeGradientVectors(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t bpc,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan)
+{
+    float minMag = 0.0f;
+    float maxMag = 0.0f;
+
+    switch (bpc)
+    {
+    case 1: gradients<uint8_t>(data, vox, numChan, srcChan, dstChan, false, minMag, maxMag); break;
+    case 2: gradients<uint16_t>(data, vox, numChan, srcChan, dstChan, false, minMag, maxMag); break;
+    case 4: gradients<float>(data, vox, numChan, srcChan, dstChan, false, minMag, maxMag); break;
+    default: assert(0); break;
+    }
+}
+
+void computeVariance(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t bpc,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan)
+{
+    // Integer channels are normalized, float channels need double sums to
+    // avoid cancellation in E[x^2] - E[x]^2
+    switch (bpc)
+    {
+    case 1: variance<uint8_t, float>(data, vox, numChan, srcChan, dstChan); break;
+    case 2: variance<uint16_t, float>(data, vox, numChan, srcChan, dstChan); break;
+    case 4: variance<float, double>(data, vox, numChan, srcChan, dstChan); break;
+    default: assert(0); break;
+    }
+}
+
+
+} // namespace virvo
@@ -0,0 +1,82 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_STENCIL_H
+#define VV_STENCIL_H
+
+
+#include <cstddef>
+
+#include "math/math.h"
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+// Neighborhood operators that derive new channels from one channel of a
+// volume frame. Frames use the vvVolDesc layout with numChan interleaved
+// channels of bpc bytes. Integer values are normalized to [0..1] before
+// processing, float values are used as is.
+//
+// The kernels stream over the volume slice by slice, keeping the decoded
+// neighbor slices of the source channel in float buffers. z slabs are
+// processed in parallel.
+
+
+// Central difference gradient magnitudes of srcChan, divided by sqrt(3) and
+// clamped to [0..1], are stored in dstChan. Edge voxels are not written.
+// minMag and maxMag return the range of the computed magnitudes.
+void computeGradientMagnitudes(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t bpc,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan,
+        float& minMag,
+        float& maxMag);
+
+// Central difference gradient vectors of srcChan are stored in dstChan..dstChan+2.
+// Integer channels store the components mapped from [-1..1] to [0..max].
+// Edge voxels are not written.
+void computeGradientVectors(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t bpc,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan);
+
+// Variance of srcChan in the 3x3x3 neighborhood of each voxel is stored in
+// dstChan. At the edges of the volume only the neighbors inside the volume are
+// used. The variance is computed from running box sums of the values and of
+// their squares.
+void computeVariance(uint8_t* data,
+        vector< 3, ssize_t > const& vox,
+        size_t bpc,
+        size_t numChan,
+        size_t srcChan,
+        size_t dstChan);
+
+
+} // namespace virvo
+
+
+#endif // VV_STENCIL_H
@@ -0,0 +1,335 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include "vvwarp.h"
+#include "parallel_for.h"
+
+#include "vvtoolshed.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+namespace virvo
+{
+
+
+namespace
+{
+
+const int PIXEL_SIZE = 4;                       // RGBA
+
+// Source coordinates of destination pixel p = (x, y, 1):
+// u = dot(a, p) / dot(w, p), v = dot(b, p) / dot(w, p)
+struct Projection
+{
+    float a[3];
+    float b[3];
+    float w[3];
+    // dot(w, p) is 1 for all pixels
+    bool affine;
+};
+
+Projection makeProjection(mat4 const& inv)
+{
+    Projection p;
+    const int cols[3] = { 0, 1, 3 };
+    for (int i = 0; i < 3; ++i)
+    {
+        p.a[i] = inv(0, cols[i]);
+        p.b[i] = inv(1, cols[i]);
+        p.w[i] = inv(3, cols[i]);
+    }
+
+    p.affine = p.w[0] == 0.0f && p.w[1] == 0.0f && p.w[2] != 0.0f;
+    if (p.affine)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            p.a[i] /= p.w[2];
+            p.b[i] /= p.w[2];
+        }
+    }
+    return p;
+}
+
+// Source coordinates of the pixels of destination line y, at offset
+// (offset, offset) from the lower left pixel corners
+void findSourceCoords(Projection const& p, float y, float offset, int width, float* u, float* v)
+{
+    y += offset;
+    const float u0 = p.a[0] * offset + p.a[1] * y + p.a[2];
+    const float v0 = p.b[0] * offset + p.b[1] * y + p.b[2];
+    int x = 0;
+
+    if (p.affine)
+    {
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+        const simd::float4 ramp(0.0f, 1.0f, 2.0f, 3.0f);
+        const simd::float4 du(p.a[0]);
+        const simd::float4 dv(p.b[0]);
+        for (; x + 4 <= width; x += 4)
+        {
+            simd::float4 xf = simd::float4(float(x)) + ramp;
+            _mm_storeu_ps(u + x, simd::float4(u0) + xf * du);
+            _mm_storeu_ps(v + x, simd::float4(v0) + xf * dv);
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            u[x] = u0 + float(x) * p.a[0];
+            v[x] = v0 + float(x) * p.b[0];
+        }
+    }
+    else
+    {
+        const float w0 = p.w[0] * offset + p.w[1] * y + p.w[2];
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+        const simd::float4 ramp(0.0f, 1.0f, 2.0f, 3.0f);
+        const simd::float4 du(p.a[0]);
+        const simd::float4 dv(p.b[0]);
+        const simd::float4 dw(p.w[0]);
+        for (; x + 4 <= width; x += 4)
+        {
+            simd::float4 xf = simd::float4(float(x)) + ramp;
+            simd::float4 w = simd::float4(w0) + xf * dw;
+            _mm_storeu_ps(u + x, (simd::float4(u0) + xf * du) / w);
+            _mm_storeu_ps(v + x, (simd::float4(v0) + xf * dv) / w);
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            const float w = w0 + float(x) * p.w[0];
+            u[x] = (u0 + float(x) * p.a[0]) / w;
+            v[x] = (v0 + float(x) * p.b[0]) / w;
+        }
+    }
+}
+
+// True if the source coordinates truncate to a pixel of the source image.
+// Also false for NaN coordinates (points at infinity).
+inline bool isInside(float u, float v, int srcWidth, int srcHeight)
+{
+    return u > -1.0f && u < float(srcWidth) && v > -1.0f && v < float(srcHeight);
+}
+
+// Index of the source pixel for each destination pixel, -1 if outside
+void findSourcePixels(const float* u, const float* v, int width, int srcWidth, int srcHeight, int* index)
+{
+    int x = 0;
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    const simd::float4 minusOne(-1.0f);
+    const simd::float4 w = simd::float4(float(srcWidth));
+    const simd::float4 h = simd::float4(float(srcHeight));
+    for (; x + 4 <= width; x += 4)
+    {
+        const simd::float4 u4(_mm_loadu_ps(u + x));
+        const simd::float4 v4(_mm_loadu_ps(v + x));
+        const simd::mask4 inside = u4 > minusOne && u4 < w && v4 > minusOne && v4 < h;
+        // Row offset in float is exact for images of less than 2^24 pixels
+        const simd::float4 yw = simd::float4(_mm_cvttps_epi32(v4)) * w;
+        const simd::int4 i(_mm_add_epi32(_mm_cvttps_epi32(u4), _mm_cvttps_epi32(yw)));
+        _mm_storeu_si128(reinterpret_cast< __m128i* >(index + x), simd::select(inside, i, simd::int4(-1)));
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        index[x] = isInside(u[x], v[x], srcWidth, srcHeight) ? int(u[x]) + int(v[x]) * srcWidth : -1;
+    }
+}
+
+void warpLineNearest(uint8_t* dst, const int* index, int width, const uint8_t* src)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        if (index[x] >= 0)
+            std::memcpy(dst + x * PIXEL_SIZE, src + index[x] * PIXEL_SIZE, PIXEL_SIZE);
+        else
+            std::memset(dst + x * PIXEL_SIZE, 0, PIXEL_SIZE);
+    }
+}
+
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+inline simd::float4 loadPixel(const uint8_t* p)
+{
+    int rgba;
+    std::memcpy(&rgba, p, PIXEL_SIZE);
+    const __m128i zero = _mm_setzero_si128();
+    return simd::float4(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(rgba), zero), zero));
+}
+
+inline void storePixel(uint8_t* p, simd::float4 const& c)
+{
+    __m128i i = _mm_cvtps_epi32(c);
+    i = _mm_packs_epi32(i, i);
+    i = _mm_packus_epi16(i, i);
+    const int rgba = _mm_cvtsi128_si32(i);
+    std::memcpy(p, &rgba, PIXEL_SIZE);
+}
+#endif
+
+// Lower left pixel of the bilinear footprint for each destination pixel
+// center, -1 if outside. The footprint is clamped to the image edge, u and v
+// are replaced by the interpolation weights.
+void findSourceFootprints(float* u, float* v, int width, int srcWidth, int srcHeight, int* index)
+{
+    const float maxX = float(srcWidth - 1);
+    const float maxY = float(srcHeight - 1);
+    // The lower left pixel must have a right and upper neighbor
+    const float lastX = float(std::max(srcWidth - 2, 0));
+    const float lastY = float(std::max(srcHeight - 2, 0));
+    int x = 0;
+
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+    const simd::float4 zero(0.0f);
+    const simd::float4 half(0.5f);
+    const simd::float4 w = simd::float4(float(srcWidth));
+    const simd::float4 h = simd::float4(float(srcHeight));
+    for (; x + 4 <= width; x += 4)
+    {
+        const simd::float4 u4(_mm_loadu_ps(u + x));
+        const simd::float4 v4(_mm_loadu_ps(v + x));
+        const simd::mask4 inside = u4 >= zero && u4 < w && v4 >= zero && v4 < h;
+        // Relative to the pixel centers
+        const simd::float4 fx = simd::min(simd::max(u4 - half, zero), simd::float4(maxX));
+        const simd::float4 fy = simd::min(simd::max(v4 - half, zero), simd::float4(maxY));
+        const simd::float4 x0 = simd::min(simd::float4(_mm_cvttps_epi32(fx)), simd::float4(lastX));
+        const simd::float4 y0 = simd::min(simd::float4(_mm_cvttps_epi32(fy)), simd::float4(lastY));
+        _mm_storeu_ps(u + x, fx - x0);
+        _mm_storeu_ps(v + x, fy - y0);
+        const simd::int4 i(_mm_cvttps_epi32(x0 + y0 * w));
+        _mm_storeu_si128(reinterpret_cast< __m128i* >(index + x), simd::select(inside, i, simd::int4(-1)));
+    }
+#endif
+
+    for (; x < width; ++x)
+    {
+        const bool inside = u[x] >= 0.0f && u[x] < float(srcWidth) && v[x] >= 0.0f && v[x] < float(srcHeight);
+        const float fx = ts_clamp(u[x] - 0.5f, 0.0f, maxX);
+        const float fy = ts_clamp(v[x] - 0.5f, 0.0f, maxY);
+        const float x0 = std::min(float(int(fx)), lastX);
+        const float y0 = std::min(float(int(fy)), lastY);
+        u[x] = fx - x0;
+        v[x] = fy - y0;
+        index[x] = inside ? int(x0) + int(y0) * srcWidth : -1;
+    }
+}
+
+void warpLineBilinear(uint8_t* dst, const int* index, const float* tx, const float* ty, int width,
+        const uint8_t* src, int srcWidth, int srcHeight)
+{
+    // Offsets of the right and upper neighbors of a pixel
+    const int right = (srcWidth > 1) ? PIXEL_SIZE : 0;
+    const int up = (srcHeight > 1) ? srcWidth * PIXEL_SIZE : 0;
+
+    for (int x = 0; x < width; ++x)
+    {
+        uint8_t* d = dst + x * PIXEL_SIZE;
+
+        if (index[x] < 0)
+        {
+            std::memset(d, 0, PIXEL_SIZE);
+            continue;
+        }
+
+        const uint8_t* p00 = src + index[x] * PIXEL_SIZE;
+        const uint8_t* p10 = p00 + right;
+        const uint8_t* p01 = p00 + up;
+        const uint8_t* p11 = p01 + right;
+
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+        const simd::float4 c00 = loadPixel(p00);
+        const simd::float4 c01 = loadPixel(p01);
+        const simd::float4 c0 = c00 + (loadPixel(p10) - c00) * simd::float4(tx[x]);
+        const simd::float4 c1 = c01 + (loadPixel(p11) - c01) * simd::float4(tx[x]);
+        storePixel(d, c0 + (c1 - c0) * simd::float4(ty[x]));
+#else
+        for (int c = 0; c < PIXEL_SIZE; ++c)
+        {
+            const float c0 = p00[c] + (p10[c] - p00[c]) * tx[x];
+            const float c1 = p01[c] + (p11[c] - p01[c]) * tx[x];
+            d[c] = uint8_t(c0 + (c1 - c0) * ty[x] + 0.5f);
+        }
+#endif
+    }
+}
+
+} // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// warpImage
+//
+
+void warpImage(uint8_t* dst,
+        int dstWidth,
+        int dstHeight,
+        const uint8_t* src,
+        int srcWidth,
+        int srcHeight,
+        mat4 const& inv,
+        bool bilinear,
+        bool parallel)
+{
+    if (dst == NULL || dstWidth <= 0 || dstHeight <= 0)
+        return;
+
+    if (src == NULL || srcWidth <= 0 || srcHeight <= 0)
+    {
+        std::memset(dst, 0, size_t(dstWidth) * dstHeight * PIXEL_SIZE);
+        return;
+    }
+
+    const Projection p = makeProjection(inv);
+
+    auto func = [&](size_t first, size_t last)
+    {
+        std::vector< float > u(dstWidth);
+        std::vector< float > v(dstWidth);
+        std::vector< int > index(dstWidth);
+
+        for (size_t y = first; y < last; ++y)
+        {
+            uint8_t* line = dst + y * dstWidth * PIXEL_SIZE;
+            if (bilinear)
+            {
+                findSourceCoords(p, float(y), 0.5f, dstWidth, &u[0], &v[0]);
+                findSourceFootprints(&u[0], &v[0], dstWidth, srcWidth, srcHeight, &index[0]);
+                warpLineBilinear(line, &index[0], &u[0], &v[0], dstWidth, src, srcWidth, srcHeight);
+            }
+            else
+            {
+                // Nearest neighbor filtering maps the pixel corners
+                findSourceCoords(p, float(y), 0.0f, dstWidth, &u[0], &v[0]);
+                findSourcePixels(&u[0], &v[0], dstWidth, srcWidth, srcHeight, &index[0]);
+                warpLineNearest(line, &index[0], dstWidth, src);
+            }
+        }
+    };
+
+    if (parallel)
+        parallel_for(0, size_t(dstHeight), func, 16);
+    else
+        func(0, size_t(dstHeight));
+}
+
+
+} // namespace virvo
@@ -0,0 +1,59 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_WARP_H
+#define VV_WARP_H
+
+
+#include "math/math.h"
+#include "vvinttypes.h"
+
+
+namespace virvo
+{
+
+
+// Warp an RGBA image with 4 bytes per pixel, rows stored bottom up.
+//
+// inv maps destination pixel coordinates (x, y, 0, 1) to homogeneous source
+// pixel coordinates; only its 2D components are used. Pixels that map outside
+// the source image are black. The source coordinates are stepped along the
+// destination lines and only divided by w if inv is a perspective
+// projection. Line bands are warped in parallel, the coordinates and
+// bilinear filtering are vectorized.
+//
+// Nearest neighbor filtering truncates the source coordinates of the pixel
+// corners. Bilinear filtering maps the pixel centers, interpolates between
+// the source pixel centers and clamps to the image edge.
+void warpImage(uint8_t* dst,
+        int dstWidth,
+        int dstHeight,
+        const uint8_t* src,
+        int srcWidth,
+        int srcHeight,
+        mat4 const& inv,
+        bool bilinear,
+        bool parallel = true);
+
+
+} // namespace virvo
+
+
+#endif // VV_WARP_H
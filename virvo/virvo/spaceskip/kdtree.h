@@ -112,6 +112,10 @@ struct KdTree
   template <typename Tex>
   void updateTransfunc(Tex transfunc);
 
+  // Transfer function entries [first,last) of num_entries changed
+  template <typename Tex>
+  void updateTransfunc(Tex transfunc, int num_entries, int first, int last);
+
   void node_splitting(NodePtr& n);
 
   std::vector<visionaray::aabb> get_leaf_nodes(visionaray::vec3 eye, bool frontToBack) const;
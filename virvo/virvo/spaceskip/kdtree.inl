@@ -44,3 +44,32 @@ void KdTree::updateTransfunc(Tex transfunc)
   std::cout << "splitting: " << sw.getTime() << " sec.\n";
 #endif
 }
+
+template <typename Tex>
+void KdTree::updateTransfunc(Tex transfunc, int num_entries, int first, int last)
+{
+  using namespace visionaray;
+
+#ifdef BUILD_TIMING
+  vvStopwatch sw; sw.start();
+#endif
+  bool changed = psvt.build(transfunc, num_entries, first, last);
+#ifdef BUILD_TIMING
+  std::cout << std::fixed << std::setprecision(3) << "svt update: " << sw.getTime() << " sec.\n";
+#endif
+
+  // Empty space did not change
+  if (!changed && root != nullptr)
+    return;
+
+#ifdef BUILD_TIMING
+  sw.start();
+#endif
+  root.reset(new Node);
+  root->bbox = psvt.boundary(aabbi(vec3i(0), vec3i(vox[0], vox[1], vox[2])));
+  root->depth = 0;
+  node_splitting(root);
+#ifdef BUILD_TIMING
+  std::cout << "splitting: " << sw.getTime() << " sec.\n";
+#endif
+}
@@ -21,6 +21,8 @@
 #ifndef VV_SPACESKIP_SVT_H
 #define VV_SPACESKIP_SVT_H
 
+#include <algorithm>
+#include <limits>
 #include <thread>
 #include <vector>
 
@@ -51,6 +53,10 @@ struct SVT
   template <typename Tex>
   void build(Tex transfunc);
 
+  // True if the SVT was not built yet or depends on the transfer
+  // function entries [first,last) of a table with num_entries entries
+  bool needs_update(int num_entries, int first, int last) const;
+
   visionaray::aabbi boundary(visionaray::aabbi bbox) const;
 
   T& operator()(int x, int y, int z)
@@ -110,6 +116,10 @@ struct SVT
   std::vector<float> voxels_;
   // SVT array
   std::vector<T> data_;
+  // Range of voxels_, and if data_ was built from them
+  float min_value_;
+  float max_value_;
+  bool built_ = false;
   int width;
   int height;
   int depth;
@@ -133,6 +143,9 @@ void SVT<T>::reset(vvVolDesc const& vd, visionaray::aabbi bbox, int channel)
   height = bbox.size().y;
   depth  = bbox.size().z;
 
+  min_value_ = std::numeric_limits<float>::max();
+  max_value_ = -std::numeric_limits<float>::max();
+  built_ = false;
 
   for (int z = 0; z < depth; ++z)
   {
@@ -146,11 +159,36 @@ void SVT<T>::reset(vvVolDesc const& vd, visionaray::aabbi bbox, int channel)
                 bbox.min.y + y,
                 bbox.min.z + z,
                 channel);
+        min_value_ = std::min(min_value_, voxels_[index]);
+        max_value_ = std::max(max_value_, voxels_[index]);
       }
     }
   }
 }
 
+template <typename T>
+bool SVT<T>::needs_update(int num_entries, int first, int last) const
+{
+  if (!built_)
+    return true;
+
+  if (voxels_.empty())
+    return false;
+
+  // Entries of a nearest neighbor lookup with clamping,
+  // plus one entry of margin for rounding
+  auto entry = [num_entries](float v)
+  {
+    v = std::max(0.0f, std::min(v, 1.0f));
+    return std::min(static_cast<int>(v * num_entries), num_entries - 1);
+  };
+
+  int lo = entry(min_value_) - 1;
+  int hi = entry(max_value_) + 1;
+
+  return lo < last && first <= hi;
+}
+
 template <typename T>
 template <typename Tex>
 void SVT<T>::build(Tex transfunc)
@@ -174,6 +212,9 @@ void SVT<T>::build(Tex transfunc)
   }
 
 
+  built_ = true;
+
+
   // Build summed volume table
 
   // Init 0-border voxel
@@ -350,6 +391,11 @@ struct PartialSVT
   template <typename Tex>
   void build(Tex transfunc);
 
+  // Only rebuild the SVTs that depend on the transfer function
+  // entries [first,last), returns false if none was rebuilt
+  template <typename Tex>
+  bool build(Tex transfunc, int num_entries, int first, int last);
+
   visionaray::aabbi boundary(visionaray::aabbi bbox);
 
   uint64_t get_count(visionaray::aabbi bounds) const;
@@ -411,6 +457,26 @@ inline void PartialSVT::build(Tex transfunc)
   });
 }
 
+template <typename Tex>
+inline bool PartialSVT::build(Tex transfunc, int num_entries, int first, int last)
+{
+  using namespace visionaray;
+
+  std::vector<size_t> outdated;
+  for (size_t i = 0; i < svts.size(); ++i)
+  {
+    if (svts[i].needs_update(num_entries, first, last))
+      outdated.push_back(i);
+  }
+
+  parallel_for(pool, range1d<size_t>(0, outdated.size()), [this, transfunc, &outdated](size_t i)
+  {
+    svts[outdated[i]].build(transfunc);
+  });
+
+  return !outdated.empty();
+}
+
 inline visionaray::aabbi PartialSVT::boundary(visionaray::aabbi bbox)
 {
   using namespace visionaray;
@@ -0,0 +1,157 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include "vvasyncfileio.h"
+#include "vvdebugmsg.h"
+#include "vvtoolshed.h"
+#include "vvvoldesc.h"
+
+//----------------------------------------------------------------------------
+/// Forwards the notifications of vvFileIO to the callbacks.
+class vvAsyncFileIO::Handler : public vvFileIO::LoadHandler
+{
+  public:
+    Handler(const Callbacks& callbacks, const std::atomic<bool>& cancelled)
+      : _callbacks(callbacks)
+      , _cancelled(cancelled)
+    {
+    }
+
+    bool header(const vvVolDesc* vd)
+    {
+      if (_cancelled) return false;
+      if (_callbacks.header)
+      {
+        vvVolDesc* attribs = new vvVolDesc(vd, -2);
+        attribs->frames = vd->frames;
+        _callbacks.header(attribs);
+      }
+      return !_cancelled;
+    }
+
+    bool preview(vvVolDesc* vd)
+    {
+      if (_cancelled || !_callbacks.preview)
+      {
+        delete vd;
+        return !_cancelled;
+      }
+      _callbacks.preview(vd);
+      return !_cancelled;
+    }
+
+    bool frame(const vvVolDesc* /*vd*/, size_t index, uint8_t* data)
+    {
+      if (_cancelled || !_callbacks.frame)
+      {
+        delete[] data;
+        return !_cancelled;
+      }
+      _callbacks.frame(index, data);
+      return !_cancelled;
+    }
+
+  private:
+    const Callbacks& _callbacks;
+    const std::atomic<bool>& _cancelled;
+};
+
+//----------------------------------------------------------------------------
+vvAsyncFileIO::vvAsyncFileIO()
+  : _cancelled(false)
+  , _loading(false)
+{
+  vvDebugMsg::msg(1, "vvAsyncFileIO::vvAsyncFileIO()");
+}
+
+//----------------------------------------------------------------------------
+/// Cancels loading and waits for the worker thread.
+vvAsyncFileIO::~vvAsyncFileIO()
+{
+  vvDebugMsg::msg(1, "vvAsyncFileIO::~vvAsyncFileIO()");
+  cancel();
+  wait();
+}
+
+//----------------------------------------------------------------------------
+/** Start loading a volume file on a worker thread.
+  A load that is still running is cancelled first.
+  @param filename  name of the volume file
+  @param callbacks receive the volume while it is loaded
+  @param sec       file sections to load, @see vvFileIO::loadVolumeData()
+  @return false if the file does not exist
+*/
+bool vvAsyncFileIO::load(const std::string& filename, const Callbacks& callbacks, vvFileIO::LoadType sec)
+{
+  vvDebugMsg::msg(1, "vvAsyncFileIO::load()");
+
+  cancel();
+  wait();
+
+  if (!vvToolshed::isFile(filename.c_str())) return false;
+
+  _cancelled = false;
+  _loading = true;
+  _thread = std::thread(&vvAsyncFileIO::run, this, filename, callbacks, sec);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Cancel loading. Frames that are currently being read are discarded,
+  the finished callback is called with vvFileIO::CANCELLED.
+*/
+void vvAsyncFileIO::cancel()
+{
+  _cancelled = true;
+}
+
+//----------------------------------------------------------------------------
+/// Wait until the worker thread has finished.
+void vvAsyncFileIO::wait()
+{
+  if (_thread.joinable()) _thread.join();
+}
+
+//----------------------------------------------------------------------------
+/// @return true until the finished callback was called
+bool vvAsyncFileIO::isLoading() const
+{
+  return _loading;
+}
+
+//----------------------------------------------------------------------------
+void vvAsyncFileIO::run(std::string filename, Callbacks callbacks, vvFileIO::LoadType sec)
+{
+  Handler handler(callbacks, _cancelled);
+  vvVolDesc vd(filename.c_str());
+  vvFileIO fio;
+  fio.setLoadHandler(&handler);
+
+  vvFileIO::ErrorType err = fio.loadVolumeData(&vd, sec);
+  if (err == vvFileIO::OK && _cancelled) err = vvFileIO::CANCELLED;
+
+  if (callbacks.finished) callbacks.finished(err);
+  _loading = false;
+}
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,94 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_ASYNCFILEIO_H
+#define VV_ASYNCFILEIO_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "vvexport.h"
+#include "vvfileio.h"
+
+//============================================================================
+// Class Definition
+//============================================================================
+
+/** Loads volume files on a worker thread.
+  The volume attributes are published as soon as the header of the file was
+  read, then the frames are delivered one by one while the rest of the file
+  is still being read. Files in brick format (.bvf) with stored LOD levels
+  additionally deliver a coarse preview of the first frame before the frames.
+  All callbacks are called on the worker thread, GUI applications have to
+  forward them to their own thread.
+  <PRE>
+  vvAsyncFileIO::Callbacks cb;
+  cb.header = [](vvVolDesc* vd) { ... };
+  cb.frame = [](size_t index, uint8_t* data) { ... };
+  cb.finished = [](vvFileIO::ErrorType err) { ... };
+  loader.load("volume.xvf", cb);
+  </PRE>
+  @see vvFileIO::setLoadHandler()
+*/
+class VIRVO_FILEIOEXPORT vvAsyncFileIO
+{
+  public:
+    struct Callbacks
+    {
+      /// Volume attributes without voxel data, the callee owns the volume
+      std::function<void(vvVolDesc*)> header;
+      /// Coarse version of the first frame, the callee owns the volume (optional)
+      std::function<void(vvVolDesc*)> preview;
+      /// Frame data allocated with new[], the callee owns the data
+      std::function<void(size_t, uint8_t*)> frame;
+      /// Loading finished, failed or was cancelled
+      std::function<void(vvFileIO::ErrorType)> finished;
+    };
+
+    vvAsyncFileIO();
+    ~vvAsyncFileIO();
+
+    bool load(const std::string& filename, const Callbacks& callbacks,
+              vvFileIO::LoadType sec = vvFileIO::ALL_DATA);
+    void cancel();
+    void wait();
+    bool isLoading() const;
+
+  private:
+    class Handler;
+
+    std::thread _thread;
+    std::atomic<bool> _cancelled;
+    std::atomic<bool> _loading;
+
+    vvAsyncFileIO(const vvAsyncFileIO&);
+    vvAsyncFileIO& operator=(const vvAsyncFileIO&);
+
+    void run(std::string filename, Callbacks callbacks, vvFileIO::LoadType sec);
+};
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
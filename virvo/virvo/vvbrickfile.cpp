@@ -0,0 +1,831 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifdef HAVE_CONFIG_H
+#include "vvconfig.h"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstring> // memcpy
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "private/parallel_for.h"
+#include "private/vvcompress.h"
+#include "vvbrickfile.h"
+#include "vvdebugmsg.h"
+#include "vvtfwidget.h"
+#include "vvtoolshed.h"
+#include "vvvoldesc.h"
+
+namespace virvo
+{
+
+  //--- Helpers ---------------------------------------------------------------
+
+  namespace
+  {
+    const char MAGIC[] = "VVBRICK\n";
+    const size_t MAGIC_SIZE = 8;
+    const uint32_t VERSION = 1;
+    const size_t ENTRY_SIZE = 16;
+
+    ssize_t div_up(ssize_t a, ssize_t b)
+    {
+      return (a + b - 1) / b;
+    }
+
+    void writeString(FILE* fp, std::string const& str)
+    {
+      serialization::write32(fp, static_cast<uint32_t>(str.size()));
+      if (!str.empty())
+        fwrite(str.data(), 1, str.size(), fp);
+    }
+
+    // Sequential reader for the header, all reads are bounds checked
+    class HeaderReader
+    {
+      public:
+        HeaderReader(std::vector< uint8_t >& buf) : buf_(buf), pos_(0), ok_(true) {}
+
+        bool ok() const { return ok_; }
+
+        uint32_t u32()
+        {
+          if (!need(4))
+            return 0;
+          uint32_t val = serialization::read32(&buf_[pos_]);
+          pos_ += 4;
+          return val;
+        }
+
+        uint64_t u64()
+        {
+          if (!need(8))
+            return 0;
+          uint64_t val = serialization::read64(&buf_[pos_]);
+          pos_ += 8;
+          return val;
+        }
+
+        float f32()
+        {
+          if (!need(4))
+            return 0.0f;
+          float val = serialization::readFloat(&buf_[pos_]);
+          pos_ += 4;
+          return val;
+        }
+
+        std::string str()
+        {
+          size_t len = u32();
+          if (!need(len))
+            return std::string();
+          std::string val(reinterpret_cast< const char* >(&buf_[0]) + pos_, len);
+          pos_ += len;
+          return val;
+        }
+
+        bool bytes(uint8_t* dst, size_t len)
+        {
+          if (!need(len))
+            return false;
+          if (len > 0)
+            memcpy(dst, &buf_[pos_], len);
+          pos_ += len;
+          return true;
+        }
+
+      private:
+        std::vector< uint8_t >& buf_;
+        size_t pos_;
+        bool ok_;
+
+        bool need(size_t len)
+        {
+          if (!ok_ || len > buf_.size() - pos_)
+            ok_ = false;
+          return ok_;
+        }
+    };
+
+    // Encode a brick, returns the codec that was actually used
+    BrickFile::Codec encodeBrick(BrickFile::Codec codec, const uint8_t* src, size_t size, size_t bpc,
+        std::vector< uint8_t >& dst)
+    {
+      switch (codec)
+      {
+      case BrickFile::CODEC_RLE:
+        {
+          dst.resize(size);
+          size_t outsize = 0;
+          if (vvToolshed::encodeRLE(&dst[0], src, size, bpc, size, &outsize) == vvToolshed::VV_OK && outsize < size)
+          {
+            dst.resize(outsize);
+            return codec;
+          }
+        }
+        break;
+      case BrickFile::CODEC_SNAPPY:
+        if (encodeSnappy(src, size, dst) && dst.size() < size)
+          return codec;
+        break;
+      case BrickFile::CODEC_ZLIB:
+#ifdef HAVE_ZLIB
+        {
+          uLongf outsize = compressBound(static_cast< uLong >(size));
+          dst.resize(outsize);
+          if (compress2(&dst[0], &outsize, src, static_cast< uLong >(size), Z_DEFAULT_COMPRESSION) == Z_OK && outsize < size)
+          {
+            dst.resize(outsize);
+            return codec;
+          }
+        }
+#endif
+        break;
+      default:
+        break;
+      }
+
+      dst.assign(src, src + size);
+      return BrickFile::CODEC_NONE;
+    }
+  }
+
+
+  //--- Byte source for brick payloads ----------------------------------------
+
+  /**
+   * Provides the bytes of a brick, either directly from the memory mapping
+   * or read from a stream that is private to the calling thread.
+   */
+  class BrickFile::Source
+  {
+    public:
+
+      explicit Source(BrickFile const& file)
+        : map_(file.map_)
+        , mapSize_(file.mapSize_)
+      {
+        if (map_ == NULL)
+          in_.open(file.filename_.c_str(), std::ios::in | std::ios::binary);
+      }
+
+      const uint8_t* get(uint64_t offset, size_t size)
+      {
+        if (map_ != NULL)
+        {
+          if (offset > mapSize_ || size > mapSize_ - offset)
+            return NULL;
+          return map_ + offset;
+        }
+
+        buffer_.resize(std::max(size, size_t(1)));
+        in_.clear();
+        in_.seekg(offset, std::ios::beg);
+        in_.read(reinterpret_cast< char* >(&buffer_[0]), size);
+        if (!in_ || static_cast< size_t >(in_.gcount()) != size)
+          return NULL;
+        return &buffer_[0];
+      }
+
+    private:
+
+      const uint8_t* map_;
+      size_t mapSize_;
+      std::ifstream in_;
+      std::vector< uint8_t > buffer_;
+  };
+
+
+  //--- Writer ----------------------------------------------------------------
+
+  const size_t BrickFile::DEFAULT_BRICK_SIZE = 64;
+
+  bool BrickFile::isCodecAvailable(Codec codec)
+  {
+    switch (codec)
+    {
+    case CODEC_NONE:
+    case CODEC_RLE:
+      return true;
+    case CODEC_SNAPPY:
+#ifdef HAVE_SNAPPY
+      return true;
+#else
+      return false;
+#endif
+    case CODEC_ZLIB:
+#ifdef HAVE_ZLIB
+      return true;
+#else
+      return false;
+#endif
+    }
+    return false;
+  }
+
+  bool BrickFile::write(const std::string& filename,
+      const vvVolDesc* vd,
+      Codec codec,
+      size_t brickSize,
+      size_t numLevels)
+  {
+    vvDebugMsg::msg(2, "BrickFile::write()");
+
+    if (vd == NULL || vd->frames == 0 || brickSize == 0 || brickSize > 1024)
+      return false;
+
+    numLevels = std::max(size_t(1), std::min(numLevels, vd->getNumLODLevels()));
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL)
+      return false;
+
+    const size_t chan = vd->getChan();
+    const ssize_t bs = static_cast< ssize_t >(brickSize);
+
+    // Header
+    fwrite(MAGIC, 1, MAGIC_SIZE, fp);
+    serialization::write32(fp, VERSION);
+    serialization::write32(fp, uint32_t(0)); // index offset, written below
+    for (size_t i = 0; i < 3; ++i)
+      serialization::write64(fp, static_cast< uint64_t >(vd->vox[i]));
+    serialization::write64(fp, static_cast< uint64_t >(vd->frames));
+    serialization::write32(fp, static_cast< uint32_t >(vd->bpc));
+    serialization::write32(fp, static_cast< uint32_t >(chan));
+    serialization::write32(fp, static_cast< uint32_t >(brickSize));
+    serialization::write32(fp, static_cast< uint32_t >(numLevels));
+    for (size_t l = 1; l < numLevels; ++l)
+    {
+      vector< 3, ssize_t > lvox = vd->getLODVox(l);
+      for (size_t i = 0; i < 3; ++i)
+        serialization::write64(fp, static_cast< uint64_t >(lvox[i]));
+    }
+    serialization::write32(fp, serialization::getEndianness() == serialization::VV_BIG_END ? 1U : 0U);
+
+    for (size_t i = 0; i < 3; ++i)
+      serialization::write(fp, vd->getDist()[i]);
+    serialization::write(fp, vd->getDt());
+    for (size_t i = 0; i < 3; ++i)
+      serialization::write(fp, vd->pos[i]);
+
+    for (size_t c = 0; c < chan; ++c)
+    {
+      serialization::write(fp, vd->mapping(c)[0]);
+      serialization::write(fp, vd->mapping(c)[1]);
+      serialization::write(fp, vd->range(c)[0]);
+      serialization::write(fp, vd->range(c)[1]);
+      writeString(fp, vd->getChannelName(c));
+    }
+
+    serialization::write32(fp, static_cast< uint32_t >(vd->tf.size()));
+    for (size_t i = 0; i < vd->tf.size(); ++i)
+    {
+      std::string widgets;
+      for (size_t w = 0; w < vd->tf[i]._widgets.size(); ++w)
+        widgets += vd->tf[i]._widgets[w]->toString();
+      writeString(fp, widgets);
+    }
+
+    const size_t iconBytes = vd->iconData != NULL ? vd->iconSize * vd->iconSize * vvVolDesc::ICON_BPP : 0;
+    serialization::write32(fp, static_cast< uint32_t >(iconBytes > 0 ? vd->iconSize : 0));
+    if (iconBytes > 0)
+      fwrite(vd->iconData, 1, iconBytes, fp);
+
+    // Reserve space for the brick index, it is written when all offsets are known
+    const long indexOffset = ftell(fp);
+    size_t numEntries = 0;
+    for (size_t l = 0; l < numLevels; ++l)
+    {
+      vector< 3, ssize_t > lvox = vd->getLODVox(l);
+      numEntries += vd->frames * chan * div_up(lvox[0], bs) * div_up(lvox[1], bs) * div_up(lvox[2], bs);
+    }
+
+    std::vector< uint8_t > index(numEntries * ENTRY_SIZE, 0);
+    fwrite(&index[0], 1, index.size(), fp);
+
+    uint64_t offset = static_cast< uint64_t >(indexOffset) + index.size();
+    size_t entry = 0;
+    bool ok = !ferror(fp);
+
+    for (size_t l = 0; l < numLevels && ok; ++l)
+    {
+      const vector< 3, ssize_t > lvox = vd->getLODVox(l);
+      const vector< 3, ssize_t > nb(div_up(lvox[0], bs), div_up(lvox[1], bs), div_up(lvox[2], bs));
+      const size_t bricksPerChannel = nb[0] * nb[1] * nb[2];
+      const size_t bpv = vd->getBPV();
+      const size_t bpc = vd->bpc;
+
+      for (size_t f = 0; f < vd->frames && ok; ++f)
+      {
+        const uint8_t* raw = vd->getLODRaw(l, static_cast< int >(f));
+        if (raw == NULL)
+        {
+          ok = false;
+          break;
+        }
+
+        // Extract and encode the bricks of all channels in parallel
+        std::vector< std::vector< uint8_t > > encoded(chan * bricksPerChannel);
+        std::vector< uint32_t > codecs(encoded.size(), CODEC_NONE);
+
+        parallel_for(0, encoded.size(), [&](size_t first, size_t last)
+        {
+          std::vector< uint8_t > brick;
+          for (size_t i = first; i < last; ++i)
+          {
+            const size_t c = i / bricksPerChannel;
+            const size_t b = i % bricksPerChannel;
+            const vector< 3, ssize_t > bi(b % nb[0], (b / nb[0]) % nb[1], b / (nb[0] * nb[1]));
+            const vector< 3, ssize_t > bmin = bi * bs;
+            const vector< 3, ssize_t > bmax = min(bmin + vector< 3, ssize_t >(bs), lvox);
+
+            brick.resize((bmax[0] - bmin[0]) * (bmax[1] - bmin[1]) * (bmax[2] - bmin[2]) * bpc);
+            uint8_t* dst = &brick[0];
+            for (ssize_t z = bmin[2]; z < bmax[2]; ++z)
+            {
+              for (ssize_t y = bmin[1]; y < bmax[1]; ++y)
+              {
+                const uint8_t* src = raw + ((z * lvox[1] + y) * lvox[0] + bmin[0]) * bpv + c * bpc;
+                for (ssize_t x = bmin[0]; x < bmax[0]; ++x, src += bpv, dst += bpc)
+                  memcpy(dst, src, bpc);
+              }
+            }
+
+            codecs[i] = encodeBrick(codec, &brick[0], brick.size(), bpc, encoded[i]);
+          }
+        });
+
+        for (size_t i = 0; i < encoded.size(); ++i, ++entry)
+        {
+          uint8_t* e = &index[entry * ENTRY_SIZE];
+          serialization::write64(e, offset);
+          serialization::write32(e + 8, static_cast< uint32_t >(encoded[i].size()));
+          serialization::write32(e + 12, codecs[i]);
+
+          if (!encoded[i].empty() && fwrite(&encoded[i][0], 1, encoded[i].size(), fp) != encoded[i].size())
+          {
+            ok = false;
+            break;
+          }
+          offset += encoded[i].size();
+        }
+      }
+    }
+
+    // Index
+    if (ok)
+    {
+      ok = fseek(fp, indexOffset, SEEK_SET) == 0
+        && fwrite(&index[0], 1, index.size(), fp) == index.size()
+        && fseek(fp, MAGIC_SIZE + 4, SEEK_SET) == 0
+        && serialization::write32(fp, static_cast< uint32_t >(indexOffset)) == 4;
+    }
+
+    ok = !ferror(fp) && ok;
+    if (fclose(fp) != 0)
+      ok = false;
+
+    return ok;
+  }
+
+
+  //--- Reader ----------------------------------------------------------------
+
+  BrickFile::BrickFile()
+    : frames_(0)
+    , bpc_(0)
+    , chan_(0)
+    , brickSize_(0)
+    , swapBytes_(false)
+    , dt_(1.0f)
+    , iconSize_(0)
+    , map_(NULL)
+    , mapSize_(0)
+  {
+  }
+
+  BrickFile::~BrickFile()
+  {
+    close();
+  }
+
+  void BrickFile::close()
+  {
+#ifndef _WIN32
+    if (map_ != NULL)
+      munmap(const_cast< uint8_t* >(map_), mapSize_);
+#endif
+    map_ = NULL;
+    mapSize_ = 0;
+    filename_.clear();
+    levelVox_.clear();
+    levelStart_.clear();
+    index_.clear();
+  }
+
+  bool BrickFile::open(const std::string& filename)
+  {
+    vvDebugMsg::msg(2, "BrickFile::open()");
+
+    close();
+
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open())
+      return false;
+
+    char magic[MAGIC_SIZE];
+    in.read(magic, MAGIC_SIZE);
+    if (!in || memcmp(magic, MAGIC, MAGIC_SIZE) != 0)
+      return false;
+
+    uint32_t version = serialization::read32(in);
+    uint32_t indexOffset = serialization::read32(in);
+    if (!in || version != VERSION || indexOffset <= MAGIC_SIZE + 8)
+      return false;
+
+    std::vector< uint8_t > header(indexOffset - MAGIC_SIZE - 8);
+    in.read(reinterpret_cast< char* >(&header[0]), header.size());
+    if (!in)
+      return false;
+
+    HeaderReader hr(header);
+
+    vector< 3, ssize_t > vox;
+    for (size_t i = 0; i < 3; ++i)
+      vox[i] = static_cast< ssize_t >(hr.u64());
+    frames_ = hr.u64();
+    bpc_ = hr.u32();
+    chan_ = hr.u32();
+    brickSize_ = hr.u32();
+    size_t numLevels = hr.u32();
+    if (!hr.ok() || brickSize_ == 0 || brickSize_ > 1024 || numLevels == 0 || numLevels > 64
+     || (bpc_ != 1 && bpc_ != 2 && bpc_ != 4) || chan_ == 0 || chan_ > 1024)
+      return false;
+
+    levelVox_.push_back(vox);
+    for (size_t l = 1; l < numLevels; ++l)
+    {
+      for (size_t i = 0; i < 3; ++i)
+        vox[i] = static_cast< ssize_t >(hr.u64());
+      levelVox_.push_back(vox);
+    }
+
+    bool bigEndian = hr.u32() != 0;
+    swapBytes_ = bigEndian != (serialization::getEndianness() == serialization::VV_BIG_END);
+
+    for (size_t i = 0; i < 3; ++i)
+      dist_[i] = hr.f32();
+    dt_ = hr.f32();
+    for (size_t i = 0; i < 3; ++i)
+      pos_[i] = hr.f32();
+
+    mapping_.resize(chan_);
+    range_.resize(chan_);
+    channelNames_.resize(chan_);
+    for (size_t c = 0; c < chan_; ++c)
+    {
+      mapping_[c][0] = hr.f32();
+      mapping_[c][1] = hr.f32();
+      range_[c][0] = hr.f32();
+      range_[c][1] = hr.f32();
+      channelNames_[c] = hr.str();
+    }
+
+    tfs_.resize(hr.u32());
+    for (size_t i = 0; i < tfs_.size() && hr.ok(); ++i)
+      tfs_[i] = hr.str();
+
+    iconSize_ = hr.u32();
+    icon_.resize(iconSize_ * iconSize_ * vvVolDesc::ICON_BPP);
+    hr.bytes(icon_.empty() ? NULL : &icon_[0], icon_.size());
+
+    if (!hr.ok())
+    {
+      close();
+      return false;
+    }
+
+    // Brick index, the entries must fit into the file
+    in.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast< uint64_t >(in.tellg());
+    in.seekg(indexOffset, std::ios::beg);
+
+    size_t numEntries = 0;
+    for (size_t l = 0; l < numLevels; ++l)
+    {
+      levelStart_.push_back(numEntries);
+      vector< 3, ssize_t > nb = getNumBricks(l);
+      if (levelVox_[l][0] <= 0 || levelVox_[l][1] <= 0 || levelVox_[l][2] <= 0)
+      {
+        close();
+        return false;
+      }
+      const uint64_t maxEntries = fileSize / ENTRY_SIZE;
+      uint64_t n = frames_ * chan_;
+      for (size_t i = 0; i < 3 && n <= maxEntries; ++i)
+        n = static_cast< uint64_t >(nb[i]) > maxEntries ? maxEntries + 1 : n * nb[i];
+      numEntries += static_cast< size_t >(std::min(n, maxEntries + 1));
+      if (frames_ > fileSize || numEntries > maxEntries)
+      {
+        close();
+        return false;
+      }
+    }
+
+    std::vector< uint8_t > index(numEntries * ENTRY_SIZE);
+    if (!index.empty())
+      in.read(reinterpret_cast< char* >(&index[0]), index.size());
+    if (!in)
+    {
+      close();
+      return false;
+    }
+
+    index_.resize(numEntries);
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+      uint8_t* e = &index[i * ENTRY_SIZE];
+      index_[i].offset = serialization::read64(e);
+      index_[i].size = serialization::read32(e + 8);
+      index_[i].codec = serialization::read32(e + 12);
+    }
+
+    filename_ = filename;
+
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+        void* ptr = mmap(NULL, static_cast< size_t >(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+          map_ = static_cast< const uint8_t* >(ptr);
+          mapSize_ = static_cast< size_t >(st.st_size);
+        }
+      }
+      ::close(fd);
+    }
+#endif
+
+    return true;
+  }
+
+  void BrickFile::getAttributes(vvVolDesc* vd) const
+  {
+    vd->vox = levelVox_.empty() ? vector< 3, ssize_t >(ssize_t(0)) : levelVox_[0];
+    vd->bpc = bpc_;
+    vd->setChan(static_cast< int >(chan_));
+    vd->setDist(dist_);
+    vd->setDt(dt_);
+    vd->pos = pos_;
+
+    for (size_t c = 0; c < chan_; ++c)
+    {
+      vd->mapping(c) = mapping_[c];
+      vd->zoomRange(c) = mapping_[c];
+      vd->range(c) = range_[c];
+      vd->setChannelName(static_cast< int >(c), channelNames_[c]);
+    }
+
+    vd->tf.clear();
+    for (size_t i = 0; i < tfs_.size(); ++i)
+    {
+      vd->tf.push_back(vvTransFunc());
+
+      // Widgets are stored as written by toString(), parse them with the
+      // same stream constructors the XVF reader uses so that multi-line
+      // widgets (TF_CUSTOM control points) survive the round trip
+      std::istringstream str(tfs_[i]);
+      std::string type;
+      while (str >> type)
+      {
+        vvTFWidget* widget = NULL;
+        if (type == "TF_PYRAMID")
+          widget = new vvTFPyramid(str);
+        else if (type == "TF_BELL")
+          widget = new vvTFBell(str);
+        else if (type == "TF_COLOR")
+          widget = new vvTFColor(str);
+        else if (type == "TF_SKIP")
+          widget = new vvTFSkip(str);
+        else if (type == "TF_CUSTOM")
+          widget = new vvTFCustom(str);
+
+        if (widget == NULL)
+        {
+          vvDebugMsg::msg(1, "BrickFile::getAttributes(): unknown widget type ", type.c_str());
+          std::string rest;
+          std::getline(str, rest);
+          continue;
+        }
+
+        vd->tf.back()._widgets.push_back(widget);
+      }
+    }
+
+    if (iconSize_ > 0)
+      vd->makeIcon(iconSize_, &icon_[0]);
+  }
+
+  vector< 3, ssize_t > BrickFile::getNumBricks(size_t level) const
+  {
+    const ssize_t bs = static_cast< ssize_t >(brickSize_);
+    const vector< 3, ssize_t >& vox = levelVox_[level];
+    return vector< 3, ssize_t >(div_up(vox[0], bs), div_up(vox[1], bs), div_up(vox[2], bs));
+  }
+
+  basic_aabb< ssize_t > BrickFile::getBrickBounds(size_t level, vector< 3, ssize_t > const& brick) const
+  {
+    const ssize_t bs = static_cast< ssize_t >(brickSize_);
+    vector< 3, ssize_t > bmin = brick * bs;
+    return basic_aabb< ssize_t >(bmin, min(bmin + vector< 3, ssize_t >(bs), levelVox_[level]));
+  }
+
+  const BrickFile::BrickEntry& BrickFile::entry(size_t level, size_t frame, size_t channel,
+      vector< 3, ssize_t > const& brick) const
+  {
+    const vector< 3, ssize_t > nb = getNumBricks(level);
+    const size_t bricksPerChannel = nb[0] * nb[1] * nb[2];
+    const size_t b = (brick[2] * nb[1] + brick[1]) * nb[0] + brick[0];
+    return index_[levelStart_[level] + (frame * chan_ + channel) * bricksPerChannel + b];
+  }
+
+  bool BrickFile::decodeBrick(Source& src, BrickEntry const& e, size_t numVoxels, uint8_t* dst) const
+  {
+    const size_t numBytes = numVoxels * bpc_;
+    const uint8_t* data = src.get(e.offset, e.size);
+    if (data == NULL)
+      return false;
+
+    bool ok = false;
+    switch (e.codec)
+    {
+    case CODEC_NONE:
+      ok = e.size == numBytes;
+      if (ok)
+        memcpy(dst, data, numBytes);
+      break;
+    case CODEC_RLE:
+      {
+        size_t outsize = 0;
+        ok = vvToolshed::decodeRLE(dst, data, e.size, bpc_, numBytes, &outsize) == vvToolshed::VV_OK
+          && outsize == numBytes;
+      }
+      break;
+    case CODEC_SNAPPY:
+      ok = decodeSnappy(data, e.size, dst, numBytes);
+      break;
+    case CODEC_ZLIB:
+#ifdef HAVE_ZLIB
+      {
+        uLongf outsize = static_cast< uLongf >(numBytes);
+        ok = uncompress(dst, &outsize, data, e.size) == Z_OK && outsize == numBytes;
+      }
+#endif
+      break;
+    default:
+      break;
+    }
+
+    if (ok && swapBytes_ && bpc_ > 1)
+    {
+      for (size_t i = 0; i < numBytes; i += bpc_)
+        std::reverse(dst + i, dst + i + bpc_);
+    }
+
+    return ok;
+  }
+
+  bool BrickFile::readBrick(size_t level, size_t frame, size_t channel,
+      vector< 3, ssize_t > const& brick, uint8_t* dst) const
+  {
+    if (level >= getNumLevels() || frame >= frames_ || channel >= chan_)
+      return false;
+
+    const vector< 3, ssize_t > nb = getNumBricks(level);
+    for (size_t i = 0; i < 3; ++i)
+    {
+      if (brick[i] < 0 || brick[i] >= nb[i])
+        return false;
+    }
+
+    Source src(*this);
+    basic_aabb< ssize_t > bounds = getBrickBounds(level, brick);
+    vector< 3, ssize_t > size = bounds.max - bounds.min;
+    return decodeBrick(src, entry(level, frame, channel, brick), size[0] * size[1] * size[2], dst);
+  }
+
+  bool BrickFile::readRegion(size_t level, size_t frame, basic_aabb< ssize_t > const& box, uint8_t* dst) const
+  {
+    vvDebugMsg::msg(3, "BrickFile::readRegion()");
+
+    if (level >= getNumLevels() || frame >= frames_)
+      return false;
+
+    const vector< 3, ssize_t >& vox = levelVox_[level];
+    for (size_t i = 0; i < 3; ++i)
+    {
+      if (box.min[i] < 0 || box.max[i] > vox[i] || box.min[i] >= box.max[i])
+        return false;
+    }
+
+    const ssize_t bs = static_cast< ssize_t >(brickSize_);
+    const vector< 3, ssize_t > bmin = box.min / bs;
+    const vector< 3, ssize_t > bmax(div_up(box.max[0], bs), div_up(box.max[1], bs), div_up(box.max[2], bs));
+    const vector< 3, ssize_t > nb = bmax - bmin;
+    const vector< 3, ssize_t > size = box.max - box.min;
+    const size_t bpv = bpc_ * chan_;
+    const size_t numTasks = nb[0] * nb[1] * nb[2] * chan_;
+
+    // Every brick covers a disjoint part of dst, so bricks are decoded
+    // and scattered independently
+    std::vector< uint8_t > failed(numTasks, 0);
+    parallel_for(0, numTasks, [&](size_t first, size_t last)
+    {
+      Source src(*this);
+      std::vector< uint8_t > brick(brickSize_ * brickSize_ * brickSize_ * bpc_);
+      for (size_t i = first; i < last; ++i)
+      {
+        const size_t c = i % chan_;
+        const size_t b = i / chan_;
+        const vector< 3, ssize_t > bi = bmin + vector< 3, ssize_t >(b % nb[0], (b / nb[0]) % nb[1], b / (nb[0] * nb[1]));
+        const basic_aabb< ssize_t > bounds = getBrickBounds(level, bi);
+        const vector< 3, ssize_t > bsize = bounds.max - bounds.min;
+
+        if (!decodeBrick(src, entry(level, frame, c, bi), bsize[0] * bsize[1] * bsize[2], &brick[0]))
+        {
+          failed[i] = 1;
+          continue;
+        }
+
+        const vector< 3, ssize_t > lo = max(bounds.min, box.min);
+        const vector< 3, ssize_t > hi = min(bounds.max, box.max);
+        for (ssize_t z = lo[2]; z < hi[2]; ++z)
+        {
+          for (ssize_t y = lo[1]; y < hi[1]; ++y)
+          {
+            const uint8_t* in = &brick[(((z - bounds.min[2]) * bsize[1] + (y - bounds.min[1])) * bsize[0] + (lo[0] - bounds.min[0])) * bpc_];
+            uint8_t* out = dst + (((z - box.min[2]) * size[1] + (y - box.min[1])) * size[0] + (lo[0] - box.min[0])) * bpv + c * bpc_;
+            if (chan_ == 1)
+            {
+              memcpy(out, in, (hi[0] - lo[0]) * bpc_);
+              continue;
+            }
+            for (ssize_t x = lo[0]; x < hi[0]; ++x, in += bpc_, out += bpv)
+              memcpy(out, in, bpc_);
+          }
+        }
+      }
+    });
+
+    return std::find(failed.begin(), failed.end(), 1) == failed.end();
+  }
+
+  bool BrickFile::readFrame(size_t level, size_t frame, uint8_t* dst) const
+  {
+    if (level >= getNumLevels())
+      return false;
+
+    return readRegion(level, frame, basic_aabb< ssize_t >(vector< 3, ssize_t >(ssize_t(0)), levelVox_[level]), dst);
+  }
+
+}
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,224 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_BRICKFILE_H
+#define VV_BRICKFILE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "math/math.h"
+#include "vvexport.h"
+#include "vvinttypes.h"
+
+class vvVolDesc;
+
+namespace virvo
+{
+
+  /**
+   * @brief Chunked, brick-compressed volume file (.bvf) with random access.
+   *
+   * Each frame and channel of the volume is subdivided into cubic bricks,
+   * which are compressed independently with a selectable codec. A brick
+   * index holds file offset, size and codec of each brick, so that single
+   * bricks, sub-boxes or frames can be read without reading anything else,
+   * and bricks can be decoded in parallel. Bricks are read from a memory
+   * mapping of the file where the platform supports it.
+   * Optionally, levels of the level-of-detail pyramid (see
+   * vvVolDesc::getLODRaw()) are stored as well.
+   *
+   * <PRE>
+   * File layout, all numbers in big endian:
+   *
+   * "VVBRICK\n"                magic string
+   * u32 version                currently 1
+   * u32 index offset           file offset of the brick index
+   * u64 x3 voxels              volume size of level 0
+   * u64 frames
+   * u32 bpc, u32 chan          bytes per channel, number of channels
+   * u32 brick size             edge length of bricks [voxels]
+   * u32 levels                 number of stored LOD levels (>= 1)
+   * u64 x3 voxels per level    for levels 1..levels-1
+   * u32 voxel byte order       0: little endian, 1: big endian
+   * f32 x3 dist, f32 dt, f32 x3 pos
+   * per channel: f32 x2 mapping, f32 x2 range, string name
+   * u32 transfer functions, per transfer function a string with the
+   *                            widgets (vvTFWidget::toString())
+   * u32 icon size, icon size^2 RGB pixels
+   *
+   * Brick index: per level, frame, channel and brick (x fastest)
+   * u64 offset, u32 size [bytes], u32 codec
+   *
+   * Strings are stored as u32 length plus characters. A brick holds the
+   * values of one channel in the usual voxel order, clipped at the
+   * volume boundary.
+   * </PRE>
+   */
+  class VIRVO_FILEIOEXPORT BrickFile
+  {
+    public:
+
+      /// Compression of a brick
+      enum Codec
+      {
+        CODEC_NONE,
+        CODEC_RLE,                                ///< vvToolshed::encodeRLE()
+        CODEC_SNAPPY,                             ///< needs Snappy
+        CODEC_ZLIB                                ///< needs zlib
+      };
+
+      /// Default edge length of bricks [voxels]
+      static const size_t DEFAULT_BRICK_SIZE;
+
+      /**
+       * @brief Write a volume, bricks are compressed in parallel.
+       *
+       * Bricks that do not get smaller with the codec, or codecs that are not
+       * available, fall back to CODEC_NONE for the brick.
+       *
+       * @param brickSize edge length of bricks [voxels], 1..1024
+       * @param numLevels number of LOD levels to store, 1 = full resolution only
+       * @return false on error
+       */
+      static bool write(const std::string& filename,
+          const vvVolDesc* vd,
+          Codec codec = CODEC_RLE,
+          size_t brickSize = DEFAULT_BRICK_SIZE,
+          size_t numLevels = 1);
+
+      /**
+       * @brief true if the codec can be used in this build
+       */
+      static bool isCodecAvailable(Codec codec);
+
+      BrickFile();
+      ~BrickFile();
+
+      /**
+       * @brief Open a file and read header and brick index
+       *
+       * @return false on error
+       */
+      bool open(const std::string& filename);
+
+      void close();
+
+      /**
+       * @brief Set all attributes of vd except for voxel data from the header
+       */
+      void getAttributes(vvVolDesc* vd) const;
+
+      size_t getFrames() const { return frames_; }
+      size_t getBPC() const { return bpc_; }
+      size_t getChan() const { return chan_; }
+      size_t getBrickSize() const { return brickSize_; }
+      size_t getNumLevels() const { return levelVox_.size(); }
+      vector< 3, ssize_t > getVox(size_t level = 0) const { return levelVox_[level]; }
+
+      /**
+       * @brief Number of bricks in each dimension
+       */
+      vector< 3, ssize_t > getNumBricks(size_t level = 0) const;
+
+      /**
+       * @brief Voxel bounds of a brick, clipped to the volume
+       */
+      basic_aabb< ssize_t > getBrickBounds(size_t level, vector< 3, ssize_t > const& brick) const;
+
+      /**
+       * @brief Decode the values of one channel of a brick into dst, which must
+       *        provide getBrickBounds().size() voxels of getBPC() bytes
+       *
+       * @return false on error
+       */
+      bool readBrick(size_t level, size_t frame, size_t channel,
+          vector< 3, ssize_t > const& brick, uint8_t* dst) const;
+
+      /**
+       * @brief Read a sub-box of a frame with all channels in the voxel
+       *        layout of vvVolDesc::getRaw(). Only the bricks that intersect
+       *        the box are read, they are decoded in parallel.
+       *
+       * @param box voxel bounds, must lie within getVox(level)
+       * @param dst box.size() voxels of getBPC()*getChan() bytes
+       * @return false on error
+       */
+      bool readRegion(size_t level, size_t frame, basic_aabb< ssize_t > const& box, uint8_t* dst) const;
+
+      /**
+       * @brief Read a whole frame of a level, @see readRegion()
+       */
+      bool readFrame(size_t level, size_t frame, uint8_t* dst) const;
+
+    private:
+
+      struct BrickEntry
+      {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t codec;
+      };
+
+      class Source;
+
+      std::string filename_;
+      size_t frames_;
+      size_t bpc_;
+      size_t chan_;
+      size_t brickSize_;
+      std::vector< vector< 3, ssize_t > > levelVox_;
+      bool swapBytes_;
+
+      // Attributes, only applied by getAttributes()
+      vec3f dist_;
+      float dt_;
+      vec3f pos_;
+      std::vector< vec2 > mapping_;
+      std::vector< vec2 > range_;
+      std::vector< std::string > channelNames_;
+      std::vector< std::string > tfs_;
+      size_t iconSize_;
+      std::vector< uint8_t > icon_;
+
+      // Per level: index of the first entry of the level in index_
+      std::vector< size_t > levelStart_;
+      std::vector< BrickEntry > index_;
+
+      // Memory mapping of the whole file, NULL if not available
+      const uint8_t* map_;
+      size_t mapSize_;
+
+      const BrickEntry& entry(size_t level, size_t frame, size_t channel, vector< 3, ssize_t > const& brick) const;
+      bool decodeBrick(Source& src, BrickEntry const& e, size_t numVoxels, uint8_t* dst) const;
+
+      BrickFile(BrickFile const&);
+      BrickFile& operator=(BrickFile const&);
+  };
+
+}
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
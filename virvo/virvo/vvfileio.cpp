@@ -33,15 +33,20 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <math.h>
 #include <limits.h>
 #include <ctype.h>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
 #include <limits>
 #include <map>
+#include <mutex>
+#include <thread>
 
+#include "vvbrickfile.h"
 #include "vvfileio.h"
 #include "vvmacros.h"
 #include "vvpixelformat.h"
@@ -49,7 +54,11 @@
 #include "vvdebugmsg.h"
 #include "vvtokenizer.h"
 #include "vvdicom.h"
+#include "private/parallel_for.h"
+#include "private/vvcompress.h"
+#include "private/vvframecache.h"
 #include "private/vvlog.h"
+#include "private/vvregionio.h"
 
 #if VV_HAVE_NIFTI
 #include "fileio/nifti.h"
@@ -90,7 +99,7 @@ enum Format
 {
     WL, RVF, XVF, AVF, XB7, ASC, TGA, TIFF, VTK, VHDCT, VHDMRI, RGB, PGM,
     VHD, DAT, DCOM, VMR, VTC, NII, FITS, NRRD,  XIMG, IEEE, HDR, VOLB, DDS, GKENT,
-    SYNTH, Incomplete, Unknown
+    SYNTH, BVF, Incomplete, Unknown
 };
 
 static std::map<std::string, Format> supported_formats()
@@ -134,6 +143,7 @@ static std::map<std::string, Format> supported_formats()
     result.insert(std::make_pair("dds",     DDS));
     result.insert(std::make_pair("gkent",   GKENT));
     result.insert(std::make_pair("synth",   SYNTH));
+    result.insert(std::make_pair("bvf",     BVF));
 
     // Incomplete, need further extension
     result.insert(std::make_pair("gz",      Incomplete));
@@ -196,6 +206,18 @@ vvFileIO::vvFileIO()
   strcpy(_nrrdID, "NRRD0001");
   _sections = ALL_DATA;
   _compression = true;
+  _brickCodec = BrickFile::CODEC_RLE;
+  _xvfCodec = BrickFile::CODEC_RLE;
+  _lazyFrames = false;
+  _brickSize = BrickFile::DEFAULT_BRICK_SIZE;
+  _brickLevels = 1;
+  _loadHandler = NULL;
+  _headerLoaded = false;
+  _framesLoaded = 0;
+  _useRegion = false;
+  _stride = virvo::vector<3, ssize_t>(ssize_t(1));
+  _regionApplied = false;
+  _fullVox = virvo::vector<3, ssize_t>(ssize_t(0));
 }
 
 //----------------------------------------------------------------------------
@@ -213,6 +235,89 @@ void vvFileIO::setDefaultValues(vvVolDesc* vd)
   vd->range(0)   = vec2(0.0f, 1.0f);
 }
 
+//----------------------------------------------------------------------------
+/** Notify the load handler that all attributes of a volume are known.
+  Loaders call this before they read voxel data. If only a region of the
+  volume is to be loaded, the volume attributes are changed to those of
+  the region first.
+  @return false if the load handler cancelled loading
+*/
+bool vvFileIO::headerLoaded(vvVolDesc* vd)
+{
+  if (_useRegion && !_regionApplied)
+  {
+    _fullVox = vd->vox;
+    virvo::ReadRegion(_region, _stride, _fullVox).applyTo(vd);
+    _regionApplied = true;
+  }
+
+  _headerLoaded = true;
+  return _loadHandler == NULL || _loadHandler->header(vd);
+}
+
+//----------------------------------------------------------------------------
+/** Add a frame that was read from a file to the volume, or pass it
+  to the load handler if there is one.
+  @param data     frame data allocated with new[], ownership passes to this function
+  @param inRegion true if data only contains the region to be loaded,
+                  false if it is a whole frame of the file
+  @return false if the load handler cancelled loading
+*/
+bool vvFileIO::storeFrame(vvVolDesc* vd, uint8_t* data, bool inRegion)
+{
+  if (_useRegion && !inRegion)
+  {
+    virvo::ReadRegion region(_region, _stride, _fullVox);
+    uint8_t* cropped = new uint8_t[region.getFrameBytes(vd->getBPV())];
+    virvo::copyRegion(data, _fullVox, vd->getBPV(), region, cropped);
+    delete[] data;
+    data = cropped;
+  }
+
+  if (_loadHandler == NULL)
+  {
+    vd->addFrame(data, vvVolDesc::ARRAY_DELETE);
+    return true;
+  }
+
+  return _loadHandler->frame(vd, _framesLoaded++, data);
+}
+
+//----------------------------------------------------------------------------
+/** Pass the frames of a volume that was loaded completely on to the load
+  handler, for loaders that cannot pass frames on while reading. The
+  frames are moved, not copied, and the region is cut out of them if only
+  a region is to be loaded. Does nothing if the loader already passed the
+  header on, or if there is neither a load handler nor a region.
+  @return false if the load handler cancelled loading
+*/
+bool vvFileIO::storeLoadedFrames(vvVolDesc* vd)
+{
+  if (_headerLoaded || (_loadHandler == NULL && !_useRegion)) return true;
+
+  std::vector<uint8_t*> frames(vd->getStoredFrames());
+  for (size_t f=0; f<frames.size(); ++f)
+    frames[f] = vd->takeFrame(f);
+
+  // removeSequence() also deletes the channel names
+  std::vector<std::string> names(vd->getChan());
+  for (int c=0; c<vd->getChan(); ++c) names[c] = vd->getChannelName(c);
+  vd->removeSequence();
+  for (int c=0; c<vd->getChan(); ++c) vd->setChannelName(c, names[c]);
+
+  bool cancelled = !headerLoaded(vd);
+  for (size_t f=0; f<frames.size(); ++f)
+  {
+    if (cancelled || frames[f] == NULL)
+    {
+      delete[] frames[f];
+      cancelled = true;
+    }
+    else cancelled = !storeFrame(vd, frames[f]);
+  }
+  return !cancelled;
+}
+
 //----------------------------------------------------------------------------
 /** Read the next ASCII integer character from a file.
   Ignores all other characters (as well as CR, LF etc.).
@@ -423,7 +528,7 @@ vvFileIO::ErrorType vvFileIO::loadASCFile(vvVolDesc* vd)
 vvFileIO::ErrorType vvFileIO::saveRVFFile(const vvVolDesc* vd)
 {
   FILE* fp;                                       // volume file pointer
-  uint8_t* raw;                                   // raw volume data
+  const uint8_t* raw;                             // raw volume data
   vvVolDesc* v;                                   // temporary volume description
 
   vvDebugMsg::msg(1, "vvFileIO::saveRVFFile()");
@@ -441,7 +546,7 @@ vvFileIO::ErrorType vvFileIO::saveRVFFile(const vvVolDesc* vd)
     v->convertChannels(1);
   }
   const size_t frameSize = v->getFrameBytes();
-  raw = v->getRaw();                              // save only current frame of loaded sequence
+  raw = v->getConstRaw();                         // save only current frame of loaded sequence
   if (frameSize==0 || raw==NULL)
   {
     delete v;
@@ -526,6 +631,179 @@ vvFileIO::ErrorType vvFileIO::loadRVFFile(vvVolDesc* vd)
   return OK;
 }
 
+//----------------------------------------------------------------------------
+// Parallel loading of XVF voxel data
+//----------------------------------------------------------------------------
+
+namespace
+{
+
+/// Location of the voxel data of one frame in an XVF file
+struct XVFFrame
+{
+  std::streamoff offset;                          ///< file offset of the voxel data
+  size_t encodedSize;                             ///< number of encoded bytes, 0 if the frame is not encoded
+};
+
+/// Result of loading one frame
+enum XVFFrameStatus
+{
+  XVF_FRAME_OK,
+  XVF_FRAME_SHORT,                                ///< insufficient voxel data in file
+  XVF_FRAME_DECODE                                ///< decoding exceeds frame size
+};
+
+/** Collect the locations of the frames of an XVF file without reading
+  the voxel data.
+  @param file       the XVF file
+  @param start      file offset of the first frame
+  @param numFrames  number of frames to look for
+  @param frameSize  bytes per frame
+  @param sizeBytes  size of the number of encoded bytes that precedes each frame (4 or 8),
+                    0 if frames are stored without encoding
+  @param frames     receives the frames that are completely contained in the file
+*/
+void scanXVFFrames(std::ifstream& file, std::streamoff start, size_t numFrames, size_t frameSize, size_t sizeBytes,
+                   std::vector<XVFFrame>& frames)
+{
+  file.seekg(0, file.end);
+  const std::streamoff fileSize = file.tellg();
+
+  frames.clear();
+  std::streamoff offset = start;
+  for (size_t f=0; f<numFrames; ++f)
+  {
+    XVFFrame frame;
+    file.seekg(offset, file.beg);
+    if (sizeBytes==4)
+      frame.encodedSize = virvo::serialization::read32(file);
+    else if (sizeBytes==8)
+      frame.encodedSize = virvo::serialization::read64(file);
+    else
+      frame.encodedSize = 0;
+    if (!file) break;
+    offset += sizeBytes;
+    frame.offset = offset;
+    offset += static_cast<std::streamoff>(frame.encodedSize>0 ? frame.encodedSize : frameSize);
+    if (offset > fileSize) break;
+    frames.push_back(frame);
+  }
+  file.clear();
+}
+
+/** Read and decode frames concurrently. Each worker thread reads a
+  contiguous range of frames through its own file stream and decodes
+  them into their final buffers.
+  @param vox     volume size in the file [voxels]
+  @param region  region of the frames to read, NULL for whole frames.
+                 Uncompressed frames only read the region from the file,
+                 encoded frames are decoded and cropped.
+  @param snappy  true if encoded frames are Snappy compressed, false for RLE
+  @param data    receives frames.size() frames allocated with new[]
+  @param status  receives the result for each frame
+*/
+void readXVFFrames(const char* filename, std::vector<XVFFrame> const& frames, virvo::vector<3, ssize_t> const& vox,
+                   size_t bpv, virvo::ReadRegion const* region, bool snappy,
+                   std::vector<uint8_t*>& data, std::vector<XVFFrameStatus>& status)
+{
+  const size_t frameSize = size_t(vox[0]) * size_t(vox[1]) * size_t(vox[2]) * bpv;
+  const size_t outSize = region != NULL ? region->getFrameBytes(bpv) : frameSize;
+  data.resize(frames.size());
+  for (size_t f=0; f<frames.size(); ++f)
+  {
+    data[f] = new uint8_t[outSize];
+  }
+  status.assign(frames.size(), XVF_FRAME_SHORT);
+
+  virvo::parallel_for(0, frames.size(), [&](size_t first, size_t last)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    virvo::PositionedFile positioned;
+    if (region != NULL) positioned.open(filename);
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> decoded;
+    for (size_t f=first; f<last && file.is_open(); ++f)
+    {
+      file.seekg(frames[f].offset, file.beg);
+      if (frames[f].encodedSize>0)
+      {
+        encoded.resize(frames[f].encodedSize);
+        file.read(reinterpret_cast< char* >(&encoded[0]), encoded.size());
+        if (static_cast< size_t >(file.gcount()) != encoded.size()) break;
+        if (region != NULL) decoded.resize(frameSize);
+        uint8_t* dst = region != NULL ? &decoded[0] : data[f];
+        size_t outsize;
+        bool ok = snappy ? virvo::decodeSnappy(&encoded[0], encoded.size(), dst, frameSize)
+                         : vvToolshed::decodeRLE(dst, &encoded[0], encoded.size(), bpv, frameSize, &outsize) == vvToolshed::VV_OK;
+        if (!ok)
+        {
+          status[f] = XVF_FRAME_DECODE;
+          break;
+        }
+        if (region != NULL) virvo::copyRegion(dst, vox, bpv, *region, data[f]);
+      }
+      else if (region != NULL)
+      {
+        if (!virvo::readRegion(positioned, frames[f].offset, vox, bpv, *region, data[f])) break;
+      }
+      else
+      {
+        file.read(reinterpret_cast< char* >(data[f]), frameSize);
+        if (static_cast< size_t >(file.gcount()) != frameSize) break;
+      }
+      status[f] = XVF_FRAME_OK;
+    }
+  });
+}
+
+/** Add the frames loaded by readXVFFrames() to the volume, up to the first
+  frame that could not be loaded. Frames after it are deleted.
+  @param numFrames  number of frames the file should contain
+  @param add        called with each frame that was loaded, takes ownership
+                    of the frame, returns false to cancel loading
+*/
+template <typename Add>
+vvFileIO::ErrorType addXVFFrames(size_t numFrames, std::vector<uint8_t*> const& data,
+                                 std::vector<XVFFrameStatus> const& status, Add add)
+{
+  vvFileIO::ErrorType err = vvFileIO::OK;
+  XVFFrameStatus failed = XVF_FRAME_SHORT;
+  for (size_t f=0; f<data.size(); ++f)
+  {
+    if (err==vvFileIO::OK && status[f]!=XVF_FRAME_OK)
+    {
+      err = vvFileIO::DATA_ERROR;
+      failed = status[f];
+    }
+    if (err==vvFileIO::OK)
+    {
+      if (!add(data[f])) err = vvFileIO::CANCELLED;
+    }
+    else delete[] data[f];
+  }
+  if (err == vvFileIO::CANCELLED) return err;
+  if (data.size() < numFrames) err = vvFileIO::DATA_ERROR;
+
+  if (err != vvFileIO::OK)
+  {
+    if (failed==XVF_FRAME_DECODE) vvDebugMsg::msg(1, "Error: Decoding exceeds frame size.");
+    else vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
+  }
+  return err;
+}
+
+/** Swap the byte order of all values of a frame.
+  @param bpc  bytes per channel, only 2 and 4 actually swap bytes
+*/
+void toggleEndianness(uint8_t* data, size_t bytes, size_t bpc)
+{
+  if (bpc != 2 && bpc != 4) return;
+  for (size_t i=0; i+bpc<=bytes; i+=bpc)
+    std::reverse(data + i, data + i + bpc);
+}
+
+} // namespace
+
 //----------------------------------------------------------------------------
 /** Loader for voxel file in old xvf (extended volume file) format.
  File specification (byte order: most significant first = big endian):
@@ -594,7 +872,6 @@ vvFileIO::ErrorType vvFileIO::loadXVFFileOld(vvVolDesc* vd)
   FILE* fp;                                       // volume file pointer
   uint8_t serialized[vvVolDesc::SERIAL_ATTRIB_SIZE];// space for serialized volume data
   char tfName[257];                               // transfer function name
-  uint8_t* encoded = NULL;                        // encoded volume data
   size_t headerSize;                              // total header size in bytes, including ID string
   int ctype;                                      // compression type
   int tnum;                                       // number of transfer functions
@@ -688,66 +965,25 @@ vvFileIO::ErrorType vvFileIO::loadXVFFileOld(vvVolDesc* vd)
     cerr << "XVF type of transfer function(s): " << ttype << endl;
   }
 
-  // Load volume data:
+  // Load volume data, locate all frames first and then read and decode them concurrently:
   if ((_sections & RAW_DATA) != 0)
   {
-    fseek(fp, static_cast<long>(headerSize), SEEK_SET);
-    if (ctype==1) encoded = new uint8_t[frameSize];
-    for (size_t f=0; f<vd->frames; ++f)
+    std::ifstream file(vd->getFilename(), std::ios::binary);
+    std::vector<XVFFrame> xvfFrames;
+    std::vector<uint8_t*> data;
+    std::vector<XVFFrameStatus> status;
+    scanXVFFrames(file, static_cast<std::streamoff>(headerSize), vd->frames, frameSize, ctype==1 ? 4 : 0, xvfFrames);
+    readXVFFrames(vd->getFilename(), xvfFrames, vd->vox, vd->getBPV(), NULL, false, data, status);
+    ErrorType err = addXVFFrames(vd->frames, data, status, [vd](uint8_t* raw)
     {
-      uint8_t* raw = new uint8_t[frameSize];                 // create new data space for volume data
-      switch (ctype)
-      {
-        default:
-        case 0:                                   // no compression
-          if (fread(raw, 1, frameSize, fp) != frameSize)
-          {
-            vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
-            fclose(fp);
-            delete[] raw;
-            delete[] encoded;
-            return DATA_ERROR;
-          }
-          break;
-        case 1:                                   // RLE encoding
-          encodedSize = static_cast<size_t>(virvo::serialization::read32(fp));
-          if (encodedSize>0)
-          {
-            if (fread(encoded, 1, encodedSize, fp) != encodedSize)
-            {
-              vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
-              fclose(fp);
-              delete[] raw;
-              delete[] encoded;
-              return DATA_ERROR;
-            }
-            size_t outsize;
-            vvToolshed::ErrorType err = vvToolshed::decodeRLE(raw, encoded, encodedSize, vd->getBPV(), frameSize, &outsize);
-            if (err != vvToolshed::VV_OK)
-            {
-              vvDebugMsg::msg(1, "Error: Decoding exceeds frame size.");
-              fclose(fp);
-              delete[] raw;
-              delete[] encoded;
-              return DATA_ERROR;
-            }
-          }
-          else                                    // no encoding
-          {
-            if (fread(raw, 1, frameSize, fp) != frameSize)
-            {
-              vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
-              fclose(fp);
-              delete[] raw;
-              delete[] encoded;
-              return DATA_ERROR;
-            }
-          }
-          break;
-      }
       vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+      return true;
+    });
+    if (err != OK)
+    {
+      fclose(fp);
+      return err;
     }
-    delete[] encoded;
   }
 
   // Read transfer function(s):
@@ -862,6 +1098,8 @@ vvFileIO::ErrorType vvFileIO::loadXVFFileOld(vvVolDesc* vd)
 MINMAX -10.0 22.0 # integer data types: physical data range
 # float data types:   min/max of range for color mapping
 POS 0.0 0.0 0.0   # real-world location of volume center (x,y,z) [mm]
+SPARSE 16         # optional: frames are stored as sparse blocks of 16^3 voxels
+COMPRESSION SNAPPY # optional: encoded frames are Snappy compressed (version 4.2), default: RLE
 ICON 32 32        # beginning of icon data (width, height) [pixels],
 # followed by width*height 24-bit RGB pixels
 CHANNELNAMES      # ASCII channel names, separated by space characters.
@@ -881,13 +1119,21 @@ then to bottom, then to back, then frames. All bytes of each voxel
 are stored successively and in big endian format.
 In RLE encoding mode, a 4 byte value precedes each frame,
 telling the number of RLE encoded bytes that will follow. If this
-value is zero, the frame is unencoded.
+value is zero, the frame is unencoded. With COMPRESSION SNAPPY,
+the encoded bytes are a Snappy compressed frame instead, which
+decodes considerably faster than RLE. The codec is selected with
+setXVFCodec().
+If SPARSE is present (version 4.1), each frame is stored as
+written by virvo::SparseFrame::write(): block size, number of
+non-empty blocks, background voxel, block index, and the voxel
+data of all non-empty blocks in host byte order.
+If any frame of the volume is sparse, all frames are saved this way.
 </PRE>
 */
 vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
 {
   FILE* fp;                                       // volume file pointer
-  uint8_t* raw;                                   // raw volume data
+  const uint8_t* raw;                             // raw volume data
   uint8_t* encoded = NULL;                        // encoded volume data
   size_t encodedSize;                             // number of bytes in encoded array
 
@@ -909,9 +1155,18 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
   // Force icon to be present:
   if (vd->iconSize==0) vd->makeIcon(vvVolDesc::DEFAULT_ICON_SIZE);
 
+  // Save sparse frames as such, dense frames are converted while writing:
+  const virvo::SparseFrame* sparseRef = NULL;
+  for (size_t f=0; f<frames && sparseRef==NULL; ++f)
+    sparseRef = vd->getSparseFrame(f);
+
+  // Frames are RLE encoded, unless Snappy was selected:
+  const bool snappy = _compression && sparseRef==NULL && _xvfCodec==BrickFile::CODEC_SNAPPY
+                   && BrickFile::isCodecAvailable(BrickFile::CODEC_SNAPPY);
+
   // Write header:
   fprintf(fp, "XVF\n");
-  fprintf(fp, "VERSION %2.1f\n", 4.0f);
+  fprintf(fp, "VERSION %2.1f\n", sparseRef ? 4.1f : (snappy ? 4.2f : 4.0f));
   fprintf(fp, "VOXELS %d %d %d\n", static_cast<int32_t>(vd->vox[0]), static_cast<int32_t>(vd->vox[1]), static_cast<int32_t>(vd->vox[2]));
   fprintf(fp, "TIMESTEPS %d\n", static_cast<int32_t>(vd->frames));
   fprintf(fp, "BPC %d\n", static_cast<int32_t>(vd->bpc));
@@ -924,6 +1179,8 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
   fprintf(fp, "ZOOMRANGE %g %g\n", vd->mapping(0)[0], vd->mapping(0)[1]); // TODO
   fprintf(fp, "RANGE %g %g\n", vd->range(0)[0], vd->range(0)[1]);
   fprintf(fp, "POS %g %g %g\n", vd->pos[0], vd->pos[1], vd->pos[2]);
+  if (sparseRef) fprintf(fp, "SPARSE %lu\n", static_cast<unsigned long>(sparseRef->getBlockSize()));
+  if (snappy) fprintf(fp, "COMPRESSION SNAPPY\n");
 
   // Write channel names:
   fprintf(fp, "CHANNELNAMES");
@@ -978,11 +1235,30 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
 
   // Write volume data frame by frame:
   fprintf(fp, "VOXELDATA\n");
-  if (_compression==1) encoded = new uint8_t[frameSize];
+  if (_compression==1 && !sparseRef && !snappy) encoded = new uint8_t[frameSize];
+  std::vector<uint8_t> snappyData;                // Snappy encoded frame
 
   for (size_t f=0; f<frames; ++f)
   {
-    raw = vd->getRaw(f);
+    if (sparseRef)
+    {
+      const virvo::SparseFrame* sf = vd->getSparseFrame(f);
+      boost::scoped_ptr<virvo::SparseFrame> tmp;
+      if (sf==NULL && vd->getConstRaw(f)!=NULL)
+      {
+        tmp.reset(new virvo::SparseFrame(vd->getConstRaw(f), vd->vox, vd->getBPV(), sparseRef->getBlockSize(), sparseRef->getBackground()));
+        sf = tmp.get();
+      }
+      if (sf==NULL || !sf->write(fp))
+      {
+        cerr << "Error: Cannot write sparse voxel data to file." << endl;
+        fclose(fp);
+        return FILE_ERROR;
+      }
+      continue;
+    }
+
+    raw = vd->getConstRaw(f);
     if (raw==NULL)
     {
       VV_LOG(1) << "Error: no data available for frame" << std::endl;
@@ -992,11 +1268,22 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
     }
     if (_compression)
     {
-      vvToolshed::ErrorType err = vvToolshed::encodeRLE(encoded, raw, frameSize, vd->bpc * vd->getChan(), frameSize, &encodedSize);
-      if (err == vvToolshed::VV_OK)                         // compression possible?
+      const uint8_t* packed = encoded;
+      bool ok;
+      if (snappy)
+      {
+        ok = virvo::encodeSnappy(raw, frameSize, snappyData) && snappyData.size() < frameSize;
+        packed = ok ? &snappyData[0] : NULL;
+        encodedSize = snappyData.size();
+      }
+      else
+      {
+        ok = vvToolshed::encodeRLE(encoded, raw, frameSize, vd->bpc * vd->getChan(), frameSize, &encodedSize) == vvToolshed::VV_OK;
+      }
+      if (ok)                                     // compression possible?
       {
         virvo::serialization::write64(fp, encodedSize);     // write length of encoded frame
-        if (fwrite(encoded, 1, encodedSize, fp) != encodedSize)
+        if (fwrite(packed, 1, encodedSize, fp) != encodedSize)
         {
           cerr << "Error: Cannot write compressed voxel data to file." << endl;
           fclose(fp);
@@ -1044,13 +1331,12 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
   const char xvfID[4] = "XVF";
   vvTokenizer::TokenType ttype;                   // currently processed token type
   size_t frameSize;                               // size of a frame in bytes
-  uint8_t* raw;                                   // raw volume data
-  uint8_t* encoded = NULL;                        // encoded volume data
   bool done;
-  size_t encodedSize;                             // size of encoded data array
   bool bigEnd = true;
   float xvfVersion = 4.0;
   bool io32bit = false;
+  bool sparse = false;
+  bool snappy = false;
 
   vvDebugMsg::msg(1, "vvFileIO::loadXVFFile()");
 
@@ -1106,7 +1392,7 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
         cerr << "Reading XVF file version " << tok.nval << endl;
         xvfVersion = tok.nval;
         assert(xvfVersion >= 2.0);
-        assert(xvfVersion <= 4.0);
+        assert(xvfVersion <= 4.2f);
         if (xvfVersion == 2.0) {
           io32bit = true;
         }
@@ -1192,6 +1478,31 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
           vd->pos[i] = tok.nval;
         }
       }
+      else if (strcmp(tok.sval, "SPARSE")==0)
+      {
+        ttype = tok.nextToken();
+        assert(ttype == vvTokenizer::VV_NUMBER);
+        sparse = true;                            // block size is also stored with each frame
+      }
+      else if (strcmp(tok.sval, "COMPRESSION")==0)
+      {
+        ttype = tok.nextToken();
+        assert(ttype == vvTokenizer::VV_WORD);
+        if (strcmp(tok.sval, "SNAPPY")==0)
+        {
+          if (!BrickFile::isCodecAvailable(BrickFile::CODEC_SNAPPY))
+          {
+            vvDebugMsg::msg(1, "Error: XVF file is Snappy compressed, but Snappy is not available.");
+            return FORMAT_ERROR;
+          }
+          snappy = true;
+        }
+        else if (strcmp(tok.sval, "RLE")!=0)
+        {
+          vvDebugMsg::msg(1, "Error: unknown XVF compression type:", tok.sval);
+          return FORMAT_ERROR;
+        }
+      }
       else if (strcmp(tok.sval, "CHANNELNAMES")==0)
       {
         if (vd->getChan()<1) tok.nextLine();
@@ -1319,56 +1630,196 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
   frameSize = vd->getFrameBytes();
 
   // Load volume data:
-  if ((_sections & RAW_DATA) != 0)
+  if ((_sections & RAW_DATA) != 0 && sparse)
   {
     file.seekg(tok.getFilePos(), file.beg);
-    encoded = new uint8_t[frameSize];
     for (size_t f=0; f<vd->frames; ++f)
     {
-      raw = new uint8_t[frameSize];                 // create new data space for volume data
-      if (io32bit)
-        encodedSize = virvo::serialization::read32(file);
-      else
-        encodedSize = virvo::serialization::read64(file);
-      if (encodedSize>0)
+      virvo::SparseFrame* sf = new virvo::SparseFrame();
+      if (!sf->read(file, vd->vox, vd->getBPV()))
       {
-        file.read(reinterpret_cast< char* >(encoded), encodedSize);
-        size_t r = static_cast< size_t >(file.gcount());
-        if (r != encodedSize)
-        {
-          vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
-          delete[] raw;
-          delete[] encoded;
-          return DATA_ERROR;
-        }
-        size_t outsize;
-        vvToolshed::ErrorType err = vvToolshed::decodeRLE(raw, encoded, encodedSize, vd->getBPV(), frameSize, &outsize);
-        if (err != vvToolshed::VV_OK)
-        {
-          vvDebugMsg::msg(1, "Error: Decoding exceeds frame size.");
-          delete[] raw;
-          delete[] encoded;
-          return DATA_ERROR;
-        }
+        vvDebugMsg::msg(1, "Error: Insuffient sparse voxel data in file.");
+        delete sf;
+        return DATA_ERROR;
       }
-      else                                        // no encoding
+      if (machineBigEndian != bigEnd) sf->toggleEndianness(vd->bpc);
+      vd->addSparseFrame(sf);
+    }
+    return OK;
+  }
+  else if ((_sections & RAW_DATA) != 0)
+  {
+    // With a region, only the region of uncompressed frames is read from disk:
+    const virvo::vector<3, ssize_t> vox = vd->vox;
+    const virvo::ReadRegion region(_region, _stride, vox);
+    if (!headerLoaded(vd)) return CANCELLED;
+
+    // Locate all frames first, then read and decode them concurrently.
+    // With a load handler, frames are passed on in batches of one frame
+    // per worker thread, so that the first frames are available early.
+    std::vector<XVFFrame> xvfFrames;
+    scanXVFFrames(file, tok.getFilePos(), vd->frames, frameSize, io32bit ? 4 : 8, xvfFrames);
+
+    if (_lazyFrames && !_useRegion && _loadHandler == NULL)
+    {
+      if (xvfFrames.size() < vd->frames)
       {
-        file.read(reinterpret_cast< char* >(raw), frameSize);
-        size_t r = static_cast< size_t >(file.gcount());
-        if (r != frameSize)
-        {
-          vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
-          delete[] raw;
-          delete[] encoded;
-          return DATA_ERROR;
-        }
+        vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
+        return DATA_ERROR;
       }
-      vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+      const virvo::FileFrame::Encoding encoding = snappy ? virvo::FileFrame::ENCODING_SNAPPY
+                                                         : virvo::FileFrame::ENCODING_RLE;
+      for (size_t f=0; f<vd->frames; ++f)
+      {
+        vd->addLazyFrame(new virvo::FileFrame(vd->getFilename(), xvfFrames[f].offset, xvfFrames[f].encodedSize,
+                                              xvfFrames[f].encodedSize>0 ? encoding : virvo::FileFrame::ENCODING_RAW,
+                                              frameSize, vd->getBPV(), machineBigEndian != bigEnd ? vd->bpc : 0));
+      }
+      return OK;
+    }
+
+    const size_t batchSize = _loadHandler != NULL ? virvo::numWorkerThreads() : xvfFrames.size();
+    const bool swap = machineBigEndian != bigEnd;
+    const size_t outSize = vd->getFrameBytes();
+    size_t first = 0;
+    do
+    {
+      const size_t last = std::min(first + batchSize, xvfFrames.size());
+      std::vector<XVFFrame> batch(xvfFrames.begin() + first, xvfFrames.begin() + last);
+      std::vector<uint8_t*> data;
+      std::vector<XVFFrameStatus> status;
+      readXVFFrames(vd->getFilename(), batch, vox, vd->getBPV(), _useRegion ? &region : NULL, snappy, data, status);
+      ErrorType err = addXVFFrames(last == xvfFrames.size() ? vd->frames - first : batch.size(), data, status,
+                                   [&](uint8_t* raw)
+      {
+        if (swap) toggleEndianness(raw, outSize, vd->bpc);
+        return storeFrame(vd, raw, true);
+      });
+      if (err != OK) return err;
+      first = last;
     }
-    delete[] encoded;
+    while (first < xvfFrames.size());
+  }
+
+  return OK;
+}
+
+//----------------------------------------------------------------------------
+/** Writer for the brick-compressed volume file format (.bvf).
+  Codec, brick size and number of LOD levels are set with setBrickOptions().
+  For the file format see virvo::BrickFile.
+*/
+vvFileIO::ErrorType vvFileIO::saveBVFFile(const vvVolDesc* vd)
+{
+  vvDebugMsg::msg(1, "vvFileIO::saveBVFFile()");
+
+  if (vd->frames == 0 || vd->getFrameBytes() == 0)
+  {
+    vvDebugMsg::msg(1, "Error: no volume data to save.");
+    return DATA_ERROR;
+  }
+
+  BrickFile::Codec codec = _compression ? _brickCodec : BrickFile::CODEC_NONE;
+  if (!BrickFile::isCodecAvailable(codec))
+  {
+    vvDebugMsg::msg(1, "Warning: brick codec not available, storing bricks uncompressed.");
+    codec = BrickFile::CODEC_NONE;
+  }
+
+  if (!BrickFile::write(vd->getFilename(), vd, codec, _brickSize, _brickLevels))
+  {
+    vvDebugMsg::msg(1, "Error: Cannot write brick file.");
+    return FILE_ERROR;
+  }
+
+  return OK;
+}
+
+//----------------------------------------------------------------------------
+/** Loader for the brick-compressed volume file format (.bvf).
+  Frames are decoded brick by brick in parallel. Single bricks, sub-volumes
+  and stored LOD levels can be read without loading the whole volume
+  with virvo::BrickFile.
+*/
+vvFileIO::ErrorType vvFileIO::loadBVFFile(vvVolDesc* vd)
+{
+  vvDebugMsg::msg(1, "vvFileIO::loadBVFFile()");
+
+  BrickFile file;
+  if (!file.open(vd->getFilename()))
+  {
+    vvDebugMsg::msg(1, "Error: Cannot open brick file or invalid header.");
+    return FORMAT_ERROR;
   }
 
-  if (machineBigEndian != bigEnd) vd->toggleEndianness();
+  vd->removeSequence();
+  file.getAttributes(vd);
+  vd->frames = file.getFrames();
+
+  if ((_sections & RAW_DATA) != 0)
+  {
+    // Only the bricks that intersect a region are read:
+    const virvo::ReadRegion region(_region, _stride, file.getVox(0));
+    if (!headerLoaded(vd)) return CANCELLED;
+
+    // Pass the coarsest stored LOD level of the first frame on as a preview:
+    const size_t coarsest = file.getNumLevels() - 1;
+    if (_loadHandler != NULL && !_useRegion && coarsest > 0 && vd->frames > 0)
+    {
+      vvVolDesc* preview = new vvVolDesc(vd, -2);
+      virvo::vector< 3, ssize_t > vox = file.getVox(coarsest);
+      vec3 dist = vd->getDist();
+      for (int i=0; i<3; ++i)
+      {
+        dist[i] *= float(vd->vox[i]) / float(vox[i]);
+        preview->vox[i] = vox[i];
+      }
+      preview->setDist(dist);
+      uint8_t* raw = new uint8_t[preview->getFrameBytes()];
+      if (!file.readFrame(coarsest, 0, raw))
+      {
+        delete[] raw;
+        delete preview;
+      }
+      else
+      {
+        preview->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+        preview->frames = 1;
+        if (!_loadHandler->preview(preview)) return CANCELLED;
+      }
+    }
+
+    // Box that covers the region, the stride is applied after decoding
+    const virvo::vector<3, ssize_t> one(ssize_t(1));
+    const virvo::basic_aabb<ssize_t> box(region.first, region.first + (region.size - one) * region.stride + one);
+    virvo::ReadRegion boxRegion(region);
+    boxRegion.first = virvo::vector<3, ssize_t>(ssize_t(0));
+    std::vector<uint8_t> boxData;
+    if (_useRegion && !region.empty()) boxData.resize(box.size()[0] * box.size()[1] * box.size()[2] * vd->getBPV());
+
+    const size_t frameSize = vd->getFrameBytes();
+    for (size_t f=0; f<vd->frames; ++f)
+    {
+      uint8_t* raw = new uint8_t[frameSize];
+      bool ok;
+      if (_useRegion)
+      {
+        ok = boxData.empty() || file.readRegion(0, f, box, &boxData[0]);
+        if (ok && !boxData.empty()) virvo::copyRegion(&boxData[0], box.size(), vd->getBPV(), boxRegion, raw);
+      }
+      else
+      {
+        ok = file.readFrame(0, f, raw);
+      }
+      if (!ok)
+      {
+        vvDebugMsg::msg(1, "Error: Cannot decode frame of brick file.");
+        delete[] raw;
+        return DATA_ERROR;
+      }
+      if (!storeFrame(vd, raw, true)) return CANCELLED;
+    }
+  }
 
   return OK;
 }
@@ -1615,7 +2066,7 @@ vvFileIO::ErrorType vvFileIO::saveNrrdFile(const vvVolDesc* vd)
 {
   char buf[256];                                  // text buffer
   FILE* fp;                                       // volume file pointer
-  uint8_t* raw;                                   // raw volume data
+  const uint8_t* raw;                             // raw volume data
   size_t frameSize;                               // frame size
 
   vvDebugMsg::msg(1, "vvFileIO::saveNrrdFile()");
@@ -1674,7 +2125,7 @@ vvFileIO::ErrorType vvFileIO::saveNrrdFile(const vvVolDesc* vd)
 
   // Write scalar data:
   fputc('\n', fp);
-  raw = vd->getRaw(0);
+  raw = vd->getConstRaw(0);
   if (raw==NULL)
   {
     cerr << "Error: no data available for frame 0" << endl;
@@ -1700,7 +2151,7 @@ vvFileIO::ErrorType vvFileIO::saveNrrdFile(const vvVolDesc* vd)
 vvFileIO::ErrorType vvFileIO::saveAVFFile(const vvVolDesc* vd)
 {
   FILE* fp;                                       // volume file pointer
-  uint8_t* raw;                                   // raw volume data
+  const uint8_t* raw;                             // raw volume data
 
   vvDebugMsg::msg(1, "vvFileIO::saveAVFFile()");
 
@@ -1745,7 +2196,7 @@ vvFileIO::ErrorType vvFileIO::saveAVFFile(const vvVolDesc* vd)
   // Write voxel data:
   for (size_t f=0; f<vd->frames; ++f)
   {
-    raw = vd->getRaw(f);
+    raw = vd->getConstRaw(f);
     for (ssize_t z=0; z<vd->vox[2]; ++z)
     {
       if (vd->frames > 1) fprintf(fp, "# Frame %d, slice %d\n", static_cast<int32_t>(f), static_cast<int32_t>(z));
@@ -1763,12 +2214,12 @@ vvFileIO::ErrorType vvFileIO::saveAVFFile(const vvVolDesc* vd)
                 break;
               case 2:
               {
-                int d = *((uint16_t*)raw++);
+                int d = *((const uint16_t*)raw++);
                 fprintf(fp, "%d", d);
                 break;
               }
               case 4:
-                fprintf(fp, "%g", *((float*)raw++));
+                fprintf(fp, "%g", *((const float*)raw++));
                 break;
             }
             fputc(' ', fp);
@@ -2750,6 +3201,9 @@ vvFileIO::ErrorType vvFileIO::loadTIFFile(vvVolDesc* vd, bool addFrames)
 
   vd->mergeFrames(slicesPerFrame);
 
+  // Pages are only known to be slices or time steps after all were read:
+  if (err == OK && !storeLoadedFrames(vd)) return CANCELLED;
+
   return err;
 }
 
@@ -3131,7 +3585,7 @@ vvFileIO::ErrorType vvFileIO::saveTIFSlices(const vvVolDesc* vd, bool overwrite)
     // Write image data:
     imgOffset = ftell(fp);
     sliceSize = tmpVD->getSliceBytes();
-    if (fwrite(tmpVD->getRaw() + i * sliceSize, sliceSize, 1, fp) != 1)
+    if (fwrite(tmpVD->getConstRaw() + i * sliceSize, sliceSize, 1, fp) != 1)
     {
       cerr << "Error writing file: " << filenames[i] << endl;
       err = FILE_ERROR;
@@ -3627,6 +4081,8 @@ vvFileIO::ErrorType vvFileIO::loadRawFile(vvVolDesc* vd)
             chan = components;
             break;
         }
+        if (_useRegion && (_sections & RAW_DATA) != 0)
+          return loadRawRegion(vd, width, height, slices, bpc, chan, 0);
         return loadRawFile(vd, width, height, slices, bpc, chan, 0);
       }
     }
@@ -3643,13 +4099,13 @@ vvFileIO::ErrorType vvFileIO::saveRawFile(const vvVolDesc* vd)
 {
   FILE* fp;                                       // volume file pointer
   size_t frameSize;                               // size of a frame in bytes
-  uint8_t* raw;                                   // raw volume data
+  const uint8_t* raw;                             // raw volume data
 
   vvDebugMsg::msg(1, "vvFileIO::saveRawFile()");
 
   // Save volume data:
   frameSize = vd->getFrameBytes();
-  raw = vd->getRaw();                             // save only current frame of loaded sequence
+  raw = vd->getConstRaw();                        // save only current frame of loaded sequence
   if (frameSize==0 || raw==NULL)
   {
     return VD_ERROR;
@@ -3721,6 +4177,46 @@ vvFileIO::ErrorType vvFileIO::loadRawFile(vvVolDesc* vd, size_t w, size_t h, siz
   return OK;
 }
 
+//----------------------------------------------------------------------------
+/** Loads the region set with loadVolumeData() from a raw volume file,
+  only the region is read from disk.
+  @see loadRawFile(vvVolDesc*, size_t, size_t, size_t, size_t, size_t, size_t)
+*/
+vvFileIO::ErrorType vvFileIO::loadRawRegion(vvVolDesc* vd, size_t w, size_t h, size_t s, size_t b, size_t c, size_t header)
+{
+  vvDebugMsg::msg(1, "vvFileIO::loadRawRegion()");
+
+  if (b<1 || b>4) return FORMAT_ERROR;
+
+  virvo::PositionedFile file(vd->getFilename());
+  if (!file.isOpen())
+  {
+    vvDebugMsg::msg(1, "Error: Cannot open raw file.");
+    return FILE_ERROR;
+  }
+
+  vd->vox[0] = w;
+  vd->vox[1] = h;
+  vd->vox[2] = s;
+  vd->bpc    = b;
+  vd->setChan((int)c);
+  ++vd->frames;
+
+  const virvo::vector<3, ssize_t> vox = vd->vox;
+  const virvo::ReadRegion region(_region, _stride, vox);
+  if (!headerLoaded(vd)) return CANCELLED;
+
+  uint8_t* rawData = new uint8_t[vd->getFrameBytes()];
+  if (!virvo::readRegion(file, static_cast<int64_t>(header), vox, vd->getBPV(), region, rawData))
+  {
+    cerr << "Error: raw file corrupt (cannot read region)" << endl;
+    delete[] rawData;
+    return FILE_ERROR;
+  }
+
+  return storeFrame(vd, rawData, true) ? OK : CANCELLED;
+}
+
 //----------------------------------------------------------------------------
 /// Loads a PGM or PPM binary image file.
 vvFileIO::ErrorType vvFileIO::loadPXMRawImage(vvVolDesc* vd)
@@ -3802,8 +4298,17 @@ vvFileIO::ErrorType vvFileIO::loadPXMRawImage(vvVolDesc* vd)
   vd->vox[2] = 1;
   if (isPGM) { vd->bpc = 1; vd->setChan(1); }
   else       { vd->bpc = 1; vd->setChan(3); }
-  rawData = new uint8_t[vd->getFrameBytes()];
-  read = fread(rawData, vd->getFrameBytes(), 1, fp);
+  ++vd->frames;
+  const virvo::vector<3, ssize_t> vox = vd->vox;
+  if (!headerLoaded(vd))
+  {
+    fclose(fp);
+    return CANCELLED;
+  }
+
+  const size_t frameBytes = size_t(vox[0] * vox[1]) * vd->getBPV();
+  rawData = new uint8_t[frameBytes];
+  read = fread(rawData, frameBytes, 1, fp);
   if (read != 1)
   {
     vvDebugMsg::msg(1, "Error: PGM/PPM file corrupt.");
@@ -3813,9 +4318,7 @@ vvFileIO::ErrorType vvFileIO::loadPXMRawImage(vvVolDesc* vd)
   }
 
   fclose(fp);
-  vd->addFrame(rawData, vvVolDesc::ARRAY_DELETE);
-  ++vd->frames;
-  return OK;
+  return storeFrame(vd, rawData) ? OK : CANCELLED;
 }
 
 //----------------------------------------------------------------------------
@@ -3993,6 +4496,9 @@ vvFileIO::ErrorType vvFileIO::loadDicomFile(vvVolDesc* vd, int* dcmSeq, int* dcm
     vd->findMinMax(c, vd->range(c)[0], vd->range(c)[1]);
   }
 
+  // The value range is only known after the slice was converted:
+  if (!storeLoadedFrames(vd)) return CANCELLED;
+
   return OK;
 }
 
@@ -4244,7 +4750,15 @@ vvFileIO::ErrorType vvFileIO::loadNiftiFile(vvVolDesc* vd)
 #if VV_HAVE_NIFTI
   try
   {
-    virvo::nifti::load(vd);
+    if (_useRegion && (_sections & RAW_DATA) != 0)
+    {
+      virvo::nifti::load(vd, &_region, &_stride);
+      _regionApplied = true;
+    }
+    else
+    {
+      virvo::nifti::load(vd);
+    }
     return OK;
   }
   catch (std::exception& e)
@@ -4480,23 +4994,59 @@ vvFileIO::ErrorType vvFileIO::loadNrrdFile(vvVolDesc* vd)
   // Load volume data:
   if ((_sections & RAW_DATA) != 0)
   {
+    // With a region, only the region is read from disk:
+    const virvo::vector<3, ssize_t> vox = vd->vox;
+    const virvo::ReadRegion region(_region, _stride, vox);
+    // The tokenizer reads ahead, the data start where it stopped parsing:
+    const std::streamoff dataStart = tokenizer.getFilePos();
+    file.clear();
+    file.seekg(dataStart, file.beg);
+    virvo::PositionedFile positioned;
+    if (_useRegion) positioned.open(vd->getFilename());
+
+    if (!headerLoaded(vd)) return CANCELLED;
+
+    if (_lazyFrames && !_useRegion && _loadHandler == NULL)
+    {
+      file.seekg(0, file.end);
+      if (file.tellg() < dataStart + std::streamoff(vd->frames * frameSize))
+      {
+        vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
+        return DATA_ERROR;
+      }
+      for (size_t f=0; f<vd->frames; ++f)
+      {
+        vd->addLazyFrame(new virvo::FileFrame(vd->getFilename(), dataStart + std::streamoff(f * frameSize), frameSize,
+                                              virvo::FileFrame::ENCODING_RAW, frameSize, vd->getBPV(),
+                                              bigEnd != machineBigEndian ? vd->bpc : 0));
+      }
+      return OK;
+    }
+
     for (size_t f=0; f<vd->frames; ++f)
     {
-      raw = new uint8_t[frameSize];                 // create new data space for volume data
-      file.read(reinterpret_cast< char* >(raw), frameSize);
-      size_t r = static_cast< size_t >(file.gcount());
-      if (r != frameSize)
+      raw = new uint8_t[vd->getFrameBytes()];     // create new data space for volume data
+      bool ok;
+      if (_useRegion)
+      {
+        ok = virvo::readRegion(positioned, dataStart + std::streamoff(f * frameSize), vox, vd->getBPV(), region, raw);
+      }
+      else
+      {
+        file.read(reinterpret_cast< char* >(raw), frameSize);
+        ok = static_cast< size_t >(file.gcount()) == frameSize;
+      }
+      if (!ok)
       {
         vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
         delete[] raw;
         return DATA_ERROR;
       }
-      vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+      if (bigEnd != machineBigEndian) toggleEndianness(raw, vd->getFrameBytes(), vd->bpc);
+      if (!storeFrame(vd, raw, true)) return CANCELLED;
     }
   }
 
-  if (bigEnd != machineBigEndian) vd->toggleEndianness();
-
   return OK;
 #endif
 }
@@ -5241,7 +5791,7 @@ vvFileIO::ErrorType vvFileIO::savePXMSlices(const vvVolDesc* vd, bool overwrite)
   size_t sliceSize;
   size_t tmpSliceSize = 0;
   char buffer[1024];
-  uint8_t* slice;                                 // original slice data
+  const uint8_t* slice;                           // original slice data
   uint8_t* tmpSlice = NULL;                       // temporary slice data
 
   vvDebugMsg::msg(1, "vvFileIO::savePXMSlices()");
@@ -5311,7 +5861,7 @@ vvFileIO::ErrorType vvFileIO::savePXMSlices(const vvVolDesc* vd, bool overwrite)
     fprintf(fp, "%d\n", 255);                     // write maximum value
 
     // Write data:
-    slice = vd->getRaw() + i * sliceSize;
+    slice = vd->getConstRaw() + i * sliceSize;
     if (vd->bpc==1 && (vd->getChan()==1 || vd->getChan()==3))
     {
       if (fwrite(slice, sliceSize, 1, fp) != 1) err = FILE_ERROR;
@@ -5373,6 +5923,9 @@ vvFileIO::ErrorType vvFileIO::saveVolumeData(vvVolDesc* vd, bool overwrite, Load
   if (vvToolshed::isSuffix(vd->getFilename(), ".xvf"))
     return saveXVFFile(vd);
 
+  if (vvToolshed::isSuffix(vd->getFilename(), ".bvf"))
+    return saveBVFFile(vd);
+
   if (vvToolshed::isSuffix(vd->getFilename(), ".avf"))
     return saveAVFFile(vd);
 
@@ -5422,6 +5975,9 @@ vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, LoadType sec, bool a
   }
 
   _sections = sec;
+  _headerLoaded = false;
+  _framesLoaded = 0;
+  _regionApplied = false;
 
   namespace fs = boost::filesystem;
 
@@ -5481,6 +6037,10 @@ vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, LoadType sec, bool a
   else if (format == XVF)
     err = loadXVFFile(vd);
 
+                                                  // Brick-compressed volume file
+  else if (format == BVF)
+    err = loadBVFFile(vd);
+
   else if (format == AVF)
     err = loadAVFFile(vd);
 
@@ -5589,6 +6149,47 @@ vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, LoadType sec, bool a
     vd->setDist(dist);
   }
 
+  // Loaders that do not pass frames on while reading are handled here:
+  if (err == OK && !storeLoadedFrames(vd)) return CANCELLED;
+
+  return err;
+}
+
+//----------------------------------------------------------------------------
+/** Load a sub-box of a volume, optionally only every n'th voxel of it.
+  Loaders for uncompressed data (raw, XVF, NRRD, NIfTI) only read the
+  region from disk, so that memory and I/O scale with the size of the
+  region, brick files (.bvf) only read the bricks that intersect it.
+  Other formats are loaded completely and the region is cut out.
+  The volume gets the size of the region, voxel distance and position are
+  adjusted like with vvVolDesc::crop().
+  @param vd     volume description
+  @param region sub-box to load [voxels], min inclusive, max exclusive,
+                clamped to the volume
+  @param stride load every stride'th voxel of the region in each dimension
+  @param sec    file sections to load, @see loadVolumeData()
+*/
+vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, const virvo::basic_aabb<ssize_t>& region,
+                                             const virvo::vector<3, ssize_t>& stride, LoadType sec)
+{
+  vvDebugMsg::msg(1, "vvFileIO::loadVolumeData(region)");
+
+  for (int i=0; i<3; ++i)
+  {
+    if (region.max[i] <= region.min[i] || stride[i] < 1) return PARAM_ERROR;
+  }
+
+  _useRegion = true;
+  _region = region;
+  _stride = stride;
+  ErrorType err = loadVolumeData(vd, sec);
+  _useRegion = false;
+
+  if (err == OK && (vd->vox[0] <= 0 || vd->vox[1] <= 0 || vd->vox[2] <= 0))
+  {
+    vvDebugMsg::msg(1, "Error: region is outside of the volume.");
+    err = PARAM_ERROR;
+  }
   return err;
 }
 
@@ -5602,6 +6203,59 @@ void vvFileIO::setCompression(bool newCompression)
   _compression = newCompression;
 }
 
+//----------------------------------------------------------------------------
+/** Set a handler that is notified while a volume is loaded. The handler gets
+  the volume attributes as soon as they are known and then each frame as it
+  is read, instead of the frames being added to the volume description.
+  Loaders that cannot pass frames on while reading deliver them after the
+  whole file was loaded.
+  @param handler load handler, NULL to add frames to the volume (default)
+*/
+void vvFileIO::setLoadHandler(LoadHandler* handler)
+{
+  _loadHandler = handler;
+}
+
+//----------------------------------------------------------------------------
+/** Set the layout of brick-compressed volume files (.bvf) to be saved.
+  The codec is only used if compression is on, @see setCompression().
+  @param codec     compression of each brick
+  @param brickSize edge length of bricks [voxels]
+  @param numLevels number of LOD levels to store, 1 = full resolution only
+*/
+void vvFileIO::setBrickOptions(BrickFile::Codec codec, size_t brickSize, size_t numLevels)
+{
+  _brickCodec = codec;
+  _brickSize = brickSize;
+  _brickLevels = numLevels;
+}
+
+//----------------------------------------------------------------------------
+/** Set the codec for frames of XVF files to be saved. The codec is only
+  used if compression is on, @see setCompression().
+  @param codec CODEC_RLE (default) or CODEC_SNAPPY. Other codecs, and
+               Snappy if it is not available, save RLE encoded files.
+*/
+void vvFileIO::setXVFCodec(BrickFile::Codec codec)
+{
+  _xvfCodec = codec;
+}
+
+//----------------------------------------------------------------------------
+/** Set lazy mode. In lazy mode, loaders for XVF and raw NRRD files only
+  parse the header and locate the frames in the file, the frames are read
+  when they are accessed (@see vvVolDesc::addLazyFrame()). Opening a file
+  then takes the same time regardless of its size. The file must not be
+  changed or deleted while the volume is in use.
+  Sparse XVF files, regions (@see loadVolumeData()) and load handlers
+  always read all frames.
+  @param lazy true = read frames on access, false = read all frames (default)
+*/
+void vvFileIO::setLazyFrames(bool lazy)
+{
+  _lazyFrames = lazy;
+}
+
 //----------------------------------------------------------------------------
 /** Parse a Leica confocal microscope type file name.
   Example: "Series006_z000_ch00.tif"
@@ -5682,8 +6336,223 @@ bool vvFileIO::changeLeicaFilename(string& fileName, int32_t slice, int32_t chan
   return true;
 }
 
+//----------------------------------------------------------------------------
+// Parallel loading of file stacks
+//----------------------------------------------------------------------------
+
+namespace
+{
+
+/** Copies the frames of one file of a stack to their place in the frames
+  of the merged volume while the file is read.
+*/
+class FileStackHandler : public vvFileIO::LoadHandler
+{
+  public:
+    /**
+      @param first     first file of the stack, all files must have its format
+      @param file      index of the file in the stack
+      @param mergeType VV_MERGE_SLABS2VOL or VV_MERGE_VOL2ANIM
+      @param frames    frames of the merged volume
+      @param failed    set if loading another file of the stack failed
+    */
+    FileStackHandler(const vvVolDesc* first, size_t file, vvVolDesc::MergeType mergeType,
+                     std::vector<uint8_t*>& frames, const std::atomic<bool>& failed)
+      : _first(first)
+      , _file(file)
+      , _mergeType(mergeType)
+      , _frames(frames)
+      , _failed(failed)
+      , _matches(true)
+      , _numFrames(0)
+    {
+    }
+
+    bool header(const vvVolDesc* vd)
+    {
+      _matches = vd->vox[0] == _first->vox[0] && vd->vox[1] == _first->vox[1] && vd->vox[2] == _first->vox[2]
+              && vd->bpc == _first->bpc && vd->getChan() == _first->getChan();
+      return _matches && !_failed;
+    }
+
+    bool frame(const vvVolDesc* vd, size_t index, uint8_t* data)
+    {
+      if (index >= _first->frames)
+      {
+        _matches = false;
+        delete[] data;
+        return false;
+      }
+
+      const size_t bytes = vd->getFrameBytes();
+      if (_mergeType == vvVolDesc::VV_MERGE_SLABS2VOL)
+        memcpy(_frames[index] + _file * bytes, data, bytes);
+      else
+        memcpy(_frames[_file * _first->frames + index], data, bytes);
+      delete[] data;
+      ++_numFrames;
+      return !_failed;
+    }
+
+    /// @return true if the file had the format of the first file of the stack
+    bool matches() const
+    {
+      return _matches && _numFrames == _first->frames;
+    }
+
+  private:
+    const vvVolDesc* _first;
+    size_t _file;
+    vvVolDesc::MergeType _mergeType;
+    std::vector<uint8_t*>& _frames;
+    const std::atomic<bool>& _failed;
+    bool _matches;
+    size_t _numFrames;
+};
+
+} // namespace
+
+//----------------------------------------------------------------------------
+/** Load a stack of image or volume files, e.g. the slices of a TIFF, DICOM
+  or PGM series, into one volume. The frames of the merged volume are
+  allocated up front. Then the files are read concurrently by a pool of
+  worker threads (VV_NUM_THREADS or the number of processors), each file's
+  voxel data is copied to its place in the merged frames when the loader
+  passes it on: while reading for raw-like formats and PGM/PPM, after the
+  file was decoded for TIFF and DICOM.
+  All files must have the size, data type and number of frames of the first
+  file.
+  @param vd        volume without voxel data that receives the stack
+  @param filenames files to load, in stack order
+  @param mergeType VV_MERGE_SLABS2VOL to stack the files along z,
+                   VV_MERGE_VOL2ANIM to make each file a time step
+  @return OK if all files were loaded, vd is not changed on error
+*/
+vvFileIO::ErrorType vvFileIO::loadFileStack(vvVolDesc* vd, const std::vector<std::string>& filenames,
+                                            vvVolDesc::MergeType mergeType)
+{
+  vvDebugMsg::msg(1, "vvFileIO::loadFileStack()");
+
+  if (vd==NULL || filenames.empty() || vd->frames!=0) return PARAM_ERROR;
+  if (mergeType!=vvVolDesc::VV_MERGE_SLABS2VOL && mergeType!=vvVolDesc::VV_MERGE_VOL2ANIM) return PARAM_ERROR;
+
+  // The first file determines the format of the stack:
+  vvVolDesc first(filenames[0].c_str());
+  vvFileIO fio;
+  ErrorType err = fio.loadVolumeData(&first);
+  if (err != OK)
+  {
+    cerr << "Cannot load file: " << filenames[0] << endl;
+    return err;
+  }
+  first.printInfoLine("Loaded: ");
+  first.frames = first.getStoredFrames();
+  if (first.frames == 0) return DATA_ERROR;
+
+  const size_t numFiles = filenames.size();
+  const size_t fileBytes = first.getFrameBytes();
+  const bool slabs = (mergeType == vvVolDesc::VV_MERGE_SLABS2VOL);
+  std::vector<uint8_t*> frames(slabs ? first.frames : numFiles * first.frames);
+  const size_t frameBytes = slabs ? numFiles * fileBytes : fileBytes;
+  for (size_t f=0; f<frames.size(); ++f)
+    frames[f] = new uint8_t[frameBytes];
+
+  for (size_t f=0; f<first.frames; ++f)
+    memcpy(frames[f], first.getConstRaw(f), fileBytes);
+
+  // Value ranges and mappings of all files, merged like vvVolDesc::merge() does:
+  std::vector<std::vector<vec2> > ranges(numFiles);
+  std::vector<std::vector<vec2> > mappings(numFiles);
+  for (int c=0; c<first.getChan(); ++c)
+  {
+    ranges[0].push_back(first.range(c));
+    mappings[0].push_back(first.mapping(c));
+  }
+
+  std::atomic<size_t> nextFile(1);
+  std::atomic<bool> failed(false);
+  std::mutex errorMutex;
+
+  auto worker = [&]()
+  {
+    vvFileIO fileIO;
+    for (size_t file = nextFile++; file < numFiles && !failed; file = nextFile++)
+    {
+      vvVolDesc fileVD(filenames[file].c_str());
+      FileStackHandler handler(&first, file, mergeType, frames, failed);
+      fileIO.setLoadHandler(&handler);
+      ErrorType fileErr = fileIO.loadVolumeData(&fileVD);
+      if ((fileErr == OK || fileErr == CANCELLED) && !handler.matches()) fileErr = DATA_ERROR;
+
+      if (fileErr != OK)
+      {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!failed)
+        {
+          if (fileErr == DATA_ERROR)
+            cerr << "File '" << filenames[file] << "' does not match the format of '" << filenames[0] << "'." << endl;
+          else
+            cerr << "Cannot load file: " << filenames[file] << endl;
+          err = fileErr;
+          failed = true;
+        }
+        return;
+      }
+
+      for (int c=0; c<first.getChan(); ++c)
+      {
+        ranges[file].push_back(fileVD.range(c));
+        mappings[file].push_back(fileVD.mapping(c));
+      }
+    }
+  };
+
+  const size_t numThreads = std::min(size_t(virvo::numWorkerThreads()), numFiles - 1);
+  if (numFiles > 1)
+    cerr << "Loading " << (numFiles - 1) << " more files with " << numThreads << " threads" << endl;
+
+  std::vector<std::thread> threads;
+  for (size_t i=1; i<numThreads; ++i)
+    threads.push_back(std::thread(worker));
+  if (numThreads > 0) worker();
+  for (size_t i=0; i<threads.size(); ++i)
+    threads[i].join();
+
+  if (failed)
+  {
+    for (size_t f=0; f<frames.size(); ++f)
+      delete[] frames[f];
+    return err;
+  }
+
+  // Assemble the merged volume:
+  vvVolDesc* stack = new vvVolDesc(&first, -2);
+  if (slabs)
+  {
+    stack->vox[2] = first.vox[2] * ssize_t(numFiles);
+    for (int c=0; c<first.getChan(); ++c)
+    {
+      for (size_t file=1; file<numFiles; ++file)
+      {
+        stack->range(c).x = std::min(stack->range(c).x, ranges[file][c].x);
+        stack->range(c).y = std::max(stack->range(c).y, ranges[file][c].y);
+      }
+      stack->mapping(c) = mappings[numFiles - 1][c];
+    }
+  }
+  for (size_t f=0; f<frames.size(); ++f)
+    stack->addFrame(frames[f], vvVolDesc::ARRAY_DELETE);
+  stack->frames = frames.size();
+
+  vd->merge(stack, mergeType);
+  delete stack;
+  return OK;
+}
+
 //----------------------------------------------------------------------------
 /** Merge image or volume files.
+  Slices and volumes are loaded in parallel with loadFileStack(), Leica
+  files and channels are merged one file at a time.
   @param vd volume to load slices into
   @param numFiles number of files to load
   @param increment file index increment. default = 1; 
@@ -5709,6 +6578,7 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
   list<string> fileNames;
   list<string> dirNames;
   string dir;
+  std::vector<std::string> mergeNames;            // names of all files to merge
 
   assert(increment >= 0);
 
@@ -5737,105 +6607,123 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
     vvToolshed::makeFileList(currentDir, fileNames, dirNames);
   }
 
-  vvFileIO fio;
+  // Collect the names of the files to merge:
   while (!done)
   {
-    // Load current file:
-    cerr << "Loading file " << (file+1) << ": " << filename << endl;
-    newVD = new vvVolDesc(filename.c_str());
+    mergeNames.push_back(filename);
 
-    if (fio.loadVolumeData(newVD) != vvFileIO::OK)
+    // Find the next file:
+    ++file;
+    if (file < numFiles || numFiles==0)
     {
-      cerr << "Cannot load file: " << filename << endl;
-      ret = FILE_ERROR;
-      done = true;
-    }
-    else
-    {
-      newVD->printInfoLine("Loaded: ");
-
-      // Merge new data to previous data:
       if (isLeicaFormat)
       {
-        if (leicaChannel==0) currentVD = new vvVolDesc();
-
-        if(currentVD->merge(newVD, vvVolDesc::VV_MERGE_CHAN2VOL) == vvVolDesc::OK)  cerr << "OK" << endl;
-
         if (leicaChannel == numLeicaChannels-1)
         {
-          vd->merge(currentVD, mergeType);
-          delete currentVD;
-          currentVD = NULL;
           leicaChannel = 0;
           leicaSlice += increment;
         }
         else ++leicaChannel;
-      }
-      else vd->merge(newVD, mergeType);
-
-      delete newVD;                            // now the new VD can be released
-      newVD = NULL;
 
-      // Find the next file:
-      ++file;
-      if (file < numFiles || numFiles==0)
-      {
-        if (isLeicaFormat)
+        if (!changeLeicaFilename(filename, leicaSlice, leicaChannel))
         {
-          if (!changeLeicaFilename(filename, leicaSlice, leicaChannel))
-          {
-            cerr << "Cannot change filename '" << filename << "'." << endl;
-            ret = FILE_ERROR;
-            done = true;
-          }
+          cerr << "Cannot change filename '" << filename << "'." << endl;
+          ret = FILE_ERROR;
+          done = true;
         }
-        else if (increment==0)    // move to next file in ordered list?
+      }
+      else if (increment==0)    // move to next file in ordered list?
+      {
+        string nextName="";
+        filePath = vvToolshed::extractDirname(filename);
+        plainFilename = vvToolshed::extractFilename(filename);
+        while (!done && nextName=="")
         {
-          string nextName="";
-          filePath = vvToolshed::extractDirname(filename);
-          plainFilename = vvToolshed::extractFilename(filename);
-          while (!done && nextName=="")
+          if (vvToolshed::nextListString(fileNames, plainFilename, nextName)) 
           {
-            if (vvToolshed::nextListString(fileNames, plainFilename, nextName)) 
+            if (vvToolshed::extractExtension(nextName) != extension) 
             {
-              if (vvToolshed::extractExtension(nextName) != extension) 
-              {
-                plainFilename = nextName;
-                nextName="";
-              }
+              plainFilename = nextName;
+              nextName="";
             }
-            else done = true;
           }
-          filename = filePath + nextName;
+          else done = true;
         }
-        else
+        filename = filePath + nextName;
+      }
+      else
+      {
+        for (j=0; j<increment && !done; ++j)
         {
-          for (j=0; j<increment && !done; ++j)
+          if (!vvToolshed::increaseFilename(filename))
           {
-            if (!vvToolshed::increaseFilename(filename))
-            {
-              cerr << "Cannot increase filename '" << filename << "'." << endl;
-              ret = FILE_ERROR;
-              done = true;
-            }
+            cerr << "Cannot increase filename '" << filename << "'." << endl;
+            ret = FILE_ERROR;
+            done = true;
           }
         }
+      }
 
-        if (!done)
+      if (!done)
+      {
+        if (!vvToolshed::isFile(filename.c_str()))
         {
-          if (!vvToolshed::isFile(filename.c_str()))
+          if (file < numFiles)
           {
-            if (file < numFiles)
-            {
-              cerr << "File '" << filename << "' expected but not found." << endl;
-              ret = FILE_NOT_FOUND;
-            }
-            done = true;
+            cerr << "File '" << filename << "' expected but not found." << endl;
+            ret = FILE_NOT_FOUND;
           }
+          done = true;
         }
       }
-      else done = true;
     }
+    else done = true;
+  }
+
+  if (!isLeicaFormat && mergeType != vvVolDesc::VV_MERGE_CHAN2VOL && vd->frames == 0)
+  {
+    ErrorType err = loadFileStack(vd, mergeNames, mergeType);
+    if (err != OK) ret = err;
+    return ret;
+  }
+
+  vvFileIO fio;
+  leicaChannel = 0;
+  for (file=0; file<int(mergeNames.size()); ++file)
+  {
+    // Load current file:
+    cerr << "Loading file " << (file+1) << ": " << mergeNames[file] << endl;
+    newVD = new vvVolDesc(mergeNames[file].c_str());
+
+    if (fio.loadVolumeData(newVD) != vvFileIO::OK)
+    {
+      cerr << "Cannot load file: " << mergeNames[file] << endl;
+      ret = FILE_ERROR;
+      break;
+    }
+
+    newVD->printInfoLine("Loaded: ");
+
+    // Merge new data to previous data:
+    if (isLeicaFormat)
+    {
+      if (leicaChannel==0) currentVD = new vvVolDesc();
+
+      if(currentVD->merge(newVD, vvVolDesc::VV_MERGE_CHAN2VOL) == vvVolDesc::OK)  cerr << "OK" << endl;
+
+      if (leicaChannel == numLeicaChannels-1)
+      {
+        vd->merge(currentVD, mergeType);
+        delete currentVD;
+        currentVD = NULL;
+        leicaChannel = 0;
+      }
+      else ++leicaChannel;
+    }
+    else vd->merge(newVD, mergeType);
+
+    delete newVD;                            // now the new VD can be released
+    newVD = NULL;
   }
   delete newVD;
   delete currentVD;
@@ -22,12 +22,15 @@
 #define VV_FILEIO_H
 
 #include <cassert>
+#include <string>
+#include <vector>
+#include "vvbrickfile.h"
 #include "vvexport.h"
 #include "vvvoldesc.h"
 
 /** File load and save routines for volume data.
   The following file formats are supported:<BR>
-  RVF, XVF, VF, AVF, 3D TIFF, Visible Human, raw, RGB, TGA, PGM, PPM<BR>
+  RVF, XVF, BVF, VF, AVF, 3D TIFF, Visible Human, raw, RGB, TGA, PGM, PPM<BR>
   When a 2D image file is loaded, the loader looks for a numbered sequence
   automatically, for instance: file001.rvf, file002.rvf, ...
   @author Juergen Schulze (schulze@hlrs.de)
@@ -72,7 +75,8 @@ class VIRVO_FILEIOEXPORT vvFileIO
       FILE_NOT_FOUND,                             ///< file not found error
       DATA_ERROR,                                 ///< data format error
       FORMAT_ERROR,                               ///< file format error (e.g. no valid TIF file)
-      VD_ERROR                                    ///< volume descriptor (vvVolDesc) error
+      VD_ERROR,                                   ///< volume descriptor (vvVolDesc) error
+      CANCELLED                                   ///< loading was cancelled by the load handler
     };
     enum LoadType                                 /// Load options
     {
@@ -83,15 +87,41 @@ class VIRVO_FILEIOEXPORT vvFileIO
       TRANSFER = 0x0008                           ///< load transfer functions
     };
 
+    /** Receives the volume attributes and the frames while a file is loaded,
+      @see setLoadHandler(). Frames that are passed to the handler are not
+      added to the volume description. Returning false from any of the
+      functions cancels loading.
+    */
+    class LoadHandler
+    {
+      public:
+        virtual ~LoadHandler() {}
+        /// All attributes of vd are set, voxel data was not read yet
+        virtual bool header(const vvVolDesc* vd) = 0;
+        /// Coarse version of the first frame, owned by the handler
+        virtual bool preview(vvVolDesc* vd) { delete vd; return true; }
+        /// Frame with vd->getFrameBytes() bytes allocated with new[], owned by the handler
+        virtual bool frame(const vvVolDesc* vd, size_t index, uint8_t* data) = 0;
+    };
+
     vvFileIO();
     ErrorType saveVolumeData(vvVolDesc *, bool, LoadType sec = ALL_DATA);
     ErrorType loadVolumeData(vvVolDesc*, LoadType sec = ALL_DATA, bool addFrame=false);
+    ErrorType loadVolumeData(vvVolDesc*, const virvo::basic_aabb<ssize_t>& region,
+                             const virvo::vector<3, ssize_t>& stride, LoadType sec = ALL_DATA);
     ErrorType loadDicomFile(vvVolDesc*, int* = NULL, int* = NULL, float* = NULL);
     ErrorType loadRawFile(vvVolDesc*, size_t, size_t, size_t, size_t, size_t, size_t);
     ErrorType loadXB7File(vvVolDesc*,int=128,int=8,bool=true);
     ErrorType loadCPTFile(vvVolDesc*,int=128,int=8,bool=true);
     ErrorType mergeFiles(vvVolDesc*, int, int, vvVolDesc::MergeType);
+    ErrorType loadFileStack(vvVolDesc*, const std::vector<std::string>&, vvVolDesc::MergeType);
     void      setCompression(bool);
+    void      setLoadHandler(LoadHandler* handler);
+    void      setBrickOptions(virvo::BrickFile::Codec codec,
+                              size_t brickSize = virvo::BrickFile::DEFAULT_BRICK_SIZE,
+                              size_t numLevels = 1);
+    void      setXVFCodec(virvo::BrickFile::Codec codec);
+    void      setLazyFrames(bool lazy);
     ErrorType importTF(vvVolDesc*, const char*);
 
   protected:
@@ -99,8 +129,25 @@ class VIRVO_FILEIOEXPORT vvFileIO
     char _nrrdID[9];                               ///< nrrd file ID
     int  _sections;                                ///< bit coded list of file sections to load
     bool _compression;                             ///< true = compression on (default)
+    virvo::BrickFile::Codec _brickCodec;           ///< brick codec for BVF files (default: RLE)
+    virvo::BrickFile::Codec _xvfCodec;             ///< frame codec for XVF files (default: RLE)
+    bool _lazyFrames;                              ///< true = read frames from disk when they are accessed
+    size_t _brickSize;                             ///< brick edge length for BVF files [voxels]
+    size_t _brickLevels;                           ///< number of LOD levels stored in BVF files
+    LoadHandler* _loadHandler;                     ///< receives header and frames while loading, NULL if none
+    bool _headerLoaded;                            ///< true if the header was passed to _loadHandler
+    size_t _framesLoaded;                          ///< number of frames passed to _loadHandler
+    bool _useRegion;                               ///< true if only _region is to be loaded
+    virvo::basic_aabb<ssize_t> _region;            ///< sub-box to load [voxels]
+    virvo::vector<3, ssize_t> _stride;             ///< load every n'th voxel of _region
+    bool _regionApplied;                           ///< true if vd already has the size of the region
+    virvo::vector<3, ssize_t> _fullVox;            ///< volume size in the file, before applying the region
 
     void setDefaultValues(vvVolDesc*);
+    bool headerLoaded(vvVolDesc*);
+    bool storeFrame(vvVolDesc*, uint8_t*, bool inRegion=false);
+    bool storeLoadedFrames(vvVolDesc*);
+    ErrorType loadRawRegion(vvVolDesc*, size_t, size_t, size_t, size_t, size_t, size_t);
     int  readASCIIint(FILE*);
     bool parseLeicaFilename(const std::string, int32_t&, int32_t&, std::string&);
     bool changeLeicaFilename(std::string&, int32_t, int32_t);
@@ -112,6 +159,8 @@ class VIRVO_FILEIOEXPORT vvFileIO
     ErrorType saveXVFFile(vvVolDesc*);
     ErrorType loadXVFFileOld(vvVolDesc*);
     ErrorType loadXVFFile(vvVolDesc*);
+    ErrorType saveBVFFile(const vvVolDesc*);
+    ErrorType loadBVFFile(vvVolDesc*);
     ErrorType saveAVFFile(const vvVolDesc*);
     ErrorType loadAVFFile(vvVolDesc*);
     ErrorType loadVTKFile(vvVolDesc*);
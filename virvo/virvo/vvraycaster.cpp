@@ -18,6 +18,7 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -77,6 +78,7 @@ using namespace visionaray;
 using ray_type          = basic_ray<float>;
 using sched_type        = cuda_sched<ray_type>;
 using transfunc_type    = cuda_texture<vec4,      1>;
+using transfunc2d_type  = cuda_texture<vec4,      2>;
 using volume8_type      = cuda_texture<unorm< 8>, 3>;
 using volume16_type     = cuda_texture<unorm<16>, 3>;
 using volume32_type     = cuda_texture<float,     3>;
@@ -90,6 +92,7 @@ using ray_type = basic_ray<float>;
 #endif
 using sched_type        = tiled_sched<ray_type>;
 using transfunc_type    = texture<vec4,      1>;
+using transfunc2d_type  = texture<vec4,      2>;
 using volume8_type      = texture<unorm< 8>, 3>;
 using volume16_type     = texture<unorm<16>, 3>;
 using volume32_type     = texture<float,     3>;
@@ -597,12 +600,15 @@ struct volume_kernel_params
 
     using clip_object    = variant<clip_plane, clip_sphere, clip_cone>;
     using transfunc_ref  = typename transfunc_type::ref_type;
+    using transfunc2d_ref = typename transfunc2d_type::ref_type;
 
     clip_box                    bbox;
     clip_box                    roi;
     float                       delta;
     int                         num_channels;
     transfunc_ref const*        transfuncs;
+    transfunc2d_ref             transfunc2d;
+    bool                        use_transfunc2d;
     vec2 const*                 ranges;
     unsigned const*             depth_buffer;
     pixel_format                depth_format;
@@ -736,10 +742,25 @@ struct volume_kernel
 
                 C color(0.0);
 
-                for (int i = 0; i < params.num_channels; ++i)
+                // A 2D transfer function classifies both channels at once
+                int num_lookups = params.use_transfunc2d ? 1 : params.num_channels;
+
+                for (int i = 0; i < num_lookups; ++i)
                 {
-                    S voxel  = tex3D(volumes[i], tex_coord);
-                    C colori = tex1D(params.transfuncs[i], voxel);
+                    C colori;
+
+                    if (params.use_transfunc2d)
+                    {
+                        // value x precomputed gradient magnitude
+                        S voxel   = tex3D(volumes[0], tex_coord);
+                        S gradmag = tex3D(volumes[1], tex_coord);
+                        colori    = tex2D(params.transfunc2d, vector<2, S>(voxel, gradmag));
+                    }
+                    else
+                    {
+                        S voxel = tex3D(volumes[i], tex_coord);
+                        colori  = tex1D(params.transfuncs[i], voxel);
+                    }
 
                     auto do_shade = params.local_shading && colori.w >= 0.1f;
 
@@ -904,16 +925,27 @@ struct vvRayCaster::Impl
     std::vector<volume16_type>      volumes16;
     std::vector<volume32_type>      volumes32;
     std::vector<transfunc_type>     transfuncs;
+    std::vector<aligned_vector<vec4>> transfunc_luts;
+    transfunc2d_type                transfunc2d;
     depth_buffer_type               depth_buffer;
 
+    // Two channels (value and gradient magnitude) with a single TF
+    // are classified with a 2D TF, as in vvTexRend
+    bool                            use_transfunc2d = false;
+
     bool                            space_skipping = true;
     virvo::SkipTree                 space_skip_tree;
 
     // Internal storage format for textures
     virvo::PixelFormat              texture_format = virvo::PF_R8;
 
+    // Level of the LOD pyramid the volume textures were built from
+    size_t                          lod_level = 0;
+
     void updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer);
+    void uploadVolumeTextures(vvVolDesc* vd, vvRenderer* renderer);
     void updateTransfuncTexture(vvVolDesc* vd, vvRenderer* renderer);
+    void updateTransfunc2DTexture(vvVolDesc* vd, vvRenderer* renderer);
 
     template <typename Volumes>
     void updateVolumeTexturesImpl(vvVolDesc* vd, vvRenderer* renderer, Volumes& volume);
@@ -921,6 +953,16 @@ struct vvRayCaster::Impl
 
 
 void vvRayCaster::Impl::updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer)
+{
+    uploadVolumeTextures(vd, renderer);
+
+    if (space_skipping)
+    {
+        space_skip_tree.updateVolume(*vd);
+    }
+}
+
+void vvRayCaster::Impl::uploadVolumeTextures(vvVolDesc* vd, vvRenderer* renderer)
 {
     if (texture_format == virvo::PF_R8)
     {
@@ -934,27 +976,64 @@ void vvRayCaster::Impl::updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer
     {
         updateVolumeTexturesImpl(vd, renderer, volumes32);
     }
+}
+
+void vvRayCaster::Impl::updateTransfuncTexture(vvVolDesc* vd, vvRenderer* renderer)
+{
+    bool use2d = vd->getChan() == 2 && vd->tf.size() == 1;
+    if (use2d != use_transfunc2d)
+    {
+        // Previous tables are not comparable
+        transfunc_luts.clear();
+        use_transfunc2d = use2d;
+    }
 
-    if (space_skipping)
+    if (use_transfunc2d)
     {
-        space_skip_tree.updateVolume(*vd);
+        updateTransfunc2DTexture(vd, renderer);
+        return;
     }
-}
 
-void vvRayCaster::Impl::updateTransfuncTexture(vvVolDesc* vd, vvRenderer* /*renderer*/)
-{
+    transfunc2d = transfunc2d_type();
+
     transfuncs.resize(vd->tf.size());
+    transfunc_luts.resize(vd->tf.size());
     for (size_t i = 0; i < vd->tf.size(); ++i)
     {
         aligned_vector<vec4> tf(256 * 1 * 1);
         vd->computeTFTexture(i, 256, 1, 1, reinterpret_cast<float*>(tf.data()));
 
-        transfuncs[i] = transfunc_type(tf.size());
-        transfuncs[i].reset(tf.data());
-        transfuncs[i].set_address_mode(Clamp);
-        transfuncs[i].set_filter_mode(Nearest);
+        // Entries that changed since the last update
+        size_t first = 0;
+        size_t last = 0;
+        static_cast<vvRayCaster*>(renderer)->getChangedTFEntries(
+                tf.size(),
+                transfunc_luts[i].size() == tf.size() ? reinterpret_cast<const float*>(transfunc_luts[i].data()) : nullptr,
+                reinterpret_cast<const float*>(tf.data()),
+                first,
+                last
+                );
+
+        if (first < last || transfunc_luts[i].size() != tf.size())
+        {
+            transfuncs[i] = transfunc_type(tf.size());
+            transfuncs[i].reset(tf.data());
+            transfuncs[i].set_address_mode(Clamp);
+            transfuncs[i].set_filter_mode(Nearest);
+        }
 
-        if (space_skipping)
+        if (space_skipping && vd->tf.size() == 1)
+        {
+            // Only rebuilds bricks with voxels in the changed range,
+            // and bricks that were invalidated by updateVolume()
+            space_skip_tree.updateTransfuncRange(
+                    reinterpret_cast<const uint8_t*>(tf.data()),
+                    static_cast<int>(tf.size()),
+                    static_cast<int>(first),
+                    static_cast<int>(last),
+                    virvo::PF_RGBA32F);
+        }
+        else if (space_skipping)
         {
             space_skip_tree.updateTransfunc(
                     reinterpret_cast<const uint8_t*>(tf.data()),
@@ -963,9 +1042,64 @@ void vvRayCaster::Impl::updateTransfuncTexture(vvVolDesc* vd, vvRenderer* /*rend
                     1,
                     virvo::PF_RGBA32F);
         }
+
+        transfunc_luts[i].swap(tf);
     }
 }
 
+void vvRayCaster::Impl::updateTransfunc2DTexture(vvVolDesc* vd, vvRenderer* renderer)
+{
+    const int width = 256;
+    const int height = 256;
+
+    // x: value in the data range, y: gradient magnitude [0..1]
+    aligned_vector<vec4> tf(width * height);
+    vd->computeTFTexture(0, width, height, 1, reinterpret_cast<float*>(tf.data()));
+
+    transfuncs.clear();
+    transfunc2d = transfunc2d_type(width, height);
+    transfunc2d.reset(tf.data());
+    transfunc2d.set_address_mode(Clamp);
+    transfunc2d.set_filter_mode(Nearest);
+
+    if (!space_skipping)
+    {
+        return;
+    }
+
+    // The skip tree classifies the value channel: a voxel is empty if its
+    // value is transparent for all gradient magnitudes
+    aligned_vector<vec4> max_opacity(width, vec4(0.0f));
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            max_opacity[x].w = std::max(max_opacity[x].w, tf[y * width + x].w);
+        }
+    }
+
+    transfunc_luts.resize(1);
+
+    size_t first = 0;
+    size_t last = 0;
+    static_cast<vvRayCaster*>(renderer)->getChangedTFEntries(
+            max_opacity.size(),
+            transfunc_luts[0].size() == max_opacity.size() ? reinterpret_cast<const float*>(transfunc_luts[0].data()) : nullptr,
+            reinterpret_cast<const float*>(max_opacity.data()),
+            first,
+            last
+            );
+
+    space_skip_tree.updateTransfuncRange(
+            reinterpret_cast<const uint8_t*>(max_opacity.data()),
+            static_cast<int>(max_opacity.size()),
+            static_cast<int>(first),
+            static_cast<int>(last),
+            virvo::PF_RGBA32F);
+
+    transfunc_luts[0].swap(max_opacity);
+}
+
 template <typename Volumes>
 void vvRayCaster::Impl::updateVolumeTexturesImpl(vvVolDesc* vd, vvRenderer* renderer, Volumes& volumes)
 {
@@ -976,7 +1110,9 @@ void vvRayCaster::Impl::updateVolumeTexturesImpl(vvVolDesc* vd, vvRenderer* rend
 
     volumes.resize(vd->frames * vd->getChan());
 
-    virvo::TextureUtil tu(vd);
+    virvo::vector<3, ssize_t> vox = vd->getLODVox(lod_level);
+
+    virvo::TextureUtil tu(vd, lod_level);
     for (size_t f = 0; f < vd->frames; ++f)
     {
         for (int c = 0; c < vd->getChan(); ++c)
@@ -986,14 +1122,14 @@ void vvRayCaster::Impl::updateVolumeTexturesImpl(vvVolDesc* vd, vvRenderer* rend
             virvo::TextureUtil::Channels channelbits = 1ULL << c;
 
             tex_data = tu.getTexture(virvo::vec3i(0),
-                virvo::vec3i(vd->vox),
+                virvo::vec3i(vox),
                 texture_format,
                 channelbits,
                 f);
 
             size_t index = f * vd->getChan() + c;
 
-            volumes[index] = Volume(vd->vox[0], vd->vox[1], vd->vox[2]);
+            volumes[index] = Volume(vox[0], vox[1], vox[2]);
             volumes[index].reset(reinterpret_cast<typename Volume::value_type const*>(tex_data));
             volumes[index].set_address_mode(address_mode);
             volumes[index].set_filter_mode(filter_mode);
@@ -1068,6 +1204,17 @@ void vvRayCaster::renderVolumeGL()
     glGetFloatv(GL_PROJECTION_MATRIX, proj_matrix.data());
     glGetIntegerv(GL_VIEWPORT, viewport.data());
 
+    // Switch to another level of the LOD pyramid if the screen-space
+    // footprint or the render time budget requires so
+    size_t lod_level = computeLODLevel();
+    if (lod_level != impl_->lod_level)
+    {
+        impl_->lod_level = lod_level;
+        impl_->uploadVolumeTextures(vd, this);
+    }
+
+    virvo::vector<3, ssize_t> vox = vd->getLODVox(lod_level);
+
     virvo::RenderTarget* rt = getRenderTarget();
 
     assert(rt);
@@ -1081,16 +1228,16 @@ void vvRayCaster::renderVolumeGL()
 
     // determine ray integration step size (aka delta)
     int axis = 0;
-    if (vd->getSize()[1] / vd->vox[1] < vd->getSize()[axis] / vd->vox[axis])
+    if (vd->getSize()[1] / vox[1] < vd->getSize()[axis] / vox[axis])
     {
         axis = 1;
     }
-    if (vd->getSize()[2] / vd->vox[2] < vd->getSize()[axis] / vd->vox[axis])
+    if (vd->getSize()[2] / vox[2] < vd->getSize()[axis] / vox[axis])
     {
         axis = 2;
     }
 
-    float delta = (vd->getSize()[axis] / vd->vox[axis]) / _quality;
+    float delta = (vd->getSize()[axis] / vox[axis]) / _quality;
 
     auto bbox = vd->getBoundingBox();
 
@@ -1356,6 +1503,19 @@ void vvRayCaster::renderVolumeGL()
     };
 #endif
 
+    // Sparse volumes: only march through the region covered by non-empty blocks
+    virvo::aabb roi(virvo::vec3(bbox.min.data()), virvo::vec3(bbox.max.data()));
+
+    if (auto sparse = vd->getSparseFrame(vd->getCurrentFrame()))
+    {
+        auto vb = sparse->getNonEmptyBounds();
+
+        // Voxel y and z axes point opposite to object space y and z
+        virvo::vec3 p0 = vd->objectCoords(vb.min) * virvo::vec3(1.0f, -1.0f, -1.0f) + vd->pos;
+        virvo::vec3 p1 = vd->objectCoords(vb.max) * virvo::vec3(1.0f, -1.0f, -1.0f) + vd->pos;
+        roi = intersect(roi, virvo::aabb(min(p0, p1), max(p0, p1)));
+    }
+
     std::vector<virvo::aabb> boxes;
 
     if (impl_->space_skipping)
@@ -1364,11 +1524,16 @@ void vvRayCaster::renderVolumeGL()
         bool frontToBack = false;
         auto bricks = impl_->space_skip_tree.getSortedBricks(eye, frontToBack);
 
-        boxes.insert(boxes.end(), bricks.begin(), bricks.end());
+        for (auto const& brick : bricks)
+        {
+            virvo::aabb b = intersect(brick, roi);
+            if (b.min.x < b.max.x && b.min.y < b.max.y && b.min.z < b.max.z)
+                boxes.push_back(b);
+        }
     }
-    else
+    else if (roi.min.x < roi.max.x && roi.min.y < roi.max.y && roi.min.z < roi.max.z)
     {
-        boxes.emplace_back(virvo::vec3(bbox.min.data()), virvo::vec3(bbox.max.data()));
+        boxes.push_back(roi);
     }
 
     for (unsigned i = 0; i < boxes.size(); ++i)
@@ -1381,6 +1546,8 @@ void vvRayCaster::renderVolumeGL()
         impl_->params.delta                     = delta;
         impl_->params.num_channels              = vd->getChan();
         impl_->params.transfuncs                = transfuncs_data();
+        impl_->params.transfunc2d               = transfunc2d_type::ref_type(impl_->transfunc2d);
+        impl_->params.use_transfunc2d           = impl_->use_transfunc2d;
         impl_->params.ranges                    = ranges_data();
         impl_->params.depth_buffer              = impl_->depth_buffer.data();
         impl_->params.depth_format              = depth_format;
@@ -1437,6 +1604,8 @@ void vvRayCaster::updateTransferFunction()
 
 void vvRayCaster::updateVolumeData()
 {
+    vvRenderer::updateVolumeData();
+
     impl_->updateVolumeTextures(vd, this);
 }
 
@@ -108,6 +108,8 @@ vvRenderState::vvRenderState()
   , _preIntegration(false)
   , _depthPrecision(8)
   , depth_range_(0.0f, 0.0f)
+  , _lodLevel(0)
+  , _lodBudget(0.0f)
   , _focusClipObj(0)
 {
   // initialize clip objects
@@ -331,6 +333,13 @@ void vvRenderState::setParameter(ParameterType param, const vvParam& value)
     break;
   case VV_PIX_SHADER:
     _currentShader = value;
+    break;
+  case VV_LOD_LEVEL:
+    _lodLevel = value;
+    break;
+  case VV_LOD_BUDGET:
+    _lodBudget = value;
+    break;
   default:
     break;
   }
@@ -479,6 +488,10 @@ vvParam vvRenderState::getParameter(ParameterType param) const
     return _clipOutlines[param - VV_CLIP_OUTLINE0];
   case VV_PIX_SHADER:
     return _currentShader;
+  case VV_LOD_LEVEL:
+    return _lodLevel;
+  case VV_LOD_BUDGET:
+    return _lodBudget;
   default:
     return vvParam();
   }
@@ -558,6 +571,7 @@ void vvRenderer::init()
   _lastRenderTime = 0.0f;
   _lastComputeTime = 0.0f;
   _lastPlaneSortingTime = 0.0f;
+  _lodBias = 0;
   for(int i=0; i<3; ++i)
   {
     _channel4Color[i] = 1.0f;
@@ -689,6 +703,87 @@ void vvRenderer::calcProbeDims(vec3& probePosObj, vec3& probeSizeObj, vec3& prob
   }
 }
 
+//----------------------------------------------------------------------------
+/** Determine the LOD level at which a voxel covers about one pixel on screen.
+  Uses the current OpenGL modelview and projection matrices and viewport.
+  @return 0 if the volume is magnified or if the viewer is inside of it
+*/
+size_t vvRenderer::getFootprintLODLevel() const
+{
+  mat4 mvp = gl::getProjectionMatrix() * gl::getModelviewMatrix();
+  virvo::recti viewport = gl::getViewport();
+
+  aabb bbox = vd->getBoundingBox();
+
+  // Screen-space bounding rectangle of the projected volume bounding box
+  virvo::vec2f smin( std::numeric_limits<float>::max());
+  virvo::vec2f smax(-std::numeric_limits<float>::max());
+  for (int i = 0; i < 8; ++i)
+  {
+    vec4 v((i & 1) ? bbox.max.x : bbox.min.x,
+           (i & 2) ? bbox.max.y : bbox.min.y,
+           (i & 4) ? bbox.max.z : bbox.min.z,
+           1.0f);
+    v = mvp * v;
+
+    // Vertex behind the viewer: footprint is unbounded
+    if (v.w <= 0.0f)
+      return 0;
+
+    virvo::vec2f ndc(v.x / v.w, v.y / v.w);
+    smin = min(smin, ndc);
+    smax = max(smax, ndc);
+  }
+
+  float pixels = std::max((smax.x - smin.x) * 0.5f * viewport[2],
+                          (smax.y - smin.y) * 0.5f * viewport[3]);
+  float voxels = static_cast<float>(ts_max(vd->vox[0], vd->vox[1], vd->vox[2]));
+
+  if (pixels < 1.0f)
+    return vd->getNumLODLevels() - 1;
+
+  size_t level = 0;
+  while (voxels > 2.0f * pixels)
+  {
+    voxels *= 0.5f;
+    ++level;
+  }
+  return level;
+}
+
+//----------------------------------------------------------------------------
+/** Determine the level of the volume's LOD pyramid to render with.
+  The level is either set explicitly with VV_LOD_LEVEL or derived from the
+  screen-space voxel footprint. If a render time budget is set with
+  VV_LOD_BUDGET, coarser levels are used as long as the budget is exceeded;
+  once rendering is fast enough again, the level converges back.
+  Must be called while the OpenGL matrices for the frame are set.
+  @return LOD level, @see vvVolDesc::getLODRaw()
+*/
+size_t vvRenderer::computeLODLevel()
+{
+  size_t numLevels = vd->getNumLODLevels();
+  if (numLevels == 0)
+    return 0;
+
+  size_t level = _lodLevel >= 0 ? size_t(_lodLevel) : getFootprintLODLevel();
+
+  if (_lodBudget > 0.0f)
+  {
+    if (_lastRenderTime > _lodBudget && level + _lodBias + 1 < numLevels)
+      ++_lodBias;
+    else if (_lastRenderTime < 0.5f * _lodBudget && _lodBias > 0)
+      --_lodBias;
+    level += _lodBias;
+  }
+  else
+  {
+    _lodBias = 0;
+  }
+
+  return std::min(level, numLevels - 1);
+}
+
 //----------------------------------------------------------------------------
 /** Destructor, called when program ends or when rendering method changes.
    Clear up all dynamically allocated memory space here.
@@ -848,6 +943,41 @@ void vvRenderer::updateTransferFunction()
   vvDebugMsg::msg(1, "vvRenderer::updateTransferFunction()");
 }
 
+//----------------------------------------------------------------------------
+/** Determine which entries of a 1D RGBA lookup table changed by comparing
+  it with the table of the previous update.
+  @param numEntries number of RGBA entries in the LUT
+  @param prevLUT    LUT from the previous update, NULL if there is none
+  @param lut        new LUT
+  @param first,last changed entries [first,last), empty if nothing changed
+*/
+void vvRenderer::getChangedTFEntries(size_t numEntries, const float* prevLUT, const float* lut,
+                                     size_t& first, size_t& last)
+{
+  vvDebugMsg::msg(3, "vvRenderer::getChangedTFEntries()");
+
+  first = 0;
+  last = numEntries;
+
+  if (prevLUT == NULL)
+  {
+    return;
+  }
+
+  while (first < last && std::equal(lut + first * 4, lut + first * 4 + 4, prevLUT + first * 4))
+  {
+    ++first;
+  }
+  while (last > first && std::equal(lut + last * 4 - 4, lut + last * 4, prevLUT + last * 4 - 4))
+  {
+    --last;
+  }
+  if (first == last)
+  {
+    first = last = 0;
+  }
+}
+
 //----------------------------------------------------------------------------
 /** Update volume data in renderer.
   This function is called when the volume data in vvVolDesc were modified.
@@ -1538,7 +1668,7 @@ float vvRenderer::getAlphaValue(float x, float y, float z)
   vec3f point(x,y,z);                             // point to get alpha value at
   float index;                                    // floating point index value into alpha TF [0..1]
   ssize_t vp[3];                                  // position of nearest voxel to x/y/z [voxel space]
-  uchar* ptr;
+  const uchar* ptr;
 
   vvDebugMsg::msg(3, "vvRenderer::getAlphaValue()");
 
@@ -1557,7 +1687,7 @@ float vvRenderer::getAlphaValue(float x, float y, float z)
 
   vp[1] = vd->vox[1] - vp[1] - 1;
   vp[2] = vd->vox[2] - vp[2] - 1;
-  ptr = vd->getRaw(getCurrentFrame()) + vd->bpc * vd->getChan() * (vp[0] + vp[1] * vd->vox[0] + vp[2] * vd->vox[0] * vd->vox[1]);
+  ptr = vd->getConstRaw(getCurrentFrame()) + vd->bpc * vd->getChan() * (vp[0] + vp[1] * vd->vox[0] + vp[2] * vd->vox[0] * vd->vox[1]);
 
   // Determine index into alpha LUT:
   if (vd->bpc==1) index = float(*ptr) / 255.0f;
@@ -1742,7 +1872,7 @@ bool vvRenderer::beginFrame(unsigned clearMask)
   if (renderTarget_->beginFrame(clearMask))
   {
     renderOpaqueGeometry();
-    if (_fpsDisplay)
+    if (_fpsDisplay || _lodBudget > 0.0f)
     {
       stopwatch_->start();
     }
@@ -1755,7 +1885,7 @@ bool vvRenderer::beginFrame(unsigned clearMask)
 
 bool vvRenderer::endFrame()
 {
-  if (_fpsDisplay)
+  if (_fpsDisplay || _lodBudget > 0.0f)
   {
     _lastRenderTime = stopwatch_->getTime();
   }
@@ -160,7 +160,11 @@ public:
     VV_CLIP_OUTLINE5,
     VV_CLIP_OUTLINE6,
     VV_CLIP_OUTLINE7,
-    VV_CLIP_OUTLINE_LAST
+    VV_CLIP_OUTLINE_LAST,
+
+    VV_LOD_LEVEL,                               ///< level of the volume's LOD pyramid to render (0=full resolution, -1=from screen-space footprint)
+    VV_LOD_BUDGET,                              ///< render time budget [seconds], coarser LOD levels are used while it is exceeded (0=off)
+    VV_AXIS_COPIES                              ///< number of permuted volume copies kept by the shear-warp renderers (1..3)
   };
 
   BOOST_STATIC_ASSERT( VV_CLIP_OBJ_LAST - VV_CLIP_OBJ0 == NUM_CLIP_OBJS );
@@ -223,6 +227,8 @@ protected:
   bool _preIntegration;                         ///< true = try to use pre-integrated rendering (planar 3d textures)
   int _depthPrecision;                          ///< number of bits in depth buffer for image based rendering
   virvo::vec2f depth_range_;
+  int _lodLevel;                                ///< LOD level to render, -1 = choose from screen-space voxel footprint
+  float _lodBudget;                             ///< render time budget for adaptive LOD selection [seconds], 0 = off
 
   boost::shared_ptr<vvClipObj> _clipObjs[NUM_CLIP_OBJS];
   int _focusClipObj;                            ///< clip object that is currently manipulated
@@ -299,6 +305,10 @@ class VIRVOEXPORT vvRenderer : public vvRenderState
                           bool isOrtho = false) const;
     void calcProbeDims(virvo::vec3& probePosObj, virvo::vec3& probeSizeObj,
         virvo::vec3& probeMin, virvo::vec3& probeMax) const;
+    static void getChangedTFEntries(size_t numEntries, const float* prevLUT, const float* lut,
+                                    size_t& first, size_t& last);
+    size_t computeLODLevel();
+    size_t getFootprintLODLevel() const;
 
     // Class Methods:
   public:                                         // public methods will be inherited as public
@@ -413,6 +423,7 @@ private:
     float		_lastComputeTime;
     float		_lastPlaneSortingTime;
     float		_lastGLdrawTime;
+    size_t		_lodBias;                          ///< additional LOD levels to meet the render time budget
 
 };
 
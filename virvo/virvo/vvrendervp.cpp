@@ -49,7 +49,7 @@ vvRenderVP::vvRenderVP(vvVolDesc* vd, vvRenderState st) : vvRenderer(vd, st)
   timing = false;
   current_percentage = 50.0;
   initialize();
-  makeUnclassifiedVolume(vd->getRaw());
+  makeUnclassifiedVolume(const_cast<uchar*>(vd->getConstRaw()));
 
   // Set gradients table:
   for (i=0; i<VP_GRAD_MAX+1; ++i)
@@ -452,7 +452,7 @@ void vvRenderVP::setCurrentFrame(size_t index)
   vd->setCurrentFrame(index);
 
   // Create new classified volume:
-  makeUnclassifiedVolume(vd->getRaw());
+  makeUnclassifiedVolume(const_cast<uchar*>(vd->getConstRaw()));
   classifyVolume();
 }
 
@@ -203,7 +203,7 @@ vvSocket::ErrorType vvSocketIO::putVolume(const vvVolDesc* vd) const
 
     for(size_t k=0; k < frames; k++)
     {
-      const uint8_t *buffer = vd->getRaw(k);
+      const uint8_t *buffer = vd->getConstRaw(k);
       if ((retval =_socket->writeData(buffer, size)) != vvSocket::VV_OK)
       {
         return retval;
@@ -37,6 +37,7 @@ using std::endl;
 #include "vvtoolshed.h"
 
 #include "private/vvgltools.h"
+#include "private/vvwarp.h"
 
 using virvo::mat4;
 using virvo::vec3;
@@ -386,55 +387,18 @@ void vvSoftImg::drawBorder(int r, int g, int b)
 
 //----------------------------------------------------------------------------
 /** Warp the source image to the current image.
+  The warp is done in software on all worker threads, it filters with the
+  warp interpolation mode of the source image (see setWarpInterpolation()).
   @param w        4x4 warp matrix, only 2D components are used
   @param srcImg   source image which is to be warped
 */
 void vvSoftImg::warp(mat4 const& w, vvSoftImg* srcImg)
 {
-   int xs, ys;                                    // source image coordinates
-   int i, j;                                      // counters
-   float xd, yd;                                  // precomputed destination values
-   float pc;                                      // perspective correction
-   float inv00, inv01, inv03;                     // elements of 1st row of inverted warp matrix
-   float inv10, inv11, inv13;                     // elements of 2nd row of inverted warp matrix
-   float inv30, inv31, inv33;                     // elements of 3rd row of inverted warp matrix
-
    vvDebugMsg::msg(3, "vvSoftImg::warp()");
 
-   mat4 inv = inverse(w);                         // inverted warp matrix
-                                                  // invert to compute source coords from destination coords
-
-   inv00 = inv(0, 0);
-   inv01 = inv(0, 1);
-   inv03 = inv(0, 3);
-   inv10 = inv(1, 0);
-   inv11 = inv(1, 1);
-   inv13 = inv(1, 3);
-   inv30 = inv(3, 0);
-   inv31 = inv(3, 1);
-   inv33 = inv(3, 3);
-
-   for (j=0; j<height; ++j)                       // loop thru destination pixels
-   {
-      yd = (float)j;
-      for (i=0; i<width; ++i)
-      {
-         // Compute source coordinates:
-         // pixel' = inv_warp x pixel
-         xd = (float)i;
-         pc = xd * inv30 + yd * inv31 + inv33;
-         xs = (int)((xd * inv00 + yd * inv01 + inv03) / pc);
-         ys = (int)((xd * inv10 + yd * inv11 + inv13) / pc);
-
-         // Check if source pixel is inside source image. If not,
-         // assume a black background.
-         if (xs>srcImg->width-1 || ys>srcImg->height-1 || xs<0 || ys<0)
-            memset(data + PIXEL_SIZE * (i + j * width), '\0', PIXEL_SIZE);
-         else
-            memcpy(data + PIXEL_SIZE * (i + j * width),
-               srcImg->data + PIXEL_SIZE * (xs + ys * srcImg->width), PIXEL_SIZE);
-      }
-   }
+   // Invert to compute source coords from destination coords:
+   virvo::warpImage(data, width, height, srcImg->data, srcImg->width, srcImg->height,
+      inverse(w), srcImg->warpInterpolation);
 }
 
 
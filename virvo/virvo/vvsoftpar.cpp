@@ -50,9 +50,6 @@ vvSoftPar::vvSoftPar(vvVolDesc* vd, vvRenderState rs) : vvSoftVR(vd, rs)
    vvDebugMsg::msg(1, "vvSoftPar::vvSoftPar()");
 
    rendererType = SOFTPAR;
-   bufSlice[0] = bufSlice[1] = NULL;
-   bufSliceLen[0] = bufSliceLen[1] = 0;
-   readSlice = 0;
    wViewDir = vec3(0.0f, 0.0f, 1.0f);
 
    // Provide enough space for all possible shear matrices:
@@ -66,9 +63,6 @@ vvSoftPar::vvSoftPar(vvVolDesc* vd, vvRenderState rs) : vvSoftVR(vd, rs)
 vvSoftPar::~vvSoftPar()
 {
    vvDebugMsg::msg(1, "vvSoftPar::~vvSoftPar()");
-
-   delete[] bufSlice[0];
-   delete[] bufSlice[1];
 }
 
 
@@ -82,51 +76,10 @@ vvSoftPar::~vvSoftPar()
 */
 void vvSoftPar::compositeVolume(int from, int to)
 {
-   int slice;                                     // currently processed slice
-   int firstSlice;                                // first slice to process
-   int lastSlice;                                 // last slice to process
-   int sliceStep;                                 // step size to get to next slice
-
    vvDebugMsg::msg(3, "vvSoftPar::compositeVolume(): ", from, to);
 
    intImg->clear();
 
-   // If stacking==true then draw front to back, else draw back to front:
-   firstSlice = (stacking) ? 0 : (len[2]-1);
-   lastSlice  = (stacking) ? (len[2]-1) : 0;
-   sliceStep  = (stacking) ? 1 : -1;
-
-   earlyRayTermination = 0;
-
-   if (_preIntegration)
-   {
-      if (!sliceBuffer)
-      {
-         // Manage two buffer slices:
-         for (size_t i=0; i<2; ++i)
-         {
-            if (bufSlice[i]==NULL || bufSliceLen[0]!=len[0]-1 || bufSliceLen[1]!=len[1]-1)
-            {
-               delete[] bufSlice[i];
-               bufSlice[i] = new float[(len[0]-1) * (len[1]-1) * vd->getBPV()];
-            }
-         }
-         bufSliceLen[0] = len[0] - 1;
-         bufSliceLen[1] = len[1] - 1;
-      }
-      else
-      {
-         // Manage one buffer slice:
-         if (bufSlice[0]==NULL || bufSliceLen[0]!=intImg->width || bufSliceLen[1]!=intImg->height)
-         {
-            delete[] bufSlice[0];
-            bufSlice[0] = new float[intImg->width * intImg->height * vd->getBPV()];
-         }
-         bufSliceLen[0] = intImg->width;
-         bufSliceLen[1] = intImg->height;
-      }
-   }
-
    if (opCorr)
    {
       // Compute opacity correction table:
@@ -145,20 +98,7 @@ void vvSoftPar::compositeVolume(int from, int to)
       }
    }
 
-   for (slice=firstSlice; slice!=lastSlice; slice += sliceStep)
-   {
-      if (_preIntegration)  compositeSlicePreIntegrated(slice, sliceStep);
-      else if (compression && rleStart[0]!=NULL)
-      {
-         if (sliceInterpol) compositeSliceCompressedBilinear(slice);
-         else               compositeSliceCompressedNearest(slice);
-      }
-      else
-      {
-         if (sliceInterpol) compositeSliceBilinear(slice);
-         else               compositeSliceNearest(slice, from, to);
-      }
-   }
+   compositeBands(from, to);
 
    //  cerr << "Early ray termination: " << earlyRayTermination << " of " << vd->getFrameVoxels() <<
    //    " (" << (100.0f * earlyRayTermination / vd->getFrameVoxels()) << "%)" << endl;
@@ -166,264 +106,121 @@ void vvSoftPar::compositeVolume(int from, int to)
 
 
 //----------------------------------------------------------------------------
-/** Composite the voxels from one slice into the intermediate image using
-  a nearest neighbor resampling algorithm.
-  Naming convention for variables:<BR>
-  i  = intermediate image space (coordinates are: u,v)<BR>
-  v  = voxel data space<P>
-  The compositing formula uses the UNDER operator
-  (see Drebin et.al.: Volume Rendering):<BR>
-  (a UNDER b) = (b OVER a)
-  <PRE>
-    vc = voxel color component [0..1]
-    va = voxel alpha component (0=transparent) [0..1]
-ic = intermediate image color component [0..1]
-ia = invermediate image alpha component (0=transparent) [0..1]
-UNDER operator:
-ic := ia * ic + (1 - ia) * (vc * va)
-ia := ia + va * (1 - ia)
-</PRE>
-@param slice   index of slice to composite [permuted value]
-@param from    first intermediate image line to render (bottom-most line, -1 to render all lines)
-@param to      last intermediate image line to render (top-most line)
+/** Composite all volume slices to the intermediate image lines of one band.
+  Called concurrently for disjoint bands by compositeBands().
+  @param band intermediate image lines to render
 */
-void vvSoftPar::compositeSliceNearest(int slice, int from, int to)
+void vvSoftPar::compositeBand(Band& band)
 {
-   vec3 vStart;                                   // bottom left voxel of this slice
-   int    iPosX, iPosY;                           // current intermediate image coordinates (Y=0 is bottom)
-   int    ix,iy;                                  // counters [intermediate image space]
-   uchar* vScalar;                                // pointer to scalar voxel data corresponding to current image pixel
-   uchar* iPixel;                                 // pointer to current intermediate image pixel
-   int    iLineOffset;                            // offset to next line on intermediate image
-   float  vr,vg,vb,va;                            // RGBA components of current voxel
-   float  ir,ig,ib,ia;                            // RGBA components of current image pixel
-   int    iSlice[2];                              // slice dimensions in intermediate image (x,y)
-   float  tmp;
+   int slice;                                     // currently processed slice
+   int firstSlice;                                // first slice to process
+   int lastSlice;                                 // last slice to process
+   int sliceStep;                                 // step size to get to next slice
 
-   findSlicePosition(slice, &vStart, NULL);
-   iPosX     = vvToolshed::round(vStart[0]);      // use nearest intermediate image column
-   iPosY     = vvToolshed::round(vStart[1]);      // use nearest intermediate image line
-   iSlice[0] = len[0];
-   iSlice[1] = len[1];
-   iLineOffset = intImg->PIXEL_SIZE * (intImg->width - iSlice[0]);
-   vScalar = raw[principal] + vd->getBPV() * (slice * len[0] * len[1] + (len[1] - 1) * len[0]);
+   // If stacking==true then draw front to back, else draw back to front:
+   firstSlice = (stacking) ? 0 : (len[2]-1);
+   lastSlice  = (stacking) ? (len[2]-1) : 0;
+   sliceStep  = (stacking) ? 1 : -1;
 
-   if (from != -1)                                // render only specific lines?
+   if (_preIntegration)
    {
-      int iTopLine;                               // topmost intermediate image line
-
-      iTopLine = iPosY + iSlice[1] - 1;
-      if (to < iPosY || from > iTopLine) return;  // return if section to render is outside of slice area
-
-      // Constrain section indices:
-      if (from < iPosY) from = iPosY;
-      if (to > iTopLine) to = iTopLine;
-
-      // Modify first voxel to draw:
-      vScalar -= (from - iPosY) * len[0] * vd->getBPV();
-
-      // Modify first pixel to draw:
-      iPosY = from;
-
-      // Modify number of lines to draw:
-      iSlice[1] = to - from + 1;
+      band.readSlice = 0;
+      if (!sliceBuffer)
+      {
+         // Two buffer slices in voxel coordinates:
+         band.bufSlice[0].resize((len[0]-1) * (len[1]-1));
+         band.bufSlice[1].resize((len[0]-1) * (len[1]-1));
+         band.bufOffset = 0;
+      }
+      else
+      {
+         // One buffer slice in intermediate image coordinates, covering
+         // the band and one line on either side of it:
+         band.bufSlice[0].resize(intImg->width * (band.to - band.from + 3));
+         band.bufOffset = band.from - 1;
+      }
    }
 
-   iPixel  = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
-
-   // Traverse intermediate image pixels which correspond to the current slice.
-   // 1 is subtracted from each loop counter to remain inside of the volume boundaries:
-   for (iy=0; iy<iSlice[1]; ++iy)
+   // The kernel is chosen once, so the inner loops do not test the render state:
+   const SliceKernel kernel = findSliceKernel();
+   for (slice=firstSlice; slice!=lastSlice; slice += sliceStep)
    {
-      for (ix=0; ix<iSlice[0]; ++ix)
-      {
-         if (rgbaConv[*vScalar][3]==0) ++earlyRayTermination;
-         if (rgbaConv[*vScalar][3]>0 &&           // skip transparent voxels
-                                                  // skip clipped voxels
-            (!getParameter(VV_CLIP_MODE) || !isVoxelClipped(ix, iSlice[1]-iy-1, slice)))
-         {
-            // Determine image color components and scale to [0..1]:
-            ir = (float)(*(iPixel++)) / 255.0f;
-            ig = (float)(*(iPixel++)) / 255.0f;
-            ib = (float)(*(iPixel++)) / 255.0f;
-            ia = (float)(*(iPixel++)) / 255.0f;
-
-            if (ia < 1.0f)                        // skip opaque intermediate image pixels
-            {
-               // Determine voxel color components and scale to [0..1]:
-               vr = (float)rgbaConv[*vScalar][0] / 255.0f;
-               vg = (float)rgbaConv[*vScalar][1] / 255.0f;
-               vb = (float)rgbaConv[*vScalar][2] / 255.0f;
-               va = (float)rgbaConv[*vScalar][3] / 255.0f;
-               iPixel -= vvSoftImg::PIXEL_SIZE;   // start over with intermediate image components
-
-               // Accumulate new intermediate image pixel values.
-               *(iPixel++) = (uchar)((tmp = (255.0f * (ir + (1.0f - ia) * vr * va))) < 255.0f ? tmp : 255.0f);
-               *(iPixel++) = (uchar)((tmp = (255.0f * (ig + (1.0f - ia) * vg * va))) < 255.0f ? tmp : 255.0f);
-               *(iPixel++) = (uchar)((tmp = (255.0f * (ib + (1.0f - ia) * vb * va))) < 255.0f ? tmp : 255.0f);
-               *(iPixel++) = (uchar)((tmp = (255.0f * (ia + (1.0f - ia) * va))) < 255.0f ? tmp : 255.0f);
-            }
-         }
-         else iPixel += vvSoftImg::PIXEL_SIZE;
-
-         // Switch to next voxel:
-         vScalar += vd->getBPV();
-      }
-      vScalar -= (2 * len[0]) * vd->getBPV();
-      iPixel += iLineOffset;
+      (this->*kernel)(slice, sliceStep, band);
    }
 }
 
 
 //----------------------------------------------------------------------------
-/** Composite a slice to the intermediate image using bilinear interpolation.
-  @param slice slice number to composite
+/** Select the compositing kernel which is specialized for the voxel data
+  type and the current interpolation, pre-integration, clipping and opacity
+  correction settings.
+  @return pointer to the slice compositing function
 */
-void vvSoftPar::compositeSliceBilinear(int slice)
+vvSoftPar::SliceKernel vvSoftPar::findSliceKernel() const
 {
-   vec3 vStart;                                   // bottom left voxel of this slice
-   int    iPosX, iPosY;                           // current intermediate image coordinates (Y=0 is bottom)
-   int    ix,iy;                                  // counters [intermediate image space]
-   uchar* vScalar[4];                             // ptr to scalar data: 0=bot.left, 1=top left, 2=top right, 3=bot.right
-   uchar* iPixel;                                 // pointer to current intermediate image pixel
-   int    iLineOffset;                            // offset to next line on intermediate image
-   int    vLineOffset;                            // offset to next line in volume
-   float  vr,vg,vb,va;                            // RGBA components of current voxel
-   float  ir,ig,ib,ia;                            // RGBA components of current image pixel
-   int    iSlice[2];                              // slice dimensions in intermediate image (x,y)
-   float  frac[2];                                // fractions for resampling (x,y)
-   float  weight[4];                              // resampling weights, one for each of the four neighboring voxels (for indices see vScalar[])
-   float  tmp;
-   int    i;
-   const bool postClassification = false;
-
-   findSlicePosition(slice, &vStart, NULL);
-   iPosX     = int(vStart[0]) + 1;                // use intermediate image column right of bottom left voxel location
-   iPosY     = int(vStart[1]) + 1;                // use intermediate image line top of bottom left voxel location
-   vScalar[0]= raw[principal] + vd->getBPV() * (slice * len[0] * len[1] + (len[1] - 1) * len[0]);
-   vScalar[1]= vScalar[0] - vd->getBPV() * len[0];
-   vScalar[2]= vScalar[1] + vd->getBPV();
-   vScalar[3]= vScalar[0] + vd->getBPV();
-   iPixel    = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
-   iSlice[0] = len[0];
-   iSlice[1] = len[1];
-   iLineOffset = intImg->PIXEL_SIZE * (intImg->width - iSlice[0] + 1);
-   vLineOffset = (2 * len[0] - 1) * (int)vd->getBPV();
-   frac[0]   = (float)iPosX - vStart[0];
-   frac[1]   = (float)iPosY - vStart[1];
+   return (rawBPV == 1) ? findSliceKernel<uchar>() : findSliceKernel<uint16_t>();
+}
 
-   // Compute bilinear resampling weights:
-   weight[0] = (1.0f - frac[0]) * (1.0f - frac[1]);
-   weight[1] = (1.0f - frac[0]) * frac[1];
-   weight[2] = frac[0] * frac[1];
-   weight[3] = frac[0] * (1.0f - frac[1]);
 
-   // Traverse intermediate image pixels which correspond to the current slice.
-   // 1 is subtracted from each loop counter to remain inside of the volume boundaries:
-   for (iy=0; iy<iSlice[1]-1; ++iy)
+//----------------------------------------------------------------------------
+/** Select the compositing kernel for voxels of type Voxel.
+  @return pointer to the slice compositing function
+*/
+template <typename Voxel>
+vvSoftPar::SliceKernel vvSoftPar::findSliceKernel() const
+{
+   static const SliceKernel preIntegrated[8] =
    {
-      for (ix=0; ix<iSlice[0]-1; ++ix)
-      {
-                                                  // skip clipped voxels
-         if (!getParameter(VV_CLIP_MODE) || !isVoxelClipped(ix, iSlice[1]-iy-1, slice))
-         {
-                                                  // skip transparent voxels
-            if (rgbaConv[*vScalar[0]][3]>0 || rgbaConv[*vScalar[1]][3]>0 ||
-               rgbaConv[*vScalar[2]][3]>0 || rgbaConv[*vScalar[3]][3]>0)
-            {
-               // Determine image color components and scale to [0..1]:
-               ir = (float)(*(iPixel++)) / 255.0f;
-               ig = (float)(*(iPixel++)) / 255.0f;
-               ib = (float)(*(iPixel++)) / 255.0f;
-               ia = (float)(*(iPixel++)) / 255.0f;
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, false, false, false>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, false, false, true>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, false, true, false>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, false, true, true>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, true, false, false>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, true, false, true>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, true, true, false>,
+      &vvSoftPar::compositeSlicePreIntegrated<Voxel, true, true, true>
+   };
+   static const SliceKernel bilinear[4] =
+   {
+      &vvSoftPar::compositeSliceBilinear<Voxel, false, false>,
+      &vvSoftPar::compositeSliceBilinear<Voxel, false, true>,
+      &vvSoftPar::compositeSliceBilinear<Voxel, true, false>,
+      &vvSoftPar::compositeSliceBilinear<Voxel, true, true>
+   };
+   static const SliceKernel nearest[4] =
+   {
+      &vvSoftPar::compositeSliceNearest<Voxel, false, false>,
+      &vvSoftPar::compositeSliceNearest<Voxel, false, true>,
+      &vvSoftPar::compositeSliceNearest<Voxel, true, false>,
+      &vvSoftPar::compositeSliceNearest<Voxel, true, true>
+   };
 
-               if (ia>=1.0f) ++earlyRayTermination;
-               if (ia < 1.0f)                     // skip opaque intermediate image pixels
-               {
-                  if(postClassification)
-                  {
-                     // Determine interpolated voxel value:
-                     uchar v = static_cast<uchar>(*vScalar[0] * weight[0]
-                        + *vScalar[1] * weight[1]
-                        + *vScalar[2] * weight[2]
-                        + *vScalar[3] * weight[3]);
-                     va = rgbaConv[v][3] / 255.0f;
-                     if (va>0.0f)                    // skip transparent voxels (yes, do it again!)
-                     {
-                        vr = rgbaConv[v][0] / 255.0f;
-                        vg = rgbaConv[v][1] / 255.0f;
-                        vb = rgbaConv[v][2] / 255.0f;
-                        // start over with intermediate image components
-                        iPixel -= vvSoftImg::PIXEL_SIZE;
-
-                        // Accumulate new intermediate image pixel values.
-                        *(iPixel++) = (uchar)((tmp = (255.0f * (ir + (1.0f - ia) * vr * va))) < 255.0f ? tmp : 255.0f);
-                        *(iPixel++) = (uchar)((tmp = (255.0f * (ig + (1.0f - ia) * vg * va))) < 255.0f ? tmp : 255.0f);
-                        *(iPixel++) = (uchar)((tmp = (255.0f * (ib + (1.0f - ia) * vb * va))) < 255.0f ? tmp : 255.0f);
-                        *(iPixel++) = (uchar)((tmp = (255.0f * (ia + (1.0f - ia) * va))) < 255.0f ? tmp : 255.0f);
-                     }
-                  }
-                  else
-                  {
-                  // Determine interpolated voxel color components and scale to [0..1]:
-                  va = ((float)rgbaConv[*vScalar[0]][3] * weight[0] +
-                     (float)rgbaConv[*vScalar[1]][3] * weight[1] +
-                     (float)rgbaConv[*vScalar[2]][3] * weight[2] +
-                     (float)rgbaConv[*vScalar[3]][3] * weight[3]) / 255.0f;
-                  if (va>0.0f)                    // skip transparent voxels (yes, do it again!)
-                  {
-                     vr = ((float)rgbaConv[*vScalar[0]][0] * weight[0] +
-                        (float)rgbaConv[*vScalar[1]][0] * weight[1] +
-                        (float)rgbaConv[*vScalar[2]][0] * weight[2] +
-                        (float)rgbaConv[*vScalar[3]][0] * weight[3]) / 255.0f;
-                     vg = ((float)rgbaConv[*vScalar[0]][1] * weight[0] +
-                        (float)rgbaConv[*vScalar[1]][1] * weight[1] +
-                        (float)rgbaConv[*vScalar[2]][1] * weight[2] +
-                        (float)rgbaConv[*vScalar[3]][1] * weight[3]) / 255.0f;
-                     vb = ((float)rgbaConv[*vScalar[0]][2] * weight[0] +
-                        (float)rgbaConv[*vScalar[1]][2] * weight[1] +
-                        (float)rgbaConv[*vScalar[2]][2] * weight[2] +
-                        (float)rgbaConv[*vScalar[3]][2] * weight[3]) / 255.0f;
-
-                                                  // start over with intermediate image components
-                     iPixel -= vvSoftImg::PIXEL_SIZE;
+   if (_preIntegration)
+   {
+      return preIntegrated[(sliceInterpol ? 4 : 0) + (bilinLookup ? 2 : 0) + (opCorr ? 1 : 0)];
+   }
+   const int index = (clipping ? 2 : 0) + (opCorr ? 1 : 0);
+   return (sliceInterpol) ? bilinear[index] : nearest[index];
+}
 
-                     // Accumulate new intermediate image pixel values.
-                     /*
-                      *(iPixel++) = (uchar)(255.0f * (ia * ir + (1.0f - ia) * vr));
-                      *(iPixel++) = (uchar)(255.0f * (ia * ig + (1.0f - ia) * vg));
-                      *(iPixel++) = (uchar)(255.0f * (ia * ib + (1.0f - ia) * vb));
-                      *(iPixel++) = (uchar)(255.0f * (ia + va * (1.0f - ia)));
-                      */
-                     *(iPixel++) = (uchar)((tmp = (255.0f * (ir + (1.0f - ia) * vr * va))) < 255.0f ? tmp : 255.0f);
-                     *(iPixel++) = (uchar)((tmp = (255.0f * (ig + (1.0f - ia) * vg * va))) < 255.0f ? tmp : 255.0f);
-                     *(iPixel++) = (uchar)((tmp = (255.0f * (ib + (1.0f - ia) * vb * va))) < 255.0f ? tmp : 255.0f);
-                     *(iPixel++) = (uchar)((tmp = (255.0f * (ia + (1.0f - ia) * va))) < 255.0f ? tmp : 255.0f);
-                  }
-                  }
-               }
-            }
-            else iPixel += vvSoftImg::PIXEL_SIZE;
-         }
-         else iPixel += vvSoftImg::PIXEL_SIZE;
 
-         // Switch to next voxel:
-         vScalar[0] = vScalar[3];
-         vScalar[1] = vScalar[2];
-         vScalar[2] += vd->getBPV();
-         vScalar[3] += vd->getBPV();
-      }
-      for (i=0; i<4; ++i)
-         vScalar[i] -= vLineOffset;
-      iPixel += iLineOffset;
-   }
+//----------------------------------------------------------------------------
+/** Correct a voxel opacity for the distance between two slices along
+  the viewing ray. compositeVolume() computes the correction table.
+  @param va voxel opacity for unit distance [0..1]
+  @return corrected opacity [0..1]
+*/
+float vvSoftPar::correctOpacity(float va) const
+{
+   return opacityCorr[ts_min(int(va * VV_OP_CORR_TABLE_SIZE), VV_OP_CORR_TABLE_SIZE - 1)] / 256.0f;
 }
 
 
 //----------------------------------------------------------------------------
 /** Composite the voxels from one slice into the intermediate image using
-  compressed volume data and nearest neighbor resampling.<BR>
-  Note: This rendering algorithm does not support clipping planes!<BR>
+  a nearest neighbor resampling algorithm.
+  Only the non-transparent voxel runs found by findVoxelRuns() are
+  traversed, and pixels which are already opaque are skipped.
   Naming convention for variables:<BR>
   i  = intermediate image space (coordinates are: u,v)<BR>
   v  = voxel data space<P>
@@ -432,157 +229,126 @@ void vvSoftPar::compositeSliceBilinear(int slice)
   (a UNDER b) = (b OVER a)
   <PRE>
     vc = voxel color component [0..1]
-va = voxel alpha component (0=transparent) [0..1]
+    va = voxel alpha component (0=transparent) [0..1]
 ic = intermediate image color component [0..1]
 ia = invermediate image alpha component (0=transparent) [0..1]
 UNDER operator:
 ic := ia * ic + (1 - ia) * (vc * va)
 ia := ia + va * (1 - ia)
 </PRE>
+Voxel, Clip and OpacityCorr select the kernel variant, see findSliceKernel().
 @param slice   index of slice to composite [permuted value]
+@param band    intermediate image lines to render
 */
-void vvSoftPar::compositeSliceCompressedNearest(int slice)
+template <typename Voxel, bool Clip, bool OpacityCorr>
+void vvSoftPar::compositeSliceNearest(int slice, int, Band& band)
 {
    vec3 vStart;                                   // bottom left voxel of this slice
    int    iPosX, iPosY;                           // current intermediate image coordinates (Y=0 is bottom)
-   int    ix,iy,i;                                // counters [intermediate image space]
-   uchar* vScalar;                                // pointer to scalar voxel data corresponding to current image pixel
+   int    ix,iy;                                  // counters [intermediate image space]
+   int    vLine;                                  // voxel line of the current image line
+   const Voxel* vLineStart;                       // pointer to first voxel of the current line
+   const float* vRGBA;                            // RGBA components of current voxel [0..1]
    uchar* iPixel;                                 // pointer to current intermediate image pixel
-   int    iLineOffset;                            // offset to next line on intermediate image
-   float  vr,vg,vb,va;                            // RGBA components of current voxel
-   float  ir,ig,ib,ia;                            // RGBA components of current image pixel
+   int    iLineStart;                             // index of the intermediate image pixel of the first voxel of the current line
+   int    pixel, end;                             // current and last+1 intermediate image pixel of a run
+   float  va;                                     // opacity of current voxel
    int    iSlice[2];                              // slice dimensions in intermediate image (x,y)
-   int    count;
+   int    iyFirst, iyLast;                        // slice lines inside of the band
+   size_t r;
+
+   // Values which are constant for the whole slice:
+   const Voxel* const vSlice = reinterpret_cast<const Voxel*>(raw) + slice * len[0] * len[1];
+   uchar* const iData = intImg->data;
+   const int iWidth = intImg->width;
 
    findSlicePosition(slice, &vStart, NULL);
    iPosX     = vvToolshed::round(vStart[0]);      // use nearest intermediate image column
    iPosY     = vvToolshed::round(vStart[1]);      // use nearest intermediate image line
-   iPixel    = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
    iSlice[0] = len[0];
    iSlice[1] = len[1];
-   iLineOffset = intImg->PIXEL_SIZE * (intImg->width - iSlice[0]);
 
-   // Traverse intermediate image pixels which correspond to the current slice.
-   // 1 is subtracted from each loop counter to remain inside of the volume boundaries:
-   for (iy=0; iy<iSlice[1]; ++iy)
+   // Constrain slice lines to the band:
+   iyFirst = ts_max(0, band.from - iPosY);
+   iyLast  = ts_min(iSlice[1], band.to - iPosY + 1);
+
+   // Traverse intermediate image pixels which correspond to the current slice:
+   for (iy=iyFirst; iy<iyLast; ++iy)
    {
-      ix = 0;                                     // start with first pixel in row
-      vScalar = rleStart[principal][slice * len[1] + (len[1] - 1 - iy)];
+      vLine      = len[1] - 1 - iy;
+      vLineStart = vSlice + vLine * len[0];
+      iLineStart = iPosX + (iPosY + iy) * iWidth;
 
-      while (ix<iSlice[0])
+      findVoxelRuns(slice, vLine, vLine, 0, band);
+      for (r=0; r<band.runs.size(); r+=2)
       {
-         count = (int)*vScalar++;
-         if (count > 127)                         // replicate run?
+         end = iLineStart + band.runs[r + 1];
+         for (pixel = skipOpaquePixels(iLineStart + band.runs[r], end, band); pixel < end;
+              pixel = skipOpaquePixels(pixel + 1, end, band))
          {
-            count -= 127;                         // remove bias
-            if (rgbaConv[*vScalar][3] > 0)        // skip transparent voxels
-            {
-               // Determine voxel color components and scale to [0..1]:
-               vr = (float)rgbaConv[*vScalar][0] / 255.0f;
-               vg = (float)rgbaConv[*vScalar][1] / 255.0f;
-               vb = (float)rgbaConv[*vScalar][2] / 255.0f;
-               va = (float)rgbaConv[*vScalar][3] / 255.0f;
-
-               for (i=0; i<count; ++i)
-               {
-                  // Determine image color components and scale to [0..1]:
-                  ir = (float)(*(iPixel++)) / 255.0f;
-                  ig = (float)(*(iPixel++)) / 255.0f;
-                  ib = (float)(*(iPixel++)) / 255.0f;
-                  ia = (float)(*(iPixel++)) / 255.0f;
+            ix    = pixel - iLineStart;
+            vRGBA = rgbaFloat[vLineStart[ix]];
+            if (vRGBA[3]<=0.0f) continue;         // skip transparent voxels
+            if (Clip && isVoxelClipped(ix, vLine, slice)) continue;
 
-                  if (ia < 1.0f)                  // skip opaque intermediate image pixels
-                  {
-                                                  // start over with intermediate image components
-                     iPixel -= vvSoftImg::PIXEL_SIZE;
+            iPixel = iData + vvSoftImg::PIXEL_SIZE * pixel;
+            if (iPixel[3]==255) continue;         // skip opaque intermediate image pixels
 
-                     // Accumulate new intermediate image pixel values.
-                     *(iPixel++) = (uchar)(255.0f * (ia * ir + (1.0f - ia) * vr));
-                     *(iPixel++) = (uchar)(255.0f * (ia * ig + (1.0f - ia) * vg));
-                     *(iPixel++) = (uchar)(255.0f * (ia * ib + (1.0f - ia) * vb));
-                     *(iPixel++) = (uchar)(255.0f * (ia + va * (1.0f - ia)));
-                  }
-               }
-            }
-            else iPixel += count * vvSoftImg::PIXEL_SIZE;
-            ++vScalar;
+            va = (OpacityCorr) ? correctOpacity(vRGBA[3]) : vRGBA[3];
+            compositeUnder(iPixel, vRGBA, va);
+            if (iPixel[3]==255) markOpaque(pixel);
          }
-         else                                     // literal run
-         {
-            ++count;                              // remove bias
-            for (i=0; i<count; ++i)
-            {
-               if (rgbaConv[*vScalar][3]>0)       // skip transparent voxels
-               {
-                  // Determine image color components and scale to [0..1]:
-                  ir = (float)(*(iPixel++)) / 255.0f;
-                  ig = (float)(*(iPixel++)) / 255.0f;
-                  ib = (float)(*(iPixel++)) / 255.0f;
-                  ia = (float)(*(iPixel++)) / 255.0f;
-
-                  if (ia < 1.0f)                  // skip opaque intermediate image pixels
-                  {
-                     // Determine voxel color components and scale to [0..1]:
-                     vr = (float)rgbaConv[*vScalar][0] / 255.0f;
-                     vg = (float)rgbaConv[*vScalar][1] / 255.0f;
-                     vb = (float)rgbaConv[*vScalar][2] / 255.0f;
-                     va = (float)rgbaConv[*vScalar][3] / 255.0f;
-
-                                                  // start over with intermediate image components
-                     iPixel -= vvSoftImg::PIXEL_SIZE;
-
-                     // Accumulate new intermediate image pixel values.
-                     *(iPixel++) = (uchar)(255.0f * (ia * ir + (1.0f - ia) * vr));
-                     *(iPixel++) = (uchar)(255.0f * (ia * ig + (1.0f - ia) * vg));
-                     *(iPixel++) = (uchar)(255.0f * (ia * ib + (1.0f - ia) * vb));
-                     *(iPixel++) = (uchar)(255.0f * (ia + va * (1.0f - ia)));
-                  }
-               }
-               else iPixel += vvSoftImg::PIXEL_SIZE;
-
-               // Switch to next voxel:
-               ++vScalar;
-            }
-         }
-         ix += count;
       }
-      iPixel += iLineOffset;
    }
 }
 
 
 //----------------------------------------------------------------------------
-/** Composite a slice to the intermediate image using bilinear interpolation
-    and RLE compression.
+/** Composite a slice to the intermediate image using bilinear interpolation.
+  Only pixels next to non-transparent voxel runs are traversed, and pixels
+  which are already opaque are skipped.
+  Voxel, Clip and OpacityCorr select the kernel variant, see findSliceKernel().
   @param slice slice number to composite
+  @param band  intermediate image lines to render
 */
-void vvSoftPar::compositeSliceCompressedBilinear(int slice)
+template <typename Voxel, bool Clip, bool OpacityCorr>
+void vvSoftPar::compositeSliceBilinear(int slice, int, Band& band)
 {
    vec3 vStart;                                   // bottom left voxel of this slice
    int    iPosX, iPosY;                           // current intermediate image coordinates (Y=0 is bottom)
    int    ix,iy;                                  // counters [intermediate image space]
-   uchar* vScalar[4];                             // ptr to scalar data: 0=bot.left, 1=top left, 2=top right, 3=bot.right
+   int    vLine;                                  // voxel line of vScalar[0]
+   const Voxel* vLineStart;                       // pointer to first voxel of line vLine
+   const float* vRGBA[4];                         // RGBA of the neighboring voxels: 0=bot.left, 1=top left, 2=top right, 3=bot.right
    uchar* iPixel;                                 // pointer to current intermediate image pixel
-   int    iLineOffset;                            // offset to next line on intermediate image
-   int    vLineOffset;                            // offset to next line in volume
-   float  vr,vg,vb,va;                            // RGBA components of current voxel
-   float  ir,ig,ib,ia;                            // RGBA components of current image pixel
+   int    iLineStart;                             // index of the intermediate image pixel of the first voxel of the current line
+   int    pixel, end;                             // current and last+1 intermediate image pixel of a run
+   float  v[4];                                   // interpolated RGBA components of current voxel [0..1]
+   float  va;                                     // opacity of current voxel
    int    iSlice[2];                              // slice dimensions in intermediate image (x,y)
    float  frac[2];                                // fractions for resampling (x,y)
-   float  weight[4];                              // resampling weights, one for each of the four neighboring voxels (for indices see vScalar[])
-   int    i;
+   float  weight[4];                              // resampling weights, one for each of the four neighboring voxels (for indices see vRGBA[])
+   int    iyFirst, iyLast;                        // slice lines inside of the band
+   size_t r;
+   int    c;
+
+   // Values which are constant for the whole slice:
+   const Voxel* const vSlice = reinterpret_cast<const Voxel*>(raw) + slice * len[0] * len[1];
+   uchar* const iData = intImg->data;
+   const int iWidth = intImg->width;
 
    findSlicePosition(slice, &vStart, NULL);
    iPosX     = int(vStart[0]) + 1;                // use intermediate image column right of bottom left voxel location
    iPosY     = int(vStart[1]) + 1;                // use intermediate image line top of bottom left voxel location
-   iPixel    = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
    iSlice[0] = len[0];
    iSlice[1] = len[1];
-   iLineOffset = intImg->PIXEL_SIZE * (intImg->width - iSlice[0] + 1);
-   vLineOffset = (2 * len[0] - 1) * (int)vd->getBPV();
    frac[0]   = (float)iPosX - vStart[0];
    frac[1]   = (float)iPosY - vStart[1];
 
+   // Constrain slice lines to the band:
+   iyFirst = ts_max(0, band.from - iPosY);
+   iyLast  = ts_min(iSlice[1] - 1, band.to - iPosY + 1);
+
    // Compute bilinear resampling weights:
    weight[0] = (1.0f - frac[0]) * (1.0f - frac[1]);
    weight[1] = (1.0f - frac[0]) * frac[1];
@@ -591,70 +357,48 @@ void vvSoftPar::compositeSliceCompressedBilinear(int slice)
 
    // Traverse intermediate image pixels which correspond to the current slice.
    // 1 is subtracted from each loop counter to remain inside of the volume boundaries:
-   for (iy=0; iy<iSlice[1]-1; ++iy)
+   for (iy=iyFirst; iy<iyLast; ++iy)
    {
-      vScalar[0]= rleStart[principal][slice * len[1] + (len[1] - 1 - iy)];
-      vScalar[1]= vScalar[0] - len[0];
-      vScalar[2]= vScalar[1] + 1;
-      vScalar[3]= vScalar[0] + 1;
+      vLine      = len[1] - 1 - iy;
+      vLineStart = vSlice + vLine * len[0];
+      iLineStart = iPosX + (iPosY + iy) * iWidth;
 
-      for (ix=0; ix<iSlice[0]-1; ++ix)
+      // A pixel depends on two voxels of this and the next line:
+      findVoxelRuns(slice, vLine - 1, vLine, 1, band);
+      for (r=0; r<band.runs.size(); r+=2)
       {
-                                                  // skip clipped voxels
-         if (!getParameter(VV_CLIP_MODE) || !isVoxelClipped(ix, iSlice[1]-iy-1, slice))
+         end = iLineStart + ts_min(band.runs[r + 1], iSlice[0] - 1);
+         for (pixel = skipOpaquePixels(iLineStart + band.runs[r], end, band); pixel < end;
+              pixel = skipOpaquePixels(pixel + 1, end, band))
          {
+            ix = pixel - iLineStart;
+            if (Clip && isVoxelClipped(ix, vLine, slice)) continue;
+
+            vRGBA[0] = rgbaFloat[vLineStart[ix]];
+            vRGBA[1] = rgbaFloat[vLineStart[ix - len[0]]];
+            vRGBA[2] = rgbaFloat[vLineStart[ix - len[0] + 1]];
+            vRGBA[3] = rgbaFloat[vLineStart[ix + 1]];
+
                                                   // skip transparent voxels
-            if (rgbaConv[*vScalar[0]][3]>0 || rgbaConv[*vScalar[1]][3]>0 ||
-               rgbaConv[*vScalar[2]][3]>0 || rgbaConv[*vScalar[3]][3]>0)
-            {
-               // Determine image color components and scale to [0..1]:
-               ir = (float)(*(iPixel++)) / 255.0f;
-               ig = (float)(*(iPixel++)) / 255.0f;
-               ib = (float)(*(iPixel++)) / 255.0f;
-               ia = (float)(*(iPixel++)) / 255.0f;
+            if (vRGBA[0][3]<=0.0f && vRGBA[1][3]<=0.0f && vRGBA[2][3]<=0.0f && vRGBA[3][3]<=0.0f)
+               continue;
 
-               if (ia < 1.0f)                     // skip opaque intermediate image pixels
-               {
-                  // Determine interpolated voxel color components and scale to [0..1]:
-                  vr = ((float)rgbaConv[*vScalar[0]][0] * weight[0] +
-                     (float)rgbaConv[*vScalar[1]][0] * weight[1] +
-                     (float)rgbaConv[*vScalar[2]][0] * weight[2] +
-                     (float)rgbaConv[*vScalar[3]][0] * weight[3]) / 255.0f;
-                  vg = ((float)rgbaConv[*vScalar[0]][1] * weight[0] +
-                     (float)rgbaConv[*vScalar[1]][1] * weight[1] +
-                     (float)rgbaConv[*vScalar[2]][1] * weight[2] +
-                     (float)rgbaConv[*vScalar[3]][1] * weight[3]) / 255.0f;
-                  vb = ((float)rgbaConv[*vScalar[0]][2] * weight[0] +
-                     (float)rgbaConv[*vScalar[1]][2] * weight[1] +
-                     (float)rgbaConv[*vScalar[2]][2] * weight[2] +
-                     (float)rgbaConv[*vScalar[3]][2] * weight[3]) / 255.0f;
-                  va = ((float)rgbaConv[*vScalar[0]][3] * weight[0] +
-                     (float)rgbaConv[*vScalar[1]][3] * weight[1] +
-                     (float)rgbaConv[*vScalar[2]][3] * weight[2] +
-                     (float)rgbaConv[*vScalar[3]][3] * weight[3]) / 255.0f;
-
-                  iPixel -= vvSoftImg::PIXEL_SIZE;// start over with intermediate image components
-
-                  // Accumulate new intermediate image pixel values.
-                  *(iPixel++) = (uchar)(255.0f * (ia * ir + (1.0f - ia) * vr));
-                  *(iPixel++) = (uchar)(255.0f * (ia * ig + (1.0f - ia) * vg));
-                  *(iPixel++) = (uchar)(255.0f * (ia * ib + (1.0f - ia) * vb));
-                  *(iPixel++) = (uchar)(255.0f * (ia + va * (1.0f - ia)));
-               }
+            iPixel = iData + vvSoftImg::PIXEL_SIZE * pixel;
+            if (iPixel[3]==255) continue;         // skip opaque intermediate image pixels
+
+            // Determine interpolated voxel color components:
+            for (c=0; c<4; ++c)
+            {
+               v[c] = vRGBA[0][c] * weight[0] + vRGBA[1][c] * weight[1] +
+                  vRGBA[2][c] * weight[2] + vRGBA[3][c] * weight[3];
             }
-            else iPixel += vvSoftImg::PIXEL_SIZE;
-         }
-         else iPixel += vvSoftImg::PIXEL_SIZE;
+            if (v[3]<=0.0f) continue;             // skip transparent voxels (yes, do it again!)
 
-         // Switch to next voxel:
-         vScalar[0] = vScalar[3];
-         vScalar[1] = vScalar[2];
-         vScalar[2] += vd->getBPV();
-         vScalar[3] += vd->getBPV();
+            va = (OpacityCorr) ? correctOpacity(v[3]) : v[3];
+            compositeUnder(iPixel, v, va);
+            if (iPixel[3]==255) markOpaque(pixel);
+         }
       }
-      for (i=0; i<4; ++i)
-         vScalar[i] -= vLineOffset;
-      iPixel += iLineOffset;
    }
 }
 
@@ -667,15 +411,18 @@ void vvSoftPar::compositeSliceCompressedBilinear(int slice)
   @see makeLookupTextureCorrect
   @param slice slice number to composite
   @param sliceStep 1 if counting up, -1 if counting down
+  Voxel, SliceInterpol, BilinLookup and OpacityCorr select the kernel
+  variant, see findSliceKernel().
+  @param band  intermediate image lines to render, also holds the buffer slices
 */
-void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
+template <typename Voxel, bool SliceInterpol, bool BilinLookup, bool OpacityCorr>
+void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep, Band& band)
 {
    vec3 vStart;                                   // bottom left voxel of this slice
    int    iPosX, iPosY;                           // current intermediate image coordinates (Y=0 is bottom)
    int    ix,iy;                                  // counters [intermediate image space]
-   uchar* vScalarB[4];                            // ptr to scalar data (back): 0=bot.left, 1=top left, 2=top right, 3=bot.right
+   const Voxel* vScalarB[4];                      // ptr to scalar data (back): 0=bot.left, 1=top left, 2=top right, 3=bot.right
    uchar* iPixel;                                 // pointer to current intermediate image pixel
-   int    iLineOffset;                            // offset to next line on intermediate image
    float  vr,vg,vb,va;                            // RGBA components of current voxel
    float  ir,ig,ib,ia;                            // RGBA components of current image pixel
    int    iSlice[2];                              // slice dimensions in intermediate image (x,y)
@@ -687,22 +434,47 @@ void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
    float  sf1, sb1;                               // sx - int(sx) = fraction after decimal point
    float  sizeFactor;                             // precomputed factor depending on pre-integration table size
    int    bufX, bufY;                             // coordinates in buffer slice
+   int    bufLen[2];                              // size of buffer slices
+   int    bufLines;                               // number of intermediate image lines in the slice buffer
    int    iSliceOffset[2];                        // difference of locations of current and previous slice
+   int    iyFirst, iyLast;                        // slice lines inside of the band, including one line on either side
+   bool   composite;                              // true if the current line belongs to the band
    float  tmp;
-   static int   lastIPos[2];                      // last slice position on the intermediate image
+   float* readBuf;                                // buffer slice with the values of the previous slice
+   float* writeBuf;                               // buffer slice for the values of the current slice
+   const Voxel* const vSlice = reinterpret_cast<const Voxel*>(raw) + slice * len[0] * len[1];
 
    findSlicePosition(slice, &vStart, NULL);
    iPosX     = int(vStart[0]) + 1;                // use intermediate image column right of bottom left voxel location
    iPosY     = int(vStart[1]) + 1;                // use intermediate image line top of bottom left voxel location
-   iPixel    = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
    iSlice[0] = len[0];
    iSlice[1] = len[1];
-   iLineOffset = intImg->PIXEL_SIZE * (intImg->width - iSlice[0] + 1);
    frac[0]   = (float)iPosX - vStart[0];
    frac[1]   = (float)iPosY - vStart[1];
-   sizeFactor = float(PRE_INT_TABLE_SIZE) / 256.0f;
+   sizeFactor = float(PRE_INT_TABLE_SIZE) / float(tfEntries);
    vr = vg = vb = 0.0f;                           // prevent warning
 
+   // The buffer slice values of the lines next to the band are needed for the
+   // next slice, because consecutive slices are shifted by up to one line:
+   iyFirst = ts_max(0, band.from - 1 - iPosY);
+   iyLast  = ts_min(iSlice[1] - 1, band.to + 1 - iPosY + 1);
+
+   if (sliceBuffer)
+   {
+      bufLen[0] = intImg->width;
+      bufLen[1] = intImg->height;
+      bufLines  = band.to - band.from + 3;
+      readBuf = writeBuf = band.bufSlice[0].data();
+   }
+   else
+   {
+      bufLen[0] = len[0] - 1;
+      bufLen[1] = len[1] - 1;
+      bufLines  = 0;
+      readBuf   = band.bufSlice[band.readSlice].data();
+      writeBuf  = band.bufSlice[1-band.readSlice].data();
+   }
+
    // Compute bilinear resampling weights for current slice:
    weight[0] = (1.0f - frac[0]) * (1.0f - frac[1]);
    weight[1] = (1.0f - frac[0]) * frac[1];
@@ -715,17 +487,16 @@ void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
                                                   // only compute backup slice for slice 0
    if ((slice==0 && sliceStep==1) || (slice==len[2]-1 && sliceStep==-1))
    {
-      for (iy=0; iy<iSlice[1]-1; ++iy)
+      for (iy=iyFirst; iy<iyLast; ++iy)
       {
-         vScalarB[0]= raw[principal] + vd->getBPV() * slice * len[0] * len[1] +
-            (len[1] - 1 - iy) * len[0];
+         vScalarB[0]= vSlice + (len[1] - 1 - iy) * len[0];
          vScalarB[1]= vScalarB[0] - len[0];
          vScalarB[2]= vScalarB[1] + 1;
          vScalarB[3]= vScalarB[0] + 1;
 
          for (ix=0; ix<iSlice[0]-1; ++ix)
          {
-            if (sliceInterpol)
+            if (SliceInterpol)
             {
                sb = ((float)*vScalarB[0] * weight[0] +
                   (float)*vScalarB[1] * weight[1] +
@@ -738,29 +509,31 @@ void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
             }
             if (sliceBuffer)
             {
-               bufSlice[0][(ix + iPosX) + (iy + iPosY) * bufSliceLen[0]] = sb;
+               writeBuf[(ix + iPosX) + (iy + iPosY - band.bufOffset) * bufLen[0]] = sb;
             }
             else
             {
-               bufSlice[1-readSlice][ix + iy * bufSliceLen[0]] = sb;
+               writeBuf[ix + iy * bufLen[0]] = sb;
             }
             vScalarB[0] = vScalarB[3];
             vScalarB[1] = vScalarB[2];
-            vScalarB[2] += vd->getBPV();
-            vScalarB[3] += vd->getBPV();
+            ++vScalarB[2];
+            ++vScalarB[3];
          }
       }
    }
    else
    {
-      iSliceOffset[0] = iPosX - lastIPos[0];
-      iSliceOffset[1] = iPosY - lastIPos[1];
+      iSliceOffset[0] = iPosX - band.lastIPos[0];
+      iSliceOffset[1] = iPosY - band.lastIPos[1];
 
-      for (iy=0; iy<iSlice[1]-1; ++iy)
+      for (iy=iyFirst; iy<iyLast; ++iy)
       {
+         composite = (iy + iPosY >= band.from && iy + iPosY <= band.to);
+         iPixel = intImg->data + intImg->PIXEL_SIZE * (iPosX + (iPosY + iy) * intImg->width);
+
          // Compute the voxels on the current slice contributing to the current intImg-Pixel:
-         vScalarB[0]= raw[principal] + vd->getBPV() * slice * len[0] * len[1] +
-            (len[1] - 1 - iy) * len[0];
+         vScalarB[0]= vSlice + (len[1] - 1 - iy) * len[0];
          vScalarB[1]= vScalarB[0] - len[0];
          vScalarB[2]= vScalarB[1] + 1;
          vScalarB[3]= vScalarB[0] + 1;
@@ -768,7 +541,7 @@ void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
          for (ix=0; ix<iSlice[0]-1; ++ix)
          {
             // Determine bilinearly interpolated scalar voxel value on current slice:
-            if (sliceInterpol)
+            if (SliceInterpol)
             {
                sb = ((float)*vScalarB[0] * weight[0] +
                   (float)*vScalarB[1] * weight[1] +
@@ -780,121 +553,123 @@ void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
                sb = float(*vScalarB[0]) * sizeFactor;
             }
 
-            // Determine intermediate image color components and scale to [0..1]:
-            ir = (float)(*(iPixel++));            // / 255.0f;
-            ig = (float)(*(iPixel++));            // / 255.0f;
-            ib = (float)(*(iPixel++));            // / 255.0f;
-            ia = (float)(*(iPixel++)) / 255.0f;
-
-            bufX = iSliceOffset[0] + ix;
-            bufY = iSliceOffset[1] + iy;
-            if (ia >= 1.0f) ++earlyRayTermination;
-            if (ia < 1.0f &&                      // skip opaque intermediate image pixels
-                                                  // and make sure that there is a value in the buffer slice corresponding with the current voxel
-               bufX >= 0 && bufX < bufSliceLen[0] && bufY >= 0 && bufY < bufSliceLen[1])
+            if (composite)
             {
-               // Determine interpolated voxel color components and scale to [0..1]:
-               if (sliceBuffer)
-               {
-                  sf = bufSlice[0][(ix + lastIPos[0]) + (iy + lastIPos[1]) * bufSliceLen[0]];
-               }
-               else
-               {
-                  sf = bufSlice[readSlice][bufX + bufY * bufSliceLen[0]];
-               }
-
-               sb1 = sb - float(int(sb));
-               sf1 = sf - float(int(sf));
-               preWght[0] = (1.0f - sf1) * (1.0f - sb1);
-               preWght[1] = (1.0f - sf1) * sb1;
-               preWght[2] = sf1 * sb1;
-               preWght[3] = sf1 * (1.0f - sb1);
+               // Determine intermediate image color components and scale to [0..1]:
+               ir = (float)(*(iPixel++));            // / 255.0f;
+               ig = (float)(*(iPixel++));            // / 255.0f;
+               ib = (float)(*(iPixel++));            // / 255.0f;
+               ia = (float)(*(iPixel++)) / 255.0f;
 
-               if (bilinLookup)
+               bufX = iSliceOffset[0] + ix;
+               bufY = iSliceOffset[1] + iy;
+               if (ia >= 1.0f) ++band.earlyRayTermination;
+               if (ia < 1.0f &&                      // skip opaque intermediate image pixels
+                                                     // and make sure that there is a value in the buffer slice corresponding with the current voxel
+                  bufX >= 0 && bufX < bufLen[0] && bufY >= 0 && bufY < bufLen[1] &&
+                  (!sliceBuffer || (iy + band.lastIPos[1] >= band.bufOffset && iy + band.lastIPos[1] < band.bufOffset + bufLines)))
                {
-                  sfi = int(sf);
-                  sbi = int(sb);
-
-                  // Perform pre-integration table look-up with bilinear interpolation:
-                  va = (preIntTable[sfi][sbi][3]     * preWght[0] +
-                     preIntTable[sfi][sbi+1][3]   * preWght[1] +
-                     preIntTable[sfi+1][sbi+1][3] * preWght[2] +
-                     preIntTable[sfi+1][sbi][3]   * preWght[3]);
-
-                  if (va>0.0f)                    // skip transparent voxels
+                  // Determine interpolated voxel color components and scale to [0..1]:
+                  if (sliceBuffer)
                   {
-                     vr = (preIntTable[sfi][sbi][0]     * preWght[0] +
-                        preIntTable[sfi][sbi+1][0]   * preWght[1] +
-                        preIntTable[sfi+1][sbi+1][0] * preWght[2] +
-                        preIntTable[sfi+1][sbi][0]   * preWght[3]);
-
-                     vg = (preIntTable[sfi][sbi][1]     * preWght[0] +
-                        preIntTable[sfi][sbi+1][1]   * preWght[1] +
-                        preIntTable[sfi+1][sbi+1][1] * preWght[2] +
-                        preIntTable[sfi+1][sbi][1]   * preWght[3]);
-
-                     vb = (preIntTable[sfi][sbi][2]     * preWght[0] +
-                        preIntTable[sfi][sbi+1][2]   * preWght[1] +
-                        preIntTable[sfi+1][sbi+1][2] * preWght[2] +
-                        preIntTable[sfi+1][sbi][2]   * preWght[3]);
+                     sf = readBuf[(ix + band.lastIPos[0]) + (iy + band.lastIPos[1] - band.bufOffset) * bufLen[0]];
                   }
-               }
-               else
-               {
-                  sfi = int(sf + 0.5f);
-                  sbi = int(sb + 0.5f);
-
-                  // Perform pre-integration table look-up with nearest neighbor interpolation:
-                  va = preIntTable[sfi][sbi][3];
-                  if (va>0.0f)                    // skip transparent voxels
+                  else
                   {
-                     vr = preIntTable[sfi][sbi][0];
-                     vg = preIntTable[sfi][sbi][1];
-                     vb = preIntTable[sfi][sbi][2];
+                     sf = readBuf[bufX + bufY * bufLen[0]];
                   }
-               }
+                  sb1 = sb - float(int(sb));
+                  sf1 = sf - float(int(sf));
+                  preWght[0] = (1.0f - sf1) * (1.0f - sb1);
+                  preWght[1] = (1.0f - sf1) * sb1;
+                  preWght[2] = sf1 * sb1;
+                  preWght[3] = sf1 * (1.0f - sb1);
+
+                  if (BilinLookup)
+                  {
+                     sfi = int(sf);
+                     sbi = int(sb);
 
-               if (va>0.0f)                       // skip transparent voxels
-               {
-                  if (opCorr)
+                     // Perform pre-integration table look-up with bilinear interpolation:
+                     va = (preIntTable[sfi][sbi][3]     * preWght[0] +
+                        preIntTable[sfi][sbi+1][3]   * preWght[1] +
+                        preIntTable[sfi+1][sbi+1][3] * preWght[2] +
+                        preIntTable[sfi+1][sbi][3]   * preWght[3]);
+
+                     if (va>0.0f)                    // skip transparent voxels
+                     {
+                        vr = (preIntTable[sfi][sbi][0]     * preWght[0] +
+                           preIntTable[sfi][sbi+1][0]   * preWght[1] +
+                           preIntTable[sfi+1][sbi+1][0] * preWght[2] +
+                           preIntTable[sfi+1][sbi][0]   * preWght[3]);
+
+                        vg = (preIntTable[sfi][sbi][1]     * preWght[0] +
+                           preIntTable[sfi][sbi+1][1]   * preWght[1] +
+                           preIntTable[sfi+1][sbi+1][1] * preWght[2] +
+                           preIntTable[sfi+1][sbi][1]   * preWght[3]);
+
+                        vb = (preIntTable[sfi][sbi][2]     * preWght[0] +
+                           preIntTable[sfi][sbi+1][2]   * preWght[1] +
+                           preIntTable[sfi+1][sbi+1][2] * preWght[2] +
+                           preIntTable[sfi+1][sbi][2]   * preWght[3]);
+                     }
+                  }
+                  else
                   {
-                     int index = int(va * VV_OP_CORR_TABLE_SIZE / 256.0f);
-                     va = opacityCorr[index];
-                     vr *= colorCorr[index];
-                     vg *= colorCorr[index];
-                     vb *= colorCorr[index];
+                     sfi = int(sf + 0.5f);
+                     sbi = int(sb + 0.5f);
+
+                     // Perform pre-integration table look-up with nearest neighbor interpolation:
+                     va = preIntTable[sfi][sbi][3];
+                     if (va>0.0f)                    // skip transparent voxels
+                     {
+                        vr = preIntTable[sfi][sbi][0];
+                        vg = preIntTable[sfi][sbi][1];
+                        vb = preIntTable[sfi][sbi][2];
+                     }
                   }
 
-                  iPixel -= vvSoftImg::PIXEL_SIZE;// start over with intermediate image components
+                  if (va>0.0f)                       // skip transparent voxels
+                  {
+                     if (OpacityCorr)
+                     {
+                        int index = int(va * VV_OP_CORR_TABLE_SIZE / 256.0f);
+                        va = opacityCorr[index];
+                        vr *= colorCorr[index];
+                        vg *= colorCorr[index];
+                        vb *= colorCorr[index];
+                     }
 
-                  // Accumulate new intermediate image pixel values.
-                  *(iPixel++) = (uchar)((tmp = ((ir + (1.0f - ia) * vr))) < 255.0f ? tmp : 255.0f);
-                  *(iPixel++) = (uchar)((tmp = ((ig + (1.0f - ia) * vg))) < 255.0f ? tmp : 255.0f);
-                  *(iPixel++) = (uchar)((tmp = ((ib + (1.0f - ia) * vb))) < 255.0f ? tmp : 255.0f);
-                  *(iPixel++) = (uchar)((tmp = ((255.0f * ia + (1.0f - ia) * va))) < 255.0f ? tmp : 255.0f);
+                     iPixel -= vvSoftImg::PIXEL_SIZE;// start over with intermediate image components
+
+                     // Accumulate new intermediate image pixel values.
+                     *(iPixel++) = (uchar)((tmp = ((ir + (1.0f - ia) * vr))) < 255.0f ? tmp : 255.0f);
+                     *(iPixel++) = (uchar)((tmp = ((ig + (1.0f - ia) * vg))) < 255.0f ? tmp : 255.0f);
+                     *(iPixel++) = (uchar)((tmp = ((ib + (1.0f - ia) * vb))) < 255.0f ? tmp : 255.0f);
+                     *(iPixel++) = (uchar)((tmp = ((255.0f * ia + (1.0f - ia) * va))) < 255.0f ? tmp : 255.0f);
+                  }
                }
             }
             if (sliceBuffer)
             {
-               bufSlice[0][(ix + iPosX) + (iy + iPosY) * bufSliceLen[0]] = sb;
+               writeBuf[(ix + iPosX) + (iy + iPosY - band.bufOffset) * bufLen[0]] = sb;
             }
             else
             {
-               bufSlice[1-readSlice][ix + iy * bufSliceLen[0]] = sb;
+               writeBuf[ix + iy * bufLen[0]] = sb;
             }
 
             // Switch to next voxel:
             vScalarB[0] = vScalarB[3];
             vScalarB[1] = vScalarB[2];
-            vScalarB[2] += vd->getBPV();
-            vScalarB[3] += vd->getBPV();
+            ++vScalarB[2];
+            ++vScalarB[3];
          }
-         iPixel += iLineOffset;
       }
    }
-   lastIPos[0] = iPosX;
-   lastIPos[1] = iPosY;
-   readSlice = 1 - readSlice;
+   band.lastIPos[0] = iPosX;
+   band.lastIPos[1] = iPosY;
+   band.readSlice = 1 - band.readSlice;
 }
 
 
@@ -929,6 +704,7 @@ void vvSoftPar::findPrincipalAxis()
    if      (fabs(oViewDir[0]) == maximum) principal = virvo::cartesian_axis< 3 >::X;
    else if (fabs(oViewDir[1]) == maximum) principal = virvo::cartesian_axis< 3 >::Y;
    else principal = virvo::cartesian_axis< 3 >::Z;
+   findSecondaryAxis(oViewDir);
 
    if (oViewDir[principal] > 0) stacking = false;
    else stacking = true;
@@ -77,9 +77,6 @@ class VIRVOEXPORT vvSoftPar : public vvSoftVR
       virvo::vec3 wViewDir;                       ///< viewing direction [world space]
       virvo::vec3 oViewDir;                       ///< viewing direction [object space]
       virvo::vec3 sViewDir;                       ///< viewing direction [standard object space]
-      float* bufSlice[2];                         ///< buffer slices for preintegrated rendering
-      int bufSliceLen[2];                         ///< size of buffer slices
-      int readSlice;                              ///< index of buffer slice currently used for reading [0..1]
       enum
       {
          VV_OP_CORR_TABLE_SIZE = 1024
@@ -87,11 +84,20 @@ class VIRVOEXPORT vvSoftPar : public vvSoftVR
       float opacityCorr[VV_OP_CORR_TABLE_SIZE];
       float colorCorr[VV_OP_CORR_TABLE_SIZE];
 
-      void compositeSliceNearest(int, int = -1, int = -1);
-      void compositeSliceBilinear(int);
-      void compositeSliceCompressedNearest(int);
-      void compositeSliceCompressedBilinear(int);
-      void compositeSlicePreIntegrated(int, int);
+      /// Composites one slice (slice, slice step) to the intermediate image lines of a band
+      typedef void (vvSoftPar::*SliceKernel)(int, int, Band&);
+
+      void compositeBand(Band&);
+      SliceKernel findSliceKernel() const;
+      template <typename Voxel>
+      SliceKernel findSliceKernel() const;
+      float correctOpacity(float) const;
+      template <typename Voxel, bool Clip, bool OpacityCorr>
+      void compositeSliceNearest(int, int, Band&);
+      template <typename Voxel, bool Clip, bool OpacityCorr>
+      void compositeSliceBilinear(int, int, Band&);
+      template <typename Voxel, bool SliceInterpol, bool BilinLookup, bool OpacityCorr>
+      void compositeSlicePreIntegrated(int, int, Band&);
       void findOViewingDirection();
       void findPrincipalAxis();
       void findSViewingDirection();
@@ -70,22 +70,50 @@ vvSoftPer::~vvSoftPer()
 */
 void vvSoftPer::compositeVolume(int from, int to)
 {
-   int slice;                                     // currently processed slice
-   int i;
-
    vvDebugMsg::msg(3, "vvSoftPer::compositeVolume(): ", from, to);
 
    intImg->clear();
 
+   compositeBands(from, to);
+}
+
+
+//----------------------------------------------------------------------------
+/** Composite all volume slices to the intermediate image lines of one band.
+  Called concurrently for disjoint bands by compositeBands().
+  @param band intermediate image lines to render
+*/
+void vvSoftPer::compositeBand(Band& band)
+{
+   int slice;                                     // currently processed slice
+   int i;
+   typedef void (vvSoftPer::*SliceKernel)(int, Band&);
+   static const SliceKernel bilinear[4] =
+   {
+      &vvSoftPer::compositeSliceBilinear<uchar, false>,
+      &vvSoftPer::compositeSliceBilinear<uchar, true>,
+      &vvSoftPer::compositeSliceBilinear<uint16_t, false>,
+      &vvSoftPer::compositeSliceBilinear<uint16_t, true>
+   };
+   static const SliceKernel nearest[4] =
+   {
+      &vvSoftPer::compositeSliceNearest<uchar, false>,
+      &vvSoftPer::compositeSliceNearest<uchar, true>,
+      &vvSoftPer::compositeSliceNearest<uint16_t, false>,
+      &vvSoftPer::compositeSliceNearest<uint16_t, true>
+   };
+
+   // Choose the kernel once, so the inner loops do not test the render state:
+   const int index = (rawBPV == 1 ? 0 : 2) + (clipping ? 1 : 0);
+   const SliceKernel composite = (sliceInterpol) ? bilinear[index] : nearest[index];
+
    for (i=0; i<len[2]; ++i)                       // traverse volume slice by slice
    {
       // Determine slice index which depends on the stacking order:
       if (stacking) slice = i;
       else slice = len[2] - i - 1;
 
-      // Composite slice according to current rendering mode:
-      if (sliceInterpol) compositeSliceBilinear(slice, from, to);
-      else compositeSliceNearest(slice, from, to);
+      (this->*composite)(slice, band);
    }
 }
 
@@ -93,6 +121,8 @@ void vvSoftPer::compositeVolume(int from, int to)
 //----------------------------------------------------------------------------
 /** Composite the voxels from one slice into the intermediate image.
   2D nearest neighbor interpolation is used.
+  Only pixels showing non-transparent voxel runs are traversed, and pixels
+  which are already opaque are skipped.
   Naming convention for variables:<BR>
   i  = intermediate image space (coordinates are: u,v)<BR>
   v  = voxel data space<P>
@@ -108,35 +138,32 @@ UNDER operator:
 ic := ia * ic + (1 - ia) * (vc * va)
 ia := ia + va * (1 - ia)
 </PRE>
+Voxel is the type of the lookup table indices in raw, Clip selects the
+kernel variant for clipping plane tests.
 @param slice   index of slice to composite [permuted value]
-@param from    first intermediate image line to render (bottom-most line, -1 to render all lines)
-@param to      last intermediate image line to render (top-most line)
+@param band    intermediate image lines to render
 */
-void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
+template <typename Voxel, bool Clip>
+void vvSoftPer::compositeSliceNearest(int slice, Band& band)
 {
-#define FLOAT_MATH                             // undefine for integer math
    vec3 vStart;                                   // bottom left voxel of the current slice
    vec3 vEnd;                                     // top right voxel of the current slice
    float  iStartX, iStartY;                       // coordinates of bottom left intermediate image pixel for this slice
    int    iPosX, iPosY;                           // current intermediate image coordinates
-   int    vPosX, vPosY;                           // current slice x and y coordinates [16.16 fixed point]
+   int    vPosX;                                  // current slice x coordinate [16.16 fixed point]
    int    vFracY;                                 // remainder of y step (always <0) [16.16 fixed point]
    int    vStepX, vStepY;                         // step size [16.16 fixed point]
+   int    vLine;                                  // current voxel line
    int    ix,iy;                                  // counters [intermediate image space]
-   uchar* vScalar;                                // pointer to current scalar voxel data
+   const Voxel* vScalar;                          // pointer to first voxel of the current line
+   const float* vRGBA;                            // RGBA components of current voxel [0..1]
    uchar* iPixel;                                 // pointer to current intermediate image pixel
-   int    iLineOffset;                            // offset to next line on intermediate image
+   int    iLineStart;                             // index of the first intermediate image pixel of the current line
+   int    pixel, end;                             // current and last+1 intermediate image pixel of a run
    int    iSlice[2];                              // slice dimensions in intermediate image (x,y)
-#ifdef FLOAT_MATH
-   float  vr,vg,vb,va;                            // RGBA components of current voxel
-   float  ir,ig,ib,ia;                            // RGBA components of current image pixel
-   float  tmp;
-   float  ia1;                                    // 1 - ia
-#else
-   uint   vr,vg,vb,va;                            // RGBA components of current voxel
-   uint   ir,ig,ib,ia;                            // RGBA components of current image pixel
-   uint   ia1;                                    // = 255-ia
-#endif
+   int    from, to;                               // first and last intermediate image line to render
+   size_t r;
+   uchar* const iData = intImg->data;
 
    // Compute values which are constant in the compositing loop:
    findSlicePosition(slice, &vStart, &vEnd);
@@ -153,33 +180,28 @@ void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
       iSlice[0]<=0 || iSlice[1]<=0)
       return;
 
-   iLineOffset = intImg->PIXEL_SIZE * (intImg->width - iSlice[0]);
-   vScalar     = raw[principal] + vd->getBPV() * (slice * len[0] * len[1] + (len[1] - 1) * len[0]);
-   vPosX       = 0;
-   vPosY       = (len[1] - 1) << 16;
+   vScalar     = reinterpret_cast<const Voxel*>(raw) + slice * len[0] * len[1] + (len[1] - 1) * len[0];
+   vLine       = len[1] - 1;
    vFracY      = 0;
    vStepX      = (len[0] << 16) / iSlice[0];      // 16.16 value
    vStepY      = (len[1] << 16) / iSlice[1];      // 16.16 value
 
-   if (from != -1)                                // render only specific lines?
+   // Render only the lines of the band:
    {
       int iTopLine;                               // topmost intermediate image line
 
       iTopLine = iPosY + iSlice[1] - 1;
-      if (to < iPosY || from > iTopLine) return;  // return if section to render is outside of slice area
+      if (band.to < iPosY || band.from > iTopLine) return;  // return if section to render is outside of slice area
 
       // Constrain section indices:
-      if (from < iPosY) from = iPosY;
-      if (to > iTopLine) to = iTopLine;
+      from = ts_max(band.from, iPosY);
+      to   = ts_min(band.to, iTopLine);
 
-      // Modify first voxel to draw:
-      for (int i=0; i<(from - iPosY); ++i)        // TODO: optimize this loop!
-      {
-         vFracY  += vStepY;
-         vScalar -= (vFracY >> 16) * len[0] * vd->getBPV();
-         vPosY   -= vStepY;
-         vFracY  &= 0xffff;                       // delete integer part of 16.16 value
-      }
+      // Modify first voxel to draw, skipping (from - iPosY) steps of vStepY at once:
+      vFracY   = (from - iPosY) * vStepY;
+      vScalar -= (vFracY >> 16) * len[0];
+      vLine   -= (vFracY >> 16);
+      vFracY  &= 0xffff;                          // delete integer part of 16.16 value
 
       // Modify first pixel to draw:
       iPosY = from;
@@ -188,69 +210,35 @@ void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
       iSlice[1] = to - from + 1;
    }
 
-   // Compute starting values for values which are variable in the compositing loop:
-   iPixel = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
-
    // Traverse intermediate image pixels which correspond to the current slice:
    for (iy=0; iy<iSlice[1]; ++iy)
    {
-      vPosX = 0;
-      for (ix=0; ix<iSlice[0]; ++ix)
+      iLineStart = iPosX + (iPosY + iy) * intImg->width;
+
+      // Pixel ix shows voxel (ix * vStepX) >> 16:
+      findVoxelRuns(slice, vLine, vLine, 0, band);
+      for (r=0; r<band.runs.size(); r+=2)
       {
-         // Determine image color components and scale to [0..1]:
-#ifdef FLOAT_MATH
-         ir = (float)(*(iPixel++)) / 255.0f;
-         ig = (float)(*(iPixel++)) / 255.0f;
-         ib = (float)(*(iPixel++)) / 255.0f;
-         ia = (float)(*(iPixel++)) / 255.0f;
-#else
-         ir = (int)(*(iPixel++));
-         ig = (int)(*(iPixel++));
-         ib = (int)(*(iPixel++));
-         ia = (int)(*(iPixel++));
-#endif
-         if ((ia<255) &&                          // early ray termination for opaque image pixels
-                                                  // skip clipped voxels
-            (!getParameter(VV_CLIP_MODE) || (!isVoxelClipped(vPosX >> 16, vPosY >> 16, slice))))
+         end = iLineStart + ts_min(iSlice[0], ((band.runs[r + 1] << 16) + vStepX - 1) / vStepX);
+         for (pixel = skipOpaquePixels(iLineStart + ((band.runs[r] << 16) + vStepX - 1) / vStepX, end, band);
+              pixel < end; pixel = skipOpaquePixels(pixel + 1, end, band))
          {
-            // Determine voxel color components and scale to [0..1]:
-#ifdef FLOAT_MATH
-            vr = (float)rgbaConv[vScalar[vPosX >> 16]][0] / 255.0f;
-            vg = (float)rgbaConv[vScalar[vPosX >> 16]][1] / 255.0f;
-            vb = (float)rgbaConv[vScalar[vPosX >> 16]][2] / 255.0f;
-            va = (float)rgbaConv[vScalar[vPosX >> 16]][3] / 255.0f;
-#else
-            vr = (int)rgbaConv[vScalar[vPosX >> 16]][0];
-            vg = (int)rgbaConv[vScalar[vPosX >> 16]][1];
-            vb = (int)rgbaConv[vScalar[vPosX >> 16]][2];
-            va = (int)rgbaConv[vScalar[vPosX >> 16]][3];
-#endif
+            ix     = pixel - iLineStart;
+            vPosX  = ix * vStepX;
+            vRGBA  = rgbaFloat[vScalar[vPosX >> 16]];
+            if (vRGBA[3]<=0.0f) continue;         // skip transparent voxels
+            if (Clip && isVoxelClipped(vPosX >> 16, vLine, slice)) continue;
 
-            // Accumulate new intermediate image pixel values.
-            iPixel -= 4;                          // start over with intermediate image components
-#ifdef FLOAT_MATH
-            ia1 = 1.0f - ia;
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ir + ia1 * vr * va))) < 255.0f ? tmp : 255.0f);
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ig + ia1 * vg * va))) < 255.0f ? tmp : 255.0f);
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ib + ia1 * vb * va))) < 255.0f ? tmp : 255.0f);
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ia + ia1 * va))) < 255.0f ? tmp : 255.0f);
-#else
-            ia1 = 0xFF - ia;
-            // TODO: color model should be adapted to the one used in FLOAT_MATH!
-            *(iPixel++) = (uchar)(((ia * ir) + (vr * ia1)) >> 8);
-            *(iPixel++) = (uchar)(((ia * ig) + (vg * ia1)) >> 8);
-            *(iPixel++) = (uchar)(((ia * ib) + (vb * ia1)) >> 8);
-            *(iPixel++) = (uchar)(ia         + ((va * ia1) >> 8));
-#endif
-         }
+            iPixel = iData + vvSoftImg::PIXEL_SIZE * pixel;
+            if (iPixel[3]==255) continue;         // early ray termination for opaque image pixels
 
-         // Switch to next voxel:
-         vPosX += vStepX;
+            compositeUnder(iPixel, vRGBA, vRGBA[3]);
+            if (iPixel[3]==255) markOpaque(pixel);
+         }
       }
-      iPixel  += iLineOffset;
       vFracY  += vStepY;
-      vScalar -= (vFracY >> 16) * len[0] * vd->getBPV();
-      vPosY   -= vStepY;
+      vScalar -= (vFracY >> 16) * len[0];
+      vLine   -= (vFracY >> 16);
       vFracY  &= 0xffff;                          // delete integer part of 16.16 value
    }
 }
@@ -264,32 +252,38 @@ void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
       use footprint resampling</LI>
   <LI>pixel distance > voxel distance (multiple pixels per voxel):
       use 4-voxel bilinear resampling</LI></UL>
+  Only pixels near non-transparent voxel runs are traversed, and pixels
+  which are already opaque are skipped.
 
+  Voxel is the type of the lookup table indices in raw, Clip selects the
+  kernel variant for clipping plane tests.
   @param slice      index of slice to composite [permuted value]
-  @param from    first intermediate image line to render (bottom-most line, -1 to render all lines)
-  @param to      last intermediate image line to render (top-most line)
+  @param band    intermediate image lines to render
 */
-void vvSoftPer::compositeSliceBilinear(int slice, int from, int to)
+template <typename Voxel, bool Clip>
+void vvSoftPer::compositeSliceBilinear(int slice, Band& band)
 {
    vec3 vStart;                                   // bottom left voxel of the current slice
    vec3 vEnd;                                     // top right voxel of the current slice
    float  vPosYBase;                              // first slice y coordinate
    float  vStepX, vStepY;                         // step size: voxels traversed per image pixel
-   float  vr,vg,vb,va;                            // RGBA components of current voxel
-   float  ir,ig,ib,ia;                            // RGBA components of current image pixel
+   float  v[4];                                   // RGBA components of current voxel
    float  vPosX, vPosY;                           // current slice x and y coordinates
-   float  ia1;                                    // = 1-ia
-   uchar* vSliceBase;                             // pointer to top left (first) voxel in current slice
-   uchar* iPixelBase;                             // pointer to first intermediate image pixel
+   float  footprint[2];                           // half size of the voxel footprint of a pixel (x,y)
+   const Voxel* vSliceBase;                       // pointer to top left (first) voxel in current slice
    uchar* iPixel;                                 // pointer to current intermediate image pixel
    int    iPosX, iPosY;                           // current intermediate image coordinates
-   int    iPixelLine;                             // number of bytes on a line in the intermediate image
+   int    iLineStart;                             // index of the first intermediate image pixel of the current line
+   int    pixel, end;                             // current and last+1 intermediate image pixel of a run
+   int    grow;                                   // number of voxels a pixel footprint reaches beyond its position
    int    iSlice[2];                              // slice dimensions in intermediate image (width,height)
    int    ix;                                     // counter [intermediate image space]
    int    iy;                                     // counter [intermediate image space]
+   int    from, to;                               // first and last intermediate image line to render
+   size_t r;
    bool   zoomMode;                               // true  = voxel slice smaller than image slice: accumulate voxels
    // false = voxel slice larger than image slice:  bilinearly interpolate
-   float  tmp;
+   uchar* const iData = intImg->data;
 
    // Compute slice position and size on intermediate image:
    findSlicePosition(slice, &vStart, &vEnd);
@@ -308,24 +302,25 @@ void vvSoftPer::compositeSliceBilinear(int slice, int from, int to)
       return;
 
    // Initialize compositing parameters:
-   iPixelLine = intImg->PIXEL_SIZE * intImg->width;
    vStepX      = (float)(len[0]-1) / (float)(iSlice[0]-1);
    vStepY      = (float)(len[1]-1) / (float)(iSlice[1]-1);
    vPosYBase   = (float)(len[1] - 1);
    if (vStepX<1.0f || vStepY<1.0f) zoomMode = false;
    else zoomMode = true;
+   footprint[0] = (zoomMode) ? vStepX / 2.0f : 0.0f;
+   footprint[1] = (zoomMode) ? vStepY / 2.0f : 0.0f;
+   grow = int(footprint[0]) + 2;
 
-   // Render only specific lines?
-   if (from != -1)
+   // Render only the lines of the band:
    {
       int iTopLine;                               // topmost intermediate image line
 
       iTopLine = iPosY + iSlice[1] - 1;
-      if (to < iPosY || from > iTopLine) return;  // return if section to render is outside of slice area
+      if (band.to < iPosY || band.from > iTopLine) return;  // return if section to render is outside of slice area
 
       // Constrain section indices:
-      if (from < iPosY) from = iPosY;
-      if (to > iTopLine) to = iTopLine;
+      from = ts_max(band.from, iPosY);
+      to   = ts_min(band.to, iTopLine);
 
       // Modify first voxel to draw:
       vPosYBase -= (from - iPosY) * vStepY;
@@ -338,52 +333,39 @@ void vvSoftPer::compositeSliceBilinear(int slice, int from, int to)
    }
 
    // Compute starting values for values which are variable in the compositing loop:
-   iPixelBase  = intImg->data + intImg->PIXEL_SIZE * (iPosX + iPosY * intImg->width);
-   vSliceBase  = raw[principal] + vd->getBPV() * slice * len[0] * len[1];
+   vSliceBase  = reinterpret_cast<const Voxel*>(raw) + slice * len[0] * len[1];
 
    // Traverse intermediate image pixels which correspond to the current slice:
    for (iy=0; iy<iSlice[1]; ++iy)
    {
-      vPosX  = 0.0f;
-      vPosY  = vPosYBase  - iy * vStepY;
-      iPixel = iPixelBase + iy * iPixelLine;
-      for (ix=0; ix<iSlice[0]; ++ix)
+      vPosY      = vPosYBase - iy * vStepY;
+      iLineStart = iPosX + (iPosY + iy) * intImg->width;
+
+      // Runs of the voxel lines in the footprint, extended by the footprint width:
+      findVoxelRuns(slice, int(vPosY - footprint[1]) - 1, int(vPosY + footprint[1]) + 1, grow, band);
+      for (r=0; r<band.runs.size(); r+=2)
       {
-         // Determine image color components and scale to [0..1]:
-         ir = (float)(*(iPixel++)) / 255.0f;
-         ig = (float)(*(iPixel++)) / 255.0f;
-         ib = (float)(*(iPixel++)) / 255.0f;
-         ia = (float)(*(iPixel++)) / 255.0f;
-
-         if ((ia<255) &&                          // early ray termination for opaque image pixels
-                                                  // skip clipped voxels
-            (!getParameter(VV_CLIP_MODE) || (!isVoxelClipped((int)vPosX, (int)vPosY, slice))))
+         end = iLineStart + ts_min(iSlice[0], (int)ceilf(band.runs[r + 1] / vStepX));
+         for (pixel = skipOpaquePixels(iLineStart + (int)ceilf(band.runs[r] / vStepX), end, band);
+              pixel < end; pixel = skipOpaquePixels(pixel + 1, end, band))
          {
+            ix     = pixel - iLineStart;
+            vPosX  = ix * vStepX;
+            iPixel = iData + vvSoftImg::PIXEL_SIZE * pixel;
+            if (iPixel[3]==255) continue;         // early ray termination for opaque image pixels
+            if (Clip && isVoxelClipped((int)vPosX, (int)vPosY, slice)) continue;
+
             // Determine voxel color components and scale to [0..1]:
             if (zoomMode)
-               accumulateVoxels(vSliceBase, vPosX, vPosY, vStepX, vStepY, &vr, &vg, &vb, &va);
+               accumulateVoxels(vSliceBase, vPosX, vPosY, vStepX, vStepY, &v[0], &v[1], &v[2], &v[3]);
             else
-               interpolateVoxels(vSliceBase, vPosX, vPosY, &vr, &vg, &vb, &va);
+               interpolateVoxels(vSliceBase, vPosX, vPosY, &v[0], &v[1], &v[2], &v[3]);
 
             // Accumulate new intermediate image pixel values.
-            iPixel -= 4;                          // start over with intermediate image components
             // Color model suggested by Martin Kraus:
-            ia1 = 1.0f - ia;
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ir + ia1 * vr * va))) < 255.0f ? tmp : 255.0f);
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ig + ia1 * vg * va))) < 255.0f ? tmp : 255.0f);
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ib + ia1 * vb * va))) < 255.0f ? tmp : 255.0f);
-            *(iPixel++) = (uchar)((tmp = (255.0f * (ia + ia1 * va))) < 255.0f ? tmp : 255.0f);
-            /*  Initial color model:
-                    ia1 = 1.0f - ia;
-                    *(iPixel++) = (uchar)(255.0f * (ia * ir + ia1 * vr));
-                    *(iPixel++) = (uchar)(255.0f * (ia * ig + ia1 * vg));
-                    *(iPixel++) = (uchar)(255.0f * (ia * ib + ia1 * vb));
-                    *(iPixel++) = (uchar)(255.0f * (ia      + ia1 * va));
-            */
+            compositeUnder(iPixel, v, v[3]);
+            if (iPixel[3]==255) markOpaque(pixel);
          }
-
-         // Switch to next voxel:
-         vPosX += vStepX;
       }
    }
 }
@@ -395,10 +377,11 @@ void vvSoftPer::compositeSliceBilinear(int slice, int from, int to)
   @param fx,fy    pixel location in voxel space
   @param r,g,b,a  accumulated RGBA return value
 */
-void vvSoftPer::interpolateVoxels(uchar* sliceBase, float fx, float fy,
+template <typename Voxel>
+void vvSoftPer::interpolateVoxels(const Voxel* sliceBase, float fx, float fy,
 float* r, float* g, float* b, float* a)
 {
-   uchar* vScalar[4];                             // ptr to scalar data: 0=bot.left, 1=top left, 2=top right, 3=bot.right
+   const Voxel* vScalar[4];                       // ptr to scalar data: 0=bot.left, 1=top left, 2=top right, 3=bot.right
    float  weight[4];                              // resampling weights, one for each of the four neighboring voxels (for indices see vScalar[])
    float  frac[2];                                // fractions for resampling (x,y)
    int    top;                                    // top voxel row to process
@@ -415,7 +398,7 @@ float* r, float* g, float* b, float* a)
       else if (left+1>=len[0]) left = len[0]-1;
       if (top<0) top=0;
       else if (top+1>=len[1]) top = len[1]-1;
-      vScalar[0] = sliceBase + vd->getBPV() * (top * len[0] + left);
+      vScalar[0] = sliceBase + top * len[0] + left;
 
       *r = ((float)rgbaConv[*vScalar[0]][0]) / 255.0f;
       *g = ((float)rgbaConv[*vScalar[0]][1]) / 255.0f;
@@ -435,10 +418,10 @@ float* r, float* g, float* b, float* a)
    weight[3] = frac[0] * frac[1];
 
    // Compute pointers to scalar values:
-   vScalar[1] = sliceBase + vd->getBPV() * (top * len[0] + left);
-   vScalar[2] = vScalar[1] + vd->getBPV();
-   vScalar[0] = vScalar[1] + vd->getBPV() * len[0];
-   vScalar[3] = vScalar[0] + vd->getBPV();
+   vScalar[1] = sliceBase + top * len[0] + left;
+   vScalar[2] = vScalar[1] + 1;
+   vScalar[0] = vScalar[1] + len[0];
+   vScalar[3] = vScalar[0] + 1;
 
    // Determine interpolated voxel color components and scale to [0..1]:
    *r = ((float)rgbaConv[*vScalar[0]][0] * weight[0] +
@@ -467,10 +450,11 @@ float* r, float* g, float* b, float* a)
   @param fw,fh    footprint size (width,height)
   @param r,g,b,a  accumulated RGBA return value
 */
-void vvSoftPer::accumulateVoxels(uchar* sliceBase, float fx, float fy, float fw, float fh,
+template <typename Voxel>
+void vvSoftPer::accumulateVoxels(const Voxel* sliceBase, float fx, float fy, float fw, float fh,
 float* r, float* g, float* b, float* a)
 {
-   uchar* scalar;                                 // pointer to current scalar value
+   const Voxel* scalar;                           // pointer to current scalar value
    int    top;                                    // first voxel row to process
    int    left;                                   // first voxel column to process
    int    w, h;                                   // number of voxels to process in x and y direction
@@ -500,8 +484,8 @@ float* r, float* g, float* b, float* a)
    assert(w>=0 && h>=0);
 
    // Accumulate voxels (compute average value):
-   scalar = sliceBase + vd->getBPV() * (top * len[0] + left);
-   lineOffset = (int)vd->getBPV() * len[0];
+   scalar = sliceBase + top * len[0] + left;
+   lineOffset = len[0];
    *r = *g = *b = *a = 0.0f;
    numVoxels = w * h;
    for (y=0; y<h; ++y)
@@ -672,6 +656,7 @@ void vvSoftPer::findPrincipalAxis()
    if (maxCount==count[2])      { principal = axis_type::Z; stacking = stack[2]; }
    else if (maxCount==count[1]) { principal = axis_type::Y; stacking = stack[1]; }
    else                         { principal = axis_type::X; stacking = stack[0]; }
+   findSecondaryAxis(oEye3);                      // direction from the volume center to the eye
 
    if (vvDebugMsg::isActive(3)) cerr << "Principal axis: " << principal << endl;
    if (vvDebugMsg::isActive(3))
@@ -89,10 +89,15 @@ class VIRVOEXPORT vvSoftPer : public vvSoftVR
       virvo::mat4 diConv;                        ///< convert deformed space to intermediate image space
       virvo::mat4 sdShear;                       ///< shear matrix from standard object space to deformed (sheared) space
 
-      void compositeSliceNearest(int, int = -1, int = -1);
-      void compositeSliceBilinear(int, int = -1, int = -1);
-      void interpolateVoxels(uchar*, float, float, float*, float*, float*, float*);
-      void accumulateVoxels(uchar*, float, float, float, float, float*, float*, float*, float*);
+      void compositeBand(Band&);
+      template <typename Voxel, bool Clip>
+      void compositeSliceNearest(int, Band&);
+      template <typename Voxel, bool Clip>
+      void compositeSliceBilinear(int, Band&);
+      template <typename Voxel>
+      void interpolateVoxels(const Voxel*, float, float, float*, float*, float*, float*);
+      template <typename Voxel>
+      void accumulateVoxels(const Voxel*, float, float, float, float, float*, float*, float*, float*);
       void setQuality(float);
       void findDIConvMatrix();
       void findOEyePosition();
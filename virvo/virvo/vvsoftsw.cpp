@@ -18,8 +18,10 @@
 // License along with this library (see license.txt); if not, write to the 
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include "gl/util.h"
 #include "private/vvgltools.h"
 
+#include "vvdebugmsg.h"
 #include "vvsoftsw.h"
 #include "vvsoftpar.h"
 #include "vvsoftper.h"
@@ -32,6 +34,32 @@ vvSoftShearWarp::vvSoftShearWarp(vvVolDesc *vd, vvRenderState rs)
   rendererType = SOFTSW;
 }
 
+void vvSoftShearWarp::renderVolumeGL()
+{
+  vvDebugMsg::msg(3, "vvSoftShearWarp::renderVolumeGL()");
+
+  // Both renderers use the same permuted copies of the volume data
+  vvMatrix pm = virvo::gl::getProjectionMatrix();
+  if(pm.isProjOrtho())
+  {
+    if(!_ortho)
+    {
+      _ortho = new vvSoftPar(vd, *this);
+      _ortho->shareAxisCache(_persp);
+    }
+  }
+  else
+  {
+    if(!_persp)
+    {
+      _persp = new vvSoftPer(vd, *this);
+      _persp->shareAxisCache(_ortho);
+    }
+  }
+
+  vvSwitchRenderer<vvSoftPar, vvSoftPer>::renderVolumeGL();
+}
+
 //============================================================================
 // End of File
 //============================================================================
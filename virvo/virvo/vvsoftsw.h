@@ -31,6 +31,8 @@ class VIRVOEXPORT vvSoftShearWarp: public vvSwitchRenderer<vvSoftPar, vvSoftPer>
 {
 public:
   vvSoftShearWarp(vvVolDesc *vd, vvRenderState rs);
+
+  virtual void renderVolumeGL();
 };
 #endif
 
@@ -18,7 +18,9 @@
 // License along with this library (see license.txt); if not, write to the 
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 using std::cerr;
 using std::endl;
 
@@ -43,17 +45,75 @@ using std::endl;
 #include "vvtoolshed.h"
 #include "vvvecmath.h"
 
+#include "private/parallel_for.h"
+#include "private/vvaxiscache.h"
 #include "private/vvgltools.h"
+#include "private/vvpreint.h"
 
 namespace gl = virvo::gl;
 using virvo::mat4;
 using virvo::vec3;
 using virvo::vec4;
 
+namespace
+{
+
+/** Append a run length to an RLE line. Runs longer than 65535 voxels are
+  split, with runs of length 0 of the other kind in between.
+  @param length run length [voxels]
+  @param dst    RLE data of the line, may be NULL to only count
+  @param count  number of values stored in dst so far
+  @return new number of values in dst
+*/
+inline int putRunLength(int length, uint16_t* dst, int count)
+{
+   while (length > 0xFFFF)
+   {
+      if (dst)
+      {
+         dst[count]     = 0xFFFF;
+         dst[count + 1] = 0;
+      }
+      count += 2;
+      length -= 0xFFFF;
+   }
+   if (dst) dst[count] = uint16_t(length);
+   return count + 1;
+}
+
+/** Find the runs of voxels which are not transparent in one voxel line.
+  @param voxel   first voxel of the line (lookup table indices)
+  @param lineLen number of voxels in the line
+  @param rgba    RGBA lookup table
+  @param dst     receives the length of the transparent run before each
+                 non-transparent run, followed by the length of the
+                 non-transparent run. May be NULL to only count the values
+  @return number of values stored in dst, two per run
+*/
+template <typename Voxel>
+int findOpaqueRuns(const Voxel* voxel, int lineLen, const uchar (*rgba)[4], uint16_t* dst)
+{
+   int count = 0;
+   for (int x=0; x<lineLen; )
+   {
+      int begin = x;
+      while (x<lineLen && rgba[voxel[x]][3]==0) ++x;
+      if (x == lineLen) break;
+      count = putRunLength(x - begin, dst, count);
+      begin = x;
+      while (x<lineLen && rgba[voxel[x]][3]>0) ++x;
+      count = putRunLength(x - begin, dst, count);
+   }
+   return count;
+}
+
+}
+
 //----------------------------------------------------------------------------
 /// Constructor.
 vvSoftVR::vvSoftVR(vvVolDesc* vd, vvRenderState rs) : vvRenderer(vd, rs)
     , principal(virvo::cartesian_axis< 3 >::X)
+    , secondary(virvo::cartesian_axis< 3 >::Y)
 {
    int i;
 
@@ -62,10 +122,11 @@ vvSoftVR::vvSoftVR(vvVolDesc* vd, vvRenderState rs) : vvRenderer(vd, rs)
    // Initialize variables:
    xClipNormal = vec3(0.0f, 0.0f, 1.0f);
    xClipDist = 0.0f;
-   numProc = vvToolshed::getNumProcessors();
+   clipping = false;
+   numProc = (int)virvo::numWorkerThreads();
    len[0] = len[1] = len[2] = 0;
-   compression = false;
-   multiprocessing = false;
+   compression = true;
+   multiprocessing = true;
    sliceInterpol = true;
    warpInterpol = true;
    sliceBuffer = true;
@@ -76,6 +137,9 @@ vvSoftVR::vvSoftVR(vvVolDesc* vd, vvRenderState rs) : vvRenderer(vd, rs)
    quality = 1.f;
    _timing = false;
    _size = vd->getSize();
+   preIntCache = new virvo::PreintCache();
+   tfEntries = 0;
+   convFirst = convLast = 0;
 
    //  setWarpMode(SOFTWARE);     // initialize warp mode
    setWarpMode(TEXTURE);
@@ -85,19 +149,13 @@ vvSoftVR::vvSoftVR(vvVolDesc* vd, vvRenderState rs) : vvRenderer(vd, rs)
    vWidth = vHeight = -1;
    setOutputImageSize();
 
-   // Generate x and y axis representations:
+   // The axis representations are generated when they are first needed:
+   raw = NULL;
+   rawBPV = virvo::AxisCache::getBPV(vd);
+   axisCache.reset(new virvo::AxisCache());
    for (i=0; i<3; ++i)
    {
-      raw[i] = NULL;
-      rle[i] = NULL;
-      rleStart[i] = NULL;
-   }
-   findAxisRepresentations();
-   //  encodeRLE();
-
-   if (vd->getBPV() != 1)
-   {
-      cerr << "Shear-warp renderer can only display 8 bit scalar datasets." << endl;
+      rleSerial[i] = 0;
    }
 
    // Generate color LUTs:
@@ -109,14 +167,11 @@ vvSoftVR::vvSoftVR(vvVolDesc* vd, vvRenderState rs) : vvRenderer(vd, rs)
 /// Destructor.
 vvSoftVR::~vvSoftVR()
 {
-   int i;
-
    vvDebugMsg::msg(1, "vvSoftVR::~vvSoftVR()");
 
    delete outImg;
    delete intImg;
-   for (i=0; i<3; ++i)
-      delete[] raw[i];
+   delete preIntCache;
 }
 
 
@@ -133,8 +188,6 @@ void vvSoftVR::renderVolumeGL()
 
    vvDebugMsg::msg(3, "vvSoftPer::renderVolumeGL()");
 
-   if (vd->getBPV() != 1) return;                      // TODO: should work with all color depths
-
    if (_timing)
    {
       sw = new vvStopwatch();
@@ -174,6 +227,9 @@ void vvSoftVR::renderVolumeGL()
 
    compositeVolume();
 
+   // Build the data for the runner-up axis while the image is warped:
+   axisCache->prefetch(vd, secondary);
+
    if (_timing)
    {
       compositing = sw->getTime() - preparation;
@@ -210,7 +266,8 @@ void vvSoftVR::renderVolumeGL()
       warp = total - compositing - preparation;
       cerr << "Times [ms]: prep=" << (preparation*1000.0f) <<
          ", comp=" << (compositing*1000.0f) << ", warp=" <<
-         (warp * 1000.0f) << ", total=" << (total*1000.0f) << endl;
+         (warp * 1000.0f) << ", total=" << (total*1000.0f) <<
+         ", skipped opaque pixels=" << earlyRayTermination << endl;
       delete sw;
    }
 
@@ -219,6 +276,91 @@ void vvSoftVR::renderVolumeGL()
 }
 
 
+//----------------------------------------------------------------------------
+/** Composite a range of intermediate image lines, split into one band per
+  thread. The band boundaries are placed so that each band gets about the
+  same share of the compositing time measured per line in the previous frame.
+  The intermediate image has to be cleared before calling this method.
+  @param from,to first and last intermediate image line, -1 for all lines
+*/
+void vvSoftVR::compositeBands(int from, int to)
+{
+   vvDebugMsg::msg(3, "vvSoftVR::compositeBands(): ", from, to);
+
+   if (from == -1)
+   {
+      from = 0;
+      to   = intImg->height - 1;
+   }
+   from = ts_max(from, 0);
+   to   = ts_min(to, intImg->height - 1);
+   const int numLines = to - from + 1;
+   earlyRayTermination = 0;
+   if (numLines <= 0) return;
+
+   // Reset the links between opaque pixels:
+   if (compression)
+   {
+      opaqueSkip.assign(intImg->width * intImg->height, 0);
+   }
+   else
+   {
+      opaqueSkip.clear();
+   }
+
+   if ((int)lineCost.size() != intImg->height)
+   {
+      lineCost.assign(intImg->height, 0.0f);
+   }
+
+   const int numBands = (multiprocessing) ? ts_clamp(numProc, 1, numLines) : 1;
+   bands.resize(numBands);
+
+   // Every line gets a small base cost, so that empty lines are not all
+   // assigned to the same band when the image content moves:
+   float total = 0.0f;
+   for (int y=from; y<=to; ++y) total += lineCost[y];
+   const float base = (total > 0.0f) ? 0.1f * total / numLines : 1.0f;
+   total += base * numLines;
+
+   int y = from;
+   float sum = 0.0f;
+   for (int i=0; i<numBands; ++i)
+   {
+      const float target = total * float(i + 1) / float(numBands);
+      const int last = to - (numBands - 1 - i);   // leave at least one line for each remaining band
+      bands[i].from = y;
+      do
+      {
+         sum += lineCost[y] + base;
+         ++y;
+      }
+      while (y <= last && (i == numBands - 1 || sum + 0.5f * (lineCost[y] + base) < target));
+      bands[i].to = y - 1;
+   }
+
+   std::vector<float> bandTime(numBands);
+   virvo::parallel_for(0, numBands, [&](size_t first, size_t last)
+   {
+      for (size_t i=first; i<last; ++i)
+      {
+         vvStopwatch sw;
+         sw.start();
+         bands[i].earlyRayTermination = 0;
+         compositeBand(bands[i]);
+         bandTime[i] = sw.getTime();
+      }
+   });
+
+   for (int i=0; i<numBands; ++i)
+   {
+      const float cost = bandTime[i] / float(bands[i].to - bands[i].from + 1);
+      for (int l=bands[i].from; l<=bands[i].to; ++l) lineCost[l] = cost;
+      earlyRayTermination += bands[i].earlyRayTermination;
+   }
+}
+
+
 //----------------------------------------------------------------------------
 /** Render the outline of the volume to the intermediate image.
   The shear transformation matrices have to be computed before calling this method.
@@ -342,137 +484,183 @@ void vvSoftVR::findVolumeDimensions()
 
 
 //----------------------------------------------------------------------------
-/** Generate raw volume data for the principal axes.
-  @param data uchar data array of scalar values (need to be copied)
+/** Get the raw volume data for the current principal axis.
+  The first channel of the current frame is converted to indices into the
+  RGBA lookup table: 8 bit data is used as is, 16 bit and float data are
+  mapped to getLUTSize() entries like vvVolDesc::rescaleVoxel() does and
+  stored with two bytes per voxel.
+  The data are taken from the axis cache, which builds them if needed.
+  The classified RLE data are updated if they belong to other data.
 */
-void vvSoftVR::findAxisRepresentations()
+void vvSoftVR::findAxisRepresentation()
 {
-   size_t frameSize;                              // number of bytes per frame
-   size_t sliceVoxels;                            // number of voxels per slice
-   size_t offset;                                 // unit: voxels
-   size_t srcIndex;                               // unit: bytes
-   uint8_t* data;
-
-   vvDebugMsg::msg(3, "vvSoftVR::findAxisRepresentations()");
-
-   frameSize    = vd->getFrameBytes();
-   sliceVoxels  = vd->getSliceVoxels();
-   data = vd->getRaw();
-
-   // Raw data for z axis view:
-   delete[] raw[2];
-   raw[2] = new uint8_t[frameSize];
-   memcpy(raw[2], data, frameSize);
-
-   // Raw data for x axis view:
-   delete[] raw[0];
-   raw[0] = new uint8_t[frameSize];
-   size_t i=0;
-   for (ptrdiff_t x=vd->vox[0]-1; x>=0; --x)                // counts slices in x axis view
-      for (ssize_t z=0; z<vd->vox[2]; ++z)                  // counts height in x axis view
+   vvDebugMsg::msg(3, "vvSoftVR::findAxisRepresentation()");
+
+   raw    = axisCache->get(vd, principal);
+   rawBPV = virvo::AxisCache::getBPV(vd);
+
+   if (compression && raw != NULL && rleSerial[principal] != axisCache->getSerial(principal))
    {
-      offset = z * sliceVoxels + x;
-      for (ptrdiff_t y=vd->vox[1]-1; y>=0; --y)
-      {
-         srcIndex = (y * vd->vox[0] + offset) * vd->getBPV();
-         for (size_t c=0; c<vd->getBPV(); ++c)
-         {
-            raw[0][i] = data[srcIndex + c];
-            ++i;
-         }
-      }
+      encodeRLE(principal);
    }
+}
 
-   // Raw data for y axis view:
-   if (raw[1]!=NULL) delete[] raw[1];
-   raw[1] = new uint8_t[frameSize];
-   i=0;
-   for (ssize_t y=0; y<vd->vox[1]; ++y)
-   {
-      for (ptrdiff_t x=vd->vox[0]-1; x>=0; --x)
+
+//----------------------------------------------------------------------------
+/** Find the runner-up viewing axis, whose data are built in the background.
+  @param dir viewing direction in object space
+*/
+void vvSoftVR::findSecondaryAxis(const vec3& dir)
+{
+   vvDebugMsg::msg(3, "vvSoftVR::findSecondaryAxis()");
+
+   typedef virvo::cartesian_axis< 3 > axis_type;
+
+   const int a = (principal + 1) % 3;
+   const int b = (principal + 2) % 3;
+   secondary = axis_type::label((fabs(dir[a]) >= fabs(dir[b])) ? a : b);
+}
+
+
+//----------------------------------------------------------------------------
+/** Run length encode the classified volume data of the current axis representation.
+  For every voxel line, the runs of voxels which are not transparent under
+  the current transfer function are stored as 16 bit run lengths: the
+  number of transparent voxels before each run, followed by the length of
+  the run. The compositing functions skip everything between the runs.
+  This has to be repeated whenever the volume data or the set of
+  transparent scalar values changes.
+  @param axis principal axis the data in raw belong to
+*/
+void vvSoftVR::encodeRLE(int axis)
+{
+   vvStopwatch sw;
+
+   vvDebugMsg::msg(1, "vvSoftVR::encodeRLE()", axis);
+
+   sw.start();
+
+   const int lineLen  = int(vd->vox[(axis+1)%3]);
+   const int numLines = int(vd->vox[axis] * vd->vox[(axis+2)%3]);
+   const uchar* src8  = raw;
+   const uint16_t* src16 = reinterpret_cast<const uint16_t*>(raw);
+   std::vector<uint16_t>& runs = opacityRuns[axis];
+   std::vector<int>& lines     = opacityLines[axis];
+
+   runs.clear();
+   lines.resize(numLines + 1);
+   lines[0] = 0;
+
+   // First pass: count the runs of each line, second pass: store them.
+   for (int pass=0; pass<2; ++pass)
    {
-      offset = x + y * vd->vox[0];
-      for (ptrdiff_t z=vd->vox[2]-1; z>=0; --z)
+      virvo::parallel_for(0, numLines, [&](size_t first, size_t last)
       {
-         srcIndex = (offset + z * sliceVoxels) * vd->getBPV();
-         for (size_t c=0; c<vd->getBPV(); ++c)
+         for (size_t l=first; l<last; ++l)
          {
-            raw[1][i] = data[srcIndex + c];
-            ++i;
+            uint16_t* dst = (pass == 0) ? NULL : &runs[lines[l]];
+            const int count = (rawBPV == 1)
+               ? findOpaqueRuns(src8 + l * lineLen, lineLen, rgbaConv, dst)
+               : findOpaqueRuns(src16 + l * lineLen, lineLen, rgbaConv, dst);
+            if (pass == 0) lines[l + 1] = count;
          }
+      }, 256);
+
+      if (pass == 0)
+      {
+         for (int l=0; l<numLines; ++l) lines[l + 1] += lines[l];
+         runs.resize(lines[numLines]);
       }
    }
+   rleSerial[axis] = axisCache->getSerial(axis);
+
+   if (_timing)
+   {
+      cerr << "Classified RLE [ms]: " << (sw.getTime() * 1000.0f) << ", runs=" << (runs.size() / 2) << endl;
    }
 }
 
 
 //----------------------------------------------------------------------------
-/** Run length encode the volume data.
-  Encoding scheme: X is first byte.<UL>
-  <LI>if X>0: copy next X voxels</LI>
-  <LI>if X<0: repeat next voxel X times</LI>
-  <LI>if X=0: done</LI></UL>
-  Runs of same voxels must contain at least 3 voxels.
+/** Find the non-transparent voxel runs of one or more neighboring lines of a
+  slice, using the classified RLE data of the current principal axis.
+  The runs of all lines are merged, so a voxel column is part of the result
+  if it is not transparent on any of the lines.
+  Without RLE data, the result is the whole line.
+  @param slice     slice index [permuted value]
+  @param firstLine first voxel line
+  @param lastLine  last voxel line
+  @param grow      number of voxels to extend every run on both sides
+  @param band      receives the runs as pairs of begin and end indices in band.runs
 */
-void vvSoftVR::encodeRLE()
+void vvSoftVR::findVoxelRuns(int slice, int firstLine, int lastLine, int grow, Band& band) const
 {
-   size_t lineSize;                               // number of bytes per line
-   uint8_t* src;                                  // pointer to unencoded array
-   uint8_t* dst;                                  // pointer to encoded array
-   int i,j;
-   size_t len;                                    // length of encoded data [bytes]
-   size_t rest;                                   // number of bytes remaining in buffer
-   virvo::vector< 3, size_t > numvox;             // object dimensions (x,y,z) [voxels]
+   const std::vector<int>& lines     = opacityLines[principal];
+   const std::vector<uint16_t>& runs = opacityRuns[principal];
 
-   vvDebugMsg::msg(1, "vvSoftVR::encodeRLE()");
+   band.runs.clear();
 
-   if (vd->getBPV() != 1) return;                      // TODO: enhance for other data types
-
-   numvox = virvo::vector< 3, size_t >(vd->vox);
-
-   vvDebugMsg::msg(1, "Original volume size: ", static_cast<int>(vd->getFrameBytes()));
-
-   // Prepare 3 sets of compressed data, one for each principal axis:
-   for (i=0; i<3; ++i)
+   if (!compression || lines.empty())
    {
-      delete[] rleStart[i];
-      delete[] rle[i];
-      rle[i] = new uchar[vd->getFrameBytes()];     // reserve as much RAM as in uncompressed case
-      rleStart[i] = new uchar*[numvox[i] * numvox[(i+2)%3]];
+      band.runs.push_back(0);
+      band.runs.push_back(len[0]);
+      return;
    }
 
-   // Now compress the data:
-   for (i=0; i<3; ++i)
+   firstLine = ts_max(firstLine, 0);
+   lastLine  = ts_min(lastLine, len[1] - 1);
+   for (int l=firstLine; l<=lastLine; ++l)
    {
-      src = raw[i];
-      dst = rle[i];
-      rest = vd->getFrameBytes();
-      lineSize = numvox[(i+1)%3];
-
-      for (size_t a=0; a<numvox[i]; ++a)
-         for (size_t b=0; b<numvox[(i+2)%3]; ++b)
-      {
-         rleStart[i][a * numvox[(i+2)%3] + b] = dst;
-         vvToolshed::encodeRLE(dst, src, numvox[(i+1)%3], vd->getBPV(), rest, &len);
-         dst  += len;
-         rest -= len;
-         src  += lineSize;
-      }
-      if (vvDebugMsg::isActive(1))
+      const int line = slice * len[1] + l;
+      int a = 0;                                  // position in band.runs
+      int b = lines[line];                        // position in runs
+      const int bEnd = lines[line + 1];
+      int pos = 0;                                // end of the last decoded run of this line
+      int runBegin = 0, runEnd = 0;               // next non-empty run of this line
+
+      // Decode the next non-empty run of this line from its run lengths:
+      auto nextRun = [&]() -> bool
       {
-         cerr << "Compressed size: " << dst-rle[i] << " = " << (dst-rle[i])*100.0/vd->getFrameBytes() << " %" << endl;
-         cerr << "rest = " << rest << endl;
-      }
-      if (rest<=0)
+         while (b < bEnd)
+         {
+            runBegin = pos + runs[b];
+            runEnd   = runBegin + runs[b + 1];
+            pos = runEnd;
+            b += 2;
+            if (runEnd > runBegin) return true;
+         }
+         return false;
+      };
+      bool haveRun = nextRun();
+
+      // Merge the runs of this line with the runs collected so far:
+      band.runsTmp.clear();
+      while (a < (int)band.runs.size() || haveRun)
       {
-         for (j=0; j<3; ++j)
+         int begin, end;
+         if (!haveRun || (a < (int)band.runs.size() && band.runs[a] <= runBegin - grow))
+         {
+            begin = band.runs[a];
+            end   = band.runs[a + 1];
+            a += 2;
+         }
+         else
+         {
+            begin = ts_max(runBegin - grow, 0);
+            end   = ts_min(runEnd + grow, len[0]);
+            haveRun = nextRun();
+         }
+         if (!band.runsTmp.empty() && begin <= band.runsTmp.back())
+         {
+            band.runsTmp.back() = ts_max(band.runsTmp.back(), end);
+         }
+         else
          {
-            delete[] rleStart[j];
-            rleStart[j] = NULL;
+            band.runsTmp.push_back(begin);
+            band.runsTmp.push_back(end);
          }
-         vvDebugMsg::msg(1, "RLE compression ineffective");
-         return;
       }
+      band.runs.swap(band.runsTmp);
    }
 }
 
@@ -483,9 +671,21 @@ void vvSoftVR::updateTransferFunction()
 {
    vvDebugMsg::msg(1, "vvSoftVR::updateTransferFunction()");
 
-   int lutEntries = getLUTSize();
+   const int lutEntries = getLUTSize();
 
-   vd->computeTFTexture(lutEntries, 1, 1, rgbaTF);
+   std::vector<float> lut(lutEntries * 4);
+   vd->computeTFTexture(lutEntries, 1, 1, &lut[0]);
+
+   // Only the changed part has to be converted
+   size_t first, last;
+   getChangedTFEntries(lutEntries, tfEntries == lutEntries ? rgbaTF : NULL, &lut[0], first, last);
+   std::copy(lut.begin() + first * 4, lut.begin() + last * 4, rgbaTF + first * 4);
+   if (first < last)
+   {
+      convFirst = convFirst < convLast ? ts_min(convFirst, int(first)) : int(first);
+      convLast = ts_max(convLast, int(last));
+   }
+   tfEntries = lutEntries;
 
    updateLUT(1.f);
 }
@@ -494,11 +694,27 @@ void vvSoftVR::updateLUT(float dist)
 {
    vvDebugMsg::msg(1, "vvSoftVR::updateLUT()", dist);
 
-   const int lutEntries = getLUTSize();
-   // Copy RGBA values to internal array:
-   for (int i=0; i<lutEntries; ++i)
+   // Copy changed RGBA values to internal array:
+   bool reclassified = false;                     // true if a scalar value became transparent or visible
+   for (int i=convFirst; i<convLast; ++i)
+   {
+      const uchar alpha = (uchar)(rgbaTF[i*4+3] * 255.0f);
+      if ((alpha > 0) != (rgbaConv[i][3] > 0)) reclassified = true;
       for (int c=0; c<4; ++c)
+      {
          rgbaConv[i][c] = (uchar)(rgbaTF[i*4+c] * 255.0f);
+         rgbaFloat[i][c] = (float)rgbaConv[i][c] / 255.0f;
+      }
+   }
+   convFirst = convLast = 0;
+
+   // The classified RLE data depends on the transparent scalar values,
+   // it is computed again when an axis is rendered the next time:
+   if (reclassified)
+   {
+      for (int i=0; i<3; ++i)
+         rleSerial[i] = 0;
+   }
 
    // Make pre-integrated LUT:
    if (_preIntegration)
@@ -544,7 +760,7 @@ of the principal viewing axis (defaults to 1.0)
 */
 void vvSoftVR::makeLookupTextureCorrect(float thickness)
 {
-   vd->tf[0].makePreintLUTCorrect(PRE_INT_TABLE_SIZE, &preIntTable[0][0][0], thickness);
+   vd->tf[0].makePreintLUTCorrect(PRE_INT_TABLE_SIZE, &preIntTable[0][0][0], thickness, 0.0f, 1.0f, preIntCache);
 }
 
 
@@ -582,7 +798,7 @@ of the principal viewing axis (defaults to 1.0)
 */
 void vvSoftVR::makeLookupTextureOptimized(float thickness)
 {
-   vd->tf[0].makePreintLUTOptimized(PRE_INT_TABLE_SIZE, &preIntTable[0][0][0], thickness);
+   vd->tf[0].makePreintLUTOptimized(PRE_INT_TABLE_SIZE, &preIntTable[0][0][0], thickness, 0.0f, 1.0f, preIntCache);
 }
 
 
@@ -590,7 +806,11 @@ void vvSoftVR::makeLookupTextureOptimized(float thickness)
 // See parent for comments.
 void vvSoftVR::updateVolumeData()
 {
-   findAxisRepresentations();
+   vvRenderer::updateVolumeData();
+
+   axisCache->clear();                            // the data may have been modified without a new revision
+   rawBPV = virvo::AxisCache::getBPV(vd);
+   if (tfEntries != getLUTSize()) updateTransferFunction();   // data type has changed
 }
 
 
@@ -610,7 +830,7 @@ bool vvSoftVR::instantClassification() const
 int vvSoftVR::getLUTSize()
 {
    vvDebugMsg::msg(2, "vvSoftVR::getLUTSize()");
-   return (vd->getBPV()==2) ? 4096 : 256;
+   return virvo::AxisCache::getLUTSize(vd);
 }
 
 
@@ -866,25 +1086,6 @@ void vvSoftVR::findClipPlaneEquation()
 }
 
 
-//----------------------------------------------------------------------------
-/** Tests if a voxel [permuted voxel space] is clipped by the clipping plane.
-  @param x,y,z  voxel coordinates
-  @returns true if voxel is clipped, false if it is visible
-*/
-bool vvSoftVR::isVoxelClipped(int x, int y, int z)
-{
-   vvDebugMsg::msg(3, "vvSoftVR::isClipped()");
-
-   if (!getParameter(VV_CLIP_MODE)) return false;
-
-   if (xClipNormal[0] * (float)x + xClipNormal[1] *
-      (float)y + xClipNormal[2] * (float)z > xClipDist)
-      return true;
-   else
-      return false;
-}
-
-
 //----------------------------------------------------------------------------
 /** Set warp mode.
   @param warpMode find valid warp modes in enum WarpType
@@ -909,15 +1110,14 @@ vvSoftVR::WarpType vvSoftVR::getWarpMode()
 
 //----------------------------------------------------------------------------
 /** Set new frame number.
-  Additionally to the call to the superclass, the axis representations
-  have to be re-computed.
+  The axis representations of the new frame are built when the frame
+  is rendered.
   @see vvRenderer#setCurrentFrame(int)
 */
 void vvSoftVR::setCurrentFrame(size_t index)
 {
    vvDebugMsg::msg(3, "vvSoftVR::setCurrentFrame()");
    vvRenderer::setCurrentFrame(index);
-   findAxisRepresentations();
 }
 
 
@@ -975,6 +1175,23 @@ void vvSoftVR::getIntermediateImageExtent(int* xmin, int* xmax, int* ymin, int*
 }
 
 
+//----------------------------------------------------------------------------
+/** Use the axis representations of another renderer of the same volume,
+  so that they are kept in memory and built only once.
+  @param other renderer to share the axis cache with
+*/
+void vvSoftVR::shareAxisCache(vvSoftVR* other)
+{
+   vvDebugMsg::msg(3, "vvSoftVR::shareAxisCache()");
+
+   if (other == NULL || other->vd != vd || other->axisCache == axisCache) return;
+
+   axisCache = other->axisCache;
+   for (int i=0; i<3; ++i)
+      rleSerial[i] = 0;
+}
+
+
 //----------------------------------------------------------------------------
 /** Prepare the rendering of the intermediate image: check projection type,
     factor view matrix, etc.
@@ -1018,7 +1235,10 @@ bool vvSoftVR::prepareRendering()
    findViewMatrix();
    factorViewMatrix();                            // do the factorization
    findVolumeDimensions();                        // precompute the permuted volume dimensions
-   if (getParameter(VV_CLIP_MODE)) findClipPlaneEquation();         // prepare clipping plane processing
+   findAxisRepresentation();                      // get the volume data for the principal axis
+   if (raw == NULL) return false;
+   clipping = getParameter(VV_CLIP_MODE);         // hoisted out of the compositing loops
+   if (clipping) findClipPlaneEquation();         // prepare clipping plane processing
 
    // Set interpolation types:
    intImg->setWarpInterpolation(warpInterpol);
@@ -1115,6 +1335,9 @@ void vvSoftVR::setParameter(ParameterType param, const vvParam& value)
          opCorr = value;
          cerr << "opCorr set to " << int(opCorr) << endl;
          break;
+      case vvRenderer::VV_AXIS_COPIES:
+         axisCache->setCapacity(size_t(ts_max(value.asInt(), 1)));
+         break;
       default:
          vvRenderer::setParameter(param, value);
          break;
@@ -1146,6 +1369,8 @@ vvParam vvSoftVR::getParameter(ParameterType param) const
 #endif
       case vvRenderer::VV_OPCORR:
          return opCorr;
+      case vvRenderer::VV_AXIS_COPIES:
+         return int(axisCache->getCapacity());
       default:
          return vvRenderer::getParameter(param);
    }
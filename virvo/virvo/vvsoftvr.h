@@ -21,6 +21,10 @@
 #ifndef VV_SOFTVR_H
 #define VV_SOFTVR_H
 
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
 #include "math/math.h"
 #include "vvexport.h"
 #include "vvrenderer.h"
@@ -28,6 +32,12 @@
 class vvImage;
 class vvSoftImg;
 
+namespace virvo
+{
+  class AxisCache;
+  class PreintCache;
+}
+
 #ifdef HAVE_CONFIG_H
 #include "vvconfig.h"
 #endif
@@ -37,8 +47,11 @@ class vvSoftImg;
   parallel (vvSoftPar) and perspective (vvSoftPer) projection variants,
   and it contains routines which are common to the above subclasses.
 
-  The volume data are kept in memory three times, once for each principal
-  axis. The permutations of coordinate axes are as follows:
+  The volume data are permuted for each principal axis. Only the first
+  channel is kept, converted to lookup table indices. The permuted copies
+  are built on demand and kept by a virvo::AxisCache, which can be shared
+  by the renderers of a volume (see shareAxisCache()). The permutations of
+  coordinate axes are as follows:
 
   <PRE>
   Principal Axis    Coordinate System    Permutation Matrix
@@ -83,8 +96,26 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
       {
          PRE_INT_TABLE_SIZE = 256
       };
+      /** Range of intermediate image lines composited by one thread.
+        Each band keeps its own pre-integration buffers, so bands can be
+        composited independently of each other.
+      */
+      struct Band
+      {
+         int from;                                ///< first intermediate image line
+         int to;                                  ///< last intermediate image line
+         int earlyRayTermination;                 ///< early ray termination counter for this band
+         std::vector<float> bufSlice[2];          ///< buffer slices for preintegrated rendering
+         int bufOffset;                           ///< intermediate image line stored in the first row of bufSlice
+         int readSlice;                           ///< index of buffer slice currently used for reading [0..1]
+         int lastIPos[2];                         ///< last slice position on the intermediate image
+         std::vector<int> runs;                   ///< non-transparent voxel runs of the current line, see findVoxelRuns()
+         std::vector<int> runsTmp;                ///< scratch buffer for findVoxelRuns()
+      };
       vvSoftImg* outImg;                          ///< output image
-      uchar* raw[3];                              ///< scalar voxel field for principle viewing axes (x, y, z)
+      const uchar* raw;                           ///< lookup table indices of the voxels for the current principal viewing axis, set by prepareRendering()
+      boost::shared_ptr<virvo::AxisCache> axisCache; ///< permuted copies of the volume data, may be shared with other renderers
+      size_t rawBPV;                              ///< bytes per voxel in raw: 1 = 8 bit indices, 2 = 16 bit indices
       virvo::mat4 owView;                         ///< viewing transformation matrix from object space to world space
       virvo::mat4 osPerm;                         ///< permutation matrix
       virvo::mat4 wvConv;                         ///< conversion from world space to OpenGL viewport space
@@ -95,16 +126,24 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
       int vHeight;                                ///< OpenGL viewport height [pixels]
       int len[3];                                 ///< volume dimensions in standard object space (x,y,z)
       virvo::cartesian_axis< 3 > principal;       ///< principal viewing axis
+      virvo::cartesian_axis< 3 > secondary;       ///< runner-up viewing axis, its copy is built in the background
       bool stacking;                              ///< slice stacking order; true=front to back
       WarpType warpMode;                          ///< current warp mode
       float rgbaTF[4096*4];                       ///< transfer function lookup table
-      uchar rgbaConv[4096][4];                    ///< density to RGBA conversion table (max. 8 bit density supported) [scalar values][RGBA]
+      uchar rgbaConv[4096][4];                    ///< density to RGBA conversion table, getLUTSize() entries [scalar values][RGBA]
+      float rgbaFloat[4096][4];                   ///< rgbaConv scaled to [0..1], used by the compositing kernels
+      int tfEntries;                              ///< number of valid entries in rgbaTF
+      int convFirst;                              ///< first entry of rgbaConv that differs from rgbaTF
+      int convLast;                               ///< last entry of rgbaConv that differs from rgbaTF, exclusive
       virvo::vec3 xClipNormal;                    ///< clipping plane normal in permuted voxel coordinate system
       float xClipDist;                            ///< clipping plane distance in permuted voxel coordinate system
-      uchar** rleStart[3];                        ///< pointer lists to line beginnings, for each principal viewing axis (x,y,z). If first entry is NULL, there is no RLE compressed volume data
-      uchar* rle[3];                              ///< RLE encoded volume data for each principal viewing axis (x,y,z)
-      int numProc;                                ///< number of processors in system
-      bool compression;                           ///< true = use compressed volume data for rendering
+      bool clipping;                              ///< clip mode of the current frame, set by prepareRendering()
+      std::vector<uint16_t> opacityRuns[3];       ///< classified RLE: per voxel line, transparent and non-transparent run lengths in turns, for each principal viewing axis (x,y,z)
+      std::vector<int> opacityLines[3];           ///< index of the first run length of each voxel line in opacityRuns, plus one entry for the end. Empty if there is no RLE data
+      size_t rleSerial[3];                        ///< serial number of the axis copy the RLE data were computed from, 0 if outdated (see virvo::AxisCache::getSerial())
+      std::vector<int> opaqueSkip;                ///< per intermediate image pixel: number of following pixels known to be opaque, 0 if not opaque
+      int numProc;                                ///< number of compositing threads
+      bool compression;                           ///< true = skip transparent voxel runs and opaque intermediate image pixels
       bool multiprocessing;                       ///< true = use multiprocessing where possible
       bool sliceInterpol;                         ///< inter-slice interpolation mode: true=bilinear interpolation (default), false=nearest neighbor
       bool warpInterpol;                          ///< warp interpolation: true=bilinear, false=nearest neighbor
@@ -115,14 +154,19 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
       float oldQuality;                           ///< previous image quality
                                                   ///< size of pre-integrated LUT ([sf][sb][RGBA])
       uchar preIntTable[PRE_INT_TABLE_SIZE][PRE_INT_TABLE_SIZE][4];
+      virvo::PreintCache* preIntCache;            ///< transfer function preIntTable was computed from
       int earlyRayTermination;                    ///< counter for number of voxels which are skipped due to early ray termination
+      std::vector<Band> bands;                    ///< intermediate image bands composited in parallel
+      std::vector<float> lineCost;                ///< compositing time per intermediate image line in the previous frame [s]
       bool _timing;
       virvo::vec3 _size;
 
       void setOutputImageSize();
       void findVolumeDimensions();
-      virtual void findAxisRepresentations();
-      void encodeRLE();
+      void findAxisRepresentation();
+      void findSecondaryAxis(const virvo::vec3&);
+      void encodeRLE(int);
+      void findVoxelRuns(int, int, int, int, Band&) const;
       int  getLUTSize();
       void findViewMatrix();
       void findPermutationMatrix();
@@ -130,12 +174,71 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
       void findSlicePosition(int, virvo::vec4*, virvo::vec4*);
       void findSlicePosition(int, virvo::vec3*, virvo::vec3*);
       void findClipPlaneEquation();
-      bool isVoxelClipped(int, int, int);
+
+      /** Tests if a voxel [permuted voxel space] is clipped by the clipping plane.
+        Uses the clip mode stored by prepareRendering(), so it is cheap enough
+        to be called per voxel.
+        @param x,y,z  voxel coordinates
+        @returns true if voxel is clipped, false if it is visible
+      */
+      bool isVoxelClipped(int x, int y, int z) const
+      {
+         return clipping && xClipNormal[0] * (float)x + xClipNormal[1] * (float)y +
+            xClipNormal[2] * (float)z > xClipDist;
+      }
       void compositeOutline();
       virtual int  getCullingStatus(float);
       virtual void factorViewMatrix() = 0;
       virtual void setQuality(float q);
       virtual void updateLUT(float dist);
+      void compositeBands(int, int);
+      virtual void compositeBand(Band&) = 0;
+
+      /** Skip intermediate image pixels which are already opaque.
+        Follows the links in opaqueSkip and shortens the path for later calls.
+        @param pixel first pixel to check (index into the intermediate image)
+        @param end   first pixel after the span of interest, on the same line
+        @return first pixel in [pixel,end) which is not opaque, or end
+      */
+      int skipOpaquePixels(int pixel, int end, Band& band)
+      {
+         if (opaqueSkip.empty()) return pixel;
+         int p = pixel;
+         while (p < end && opaqueSkip[p] > 0) p += opaqueSkip[p];
+         for (int q = pixel; q < p; )
+         {
+            const int next = q + opaqueSkip[q];
+            opaqueSkip[q] = p - q;
+            q = next;
+         }
+         if (p > end) p = end;
+         band.earlyRayTermination += p - pixel;
+         return p;
+      }
+
+      /** Composite a voxel to an intermediate image pixel with the UNDER operator.
+        The four channels are processed in one loop, which the compiler maps to
+        vector instructions.
+        @param iPixel intermediate image pixel (RGBA)
+        @param v      voxel color components [0..1], v[3] is not used
+        @param va     voxel opacity [0..1]
+      */
+      static void compositeUnder(uchar* iPixel, const float* v, float va)
+      {
+         const float ia1 = 1.0f - (float)iPixel[3] / 255.0f;
+         const float vc[4] = { v[0], v[1], v[2], 1.0f };
+         for (int c=0; c<4; ++c)
+         {
+            const float tmp = 255.0f * ((float)iPixel[c] / 255.0f + ia1 * vc[c] * va);
+            iPixel[c] = (uchar)(tmp < 255.0f ? tmp : 255.0f);
+         }
+      }
+
+      /// Mark an intermediate image pixel as opaque, so that skipOpaquePixels() skips it.
+      void markOpaque(int pixel)
+      {
+         if (!opaqueSkip.empty()) opaqueSkip[pixel] = 1;
+      }
 
    public:
       vvSoftImg* intImg;                          ///< intermediate image
@@ -158,6 +261,7 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
       virtual vvParam getParameter(ParameterType param) const;
       virtual void compositeVolume(int = -1, int = -1) = 0;
       virtual void getIntermediateImageExtent(int*, int*, int*, int*);
+      void     shareAxisCache(vvSoftVR*);
 };
 #endif
 
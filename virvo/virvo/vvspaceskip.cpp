@@ -75,6 +75,25 @@ void SkipTree::updateTransfunc(const uint8_t* data,
   }
 }
 
+void SkipTree::updateTransfuncRange(const uint8_t* data,
+        int numEntries,
+        int first,
+        int last,
+        PixelFormat format)
+{
+  using namespace visionaray;
+
+  if (format == PF_RGBA32F)
+  {
+    texture_ref<visionaray::vec4, 1> transfunc(numEntries);
+    transfunc.reset(reinterpret_cast<const visionaray::vec4*>(data));
+    transfunc.set_address_mode(Clamp);
+    transfunc.set_filter_mode(Nearest);
+
+    impl_->kdtree.updateTransfunc(transfunc, numEntries, first, last);
+  }
+}
+
 std::vector<aabb> SkipTree::getSortedBricks(vec3 eye, bool frontToBack)
 {
   std::vector<aabb> result;
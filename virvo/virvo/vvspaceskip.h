@@ -62,6 +62,16 @@ namespace virvo
         int numEntriesZ = 1, // for 3D TF
         PixelFormat format = PF_RGBA32F);
 
+    /**
+     * @brief Update after the 1D TF entries [first,last) changed, only
+     *        rebuilds the parts of the tree that depend on them
+     */
+    VVAPI void updateTransfuncRange(const uint8_t* data,
+        int numEntries,
+        int first,
+        int last,
+        PixelFormat format = PF_RGBA32F);
+
     /**
      * @brief Produce a sorted list of bricks that contain non-empty voxels
      */
@@ -0,0 +1,322 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <cassert>
+#include <cstring> // memcmp, memcpy
+#include <limits>
+
+#include "private/parallel_for.h"
+#include "vvsparseframe.h"
+#include "vvtoolshed.h"
+
+namespace virvo
+{
+
+  //--- Helpers ---------------------------------------------------------------
+
+  namespace
+  {
+    ssize_t div_up(ssize_t a, ssize_t b)
+    {
+      return (a + b - 1) / b;
+    }
+  }
+
+
+  //--- Interface -------------------------------------------------------------
+
+  const uint32_t SparseFrame::EMPTY_BLOCK = std::numeric_limits<uint32_t>::max();
+
+  const size_t SparseFrame::DEFAULT_BLOCK_SIZE = 16;
+
+  SparseFrame::SparseFrame()
+    : vox_(ssize_t(0))
+    , bpv_(0)
+    , blockSize_(DEFAULT_BLOCK_SIZE)
+    , numBlocks_(ssize_t(0))
+  {
+  }
+
+  SparseFrame::SparseFrame(const uint8_t* data,
+      vector< 3, ssize_t > const& vox,
+      size_t bpv,
+      size_t blockSize,
+      const uint8_t* background)
+    : vox_(vox)
+    , bpv_(bpv)
+    , blockSize_(blockSize)
+  {
+    assert(blockSize_ > 0);
+
+    background_.resize(bpv_, 0);
+    if (background != NULL)
+      std::copy(background, background + bpv_, background_.begin());
+
+    const ssize_t bs = static_cast<ssize_t>(blockSize_);
+    numBlocks_ = vector< 3, ssize_t >(div_up(vox[0], bs), div_up(vox[1], bs), div_up(vox[2], bs));
+    index_.resize(numBlocks_[0] * numBlocks_[1] * numBlocks_[2], EMPTY_BLOCK);
+
+    const size_t lineBytes = vox_[0] * bpv_;
+    const size_t sliceBytes = lineBytes * vox_[1];
+
+    // Find blocks with voxels that differ from the background,
+    // rows of blocks are processed in parallel
+    std::vector< uint8_t > used(index_.size(), 0);
+
+    parallel_for(0, numBlocks_[1] * numBlocks_[2], [&](size_t first, size_t last)
+    {
+      for (size_t row = first; row < last; ++row)
+      {
+        const ssize_t by = row % numBlocks_[1];
+        const ssize_t bz = row / numBlocks_[1];
+        for (ssize_t bx = 0; bx < numBlocks_[0]; ++bx)
+        {
+          bool isUsed = false;
+          for (ssize_t z = bz * bs; z < std::min((bz + 1) * bs, vox_[2]) && !isUsed; ++z)
+          {
+            for (ssize_t y = by * bs; y < std::min((by + 1) * bs, vox_[1]) && !isUsed; ++y)
+            {
+              const uint8_t* src = data + z * sliceBytes + y * lineBytes + bx * bs * bpv_;
+              const ssize_t w = std::min(bs, vox_[0] - bx * bs);
+              for (ssize_t x = 0; x < w; ++x, src += bpv_)
+              {
+                if (memcmp(src, &background_[0], bpv_) != 0)
+                {
+                  isUsed = true;
+                  break;
+                }
+              }
+            }
+          }
+          used[row * numBlocks_[0] + bx] = isUsed ? 1 : 0;
+        }
+      }
+    });
+
+    // Assign storage to non-empty blocks
+    uint32_t numUsed = 0;
+    for (size_t i = 0; i < index_.size(); ++i)
+    {
+      if (used[i])
+        index_[i] = numUsed++;
+    }
+
+    // Copy voxel data, pad border blocks with the background value
+    blocks_.resize(numUsed * blockBytes());
+    for (size_t i = 0; i < blocks_.size(); i += bpv_)
+      memcpy(&blocks_[i], &background_[0], bpv_);
+
+    parallel_for(0, numBlocks_[1] * numBlocks_[2], [&](size_t first, size_t last)
+    {
+      for (size_t row = first; row < last; ++row)
+      {
+        const ssize_t by = row % numBlocks_[1];
+        const ssize_t bz = row / numBlocks_[1];
+        for (ssize_t bx = 0; bx < numBlocks_[0]; ++bx)
+        {
+          uint32_t idx = index_[row * numBlocks_[0] + bx];
+          if (idx == EMPTY_BLOCK)
+            continue;
+
+          uint8_t* block = &blocks_[idx * blockBytes()];
+          const ssize_t w = std::min(bs, vox_[0] - bx * bs);
+          for (ssize_t z = bz * bs; z < std::min((bz + 1) * bs, vox_[2]); ++z)
+          {
+            for (ssize_t y = by * bs; y < std::min((by + 1) * bs, vox_[1]); ++y)
+            {
+              const uint8_t* src = data + z * sliceBytes + y * lineBytes + bx * bs * bpv_;
+              uint8_t* dst = block + ((z - bz * bs) * bs + (y - by * bs)) * bs * bpv_;
+              memcpy(dst, src, w * bpv_);
+            }
+          }
+        }
+      }
+    });
+  }
+
+  void SparseFrame::toDense(uint8_t* dst) const
+  {
+    const ssize_t bs = static_cast<ssize_t>(blockSize_);
+    const size_t lineBytes = vox_[0] * bpv_;
+    const size_t sliceBytes = lineBytes * vox_[1];
+
+    parallel_for(0, vox_[2], [&](size_t first, size_t last)
+    {
+      for (ssize_t z = ssize_t(first); z < ssize_t(last); ++z)
+      {
+        const ssize_t bz = z / bs;
+        for (ssize_t y = 0; y < vox_[1]; ++y)
+        {
+          const ssize_t by = y / bs;
+          uint8_t* line = dst + z * sliceBytes + y * lineBytes;
+          for (ssize_t bx = 0; bx < numBlocks_[0]; ++bx)
+          {
+            const ssize_t w = std::min(bs, vox_[0] - bx * bs);
+            uint8_t* out = line + bx * bs * bpv_;
+            uint32_t idx = index_[(bz * numBlocks_[1] + by) * numBlocks_[0] + bx];
+            if (idx == EMPTY_BLOCK)
+            {
+              for (ssize_t x = 0; x < w; ++x, out += bpv_)
+                memcpy(out, &background_[0], bpv_);
+            }
+            else
+            {
+              const uint8_t* block = &blocks_[idx * blockBytes()];
+              memcpy(out, block + ((z - bz * bs) * bs + (y - by * bs)) * bs * bpv_, w * bpv_);
+            }
+          }
+        }
+      }
+    }, 4);
+  }
+
+  const uint8_t* SparseFrame::getVoxel(ssize_t x, ssize_t y, ssize_t z) const
+  {
+    const ssize_t bs = static_cast<ssize_t>(blockSize_);
+    const ssize_t bx = x / bs;
+    const ssize_t by = y / bs;
+    const ssize_t bz = z / bs;
+
+    uint32_t idx = index_[(bz * numBlocks_[1] + by) * numBlocks_[0] + bx];
+    if (idx == EMPTY_BLOCK)
+      return &background_[0];
+
+    return &blocks_[idx * blockBytes() + (((z - bz * bs) * bs + (y - by * bs)) * bs + (x - bx * bs)) * bpv_];
+  }
+
+  const uint8_t* SparseFrame::getVoxel(size_t indexXYZ) const
+  {
+    const size_t sliceVoxels = vox_[0] * vox_[1];
+    const ssize_t z = indexXYZ / sliceVoxels;
+    const ssize_t y = (indexXYZ % sliceVoxels) / vox_[0];
+    const ssize_t x = indexXYZ % vox_[0];
+    return getVoxel(x, y, z);
+  }
+
+  size_t SparseFrame::getNumNonEmptyBlocks() const
+  {
+    return blockBytes() > 0 ? blocks_.size() / blockBytes() : 0;
+  }
+
+  bool SparseFrame::isBlockEmpty(ssize_t bx, ssize_t by, ssize_t bz) const
+  {
+    return index_[(bz * numBlocks_[1] + by) * numBlocks_[0] + bx] == EMPTY_BLOCK;
+  }
+
+  basic_aabb< ssize_t > SparseFrame::getNonEmptyBounds() const
+  {
+    vector< 3, ssize_t > bmin(numBlocks_);
+    vector< 3, ssize_t > bmax(ssize_t(0));
+
+    for (ssize_t bz = 0; bz < numBlocks_[2]; ++bz)
+    {
+      for (ssize_t by = 0; by < numBlocks_[1]; ++by)
+      {
+        for (ssize_t bx = 0; bx < numBlocks_[0]; ++bx)
+        {
+          if (isBlockEmpty(bx, by, bz))
+            continue;
+
+          vector< 3, ssize_t > b(bx, by, bz);
+          bmin = min(bmin, b);
+          bmax = max(bmax, b + vector< 3, ssize_t >(ssize_t(1)));
+        }
+      }
+    }
+
+    if (bmax[0] <= bmin[0])
+      return basic_aabb< ssize_t >(vector< 3, ssize_t >(ssize_t(0)), vector< 3, ssize_t >(ssize_t(0)));
+
+    const ssize_t bs = static_cast<ssize_t>(blockSize_);
+    return basic_aabb< ssize_t >(bmin * bs, min(bmax * bs, vox_));
+  }
+
+  size_t SparseFrame::getBytes() const
+  {
+    return index_.size() * sizeof(uint32_t) + blocks_.size() + background_.size();
+  }
+
+  void SparseFrame::toggleEndianness(size_t bpc)
+  {
+    if (bpc != 2 && bpc != 4)
+      return;
+
+    for (size_t i = 0; i + bpc <= blocks_.size(); i += bpc)
+      std::reverse(&blocks_[i], &blocks_[i] + bpc);
+
+    for (size_t i = 0; i + bpc <= background_.size(); i += bpc)
+      std::reverse(&background_[i], &background_[i] + bpc);
+  }
+
+  bool SparseFrame::write(FILE* fp) const
+  {
+    serialization::write32(fp, static_cast<uint32_t>(blockSize_));
+    serialization::write32(fp, static_cast<uint32_t>(getNumNonEmptyBlocks()));
+
+    if (fwrite(&background_[0], 1, bpv_, fp) != bpv_)
+      return false;
+
+    for (size_t i = 0; i < index_.size(); ++i)
+      serialization::write32(fp, index_[i]);
+
+    if (!blocks_.empty() && fwrite(&blocks_[0], 1, blocks_.size(), fp) != blocks_.size())
+      return false;
+
+    return !ferror(fp);
+  }
+
+  bool SparseFrame::read(std::ifstream& in, vector< 3, ssize_t > const& vox, size_t bpv)
+  {
+    vox_ = vox;
+    bpv_ = bpv;
+    blockSize_ = serialization::read32(in);
+    size_t numUsed = serialization::read32(in);
+
+    if (blockSize_ == 0)
+      return false;
+
+    const ssize_t bs = static_cast<ssize_t>(blockSize_);
+    numBlocks_ = vector< 3, ssize_t >(div_up(vox[0], bs), div_up(vox[1], bs), div_up(vox[2], bs));
+
+    background_.resize(bpv_);
+    in.read(reinterpret_cast< char* >(&background_[0]), bpv_);
+
+    index_.resize(numBlocks_[0] * numBlocks_[1] * numBlocks_[2]);
+    for (size_t i = 0; i < index_.size(); ++i)
+    {
+      index_[i] = serialization::read32(in);
+      if (index_[i] != EMPTY_BLOCK && index_[i] >= numUsed)
+        return false;
+    }
+
+    blocks_.resize(numUsed * blockBytes());
+    if (!blocks_.empty())
+      in.read(reinterpret_cast< char* >(&blocks_[0]), blocks_.size());
+
+    return in.good();
+  }
+
+}
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,174 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_SPARSEFRAME_H
+#define VV_SPARSEFRAME_H
+
+#include <stdio.h>
+
+#include <fstream>
+#include <vector>
+
+#include "math/math.h"
+#include "vvexport.h"
+#include "vvinttypes.h"
+
+namespace virvo
+{
+
+  /**
+   * @brief Sparse storage of one animation frame of a volume.
+   *
+   * The frame is subdivided into cubic blocks. Only blocks that contain
+   * at least one voxel differing from the background value are stored,
+   * a block index maps each block to its data or marks it as empty.
+   * Voxel layout inside a block and voxel format are the same as for
+   * dense frames (see vvVolDesc::getRaw()), border blocks are padded
+   * with the background value.
+   */
+  class VIRVO_FILEIOEXPORT SparseFrame
+  {
+    public:
+
+      /// Block index entry for blocks that only contain background voxels
+      static const uint32_t EMPTY_BLOCK;
+
+      /// Default edge length of blocks [voxels]
+      static const size_t DEFAULT_BLOCK_SIZE;
+
+      /**
+       * @brief Construct an empty frame
+       */
+      SparseFrame();
+
+      /**
+       * @brief Construct from a dense frame
+       *
+       * @param data dense voxel data
+       * @param vox volume dimensions [voxels]
+       * @param bpv bytes per voxel
+       * @param blockSize edge length of blocks [voxels]
+       * @param background bpv bytes with the background voxel value, NULL for 0
+       */
+      SparseFrame(const uint8_t* data,
+          vector< 3, ssize_t > const& vox,
+          size_t bpv,
+          size_t blockSize = DEFAULT_BLOCK_SIZE,
+          const uint8_t* background = NULL);
+
+      /**
+       * @brief Write the frame as a dense frame to dst,
+       *        which must provide vox.x*vox.y*vox.z*bpv bytes
+       */
+      void toDense(uint8_t* dst) const;
+
+      /**
+       * @brief Return a pointer to the bpv bytes of a voxel
+       */
+      const uint8_t* getVoxel(ssize_t x, ssize_t y, ssize_t z) const;
+
+      /**
+       * @brief @see getVoxel(), overload taking a linear voxel index
+       *        as used for dense frames
+       */
+      const uint8_t* getVoxel(size_t indexXYZ) const;
+
+      /**
+       * @brief Number of blocks in each dimension
+       */
+      vector< 3, ssize_t > getNumBlocks() const { return numBlocks_; }
+
+      /**
+       * @brief Number of blocks that are stored
+       */
+      size_t getNumNonEmptyBlocks() const;
+
+      /**
+       * @brief true if the block only contains background voxels
+       */
+      bool isBlockEmpty(ssize_t bx, ssize_t by, ssize_t bz) const;
+
+      /**
+       * @brief Voxel bounds of all non-empty blocks, clamped to the volume,
+       *        empty box if the frame only contains background voxels
+       */
+      basic_aabb< ssize_t > getNonEmptyBounds() const;
+
+      /**
+       * @brief Number of bytes occupied by index and block data
+       */
+      size_t getBytes() const;
+
+      vector< 3, ssize_t > getVox() const { return vox_; }
+      size_t getBPV() const { return bpv_; }
+      size_t getBlockSize() const { return blockSize_; }
+      const uint8_t* getBackground() const { return &background_[0]; }
+
+      /**
+       * @brief Swap the byte order of all voxel values
+       *
+       * @param bpc bytes per channel (2 or 4 actually swap bytes)
+       */
+      void toggleEndianness(size_t bpc);
+
+      /**
+       * @brief Write the frame to a file, integers in big endian,
+       *        voxel data in host byte order
+       *
+       * @return false on error
+       */
+      bool write(FILE* fp) const;
+
+      /**
+       * @brief Read a frame written with write()
+       *
+       * @param vox volume dimensions the frame must have [voxels]
+       * @param bpv bytes per voxel the frame must have
+       * @return false on error or on mismatching format
+       */
+      bool read(std::ifstream& in, vector< 3, ssize_t > const& vox, size_t bpv);
+
+    private:
+
+      vector< 3, ssize_t > vox_;
+      size_t bpv_;
+      size_t blockSize_;
+      vector< 3, ssize_t > numBlocks_;
+
+      // Per block: index of block in blocks_, or EMPTY_BLOCK
+      std::vector< uint32_t > index_;
+
+      // Data of all non-empty blocks, blockSize^3 voxels each
+      std::vector< uint8_t > blocks_;
+
+      // Background voxel value
+      std::vector< uint8_t > background_;
+
+      size_t blockBytes() const { return blockSize_ * blockSize_ * blockSize_ * bpv_; }
+  };
+
+}
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
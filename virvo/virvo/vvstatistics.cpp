@@ -0,0 +1,262 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+#include "private/parallel_for.h"
+#include "vvstatistics.h"
+
+namespace virvo
+{
+
+  //--- Helpers ---------------------------------------------------------------
+
+  namespace
+  {
+    // Voxels per work item, keeps small volumes on the calling thread
+    const size_t MIN_CHUNK_VOXELS = 1 << 16;
+
+    size_t numChunks(size_t numVoxels)
+    {
+      size_t n = numWorkerThreads();
+      return std::max(size_t(1), std::min(n, numVoxels / MIN_CHUNK_VOXELS));
+    }
+
+    // Integer data: count occurrences of each value per channel
+    template < typename T >
+    void countValues(const T* data, size_t first, size_t last, size_t numChan, uint64_t* counts)
+    {
+      const size_t numValues = size_t(1) << (sizeof(T) * 8);
+
+      if (numChan == 1)
+      {
+        // Alternate between four tables so that runs of equal values
+        // do not serialize on the same counter
+        uint64_t* c0 = counts;
+        uint64_t* c1 = counts + numValues;
+        uint64_t* c2 = counts + 2 * numValues;
+        uint64_t* c3 = counts + 3 * numValues;
+
+        size_t i = first;
+        for ( ; i + 4 <= last; i += 4)
+        {
+          ++c0[data[i]];
+          ++c1[data[i + 1]];
+          ++c2[data[i + 2]];
+          ++c3[data[i + 3]];
+        }
+        for ( ; i < last; ++i)
+          ++c0[data[i]];
+
+        for (size_t v = 0; v < numValues; ++v)
+          c0[v] += c1[v] + c2[v] + c3[v];
+      }
+      else
+      {
+        for (size_t i = first; i < last; ++i)
+        {
+          const T* voxel = data + i * numChan;
+          for (size_t c = 0; c < numChan; ++c)
+            ++counts[c * numValues + voxel[c]];
+        }
+      }
+    }
+
+    template < typename T >
+    void integerStatistics(const T* data, size_t numVoxels, size_t numChan, ChannelStatistics* stats)
+    {
+      const size_t numValues = size_t(1) << (sizeof(T) * 8);
+      const size_t n = numChunks(numVoxels);
+
+      // Single channel volumes need room for four tables per chunk
+      const size_t tableSize = numValues * (numChan == 1 ? 4 : numChan);
+      std::vector< std::vector< uint64_t > > partial(n);
+
+      parallel_for(0, n, [&](size_t first, size_t last)
+      {
+        for (size_t k = first; k < last; ++k)
+        {
+          partial[k].assign(tableSize, 0);
+          countValues(data, k * numVoxels / n, (k + 1) * numVoxels / n, numChan, &partial[k][0]);
+        }
+      });
+
+      for (size_t c = 0; c < numChan; ++c)
+      {
+        ChannelStatistics& s = stats[c];
+        s = ChannelStatistics();
+        s.numVoxels = numVoxels;
+        s.histogram.assign(numValues, 0);
+
+        for (size_t k = 0; k < n; ++k)
+        {
+          const uint64_t* counts = &partial[k][c * numValues];
+          for (size_t v = 0; v < numValues; ++v)
+            s.histogram[v] += counts[v];
+        }
+
+        // Derive the moments from the histogram
+        bool found = false;
+        for (size_t v = 0; v < numValues; ++v)
+        {
+          if (s.histogram[v] == 0)
+            continue;
+
+          double dv = static_cast<double>(v);
+          s.sum += dv * s.histogram[v];
+          s.sumSquares += dv * dv * s.histogram[v];
+          if (!found)
+            s.min = static_cast<float>(v);
+          s.max = static_cast<float>(v);
+          found = true;
+        }
+      }
+    }
+
+    void floatStatistics(const float* data, size_t numVoxels, size_t numChan, ChannelStatistics* stats)
+    {
+      struct Partial
+      {
+        float min;
+        float max;
+        double sum;
+        double sumSquares;
+      };
+
+      const size_t n = numChunks(numVoxels);
+      std::vector< Partial > partial(n * numChan);
+
+      parallel_for(0, n, [&](size_t first, size_t last)
+      {
+        for (size_t k = first; k < last; ++k)
+        {
+          for (size_t c = 0; c < numChan; ++c)
+          {
+            // Scalar loop: min/max and the double sums are not vectorized
+            // without fast-math, and the access is strided by numChan
+            float mi = FLT_MAX;
+            float ma = -FLT_MAX;
+            double sum = 0.0;
+            double sumSquares = 0.0;
+
+            const float* p = data + c;
+            for (size_t i = k * numVoxels / n; i < (k + 1) * numVoxels / n; ++i)
+            {
+              float v = p[i * numChan];
+              mi = std::min(mi, v);
+              ma = std::max(ma, v);
+              sum += v;
+              sumSquares += static_cast<double>(v) * v;
+            }
+
+            Partial& res = partial[k * numChan + c];
+            res.min = mi;
+            res.max = ma;
+            res.sum = sum;
+            res.sumSquares = sumSquares;
+          }
+        }
+      });
+
+      for (size_t c = 0; c < numChan; ++c)
+      {
+        ChannelStatistics& s = stats[c];
+        s = ChannelStatistics();
+        s.numVoxels = numVoxels;
+        s.min = FLT_MAX;
+        s.max = -FLT_MAX;
+
+        for (size_t k = 0; k < n; ++k)
+        {
+          const Partial& p = partial[k * numChan + c];
+          s.min = std::min(s.min, p.min);
+          s.max = std::max(s.max, p.max);
+          s.sum += p.sum;
+          s.sumSquares += p.sumSquares;
+        }
+      }
+    }
+  }
+
+
+  //--- Interface -------------------------------------------------------------
+
+  ChannelStatistics::ChannelStatistics()
+    : min(0.0f)
+    , max(0.0f)
+    , sum(0.0)
+    , sumSquares(0.0)
+    , numVoxels(0)
+  {
+  }
+
+  double ChannelStatistics::mean() const
+  {
+    return numVoxels > 0 ? sum / static_cast<double>(numVoxels) : 0.0;
+  }
+
+  double ChannelStatistics::variance() const
+  {
+    if (numVoxels == 0)
+      return 0.0;
+
+    double m = mean();
+    return std::max(0.0, sumSquares / static_cast<double>(numVoxels) - m * m);
+  }
+
+  int ChannelStatistics::numUsed() const
+  {
+    if (histogram.empty())
+      return -1;
+
+    return static_cast<int>(histogram.size() - std::count(histogram.begin(), histogram.end(), uint64_t(0)));
+  }
+
+  void computeStatistics(const uint8_t* data,
+      size_t numVoxels,
+      size_t bpc,
+      size_t numChan,
+      ChannelStatistics* stats)
+  {
+    switch (bpc)
+    {
+      case 1:
+        integerStatistics(data, numVoxels, numChan, stats);
+        break;
+      case 2:
+        integerStatistics(reinterpret_cast< const uint16_t* >(data), numVoxels, numChan, stats);
+        break;
+      case 4:
+        floatStatistics(reinterpret_cast< const float* >(data), numVoxels, numChan, stats);
+        break;
+      default:
+        assert(0);
+        break;
+    }
+  }
+
+}
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,84 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_STATISTICS_H
+#define VV_STATISTICS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+
+namespace virvo
+{
+
+  /**
+   * @brief Statistics of one data channel of an animation frame.
+   *
+   * All values refer to raw scalar values, i.e. integer data is not
+   * mapped to the physical data range (see vvVolDesc::mapping()).
+   */
+  struct VIRVO_FILEIOEXPORT ChannelStatistics
+  {
+    ChannelStatistics();
+
+    float  min;
+    float  max;
+    double sum;
+    double sumSquares;
+    size_t numVoxels;
+
+    /// Integer data: number of voxels for each scalar value (256 or 65536 entries),
+    /// empty for floating point data
+    std::vector< uint64_t > histogram;
+
+    double mean() const;
+    double variance() const;
+
+    /// Number of different scalar values, -1 for floating point data
+    int numUsed() const;
+  };
+
+  /**
+   * @brief Compute the statistics of all channels of a frame in a single
+   *        pass over the voxel data, the work is distributed over all
+   *        worker threads
+   *
+   * @param data voxel data in host byte order, channels interleaved
+   * @param numVoxels number of voxels
+   * @param bpc bytes per channel (1, 2 or 4)
+   * @param numChan number of channels
+   * @param stats array with numChan entries that receives the results
+   */
+  VIRVO_FILEIOEXPORT void computeStatistics(const uint8_t* data,
+      size_t numVoxels,
+      size_t bpc,
+      size_t numChan,
+      ChannelStatistics* stats);
+
+}
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
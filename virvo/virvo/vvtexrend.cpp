@@ -56,6 +56,7 @@
 
 #include "private/vvgltools.h"
 #include "private/vvlog.h"
+#include "private/vvpreint.h"
 
 using namespace std;
 using namespace virvo;
@@ -196,6 +197,7 @@ vvTexRend::vvTexRend(vvVolDesc* vd, vvRenderState renderState)
   rgbaLUT.resize(1);
   usePreIntegration = false;
   textures = 0;
+  lodLevel = 0;
 
   setCurrentShader(_currentShader);
 
@@ -326,9 +328,11 @@ vvTexRend::ErrorType vvTexRend::makeTextures(bool newTex)
   vvDebugMsg::msg(2, "vvTexRend::makeTextures()");
 
   virvo::vector< 3, ssize_t > vox = _paddingRegion.max - _paddingRegion.min;
+  virvo::vector< 3, ssize_t > lodVox = vd->getLODVox(lodLevel);
   for (size_t i = 0; i < 3; ++i)
   {
     vox[i] = std::min(vox[i], vd->vox[i]);
+    vox[i] = std::min((vox[i] + (ssize_t(1) << lodLevel) - 1) >> lodLevel, lodVox[i]);
   }
 
   if (vox[0] == 0 || vox[1] == 0 || vox[2] == 0)
@@ -425,6 +429,14 @@ void vvTexRend::updateVolumeData()
 void vvTexRend::updateVolumeData(size_t offsetX, size_t offsetY, size_t offsetZ,
                                  size_t sizeX, size_t sizeY, size_t sizeZ)
 {
+  if (lodLevel > 0)
+  {
+    // Region is given in full resolution voxels, rebuild the coarse level
+    vd->invalidateLOD();
+    makeTextures(false);
+    return;
+  }
+
   updateTextures3D(offsetX, offsetY, offsetZ, sizeX, sizeY, sizeZ, false);
 }
 
@@ -487,7 +499,7 @@ vvTexRend::ErrorType vvTexRend::updateTextures3D(ssize_t offsetX, ssize_t offset
     // TODO: out..
 
   // Generate sub texture contents:
-  TextureUtil tu(vd);
+  TextureUtil tu(vd, lodLevel);
   for (size_t f = 0; f < vd->frames; f++)
   {
     TextureUtil::Pointer texData = NULL;
@@ -650,9 +662,10 @@ void vvTexRend::renderTex3DPlanar(mat4 const& mv)
   vissize = maxCorner - minCorner;
   vec3 center = aabb(minCorner, maxCorner).center();
 
+  virvo::vector< 3, ssize_t > lodVox = vd->getLODVox(lodLevel);
   for (size_t i=0; i<3; ++i)
   {
-    texSize[i] = vissize[i] * (float)texels[i] / (float)vd->vox[i];
+    texSize[i] = vissize[i] * (float)texels[i] / (float)lodVox[i];
     vissize2[i]   = 0.5f * vissize[i];
   }
   vec3f pos = vd->pos + center;
@@ -705,7 +718,7 @@ void vvTexRend::renderTex3DPlanar(mat4 const& mv)
   }
   else                                            // probe mode off
   {
-    probeTexels = vec3f( (float)vd->vox[0], (float)vd->vox[1], (float)vd->vox[2] );
+    probeTexels = vec3f( (float)lodVox[0], (float)lodVox[1], (float)lodVox[2] );
   }
 
   glMatrixMode(GL_MODELVIEW);
@@ -1025,10 +1038,21 @@ void vvTexRend::renderVolumeGL()
 
   activateClippingPlanes();
 
+  // Switch to another level of the LOD pyramid if the screen-space
+  // footprint or the render time budget requires so
+  size_t lod = computeLODLevel();
+  if (lod != lodLevel)
+  {
+    lodLevel = lod;
+    makeTextures(true);
+  }
+
   virvo::vector< 3, ssize_t > vox = _paddingRegion.max - _paddingRegion.min;
+  virvo::vector< 3, ssize_t > lodVox = vd->getLODVox(lodLevel);
   for (size_t i = 0; i < 3; ++i)
   {
     vox[i] = std::min(vox[i], vd->vox[i]);
+    vox[i] = std::min((vox[i] + (ssize_t(1) << lodLevel) - 1) >> lodLevel, lodVox[i]);
   }
 
   if (vox[0] * vox[1] * vox[2] == 0)
@@ -1040,8 +1064,8 @@ void vvTexRend::renderVolumeGL()
   for (size_t i = 0; i < 3; ++i)
   {
     // padded borders for (trilinear) interpolation
-    size_t paddingLeft = size_t(abs(ptrdiff_t(_visibleRegion.min[i] - _paddingRegion.min[i])));
-    size_t paddingRight = size_t(abs(ptrdiff_t(_visibleRegion.max[i] - _paddingRegion.max[i])));
+    size_t paddingLeft = size_t(abs(ptrdiff_t(_visibleRegion.min[i] - _paddingRegion.min[i]))) >> lodLevel;
+    size_t paddingRight = size_t(abs(ptrdiff_t(_visibleRegion.max[i] - _paddingRegion.max[i]))) >> lodLevel;
     // a voxels size
     const float vsize = 1.0f / (float)texels[i];
     // half a voxels size
@@ -1077,7 +1101,7 @@ void vvTexRend::renderVolumeGL()
 
   unsetGLenvironment();
 
-  if (_fpsDisplay)
+  if (_fpsDisplay || _lodBudget > 0.0f)
   {
     // Make sure rendering is done to measure correct time.
     // Since this operation is costly, only do it if necessary.
@@ -1243,22 +1267,37 @@ void vvTexRend::updateLUT(const float dist)
   }
   else if (pixLUTName.size() < rgbaLUT.size())
   {
+    size_t numNames = pixLUTName.size();
     pixLUTName.resize(rgbaLUT.size());
-    glGenTextures(pixLUTName.size()-rgbaLUT.size(), &pixLUTName[rgbaLUT.size()]);
+    glGenTextures(pixLUTName.size()-numNames, &pixLUTName[numNames]);
+  }
+  pixLUTSize.resize(pixLUTName.size(), virvo::vector< 2, size_t >(0, 0));
+  preIntCache.resize(rgbaLUT.size());
+  for (size_t chan=0; chan<preIntCache.size(); ++chan)
+  {
+    if (!preIntCache[chan])
+      preIntCache[chan].reset(new virvo::PreintCache);
   }
  
+  std::vector<uint8_t> prevLUT;
   for (size_t chan=0; chan<rgbaTF.size(); ++chan)
   {
     assert(total*4 == rgbaTF[chan].size());
     if (rgbaLUT[chan].size() != rgbaTF[chan].size())
       rgbaLUT[chan].resize(rgbaTF[chan].size());
 
+    // Keep the uploaded table to find the entries that changed
+    bool uploaded = _postClassification && pixLUTSize[chan] == virvo::vector< 2, size_t >(lutSize[0], lutSize[1]);
+    if (uploaded)
+      prevLUT = rgbaLUT[chan];
+
     if (usePreIntegration)
     {
-      vd->tf[chan].makePreintLUTCorrect(getPreintTableSize(), &rgbaLUT[chan][0], dist);
+      vd->tf[chan].makePreintLUTCorrect(getPreintTableSize(), &rgbaLUT[chan][0], dist, 0.0f, 1.0f, preIntCache[chan].get());
     }
     else
     {
+      preIntCache[chan]->invalidate();
       for (size_t i=0; i<total; ++i)
       {
         // Gamma correction:
@@ -1292,7 +1331,32 @@ void vvTexRend::updateLUT(const float dist)
 
     // Copy LUT to graphics card:
     vvGLTools::printGLError("enter updateLUT()");
-    if (_postClassification)
+    if (uploaded)
+    {
+      // Only upload the changed entries of a 1D table, the changed rows of a 2D table
+      size_t rowSize = lutSize[1] == 1 ? 4 : lutSize[0] * 4;
+      size_t first = 0;
+      size_t last = rgbaLUT[chan].size() / rowSize;
+      while (first < last && std::equal(&rgbaLUT[chan][first * rowSize], &rgbaLUT[chan][first * rowSize] + rowSize,
+                                        &prevLUT[first * rowSize]))
+        ++first;
+      while (last > first && std::equal(&rgbaLUT[chan][(last - 1) * rowSize], &rgbaLUT[chan][(last - 1) * rowSize] + rowSize,
+                                        &prevLUT[(last - 1) * rowSize]))
+        --last;
+
+      if (first < last)
+      {
+        glBindTexture(GL_TEXTURE_2D, pixLUTName[chan]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (lutSize[1] == 1)
+          glTexSubImage2D(GL_TEXTURE_2D, 0, first, 0, last - first, 1,
+              GL_RGBA, GL_UNSIGNED_BYTE, &rgbaLUT[chan][first * rowSize]);
+        else
+          glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, lutSize[0], last - first,
+              GL_RGBA, GL_UNSIGNED_BYTE, &rgbaLUT[chan][first * rowSize]);
+      }
+    }
+    else if (_postClassification)
     {
       glBindTexture(GL_TEXTURE_2D, pixLUTName[chan]);
       glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -1303,6 +1367,11 @@ void vvTexRend::updateLUT(const float dist)
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, lutSize[0], lutSize[1], 0,
           GL_RGBA, GL_UNSIGNED_BYTE, &rgbaLUT[chan][0]);
+      pixLUTSize[chan] = virvo::vector< 2, size_t >(lutSize[0], lutSize[1]);
+    }
+    else
+    {
+      pixLUTSize[chan] = virvo::vector< 2, size_t >(0, 0);
     }
   }
 
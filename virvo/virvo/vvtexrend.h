@@ -24,6 +24,7 @@
 #include <vector>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 // Virvo:
 #include "vvexport.h"
@@ -34,6 +35,11 @@ class vvShaderFactory;
 class vvShaderProgram;
 class vvVolDesc;
 
+namespace virvo
+{
+  class PreintCache;
+}
+
 //============================================================================
 // Class Definitions
 //============================================================================
@@ -87,11 +93,14 @@ class VIRVOEXPORT vvTexRend : public vvRenderer
     float texMin[3];                              ///< minimum texture value of object [0..1] (to prevent border interpolation)
     float texMax[3];                              ///< maximum texture value of object [0..1] (to prevent border interpolation)
     size_t   textures;                            ///< number of textures stored in TRAM
+    size_t   lodLevel;                            ///< level of the LOD pyramid the textures were built from
     size_t   texelsize;                           ///< number of bytes/voxel transferred to OpenGL (depending on rendering mode)
     GLint internalTexFormat;                      ///< internal texture format (parameter for glTexImage...)
     GLenum texFormat;                             ///< texture format (parameter for glTexImage...)
     GLuint* texNames;                             ///< names of texture slices stored in TRAM
     std::vector<GLuint> pixLUTName;               ///< names for transfer function textures
+    std::vector< virvo::vector< 2, size_t > > pixLUTSize; ///< size of the transfer function textures, 0 if not uploaded
+    std::vector<boost::shared_ptr<virvo::PreintCache> > preIntCache; ///< transfer functions rgbaLUT was pre-integrated from
     bool extTex3d;                                ///< true = 3D texturing supported
     bool extNonPower2;                            ///< true = NonPowerOf2 textures supported
     bool extMinMax;                               ///< true = maximum/minimum intensity projections supported
@@ -104,20 +104,54 @@ namespace virvo
 
   struct TextureUtil::Impl
   {
-    Impl(const vvVolDesc* vd) : vd(vd) {}
+    Impl(const vvVolDesc* vd, size_t lodLevel)
+      : vd(vd)
+      , lodLevel(lodLevel)
+      , vox(vd->getLODVox(lodLevel))
+      , denseFrame(-1)
+    {
+    }
+
+    // Voxel data of the LOD level for an animation frame
+    const uint8_t* getRaw(int frame)
+    {
+      // Decode sparse frames locally so the volume description stays sparse
+      const SparseFrame* sf = lodLevel == 0 ? vd->getSparseFrame(frame) : NULL;
+      if (sf == NULL)
+        return vd->getLODRaw(lodLevel, frame);
+
+      int f = frame == -1 ? static_cast<int>(vd->getCurrentFrame()) : frame;
+      if (f != denseFrame)
+      {
+        dense.resize(vd->getFrameBytes());
+        sf->toDense(&dense[0]);
+        denseFrame = f;
+      }
+      return &dense[0];
+    }
 
     // The volume description
     const vvVolDesc* vd;
 
+    // LOD level to take the voxel data from
+    size_t lodLevel;
+
+    // Volume dimensions at that level
+    vector< 3, ssize_t > vox;
+
     // Memory to hold the texture, in case we need it
     std::vector<uint8_t> mem;
+
+    // Dense copy of a sparse frame, and its frame index
+    std::vector<uint8_t> dense;
+    int denseFrame;
   };
 
 
   //--- Interface -------------------------------------------------------------
 
-  TextureUtil::TextureUtil(const vvVolDesc* vd)
-    : impl_(new Impl(vd))
+  TextureUtil::TextureUtil(const vvVolDesc* vd, size_t lodLevel)
+    : impl_(new Impl(vd, lodLevel))
   {
   }
 
@@ -130,7 +164,7 @@ namespace virvo
       int frame)
   {
     return getTexture(vec3i(0),
-        vec3i(impl_->vd->vox),
+        vec3i(impl_->vox),
         tf,
         chans,
         frame);
@@ -162,9 +196,9 @@ namespace virvo
     //--- Make texture ----------------
 
     // Maybe we can just return a pointer from the voldesc
-    if (nativeFormat(vd) == tf && first.xy() == vec2i(0) && last.xy() == vec2i(vd->vox.xy()))
+    if (nativeFormat(vd) == tf && first.xy() == vec2i(0) && last.xy() == vec2i(impl_->vox.xy()))
     {
-      return vd->getRaw(frame) + first.z * vd->getSliceBytes();
+      return impl_->getRaw(frame) + first.z * impl_->vox.x * impl_->vox.y * vd->getBPV();
     }
 
     // Maybe the conversion operation is trivial and we can
@@ -174,7 +208,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, tf));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* raw = impl_->getRaw(frame);
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z < last.z; ++z)
@@ -200,7 +234,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, tf));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* raw = impl_->getRaw(frame);
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z < last.z; ++z)
@@ -247,7 +281,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, PF_RGBA8));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* raw = impl_->getRaw(frame);
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z < last.z; ++z)
@@ -281,7 +315,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, PF_RGBA8));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* raw = impl_->getRaw(frame);
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z != last.z; ++z)
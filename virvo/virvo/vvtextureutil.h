@@ -66,8 +66,11 @@ namespace virvo
        * @brief Constructor
        *
        * @param vd volume description, must be valid throughout object lifetime
+       * @param lodLevel level of the volume's LOD pyramid to obtain textures
+       *        from (0=full resolution); voxel indices passed to getTexture()
+       *        refer to that level, @see vvVolDesc::getLODVox()
        */
-      TextureUtil(const vvVolDesc* vd);
+      TextureUtil(const vvVolDesc* vd, size_t lodLevel = 0);
 
       /**
        * @brief Destructor, for pimpl
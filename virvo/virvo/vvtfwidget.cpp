@@ -189,7 +189,7 @@ vec3 vvTFWidget::pos() const
   return _pos;
 }
 
-void vvTFWidget::readName(std::ifstream& file)
+void vvTFWidget::readName(std::istream& file)
 {
   char tmpName[128] = "";
   if (file >> tmpName)
@@ -331,7 +331,7 @@ float x, float w, float y, float h, float z, float d) : vvTFWidget(x, y, z)
   _size[2] = d;
 }
 
-vvTFBell::vvTFBell(std::ifstream& file) : vvTFWidget()
+vvTFBell::vvTFBell(std::istream& file) : vvTFWidget()
 {
   readName(file);
   int ownColorInt = 0;
@@ -347,7 +347,7 @@ vvTFBell::vvTFBell(std::ifstream& file) : vvTFWidget()
       !(file >> ownColorInt)    ||
       !(file >> _opacity))
   {
-    VV_LOG(0) << "vvTFBell(ifstream& file) error";
+    VV_LOG(0) << "vvTFBell(istream& file) error";
   }
   _ownColor = (ownColorInt != 0);
 }
@@ -562,7 +562,7 @@ float y, float hb, float ht, float z, float db, float dt) : vvTFWidget(x, y, z)
   _bottom[2] = db;
 }
 
-vvTFPyramid::vvTFPyramid(std::ifstream& file) : vvTFWidget()
+vvTFPyramid::vvTFPyramid(std::istream& file) : vvTFWidget()
 {
   int ownColorInt = 0;
   readName(file);
@@ -581,7 +581,7 @@ vvTFPyramid::vvTFPyramid(std::ifstream& file) : vvTFWidget()
       !(file >> ownColorInt)    ||
       !(file >> _opacity))
   {
-    VV_LOG(0) << "vvTFPyramid(ifstream& file) error";
+    VV_LOG(0) << "vvTFPyramid(istream& file) error";
   }
   _ownColor = (ownColorInt != 0);
 }
@@ -897,7 +897,7 @@ vvColor vvTFColor::color() const
   return _col;
 }
 
-vvTFColor::vvTFColor(std::ifstream& file) : vvTFWidget()
+vvTFColor::vvTFColor(std::istream& file) : vvTFWidget()
 {
   readName(file);
   if (!(file >> _pos[0])        ||
@@ -907,7 +907,7 @@ vvTFColor::vvTFColor(std::ifstream& file) : vvTFWidget()
       !(file >> _col[1])        ||
       !(file >> _col[2]))
   {
-    VV_LOG(0) << "vvTFColor(ifstream& file) error";
+    VV_LOG(0) << "vvTFColor(istream& file) error";
   }
 }
 
@@ -984,7 +984,7 @@ vvTFSkip::vvTFSkip(float xpos, float xsize, float ypos, float ysize, float zpos,
   _size[2] = zsize;
 }
 
-vvTFSkip::vvTFSkip(std::ifstream& file) : vvTFWidget()
+vvTFSkip::vvTFSkip(std::istream& file) : vvTFWidget()
 {
   readName(file);
   if (!(file >> _pos[0])        ||
@@ -994,7 +994,7 @@ vvTFSkip::vvTFSkip(std::ifstream& file) : vvTFWidget()
       !(file >> _size[1])     ||
       !(file >> _size[2]))
   {
-    VV_LOG(0) << "vvTFSkip(ifstream& file) error";
+    VV_LOG(0) << "vvTFSkip(istream& file) error";
   }
 }
 
@@ -1141,20 +1141,23 @@ vvTFCustom::vvTFCustom(float xpos, float xsize, float ypos, float ysize, float z
 
 /** Constructor reading parameters from file.
 */
-vvTFCustom::vvTFCustom(std::ifstream& file) : vvTFWidget()
+vvTFCustom::vvTFCustom(std::istream& file) : vvTFWidget()
 {
   vvTFPoint* point;
   float op, x, y, z;
-  int numPoints;
+  int numPoints = 0;
   int i;
 
   readName(file);
-  if (!(file >> numPoints)      ||
+  if (!(file >> _pos[0])        ||
+      !(file >> _pos[1])        ||
+      !(file >> _pos[2])        ||
       !(file >> _size[0])       ||
       !(file >> _size[1])       ||
-      !(file >> _size[2]))
+      !(file >> _size[2])       ||
+      !(file >> numPoints))
   {
-    VV_LOG(0) << "vvTFCustom(ifstream& file) error";
+    VV_LOG(0) << "vvTFCustom(istream& file) error";
   }
 
   for(i=0; i<numPoints; ++i)
@@ -1164,7 +1167,8 @@ vvTFCustom::vvTFCustom(std::ifstream& file) : vvTFWidget()
         !(file >> y)            ||
         !(file >> z))
     {
-      VV_LOG(0) << "vvTFCustom(ifstream& file) 2 error";
+      VV_LOG(0) << "vvTFCustom(istream& file) 2 error";
+      break;
     }
     point = new vvTFPoint(op, x, y, z);
     _points.push_back(point);
@@ -1209,8 +1213,8 @@ std::string vvTFCustom::toString() const
 
   list<vvTFPoint*>::const_iterator iter;
 
-  str << "TF_CUSTOM " << getName() << " " << _size[0] << " " << _size[1] << " " << _size[2] << " "
-      << static_cast< int >(_points.size()) << "\n";
+  str << "TF_CUSTOM " << getName() << " " << _pos[0] << " " << _pos[1] << " " << _pos[2] << " "
+      << _size[0] << " " << _size[1] << " " << _size[2] << " " << static_cast< int >(_points.size()) << "\n";
 
   for(iter=_points.begin(); iter!=_points.end(); iter++)
   {
@@ -1223,7 +1227,7 @@ std::string vvTFCustom::toString() const
 void vvTFCustom::fromString(const std::string& str)
 {
   std::vector<std::string> tokens = vvToolshed::split(str, " ");
-  assert(tokens.size() >= 6);
+  assert(tokens.size() >= 9);
   assert(tokens[0].compare("TF_CUSTOM") == 0);
 
   _name = tokens[1];
@@ -126,7 +126,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFWidget
     void setPos(virvo::vec3 const& pos);
     void setPos(float x, float y, float z);
     virvo::vec3 pos() const;
-    virtual void readName(std::ifstream& file);
+    virtual void readName(std::istream& file);
     void write(FILE*);
     virtual std::string toString() const { throw std::runtime_error("not implemented"); }
     virtual void fromString(const std::string& /*str*/) { throw std::runtime_error("not implemented"); }
@@ -163,7 +163,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFBell : public vvTFWidget
     vvTFBell();
     vvTFBell(vvTFBell*);
     vvTFBell(vvColor, bool, float, float, float, float=0.5f, float=1.0f, float=0.5f, float=1.0f);
-    vvTFBell(std::ifstream& file);
+    vvTFBell(std::istream& file);
 
     virtual bool operator==(const vvTFWidget &rhs) const;
 
@@ -207,7 +207,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFPyramid : public vvTFWidget
     vvTFPyramid();
     vvTFPyramid(vvTFPyramid*);
     vvTFPyramid(vvColor, bool, float, float, float, float, float=0.5f, float=1.0f, float=0.0f, float=0.5f, float=1.0f, float=0.0f);
-    vvTFPyramid(std::ifstream& file);
+    vvTFPyramid(std::istream& file);
 
     virtual bool operator==(const vvTFWidget &rhs) const;
 
@@ -249,7 +249,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFColor : public vvTFWidget
     vvTFColor();
     vvTFColor(vvTFColor*);
     vvTFColor(vvColor, float, float=0.0f, float=0.0f);
-    vvTFColor(std::ifstream& file);
+    vvTFColor(std::istream& file);
 
     virtual bool operator==(const vvTFWidget &rhs) const;
 
@@ -278,7 +278,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFSkip : public vvTFWidget
     vvTFSkip();
     vvTFSkip(vvTFSkip*);
     vvTFSkip(float, float, float=0.5f, float=0.0f, float=0.5f, float=0.0f);
-    vvTFSkip(std::ifstream& file);
+    vvTFSkip(std::istream& file);
 
     virtual bool operator==(const vvTFWidget &rhs) const;
 
@@ -313,7 +313,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFCustom : public vvTFWidget
     vvTFCustom();
     vvTFCustom(vvTFCustom*);
     vvTFCustom(float, float, float=0.5f, float=0.0f, float=0.5f, float=0.0f);
-    vvTFCustom(std::ifstream& file);
+    vvTFCustom(std::istream& file);
     virtual ~vvTFCustom();
 
     virtual bool operator==(const vvTFWidget &rhs) const;
@@ -354,7 +354,7 @@ public:
 
     vvTFCustom2D(bool extrude, float opacity, float xCenter, float yCenter);
     vvTFCustom2D(vvTFCustom2D*);
-    vvTFCustom2D(std::ifstream& file);
+    vvTFCustom2D(std::istream& file);
     virtual ~vvTFCustom2D();
 
     virtual bool operator==(const vvTFWidget &rhs) const;
@@ -402,7 +402,7 @@ class VIRVO_TRANSFUNCEXPORT vvTFCustomMap : public vvTFWidget
     vvTFCustomMap(float x, float w, float y=0.5f, float h=0.0f, float z=0.5f, float d=0.0f);
     vvTFCustomMap(vvColor, bool, float x, float w, float y=0.5f, float h=0.0f, float z=0.5f, float d=0.0f);
     vvTFCustomMap(vvTFCustomMap*);
-    vvTFCustomMap(std::ifstream& file);
+    vvTFCustomMap(std::istream& file);
     virtual ~vvTFCustomMap();
 
     virtual bool operator==(const vvTFWidget &rhs) const;
@@ -18,6 +18,7 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -37,6 +38,10 @@
 #include <errno.h>
 #include "vvplatform.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>                               // _BitScanForward
+#endif
+
 #if defined(__linux__) || defined(__APPLE__)
 #include <execinfo.h>
 #endif
@@ -48,6 +53,7 @@
 
 #include "vvtoolshed.h"
 
+#include "math/simd/intrinsics.h"
 #include "private/vvlog.h"
 
 #ifdef __sun
@@ -1351,11 +1357,126 @@ void vvToolshed::printProgress(int current)
   cerr << setw(3) << percent << " %";
 }
 
+//----------------------------------------------------------------------------
+// Helpers for run length encoding
+//----------------------------------------------------------------------------
+
+namespace
+{
+
+/// Index of the lowest set bit, x must not be 0
+inline unsigned lowestBit(unsigned x)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return unsigned(index);
+#else
+  return unsigned(__builtin_ctz(x));
+#endif
+}
+
+/** Find the first symbol in [first, last) that is equal to its successor
+  (equal=true), or that differs from it (equal=false). Symbols of 1, 2
+  and 4 bytes are compared 16 bytes at a time with SSE2.
+  @param last  index of the last symbol, which has no successor
+  @return last if there is no such symbol
+*/
+size_t findRLETransition(const uint8_t* in, size_t first, size_t last, size_t symbol_size, bool equal)
+{
+  size_t i = first;
+
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+  if (symbol_size==1 || symbol_size==2 || symbol_size==4)
+  {
+    const size_t lanes = 16 / symbol_size;
+    const unsigned flip = equal ? 0U : 0xFFFFU;
+    for (; i + lanes <= last; i += lanes)                   // successors of all lanes must exist
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * symbol_size));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (i + 1) * symbol_size));
+      __m128i eq;
+      if (symbol_size==1) eq = _mm_cmpeq_epi8(a, b);
+      else if (symbol_size==2) eq = _mm_cmpeq_epi16(a, b);
+      else eq = _mm_cmpeq_epi32(a, b);
+      unsigned mask = unsigned(_mm_movemask_epi8(eq)) ^ flip;
+      if (mask != 0)
+        return i + lowestBit(mask) / symbol_size;
+    }
+  }
+#endif
+
+  for (; i < last; ++i)
+  {
+    bool same = (symbol_size==1) ? in[i]==in[i+1]
+                                 : memcmp(in + i * symbol_size, in + (i + 1) * symbol_size, symbol_size)==0;
+    if (same == equal) return i;
+  }
+  return last;
+}
+
+/// Write count copies of a symbol to out
+void fillRLESymbol(uint8_t* out, const uint8_t* symbol, size_t symbol_size, size_t count)
+{
+  size_t bytes = count * symbol_size;
+
+  if (symbol_size==1)
+  {
+    memset(out, *symbol, count);
+    return;
+  }
+
+#if VV_SIMD_ISA_GE(VV_SIMD_ISA_SSE2)
+  if (symbol_size==2 || symbol_size==4 || symbol_size==8)
+  {
+    __m128i pattern;
+    if (symbol_size==2)
+    {
+      uint16_t v;
+      memcpy(&v, symbol, 2);
+      pattern = _mm_set1_epi16(short(v));
+    }
+    else if (symbol_size==4)
+    {
+      uint32_t v;
+      memcpy(&v, symbol, 4);
+      pattern = _mm_set1_epi32(int(v));
+    }
+    else
+    {
+      pattern = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(symbol));
+      pattern = _mm_unpacklo_epi64(pattern, pattern);
+    }
+
+    for (; bytes >= 16; bytes -= 16, out += 16)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), pattern);
+    uint8_t tail[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(tail), pattern);
+    memcpy(out, tail, bytes);
+    return;
+  }
+#endif
+
+  // Double the filled part until the run is complete:
+  memcpy(out, symbol, symbol_size);
+  for (size_t filled = symbol_size; filled < bytes; )
+  {
+    size_t n = std::min(filled, bytes - filled);
+    memcpy(out + filled, out, n);
+    filled += n;
+  }
+}
+
+} // namespace
+
 //----------------------------------------------------------------------------
 /** Run length encode (RLE) a sequence in memory.
   Encoding scheme: X is first data chunk (unsigned char).<UL>
   <LI>if X<128:  copy next X+1 chunks (literal run)</LI>
   <LI>if X>=128: repeat next chunk X-127 times (replicate run)</LI></UL>
+  Two or more equal chunks always make a replicate run. The boundaries
+  of runs are searched with SIMD instructions for chunks of 1, 2 and 4
+  bytes, literal runs are copied as a whole.
   @param out  destination position in memory (must be _allocated_!)
   @param in   source location in memory
   @param size number of bytes to encode
@@ -1368,109 +1489,66 @@ enough destination memory or if an invalid data size was passed
 @see decodeRLE
 @author Michael Poehnl
 */
-vvToolshed::ErrorType vvToolshed::encodeRLE(uint8_t* out, uint8_t* in, size_t size, size_t symbol_size, size_t space, size_t* outsize)
+vvToolshed::ErrorType vvToolshed::encodeRLE(uint8_t* out, const uint8_t* in, size_t size, size_t symbol_size, size_t space, size_t* outsize)
 {
-  int same_symbol=1;
-  int diff_symbol=0;
-  size_t src=0;
-  size_t dest=0;
-  bool same;
-  size_t i;
+  size_t dest = 0;
+  size_t litStart = 0;                            // first symbol of pending literal run
+  size_t litCount = 0;                            // number of symbols in pending literal run
 
-  if ((size % symbol_size) != 0)
+  *outsize = 0;
+  if (symbol_size==0 || (size % symbol_size) != 0)
   {
-    *outsize = 0;
     return VV_INVALID_SIZE;
   }
 
-  while (src < (size - symbol_size))
+  const size_t n = size / symbol_size;            // number of symbols
+
+  // Write the pending literal run:
+  auto flushLiterals = [&]() -> bool
   {
-    same = true;
-    for (i=0; i<symbol_size; i++)
+    if (litCount==0) return true;
+    const size_t bytes = litCount * symbol_size;
+    if (dest + 1 + bytes > space) return false;
+    out[dest] = (uint8_t)(litCount - 1);
+    memcpy(&out[dest + 1], &in[litStart * symbol_size], bytes);
+    dest += 1 + bytes;
+    litCount = 0;
+    return true;
+  };
+
+  size_t i = 0;
+  while (i < n)
+  {
+    // Symbols up to the next pair of equal symbols are literals:
+    size_t next = findRLETransition(in, i, n - 1, symbol_size, true);
+    size_t litEnd = (next == n - 1) ? n : next;
+    while (i < litEnd)
     {
-      if (in[src+i] != in[src+symbol_size+i])
-      {
-        same = false;
-        break;
-      }
+      if (litCount==0) litStart = i;
+      size_t count = std::min(litEnd - i, 128 - litCount);
+      litCount += count;
+      i += count;
+      if (litCount==128 && !flushLiterals()) return VV_OUT_OF_MEMORY;
     }
-    if (same)
-    {
-      if (same_symbol == 129)
-      {
-        assert(dest<space);
-        out[dest] = (uint8_t)(126+same_symbol);
-        dest += symbol_size+1;
-        same_symbol = 1;
-      }
-      else
-      {
-        same_symbol++;
-        if (diff_symbol > 0)
-        {
-          assert(dest<space);
-          out[dest] = (uint8_t)(diff_symbol-1);
-          dest += 1+symbol_size*diff_symbol;
-          diff_symbol=0;
-        }
-        if (same_symbol == 2)
-        {
-          if ((dest+1+symbol_size) > space)
-          {
-            *outsize = 0;
-            return VV_OUT_OF_MEMORY;
-          }
-          memcpy(&out[dest+1], &in[src], symbol_size);
-        }
-      }
-    }
-    else
-    {
-      if (same_symbol > 1)
-      {
-        assert(dest<space);
-        out[dest] = (uint8_t)(126+same_symbol);
-        dest += symbol_size+1;
-        same_symbol = 1;
-      }
-      else
-      {
-        if ((dest+1+diff_symbol*symbol_size+symbol_size) > space)
-        {
-          outsize = 0;
-          return VV_OUT_OF_MEMORY;
-        }
-        memcpy(&out[dest+1+diff_symbol*symbol_size], &in[src], symbol_size);
-        diff_symbol++;
-        if (diff_symbol == 128)
-        {
-          assert(dest<space);
-          out[dest] = (uint8_t)(diff_symbol-1);
-          dest += 1+symbol_size*diff_symbol;
-          diff_symbol=0;
-        }
-      }
-    }
-    src += symbol_size;
-  }
-  if (same_symbol > 1)
-  {
-    assert(dest<space);
-    out[dest] = (uint8_t)(126+same_symbol);
-    dest += symbol_size+1;
-  }
-  else
-  {
-    if ((dest+1+diff_symbol*symbol_size+symbol_size) > space)
+    if (i >= n) break;
+
+    // Replicate runs of up to 129 symbols:
+    if (!flushLiterals()) return VV_OUT_OF_MEMORY;
+    size_t runLength = findRLETransition(in, i, n - 1, symbol_size, false) - i + 1;
+    while (runLength >= 2)
     {
-      *outsize = 0;
-      return VV_OUT_OF_MEMORY;
+      size_t count = std::min(runLength, size_t(129));
+      if (dest + 1 + symbol_size > space) return VV_OUT_OF_MEMORY;
+      out[dest] = (uint8_t)(126 + count);
+      memcpy(&out[dest + 1], &in[i * symbol_size], symbol_size);
+      dest += 1 + symbol_size;
+      i += count;
+      runLength -= count;
     }
-    memcpy(&out[dest+1+diff_symbol*symbol_size], &in[src], symbol_size);
-    diff_symbol++;
-    out[dest] = (uint8_t)(diff_symbol-1);
-    dest += 1+symbol_size*diff_symbol;
+    // a single remaining symbol starts the next literal run
   }
+  if (!flushLiterals()) return VV_OUT_OF_MEMORY;
+
   *outsize = dest;
   return VV_OK;
 }
@@ -1489,32 +1567,40 @@ vvToolshed::ErrorType vvToolshed::encodeRLE(uint8_t* out, uint8_t* in, size_t si
   @see encodeRLE
   @author Michael Poehnl
 */
-vvToolshed::ErrorType vvToolshed::decodeRLE(uint8_t* out, uint8_t* in, size_t size, size_t symbol_size, size_t space, size_t* outsize)
+vvToolshed::ErrorType vvToolshed::decodeRLE(uint8_t* out, const uint8_t* in, size_t size, size_t symbol_size, size_t space, size_t* outsize)
 {
   size_t src=0;
   size_t dest=0;
-  size_t i, length;
+  size_t length;
 
   while (src < size)
   {
     length = (size_t)in[src];
     if (length > 127)
     {
-      for(i=0; i<(length - 126); i++)
+      length -= 126;
+      if ((src + 1 + symbol_size) > size)
       {
-        if ((dest + symbol_size) > space)
-        {
-          *outsize = 0;
-          return VV_INVALID_SIZE;
-        }
-        memcpy(&out[dest], &in[src+1], symbol_size);
-        dest += symbol_size;
+        *outsize = 0;
+        return VV_INVALID_SIZE;
+      }
+      if ((dest + length*symbol_size) > space)
+      {
+        *outsize = 0;
+        return VV_INVALID_SIZE;
       }
+      fillRLESymbol(&out[dest], &in[src+1], symbol_size, length);
+      dest += length*symbol_size;
       src += 1+symbol_size;
     }
     else
     {
       length++;
+      if ((src + 1 + length*symbol_size) > size)
+      {
+        *outsize = 0;
+        return VV_INVALID_SIZE;
+      }
       if ((dest + length*symbol_size) > space)
       {
         *outsize = 0;
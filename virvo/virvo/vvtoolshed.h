@@ -229,8 +229,8 @@ class VIRVO_TRANSFUNCEXPORT vvToolshed
     static int     round(double x);
     static void    initProgress(int);
     static void    printProgress(int);
-    static ErrorType encodeRLE(uint8_t*, uint8_t*, size_t, size_t, size_t, size_t* outsize);
-    static ErrorType decodeRLE(uint8_t*, uint8_t*, size_t, size_t, size_t, size_t* outsize);
+    static ErrorType encodeRLE(uint8_t*, const uint8_t*, size_t, size_t, size_t, size_t* outsize);
+    static ErrorType decodeRLE(uint8_t*, const uint8_t*, size_t, size_t, size_t, size_t* outsize);
     static size_t  encodeRLEFast(uint8_t*, uint8_t*, size_t, size_t);
     static size_t  decodeRLEFast(uint8_t*, uint8_t*, size_t, size_t);
     static int     getNumProcessors();
@@ -38,6 +38,9 @@
 #include "vvtransfunc.h"
 #include "vvcudatransfunc.h"
 #include "vvtoolshed.h"
+#include "private/parallel_for.h"
+#include "private/vvcompiledtf.h"
+#include "private/vvpreint.h"
 
 #include <algorithm>
 #include <fstream>
@@ -457,25 +460,49 @@ void vvTransFunc::computeTFTexture(size_t w, size_t h, size_t d, float* array,
     mask = vec4i(0, 1, 2, 3);
   }
 
-  vec3f norm;    // normalized 3D position
-  int index = 0;
-  for (size_t z=0; z<d; ++z)
+  if (w == 0)
+  {
+    return;
+  }
+
+  // Evaluate the widgets row by row, rows are independent
+  virvo::CompiledTF compiled(_widgets, _discreteColors);
+
+  std::vector<float> xs(w);
+  for (size_t x=0; x<w; ++x)
+  {
+    xs[x] = (float(x) / float(w-1)) * (maxX - minX) + minX;
+  }
+
+  auto rows = [&](size_t first, size_t last)
   {
-    norm[2] = (d==1) ? -1.0f : ((float(z) / float(d-1)) * (maxZ - minZ) + minZ);
-    for (size_t y=0; y<h; ++y)
+    std::vector<float> rgba(w * 4);
+    for (size_t row=first; row<last; ++row)
     {
-      norm[1] = (h==1) ? -1.0f : ((float(y) / float(h-1)) * (maxY - minY) + minY);
+      size_t y = row % h;
+      size_t z = row / h;
+      float normY = (h==1) ? -1.0f : ((float(y) / float(h-1)) * (maxY - minY) + minY);
+      float normZ = (d==1) ? -1.0f : ((float(z) / float(d-1)) * (maxZ - minZ) + minZ);
+      compiled.evaluate(&xs[0], w, normY, normZ, &rgba[0]);
+
+      float* dst = array + row * w * 4;
       for (size_t x=0; x<w; ++x)
       {
-        norm[0] = (float(x) / float(w-1)) * (maxX - minX) + minX;
-        vvColor col = computeColor(norm[0], norm[1], norm[2]);
-        array[index + mask[0]] = col[0];
-        array[index + mask[1]] = col[1];
-        array[index + mask[2]] = col[2];
-        array[index + mask[3]] = computeOpacity(norm[0], norm[1], norm[2]);
-        index += 4;
+        dst[x * 4 + mask[0]] = rgba[x * 4];
+        dst[x * 4 + mask[1]] = rgba[x * 4 + 1];
+        dst[x * 4 + mask[2]] = rgba[x * 4 + 2];
+        dst[x * 4 + mask[3]] = rgba[x * 4 + 3];
       }
     }
+  };
+
+  if (compiled.isThreadSafe() && h * d > 1)
+  {
+    virvo::parallel_for(size_t(0), h * d, rows, 1);
+  }
+  else
+  {
+    rows(0, h * d);
   }
 }
 // 1st channel in contiguous block; last for opacity channel
@@ -886,8 +913,11 @@ I would like to thank Martin Kraus who helped in the adaptation
 of the pre-integration method to Virvo.
 @param thickness  distance of two volume slices in the direction
 of the principal viewing axis (defaults to 1.0)
+@param cache      transfer function of the previous call with the same table,
+                  only the entries affected by changes are recomputed if given
 */
-void vvTransFunc::makePreintLUTCorrect(int width, uchar *preIntTable, float thickness, float min, float max)
+void vvTransFunc::makePreintLUTCorrect(int width, uchar *preIntTable, float thickness, float min, float max,
+  virvo::PreintCache* cache)
 {
   vvDebugMsg::msg(1, "vvTransFunc::makePreintLUTCorrect()");
 
@@ -899,61 +929,20 @@ void vvTransFunc::makePreintLUTCorrect(int width, uchar *preIntTable, float thic
   rgba[width*4+2] = rgba[(width-1)*4+2];
   rgba[width*4+3] = rgba[(width-1)*4+3];
 
-#if VV_HAVE_CUDA
-  if(!makePreintLUTCorrectCuda(width, preIntTable, thickness, min, max, rgba))
-#endif
-  {
-  const int minLookupSteps = 2;
-  const int addLookupSteps = 1;
-
-  // cerr << "Calculating dependent texture - Please wait ...";
-  vvToolshed::initProgress(width);
-  for (int sb=0;sb<width;sb++)
+  int first = 0;
+  int last = width - 1;
+  if (cache != NULL && !cache->update(virvo::PreintCache::CORRECT, rgba, width, thickness, preIntTable, first, last))
   {
-    for (int sf=0;sf<width;sf++)
-    {
-      int n=minLookupSteps+addLookupSteps*abs(sb-sf);
-      double stepWidth = 1./n;
-      double r=0., g=0., b=0., tau=0.;
-      for (int i=0;i<n;i++)
-      {
-        const double s = sf+(sb-sf)*(double)i/n;
-        const int is = (int)s;
-        const double fract_s = s-floor(s);
-        const double tauc = thickness*stepWidth*(rgba[is*4+3]*fract_s+rgba[(is+1)*4+3]*(1.0-fract_s));
-        const double e_tau = exp(-tau);
-#ifdef STANDARD
-        /* standard optical model: r,g,b densities are multiplied with opacity density */
-        const double rc = e_tau*tauc*(rgba[is*4+0]*fract_s+rgba[(is+1)*4+0]*(1.0-fract_s));
-        const double gc = e_tau*tauc*(rgba[is*4+1]*fract_s+rgba[(is+1)*4+1]*(1.0-fract_s));
-        const double bc = e_tau*tauc*(rgba[is*4+2]*fract_s+rgba[(is+1)*4+2]*(1.0-fract_s));
+    delete[] rgba;
+    return;
+  }
 
-#else
-        /* Willhelms, Van Gelder optical model: r,g,b densities are not multiplied */
-        const double rc = e_tau*stepWidth*(rgba[is*4+0]*fract_s+rgba[(is+1)*4+0]*(1.0-fract_s));
-        const double gc = e_tau*stepWidth*(rgba[is*4+1]*fract_s+rgba[(is+1)*4+1]*(1.0-fract_s));
-        const double bc = e_tau*stepWidth*(rgba[is*4+2]*fract_s+rgba[(is+1)*4+2]*(1.0-fract_s));
+#if VV_HAVE_CUDA
+  // Partial updates are cheaper on the CPU
+  if((first > 0 || last < width - 1) || !makePreintLUTCorrectCuda(width, preIntTable, thickness, min, max, rgba))
 #endif
-
-        r = r+rc;
-        g = g+gc;
-        b = b+bc;
-        tau = tau + tauc;
-      }
-      if (r>1.)
-        r = 1.;
-      preIntTable[sf*width*4+sb*4+0] = uchar(r*255.99);
-      if (g>1.)
-        g = 1.;
-      preIntTable[sf*width*4+sb*4+1] = uchar(g*255.99);
-      if (b>1.)
-        b = 1.;
-      preIntTable[sf*width*4+sb*4+2] = uchar(b*255.99);
-      preIntTable[sf*width*4+sb*4+3] = uchar((1.- exp(-tau))*255.99);
-    }
-    vvToolshed::printProgress(sb);
-  }
-  // cerr << "done." << endl;
+  {
+  virvo::makePreintTableCorrect(rgba, width, thickness, preIntTable, first, last);
   }
   delete[] rgba;
 }
@@ -989,152 +978,26 @@ I would like to thank Martin Kraus who helped in the adaptation
 of the pre-integration method to Virvo.
 @param thickness  distance of two volume slices in the direction
 of the principal viewing axis (defaults to 1.0)
+@param cache      transfer function of the previous call with the same table,
+                  only the entries affected by changes are recomputed if given
 */
-void vvTransFunc::makePreintLUTOptimized(int width, uchar *preIntTable, float thickness, float min, float max)
+void vvTransFunc::makePreintLUTOptimized(int width, uchar *preIntTable, float thickness, float min, float max,
+  virvo::PreintCache* cache)
 {
-  float *rInt = new float[width];
-  float *gInt = new float[width];
-  float *bInt = new float[width];
-  float *aInt = new float[width];
-
   vvDebugMsg::msg(1, "vvTransFunc::makePreintLUTOptimized()");
 
   // Generate arrays from pins:
-  float *rgba = new float[width * 4];
-  computeTFTexture(width, 1, 1, rgba, min, max);
-
-  // cerr << "Calculating optimized dependent texture" << endl;
-  int rcol=0, gcol=0, bcol=0, acol=0;
-  rInt[0] = 0.f;
-  gInt[0] = 0.f;
-  bInt[0] = 0.f;
-  aInt[0] = 0.f;
-  preIntTable[0] = int(rgba[0]);
-  preIntTable[1] = int(rgba[1]);
-  preIntTable[2] = int(rgba[2]);
-  preIntTable[3] = int((1.f - expf(-rgba[3]*thickness)) * 255.99f);
-  for (int i=1;i<width;i++)
-  {
-#ifdef STANDARD
-    /* standard optical model: r,g,b densities are multiplied with opacity density */
-    // accumulated values
-    float tauc = (int(rgba[(i-1)*4+3]) + int(rgba[i*4+3])) * .5f;
-    rInt[i] = rInt[i-1] + (int(255.99f*rgba[(i-1)*4+0]) + int(255.99f*rgba[i*4+0])) * .5f * tauc;
-    gInt[i] = gInt[i-1] + (int(255.99f*rgba[(i-1)*4+1]) + int(255.99f*rgba[i*4+1])) * .5f * tauc;
-    bInt[i] = bInt[i-1] + (int(255.99f*rgba[(i-1)*4+2]) + int(255.99f*rgba[i*4+2])) * .5f * tauc;
-    aInt[i] = aInt[i-1] + tauc;
-
-    // diagonal for lookup texture
-    rcol = int(rgba[i*4+0] * rgba[i*4+3] * thickness * 255.99f);
-    gcol = int(rgba[i*4+1] * rgba[i*4+3] * thickness * 255.99f);
-    bcol = int(rgba[i*4+2] * rgba[i*4+3] * thickness * 255.99f);
-    acol = int((1.f - expf(- rgba[i*4+3] * thickness)) * 255.99f);
-#else
-    /* Willhelms, Van Gelder optical model: r,g,b densities are not multiplied */
-    // accumulated values
-    rInt[i] = rInt[i-1] + (rgba[(i-1)*4+0] + rgba[i*4+0]) * .5f * 255;
-    gInt[i] = gInt[i-1] + (rgba[(i-1)*4+1] + rgba[i*4+1]) * .5f * 255;
-    bInt[i] = bInt[i-1] + (rgba[(i-1)*4+2] + rgba[i*4+2]) * .5f * 255;
-    aInt[i] = aInt[i-1] + (rgba[(i-1)*4+3] + rgba[i*4+3]) * .5f;
-
-    // diagonal for lookup texture
-    rcol = int(255.99f*rgba[i*4+0]);
-    gcol = int(255.99f*rgba[i*4+1]);
-    bcol = int(255.99f*rgba[i*4+2]);
-    acol = int((1.f - expf(-rgba[i*4+3] * thickness)) * 255.99f);
-#endif
-
-    preIntTable[i*width*4+i*4+0] = uchar(rcol);
-    preIntTable[i*width*4+i*4+1] = uchar(gcol);
-    preIntTable[i*width*4+i*4+2] = uchar(bcol);
-    preIntTable[i*width*4+i*4+3] = uchar(acol);
-  }
+  std::vector<float> rgba(width * 4);
+  computeTFTexture(width, 1, 1, &rgba[0], min, max);
 
-  for (int sb=0;sb<width;sb++)
+  int first = 0;
+  int last = width - 1;
+  if (cache != NULL && !cache->update(virvo::PreintCache::OPTIMIZED, &rgba[0], width, thickness, preIntTable, first, last))
   {
-    for (int sf=0;sf<sb;sf++)
-    {
-      bool opaque = false;
-      for (int s = sf; s <= sb; s++)
-      {
-        if (rgba[s*4+3] >= .996f)
-        {
-          rcol = int(rgba[s*4+0]*255.99f);
-          gcol = int(rgba[s*4+1]*255.99f);
-          bcol = int(rgba[s*4+2]*255.99f);
-          acol = int(255);
-          opaque = true;
-          break;
-        }
-      }
-
-      if(opaque)
-      {
-        preIntTable[sb*width*4+sf*4+0] = uchar(rcol);
-        preIntTable[sb*width*4+sf*4+1] = uchar(gcol);
-        preIntTable[sb*width*4+sf*4+2] = uchar(bcol);
-        preIntTable[sb*width*4+sf*4+3] = uchar(acol);
-
-        for (int s = sb; s >= sf; s--)
-        {
-          if (rgba[s*4+3] >= .996f)
-          {
-            rcol = int(rgba[s*4+0]*255.99f);
-            gcol = int(rgba[s*4+1]*255.99f);
-            bcol = int(rgba[s*4+2]*255.99f);
-            acol = int(255);
-            break;
-          }
-        }
-        preIntTable[sf*width*4+sb*4+0] = uchar(rcol);
-        preIntTable[sf*width*4+sb*4+1] = uchar(gcol);
-        preIntTable[sf*width*4+sb*4+2] = uchar(bcol);
-        preIntTable[sf*width*4+sb*4+3] = uchar(acol);
-        continue;
-      }
-
-      float scale = 1.f/(sb-sf);
-      rcol = int((rInt[sb] - rInt[sf])*scale);
-      gcol = int((gInt[sb] - gInt[sf])*scale);
-      bcol = int((bInt[sb] - bInt[sf])*scale);
-      acol = int((1.f - expf(-(aInt[sb]-aInt[sf])*scale * thickness)) * 255.99f);
-
-      if (rcol > 255)
-        rcol = 255;
-      if (gcol > 255)
-        gcol = 255;
-      if (bcol > 255)
-        bcol = 255;
-      if (acol > 255)
-        acol = 255;
-
-      preIntTable[sf*width*4+sb*4+0] = uchar(rcol);
-      preIntTable[sf*width*4+sb*4+1] = uchar(gcol);
-      preIntTable[sf*width*4+sb*4+2] = uchar(bcol);
-      preIntTable[sf*width*4+sb*4+3] = uchar(acol);
-
-      preIntTable[sb*width*4+sf*4+0] = uchar(rcol);
-      preIntTable[sb*width*4+sf*4+1] = uchar(gcol);
-      preIntTable[sb*width*4+sf*4+2] = uchar(bcol);
-      preIntTable[sb*width*4+sf*4+3] = uchar(acol);
-
-#if 0
-      if (sb%16==0 && sf%16==0)
-      {
-        std::cerr << "preIntTable(" << sf << "," << sb << ") = ("
-          << int(preIntTable[sf*width*4+sb*4+0]) << " "
-          << int(preIntTable[sf*width*4+sb*4+1]) << " "
-          << int(preIntTable[sf*width*4+sb*4+2]) << " "
-          << int(preIntTable[sf*width*4+sb*4+3]) << ")" << std::endl;
-      }
-#endif
-    }
+    return;
   }
 
-  delete[] rInt;
-  delete[] gInt;
-  delete[] bInt;
-  delete[] aInt;
+  virvo::makePreintTableOptimized(&rgba[0], width, thickness, preIntTable, first, last);
 }
 
 /** Save transfer function to ascii file
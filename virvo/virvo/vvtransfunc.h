@@ -28,6 +28,11 @@
 
 #include <vector>
 
+namespace virvo
+{
+  class PreintCache;
+}
+
 /** Description of a transfer function.
   @author Jurgen P. Schulze (jschulze@ucsd.edu)
   @see vvTFWidget
@@ -92,8 +97,10 @@ class VIRVO_TRANSFUNCEXPORT vvTransFunc
     void make2DTFTexture2(int, int, uchar*, float, float, float, float);
     void make8bitLUT(int, uchar*, float, float);
     void makeFloatLUT(int, float*);
-    void makePreintLUTOptimized(int width, uchar *preintLUT, float thickness=1.0, float min=0.0, float max=1.0);
-    void makePreintLUTCorrect(int width, uchar *preintLUT, float thickness=1.0, float min=0.0, float max=1.0);
+    void makePreintLUTOptimized(int width, uchar *preintLUT, float thickness=1.0, float min=0.0, float max=1.0,
+                                virvo::PreintCache* cache = NULL);
+    void makePreintLUTCorrect(int width, uchar *preintLUT, float thickness=1.0, float min=0.0, float max=1.0,
+                              virvo::PreintCache* cache = NULL);
     void makeMinMaxTable(int width, uchar *minmax, float min=0.0, float max=1.0);
     static void copy(std::vector<vvTFWidget*>*, const std::vector<vvTFWidget *> *);
     void putUndoBuffer();
@@ -28,8 +28,12 @@
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
+#include <atomic>
+#include <float.h>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <sstream>
 
@@ -51,6 +55,12 @@
 #include "vvvecmath.h"
 #include "vvvoldesc.h"
 #include "mem/swap.h"
+#include "private/parallel_for.h"
+#include "private/vvcompiledtf.h"
+#include "private/vvframecache.h"
+#include "private/vvquantiles.h"
+#include "private/vvresample.h"
+#include "private/vvstencil.h"
 
 #ifdef __sun
 #define logf log
@@ -63,6 +73,80 @@ using namespace virvo;
 const size_t vvVolDesc::DEFAULT_ICON_SIZE = 64;
 const size_t vvVolDesc::NUM_HDR_BINS = vvTransFunc::NUM_HDR_BINS;
 
+namespace
+{
+  /// Decode one channel of a voxel the same way getChannelValue() does.
+  inline float decodeChannelValue(const uint8_t* ptr, size_t bpc, vec2 const& mapping)
+  {
+    switch (bpc)
+    {
+      case 1:
+        return lerp(mapping[0], mapping[1], float(*ptr) / 255);
+      case 2:
+      {
+        uint16_t ival;
+        memcpy(&ival, ptr, sizeof(ival));
+        return lerp(mapping[0], mapping[1], float(ival) / 65535);
+      }
+      case 4:
+      {
+        float fval;
+        memcpy(&fval, ptr, sizeof(fval));
+        return fval;
+      }
+      default:
+        assert(0);
+        return 0.0f;
+    }
+  }
+
+  /// Source of frame revisions, shared by all volumes.
+  std::atomic<size_t> nextRevision(0);
+
+  /// Deletes a shared frame, unless ownership went back to a frame list.
+  struct FrameDeleter
+  {
+    bool released;
+
+    FrameDeleter() : released(false) {}
+
+    void operator()(uint8_t* data) const
+    {
+      if (!released) delete[] data;
+    }
+  };
+
+  /// Decodes sparse frames into the cache of decompressed frames.
+  class SparseSource : public virvo::FrameSource
+  {
+  public:
+    explicit SparseSource(boost::shared_ptr< virvo::SparseFrame > const& frame)
+      : frame_(frame)
+    {
+    }
+
+    bool decompress(uint8_t* dst, bool /* parallel */) const
+    {
+      frame_->toDense(dst);
+      return true;
+    }
+
+    size_t getFrameBytes() const
+    {
+      virvo::vector< 3, ssize_t > v = frame_->getVox();
+      return v[0] * v[1] * v[2] * frame_->getBPV();
+    }
+
+    size_t getBytes() const
+    {
+      return frame_->getBytes();
+    }
+
+  private:
+    boost::shared_ptr< virvo::SparseFrame > frame_;
+  };
+}
+
 //============================================================================
 // Class vvVolDesc
 //============================================================================
@@ -113,7 +197,9 @@ uint8_t** d, vvVolDesc::DeleteType deleteType)
   bpc    = b;
   chan    = m;
   frames = f;
-  range_.resize(chan);
+  mapping_.resize(chan, vec2(0.0f, 1.0f));
+  zoomRange_.resize(chan, vec2(0.0f, 1.0f));
+  range_.resize(chan, vec2(0.0f, 1.0f));
   channelWeights.resize(chan);
   std::fill(channelWeights.begin(), channelWeights.end(), 1.0f);
 
@@ -267,7 +353,9 @@ vvVolDesc::vvVolDesc(const char* fn, size_t w, size_t h, uint8_t* d)
 
 //----------------------------------------------------------------------------
 /** Copy constructor.
- Copies all vvVolDesc data including transfer functions and raw voxel data.
+ Copies all vvVolDesc data including transfer functions. Voxel data
+ is shared copy-on-write: frames are only duplicated when one of the
+ volumes modifies them (see getRaw()).
  @param v  source volume description
  @param f  frame index to copy (0 for first frame, -1 for all frames, -2 for no copying of raw data)
 */
@@ -282,16 +370,22 @@ vvVolDesc::vvVolDesc(const vvVolDesc* v, int f)
     vox[i]  = v->vox[i];
     dist[i] = v->dist[i];
   }
-  std::copy(v->range_.begin(), v->range_.end(), std::back_inserter(range_));
+  mapping_   = v->mapping_;
+  zoomRange_ = v->zoomRange_;
+  range_     = v->range_;
+  channelNames = v->channelNames;
+  pos    = v->pos;
   dt     = v->dt;
   bpc    = v->bpc;
   chan   = v->chan;
   frames = 0;
   currentFrame = (f==-1) ? v->currentFrame : 0;
   indexChannel = -1;
+  lodFilter_ = v->lodFilter_;
+  prefetchFrames_ = v->prefetchFrames_;
+  residentFrames_ = v->residentFrames_;
 
-  std::copy(v->range_.begin(), v->range_.end(), std::back_inserter(range_));
-  std::copy(v->channelWeights.begin(), v->channelWeights.end(), std::back_inserter(channelWeights));
+  channelWeights = v->channelWeights;
 
   // Copy icon:
   iconSize = v->iconSize;
@@ -302,20 +396,41 @@ vvVolDesc::vvVolDesc(const vvVolDesc* v, int f)
   }
 
   // Copy transfer functions:
-  std::copy(v->tf.begin(), v->tf.end(), std::back_inserter(tf));
+  tf = v->tf;
 
-  if (f==-1)
+  if (f!=-2)
   {
-    for (size_t i=0; i<v->frames; ++i)
+    size_t first = (f==-1) ? 0 : size_t(f);
+    size_t last = (f==-1) ? v->frames : size_t(f) + 1;
+    for (size_t i=first; i<last; ++i)
     {
-      copyFrame(v->getRaw(i));
+      if (v->isSparse(i))                         // sparse frames are never modified in place
+      {
+        raw.append(NULL, vvSLNode<uint8_t*>::NO_DELETE);
+        sparse_.resize(raw.count());
+        sparse_.back() = v->sparse_[i];
+      }
+      else if (v->isCompressed(i) || v->isLazy(i)) // neither are compressed or lazily loaded frames
+      {
+        raw.append(NULL, vvSLNode<uint8_t*>::NO_DELETE);
+        compressed_.resize(raw.count());
+        compressed_.back() = v->compressed_[i];
+      }
+      else
+      {
+        v->shareFrame(i);
+        if (i < v->shared_.size() && v->shared_[i])
+        {
+          raw.append(v->shared_[i].get(), vvSLNode<uint8_t*>::NO_DELETE);
+          shared_.resize(raw.count());
+          shared_.back() = v->shared_[i];
+        }
+        else copyFrame(v->getConstRaw(i));        // frame memory is owned by the caller
+      }
       ++frames;
     }
-  }
-  else if (f!=-2)
-  {
-    copyFrame(v->getRaw(size_t(f)));
-    ++frames;
+    if (channelNames.size() == 0) channelNames.resize(chan);
+    updateFrameCache();
   }
 }
 
@@ -339,7 +454,7 @@ uint8_t* vvVolDesc::operator()(size_t x, size_t y, size_t slice)
 
 const uint8_t* vvVolDesc::operator()(size_t x, size_t y, size_t slice) const
 {
-  const uint8_t* raw = getRaw(-1);
+  const uint8_t* raw = getConstRaw(-1);
   raw += slice * getSliceBytes();
   return &raw[(vox[0] * y + x) * getBPV()];
 }
@@ -353,7 +468,7 @@ uint8_t* vvVolDesc::operator()(size_t f, size_t x, size_t y, size_t slice)
 
 const uint8_t* vvVolDesc::operator()(size_t f, size_t x, size_t y, size_t slice) const
 {
-  uint8_t* raw = getRaw(f);
+  const uint8_t* raw = getConstRaw(f);
   raw += slice * getSliceBytes();
   return &raw[(vox[0] * y + x) * getBPV()];
 }
@@ -381,6 +496,11 @@ void vvVolDesc::initialize()
   _binning = LINEAR;
   _transOp = false;
   iconData = NULL;
+  lodFilter_ = LOD_AVERAGE;
+  lodFormat_ = virvo::vector< 4, ssize_t >(ssize_t(0));
+  prefetchFrames_ = 2;
+  residentFrames_ = 1;
+  statsFormat_ = virvo::vector< 3, ssize_t >(ssize_t(0));
 }
 
 //----------------------------------------------------------------------------
@@ -408,7 +528,13 @@ void vvVolDesc::removeSequence()
   vvDebugMsg::msg(2, "vvVolDesc::removeSequence()");
   if (raw.isEmpty()) return;
   raw.removeAll();
+  if (frameCache_) frameCache_->clear();
+  sparse_.clear();
+  sparseSource_.clear();
+  shared_.clear();
+  compressed_.clear();
   deleteChannelNames();
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -519,6 +645,8 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
 
   vvDebugMsg::msg(2, "vvVolDesc::merge()");
   if (src->frames==0) return OK;                  // is source src empty?
+  densify();                                      // frames are moved between both sequences
+  src->densify();
                                                   // are data types the same?
   if ((bpc != src->bpc) && frames != 0) return TYPE_ERROR;
 
@@ -550,6 +678,8 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
 
     // Delete sequence information from source:
     src->bpc = src->chan = src->vox[0] = src->vox[1] = src->vox[2] = src->frames = src->currentFrame = 0;
+    dataChanged();
+    src->dataChanged();
     return OK;
   }
 
@@ -563,7 +693,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
       {
         raw.makeCurrent(f);
         rd = raw.getData();
-        uint8_t* srcRD = src->getRaw(f);
+        const uint8_t* srcRD = src->getConstRaw(f);
         newRaw = new uint8_t[getFrameBytes() + src->getFrameBytes()];
         for (size_t i=0; i<getFrameVoxels(); ++i)
         {
@@ -577,6 +707,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
       for (int i=0; i<src->chan; ++i) setChannelName((chan+i), src->channelNames[i]);
       chan += src->chan;                          // update target channel number
       src->removeSequence();                      // delete copied frames from source
+      dataChanged();
       return OK;
     }
     else
@@ -598,6 +729,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
       // Delete sequence information from src:
       src->bpc = src->chan = src->vox[0] = src->vox[1] = src->vox[2] = src->frames = src->currentFrame = 0;
       src->deleteChannelNames();
+      src->dataChanged();                         // the frames of this volume did not change
       return OK;
     }
     else
@@ -619,7 +751,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
         newRaw = new uint8_t[getFrameBytes() + src->getFrameBytes()];
         memcpy(newRaw, rd, getFrameBytes());      // copy current frame to new raw data array
                                                   // copy source frame to new raw data array
-        memcpy(newRaw + getFrameBytes(), src->getRaw(f), src->getFrameBytes());
+        memcpy(newRaw + getFrameBytes(), src->getConstRaw(f), src->getFrameBytes());
         raw.remove();
         if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
         else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
@@ -632,6 +764,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
         range(c).y = std::max(range(c).y, src->range(c).y);
         mapping(c) = src->mapping(c);
       }
+      dataChanged();
       return OK;
     }
     else
@@ -675,7 +808,7 @@ vvVolDesc::ErrorType vvVolDesc::mergeFrames(ssize_t slicesPerFrame)
         fn = frames-1;
         fprintf(stderr," please read all frames, not enough space for all frames\n");
       }
-      memcpy(newRaw + getFrameBytes()*fn, getRaw(f), getFrameBytes());
+      memcpy(newRaw + getFrameBytes()*fn, getConstRaw(f), getFrameBytes());
     }
     rawFrames.push_back(newRaw);
   }
@@ -690,7 +823,7 @@ vvVolDesc::ErrorType vvVolDesc::mergeFrames(ssize_t slicesPerFrame)
         newRaw = new uint8_t[getFrameBytes() * slicesPerFrame];
         rawFrames.push_back(newRaw);
       }
-      memcpy(newRaw + getFrameBytes()*fn, getRaw(f), getFrameBytes());
+      memcpy(newRaw + getFrameBytes()*fn, getConstRaw(f), getFrameBytes());
     }
   }
 
@@ -724,12 +857,51 @@ uint8_t* vvVolDesc::getRaw(int frame) const
 
 //----------------------------------------------------------------------------
 /** Returns a pointer to the raw data of a specific frame.
+  The data may be modified: a frame that is shared with copies of this volume
+  is duplicated first, and the frame gets a new revision, so data derived
+  from it (LOD levels, statistics) is recomputed. Use getConstRaw() to only
+  read the data.
   @param frame  index of desired frame (0 for first frame) if frame does not
-                exist, NULL will be returned
+                exist or is a lazily loaded frame that cannot be read from
+                its file, NULL will be returned
 */
 uint8_t* vvVolDesc::getRaw(size_t frame) const
 {
   if (frame>=frames) return NULL;     // frame does not exist
+  newRevision(int(frame));
+  if (frame < sparse_.size() && sparse_[frame]) return densifyFrame(frame);
+  if (frame < compressed_.size() && compressed_[frame]) return decompressFrame(frame);
+  if (frame < shared_.size() && shared_[frame]) return unshareFrame(frame);
+  raw.makeCurrent(frame);
+  return raw.getData();
+}
+
+//----------------------------------------------------------------------------
+/** Returns a read-only pointer to the raw data of a frame.
+  Unlike getRaw(), frames shared with copies of this volume stay shared,
+  and compressed and sparse frames keep their storage: the pointer refers to
+  a decompressed copy in the cache of decompressed frames (see
+  compressFrames() for how long it remains valid).
+  @param frame  index of desired frame (0 for first frame, -1 for current frame)
+*/
+const uint8_t* vvVolDesc::getConstRaw(int frame) const
+{
+  if (frame == -1)
+    return getConstRaw(static_cast< size_t >(currentFrame));
+  else
+    return getConstRaw(static_cast< size_t >(frame));
+}
+
+//----------------------------------------------------------------------------
+/** Returns a read-only pointer to the raw data of a specific frame.
+  @param frame  index of desired frame (0 for first frame) if frame does not
+                exist or cannot be read, NULL will be returned
+*/
+const uint8_t* vvVolDesc::getConstRaw(size_t frame) const
+{
+  if (frame>=frames) return NULL;     // frame does not exist
+  if (frame < sparse_.size() && sparse_[frame]) return frameCache().get(frame, sparseSource(frame));
+  if (frame < compressed_.size() && compressed_[frame]) return frameCache().get(frame, compressed_[frame].get());
   raw.makeCurrent(frame);
   return raw.getData();
 }
@@ -785,7 +957,7 @@ size_t vvVolDesc::getStoredFrames() const
     to the animation sequence.
   @param ptr  pointer to raw source data, _must_ be deleted by the caller!
 */
-void vvVolDesc::copyFrame(uint8_t* ptr)
+void vvVolDesc::copyFrame(const uint8_t* ptr)
 {
   uint8_t* newData;
 
@@ -801,6 +973,45 @@ void vvVolDesc::copyFrame(uint8_t* ptr)
   }
 }
 
+//----------------------------------------------------------------------------
+/** Passes the voxel data of a frame to the caller without copying it if
+  possible. The frame stays in the sequence but has no data afterwards,
+  it is meant to be followed by removeSequence().
+  @param frame frame ID (0=first)
+  @return frame data allocated with new[], owned by the caller,
+          NULL if the frame does not exist or cannot be read
+*/
+uint8_t* vvVolDesc::takeFrame(size_t frame)
+{
+  vvDebugMsg::msg(3, "vvVolDesc::takeFrame()");
+
+  if (frame >= raw.count()) return NULL;
+
+  if (frame < sparse_.size() && sparse_[frame]) densifyFrame(frame);
+  else if (frame < compressed_.size() && compressed_[frame]) decompressFrame(frame);
+  else if (frame < shared_.size() && shared_[frame]) unshareFrame(frame);
+
+  raw.makeCurrent(frame);
+  uint8_t* data = raw.getData();
+  if (data != NULL)
+  {
+    if (raw.getDeleteType() == vvSLNode<uint8_t*>::ARRAY_DELETE)
+    {
+      raw.setDeleteData(vvSLNode<uint8_t*>::NO_DELETE);
+    }
+    else
+    {
+      uint8_t* copy = new uint8_t[getFrameBytes()];
+      memcpy(copy, data, getFrameBytes());
+      data = copy;
+    }
+  }
+
+  releaseFrame(frame);
+  dataChanged(int(frame));
+  return data;
+}
+
 //----------------------------------------------------------------------------
 /** Updates the volume data of a frame. The data format needs to stay
 the same.
@@ -811,6 +1022,11 @@ the same.
 void vvVolDesc::updateFrame(int frame, uint8_t* newData, DeleteType deleteData)
 {
   vvDebugMsg::msg(3, "vvVolDesc::updateFrame()");
+  if (frame < static_cast<int>(sparse_.size())) sparse_[frame].reset();
+  if (frame < static_cast<int>(shared_.size())) shared_[frame].reset();
+  if (frameCache_) frameCache_->release(frame);
+  if (frame < static_cast<int>(sparseSource_.size())) sparseSource_[frame].reset();
+  if (frame < static_cast<int>(compressed_.size())) compressed_[frame].reset();
   raw.makeCurrent(frame);
   raw.remove();
   switch(deleteData)
@@ -820,6 +1036,7 @@ void vvVolDesc::updateFrame(int frame, uint8_t* newData, DeleteType deleteData)
     case ARRAY_DELETE:  raw.insertAfter(newData, vvSLNode<uint8_t*>::ARRAY_DELETE); break;
     default: assert(0); break;
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -885,31 +1102,73 @@ void vvVolDesc::makeHistogram(int frame, int chan1, int numChan, int* buckets, i
   int totalBuckets = std::accumulate(buckets, buckets+numChan, 1, std::multiplies<int>());
   std::fill(count, count+totalBuckets, 0);        // initialize counter array
 
-  //vvStopwatch sw;sw.start();
-  for (int f=0; f<(int)frames; ++f)
+  // Integer data, one channel: accumulate the cached value histograms
+  if (numChan == 1 && bpc < 4)
+  {
+    float maxVal = (bpc == 1) ? 255.0f : 65535.0f;
+    for (size_t f=0; f<frames; ++f)
+    {
+      if (frame != -1 && frame != (int)f)
+        continue;
+
+      const std::vector<uint64_t>& hist = getStatistics(f, chan1).histogram;
+      for (size_t v=0; v<hist.size(); ++v)
+      {
+        if (hist[v] == 0) continue;
+        float voxVal = lerp(mapping(chan1)[0], mapping(chan1)[1], float(v) / maxVal);
+        int bucketIndex = (int)((voxVal - min) * (buckets[0] / (max-min)));
+        bucketIndex = ts_clamp(bucketIndex, 0, buckets[0]-1);
+        count[bucketIndex] += hist[v];
+      }
+    }
+    return;
+  }
+
+  // Otherwise: one parallel pass per frame, each thread counts into its own array
+  size_t frameVoxels = getFrameVoxels();
+  size_t bpv = getBPV();
+  size_t numChunks = std::max(size_t(1), std::min(size_t(virvo::numWorkerThreads()), frameVoxels / 65536));
+  std::vector< std::vector<int> > partial(numChunks);
+  std::vector<uint8_t> tmp;
+
+  for (size_t f=0; f<frames; ++f)
   {
-    if (frame != -1 && frame != f)
+    if (frame != -1 && frame != (int)f)
       continue; // only compute histogram for a specific frame
 
-    for (size_t i=0; i<getFrameVoxels(); ++i)     // count each voxel value
+    const uint8_t* data = getFrameData(f, tmp);
+    virvo::parallel_for(0, numChunks, [&](size_t first, size_t last)
     {
-      int dstIndex = 0;                           // index into histogram array
-      int factor = 1;                             // multiplication factor for dstIndex
-      for (int c=0; c<numChan; ++c)
+      for (size_t k=first; k<last; ++k)
       {
-        float voxVal = getChannelValue(f, i, chan1+c);
+        partial[k].assign(totalBuckets, 0);
+        for (size_t i=k*frameVoxels/numChunks; i<(k+1)*frameVoxels/numChunks; ++i)
+        {
+          const uint8_t* voxel = data + i * bpv;
+          int dstIndex = 0;                       // index into histogram array
+          int factor = 1;                         // multiplication factor for dstIndex
+          for (int c=0; c<numChan; ++c)
+          {
+            float voxVal = decodeChannelValue(voxel + (chan1+c) * bpc, bpc, mapping(chan1+c));
 
-        // Bucket index with respect to channel c
-        int bucketIndex = (int)((voxVal - min) * (buckets[c] / (max-min)));
-        bucketIndex = ts_clamp(bucketIndex, 0, buckets[c]-1);
+            // Bucket index with respect to channel c
+            int bucketIndex = (int)((voxVal - min) * (buckets[c] / (max-min)));
+            bucketIndex = ts_clamp(bucketIndex, 0, buckets[c]-1);
 
-        dstIndex += bucketIndex * factor;
-        factor *= buckets[c];
+            dstIndex += bucketIndex * factor;
+            factor *= buckets[c];
+          }
+          ++partial[k][dstIndex];
+        }
       }
-      ++count[dstIndex];
+    });
+
+    for (size_t k=0; k<numChunks; ++k)
+    {
+      for (int i=0; i<totalBuckets; ++i)
+        count[i] += partial[k][i];
     }
   }
-  //std::cout << sw.getTime() << '\n';
 }
 
 //----------------------------------------------------------------------------
@@ -1285,6 +1544,7 @@ const char* vvVolDesc::getFilename() const
 void vvVolDesc::setCurrentFrame(size_t f)
 {
   if (f<frames) currentFrame = f;
+  updateFrameCache();
 }
 
 //----------------------------------------------------------------------------
@@ -1394,6 +1654,7 @@ void vvVolDesc::convertBPC(size_t newBPC, bool verbose)
   newSliceSize = vox[0] * vox[1] * newBPC * chan;
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
 
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -1462,6 +1723,7 @@ void vvVolDesc::convertBPC(size_t newBPC, bool verbose)
     raw.next();
   }
   bpc = newBPC;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1493,6 +1755,7 @@ void vvVolDesc::convertChannels(int newChan, int frame, bool verbose)
 
   newSliceSize = vox[0] * vox[1] * newChan * bpc;
   if (verbose) vvToolshed::initProgress(vox[2] * (endFrame-startFrame));
+  densify();
   raw.first();
   for (size_t f=startFrame; f<endFrame; ++f)
   {
@@ -1528,6 +1791,7 @@ void vvVolDesc::convertChannels(int newChan, int frame, bool verbose)
     // Adjust per-channel data:
     setChan(newChan);
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1549,6 +1813,7 @@ void vvVolDesc::deleteChannel(int channel, bool verbose)
 
   newSliceSize = vox[0] * vox[1] * (chan-1) * bpc;
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -1587,6 +1852,7 @@ void vvVolDesc::deleteChannel(int channel, bool verbose)
   zoomRange_.erase(zoomRange_.begin() + channel);
   range_.erase(range_.begin() + channel);
   --chan;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1615,6 +1881,7 @@ void vvVolDesc::bitShiftData(int bits, int frame, bool verbose)
     endFrame = frame+1;
   }
   if (verbose) vvToolshed::initProgress(vox[2] * (endFrame-startFrame));
+  densify();
   raw.first();
   for (size_t f=0; f<startFrame; ++f) raw.next();
   for (size_t f=startFrame; f<endFrame; ++f)
@@ -1663,6 +1930,7 @@ void vvVolDesc::bitShiftData(int bits, int frame, bool verbose)
       if (verbose) vvToolshed::printProgress(z + vox[2] * (f-startFrame));
     }
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1675,6 +1943,7 @@ void vvVolDesc::invert()
 
   vvDebugMsg::msg(2, "vvVolDesc::invert()");
 
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -1690,6 +1959,7 @@ void vvVolDesc::invert()
             ++ptr;
           }
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1712,6 +1982,7 @@ void vvVolDesc::convertRGB24toRGB8()
 
   oldSliceSize = getSliceBytes();
   newSliceSize = vox[0] * vox[1];
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -1737,6 +2008,7 @@ void vvVolDesc::convertRGB24toRGB8()
     raw.next();
   }
   chan = 1;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1774,6 +2046,7 @@ void vvVolDesc::flip(virvo::cartesian_axis< 3 > axis)
   sliceSize = getSliceBytes();
   if (axis==axis_type::Z) voxelData = new uchar[sliceSize];
   else voxelData = new uint8_t[lineSize];
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -1821,6 +2094,7 @@ void vvVolDesc::flip(virvo::cartesian_axis< 3 > axis)
     raw.next();
   }
   delete[] voxelData;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1875,6 +2149,7 @@ void vvVolDesc::rotate(virvo::cartesian_axis< 3 > axis, int dir)
   }
 
   size_t frameSize = getFrameBytes();
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -1943,6 +2218,7 @@ void vvVolDesc::rotate(virvo::cartesian_axis< 3 > axis, int dir)
   vox[0] = newWidth;
   vox[1] = newHeight;
   vox[2] = newSlices;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -1977,6 +2253,7 @@ void vvVolDesc::convertRGBPlanarToRGBInterleaved(int frame)
     memcpy(raw, tmpData, frameSize);
   }
   delete[] tmpData;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2056,6 +2333,7 @@ void vvVolDesc::toggleEndianness(int frame)
     }
 #endif
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2074,6 +2352,7 @@ void vvVolDesc::toggleSign(int /* frame */)
   vvDebugMsg::msg(2, "vvVolDesc::toggleSign()");
 
   size_t frameVoxels = getFrameVoxels();
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -2096,6 +2375,7 @@ void vvVolDesc::toggleSign(int /* frame */)
     }
     raw.next();
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2113,6 +2393,7 @@ void vvVolDesc::makeUnsigned(int /* frame */)
   vvDebugMsg::msg(2, "vvVolDesc::makeUnsigned()");
 
   size_t frameVoxels = getFrameVoxels();
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -2138,6 +2419,7 @@ void vvVolDesc::makeUnsigned(int /* frame */)
     }
     raw.next();
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2146,16 +2428,15 @@ void vvVolDesc::makeUnsigned(int /* frame */)
 */
 bool vvVolDesc::isChannelUsed(size_t m)
 {
-  uint8_t* rd;
+  const uint8_t* rd;
 
   vvDebugMsg::msg(2, "vvVolDesc::isChannelUsed()");
   assert(m<chan);
 
   size_t frameSize = getFrameVoxels();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = getConstRaw(f);
     for (size_t i=0; i<frameSize; ++i)
     {
       switch(bpc)
@@ -2165,7 +2446,6 @@ bool vvVolDesc::isChannelUsed(size_t m)
         case 4: if (*((float*)rd) != 0.0f) return true;
       }
     }
-    raw.next();
   }
   return false;
 }
@@ -2203,6 +2483,7 @@ void vvVolDesc::crop(ssize_t x, ssize_t y, ssize_t z, ssize_t w, ssize_t h, ssiz
   // Now cropping can be done:
   oldSliceSize = getSliceBytes();
   newSliceSize = newWidth * newHeight * getBPV();
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -2231,6 +2512,7 @@ void vvVolDesc::crop(ssize_t x, ssize_t y, ssize_t z, ssize_t w, ssize_t h, ssiz
   vox[0] = newWidth;
   vox[1] = newHeight;
   vox[2] = newSlices;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2240,6 +2522,7 @@ void vvVolDesc::crop(ssize_t x, ssize_t y, ssize_t z, ssize_t w, ssize_t h, ssiz
 */
 void vvVolDesc::cropTimesteps(size_t start, size_t steps)
 {
+  densify();
   raw.first();
 
   // Remove steps before the desired range:
@@ -2252,11 +2535,13 @@ void vvVolDesc::cropTimesteps(size_t start, size_t steps)
     raw.remove();
 
   frames = raw.count();
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
 /** Resize each volume of the animation. The real voxel size parameters
-  are adjusted accordingly.
+  are adjusted accordingly. Frames are resampled with separable filters,
+  using multiple threads.
   @param w,h,s   new width, height, and number of slices
   @param ipt     interpolation type to use for resampling
   @param verbose true = verbose mode
@@ -2264,13 +2549,8 @@ void vvVolDesc::cropTimesteps(size_t start, size_t steps)
 void vvVolDesc::resize(ssize_t w, ssize_t h, ssize_t s, InterpolationType ipt, bool verbose)
 {
   uint8_t* newRaw;                                  // pointer to new volume data
-  uint8_t* rd;
-  size_t newSliceSize, newFrameSize;
-  size_t oldSliceVoxels;
-  uint8_t *src, *dst;
-  ssize_t ix, iy, iz;                             // integer source voxel coordinates
-  float fx, fy, fz;                               // floating point source voxel coordinates
-  uint8_t interpolated[4];                        // interpolated voxel values
+  size_t newFrameSize;
+  virvo::ResampleFilter filter;
 
   vvDebugMsg::msg(2, "vvVolDesc::resize()");
 
@@ -2278,57 +2558,27 @@ void vvVolDesc::resize(ssize_t w, ssize_t h, ssize_t s, InterpolationType ipt, b
   if (w<=0 || h<=0 || s<=0) return;
   if (w==vox[0] && h==vox[1] && s==vox[2]) return;// already done
 
+  switch (ipt)
+  {
+    case TRILINEAR: filter = virvo::RESAMPLE_TRILINEAR; break;
+    case BOX:       filter = virvo::RESAMPLE_BOX; break;
+    case LANCZOS:   filter = virvo::RESAMPLE_LANCZOS; break;
+    case MAXIMUM:   filter = virvo::RESAMPLE_MAX; break;
+    case NEAREST:
+    default:        filter = virvo::RESAMPLE_NEAREST; break;
+  }
+
   // Now resizing can be done:
-  oldSliceVoxels = getSliceVoxels();
-  newSliceSize = w * h * getBPV();
-  newFrameSize = newSliceSize * s;
-  if (verbose) vvToolshed::initProgress(s * frames);
+  newFrameSize = w * h * s * getBPV();
+  if (verbose) vvToolshed::initProgress(frames);
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
     newRaw = new uint8_t[newFrameSize];
-    dst = newRaw;
-
-    // Traverse destination data:
-    for (ssize_t z=0; z<s; ++z)
-    {
-      for (ssize_t y=0; y<h; ++y)
-        for (ssize_t x=0; x<w; ++x)
-      {
-        // Compute source coordinates of current destination voxel:
-        if (ipt==TRILINEAR)                       // trilinear interpolation
-        {
-          // Compute source coordinates of current destination voxel:
-          fx = (float)x / (float)(w-1) * (float)(vox[0]-1);
-          fy = (float)y / (float)(h-1) * (float)(vox[1]-1);
-          fz = (float)z / (float)(s-1) * (float)(vox[2]-1);
-          trilinearInterpolation(f, fx, fy, fz, interpolated);
+    virvo::resample(raw.getData(), vox, newRaw, virvo::vector< 3, ssize_t >(w, h, s), bpc, chan, filter);
+    if (verbose) vvToolshed::printProgress(f);
 
-          // Copy interpolated voxel data to destination voxel:
-          memcpy(dst, interpolated, getBPV());
-        }
-        else                                      // nearest neighbor interpolation
-        {
-          // Compute source coordinates of current destination voxel:
-          if (w>1) ix = x * (vox[0]-1)  / (w-1);
-          else     ix = 0;
-          if (h>1) iy = y * (vox[1]-1) / (h-1);
-          else     iy = 0;
-          if (s>1) iz = z * (vox[2]-1) / (s-1);
-          else     iz = 0;
-          ix = ts_clamp(ix, ssize_t(0), vox[0]-1);
-          iy = ts_clamp(iy, ssize_t(0), vox[1]-1);
-          iz = ts_clamp(iz, ssize_t(0), vox[2]-1);
-
-          // Copy source voxel data to destination voxel:
-          src = rd + getBPV() * (ix + iy * vox[0] + iz * oldSliceVoxels);
-          memcpy(dst, src, getBPV());
-        }
-        dst += getBPV();
-      }
-      if (verbose) vvToolshed::printProgress(z + s * f);
-    }
     raw.remove();
     if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
     else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
@@ -2344,6 +2594,7 @@ void vvVolDesc::resize(ssize_t w, ssize_t h, ssize_t s, InterpolationType ipt, b
   vox[0] = w;
   vox[1] = h;
   vox[2] = s;
+  dataChanged();
 }
 
 void vvVolDesc::replaceData(int numChan, const int *oldVal, const int *newVal, bool verbose)
@@ -2357,6 +2608,7 @@ void vvVolDesc::replaceData(int numChan, const int *oldVal, const int *newVal, b
     numChan = chan;
 
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -2396,6 +2648,7 @@ void vvVolDesc::replaceData(int numChan, const int *oldVal, const int *newVal, b
   {
     vvDebugMsg::msg(1, "vvVolDesc::replaceData(): %d voxels replaced", (int)numReplaced);
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2431,6 +2684,7 @@ void vvVolDesc::shift(int sx, int sy, int sz)
   lineSize  = vox[0] * getBPV();
   sliceSize = getSliceBytes();
   frameSize = getFrameBytes();
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -2483,6 +2737,7 @@ void vvVolDesc::shift(int sx, int sy, int sz)
     }
     raw.next();
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2513,6 +2768,7 @@ void vvVolDesc::convertVoxelOrder()
     memcpy(raw, tmpData, frameSize);
   }
   delete[] tmpData;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2550,6 +2806,7 @@ void vvVolDesc::convertCoviseToVirvo()
 #if defined(__linux__) || defined(LINUX)
   if (bpc==1 && chan==4) toggleEndianness();      // RGBA data are transferred as packed colors, which are integers
 #endif
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2583,6 +2840,7 @@ void vvVolDesc::convertVirvoToCovise()
     memcpy(raw, tmpData, frameSize);
   }
   delete[] tmpData;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2616,6 +2874,7 @@ void vvVolDesc::convertVirvoToOpenGL()
     memcpy(raw, tmpData, frameSize);
   }
   delete[] tmpData;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2649,6 +2908,7 @@ void vvVolDesc::convertOpenGLToVirvo()
     memcpy(raw, tmpData, frameSize);
   }
   delete[] tmpData;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2689,8 +2949,8 @@ void vvVolDesc::makeIcon(size_t size)
 
   vvDebugMsg::msg(2, "vvVolDesc::makeIcon(1)");
 
-  // Create temporary volume if necessary:
-  if (bpc==1) tmpVD = this;
+  // Create temporary volume if necessary, sparse volumes stay sparse:
+  if (bpc==1 && !isSparse()) tmpVD = this;
   else tmpVD = new vvVolDesc(this, 0);
   tmpVD->convertBPC(1);
 
@@ -2703,7 +2963,7 @@ void vvVolDesc::makeIcon(size_t size)
   // Compute icon image:
   uint8_t* tmpSlice = new uint8_t[iconBytes];
   memset(iconData, 0, iconBytes);
-  uint8_t* raw = tmpVD->getRaw();
+  uint8_t* raw = const_cast<uint8_t*>(tmpVD->getConstRaw());
   for (ptrdiff_t i=tmpVD->vox[2]-1; i>=0; --i)
   {
     // Resample current volume slice to temporary image of icon size:
@@ -2779,6 +3039,7 @@ void vvVolDesc::makeSphere(size_t outer, size_t inner, InterpolationType ipt, bo
   center = vec3f(radius, radius, radius);
   sliceVoxels = vox[0] * vox[1];
   if (verbose) vvToolshed::initProgress(outer * frames);
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -2806,7 +3067,7 @@ void vvVolDesc::makeSphere(size_t outer, size_t inner, InterpolationType ipt, bo
           sx = phi / (2.0f * M_PI) * (float)vox[0];
           sy = theta / M_PI * (float)vox[1];
           sz = (float)vox[2] - 1.0f - ((dist-core) / ringSize * (float)vox[2]);
-          if (ipt==TRILINEAR)                     // trilinear interpolation
+          if (ipt!=NEAREST)                       // trilinear interpolation
           {
             trilinearInterpolation(f, sx, sy, sz, interpolated);
             memcpy(dst, interpolated, getBPV());
@@ -2832,6 +3093,7 @@ void vvVolDesc::makeSphere(size_t outer, size_t inner, InterpolationType ipt, bo
     raw.next();
   }
   vox[0] = vox[1] = vox[2] = outer;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -2930,6 +3192,44 @@ void vvVolDesc::printVolumeInfo()
     cerr << "Voxels total:                      " << getMovieVoxels() << endl;
     cerr << "Data bytes total:                  " << getMovieBytes() << endl;
   }
+  if (getSparseBytes() > 0)
+  {
+    size_t numSparse = 0;
+    size_t numBlocks = 0;
+    size_t numUsed = 0;
+    for (size_t f=0; f<frames; ++f)
+    {
+      const virvo::SparseFrame* sf = getSparseFrame(f);
+      if (!sf) continue;
+      virvo::vector< 3, ssize_t > nb = sf->getNumBlocks();
+      ++numSparse;
+      numBlocks += nb[0] * nb[1] * nb[2];
+      numUsed += sf->getNumNonEmptyBlocks();
+    }
+    cerr << "Sparse frames:                     " << numSparse << " of " << frames << endl;
+    cerr << "Non-empty blocks:                  " << numUsed << " of " << numBlocks << endl;
+    cerr << "Sparse data bytes:                 " << getSparseBytes() << endl;
+  }
+  if (getCompressedBytes() > 0)
+  {
+    size_t numCompressed = 0;
+    for (size_t f=0; f<frames; ++f)
+    {
+      if (isCompressed(f)) ++numCompressed;
+    }
+    cerr << "Compressed frames:                 " << numCompressed << " of " << frames << endl;
+    cerr << "Compressed data bytes:             " << getCompressedBytes() << endl;
+    cerr << "Decompressed data bytes:           " << getDecompressedBytes() << endl;
+  }
+  size_t numLazy = 0;
+  for (size_t f=0; f<frames; ++f)
+  {
+    if (isLazy(f)) ++numLazy;
+  }
+  if (numLazy > 0)
+  {
+    cerr << "Frames not read from file yet:     " << numLazy << " of " << frames << endl;
+  }
   cerr << "Sample distances:                  " << setprecision(3) << dist[0] << " x " << dist[1] << " x " << dist[2] << endl;
   cerr << "Time step duration [s]:            " << setprecision(3) << dt << endl;
   cerr << "Mapped data range:                 " << mapping(0)[0] << " to " << mapping(0)[1] << endl;
@@ -2955,7 +3255,7 @@ void vvVolDesc::printStatistics()
   for (int c=0; c<chan; ++c)
   {
     if (chan>1) cerr << "Channel " << c+1 << endl;
-    findMinMax(0, scalarMin, scalarMax);
+    findMinMax(c, scalarMin, scalarMax);
     calculateDistribution(0, c, mean, variance, stdev);
     cerr << "Scalar value range:                " << scalarMin << " to " << scalarMax << endl;
     if (bpc<3)  // doesn't work with floats
@@ -3003,11 +3303,11 @@ void vvVolDesc::printHistogram(int frame, int channel)
 */
 void vvVolDesc::printVoxelData(int frame, ssize_t slice, ssize_t width, ssize_t height)
 {
-  uint8_t* raw;                                   // pointer to raw volume data
+  const uint8_t* raw;                             // pointer to raw volume data
   ssize_t nx,ny;                                  // number of voxels to display per row/column
   int val;
 
-  raw = getRaw(frame);
+  raw = getConstRaw(frame);
   raw += slice * getSliceBytes();                 // move pointer to beginning of slice to display
   if (width<=0) nx = vox[0];
   else nx = ts_min(width, vox[0]);
@@ -3065,8 +3365,8 @@ an _allocated_ memory space of bpc * chan bytes.
 */
 void vvVolDesc::trilinearInterpolation(size_t f, float x, float y, float z, uint8_t* result)
 {
-  uint8_t* rd;
-  uint8_t* neighbor[8];                           // pointers to neighboring voxels
+  const uint8_t* rd;
+  const uint8_t* neighbor[8];                           // pointers to neighboring voxels
   float val[8];                                   // neighboring voxel values
   virvo::vector< 3, ssize_t > tfl;                // coordinates of neighbor 0 (top-front-left)
   float dist[3];                                  // distance to neighbor 0
@@ -3113,8 +3413,7 @@ void vvVolDesc::trilinearInterpolation(size_t f, float x, float y, float z, uint
     dist[2] = 1.0f;
   }
 
-  raw.makeCurrent(f);
-  rd = raw.getData();                             // get pointer to voxel data
+  rd = getConstRaw(f);                            // get pointer to voxel data
 
   // Compute pointers to neighboring voxels:
   sliceSize = vox[0] * vox[1] * getBPV();
@@ -3214,6 +3513,7 @@ void vvVolDesc::drawBox(ssize_t p1x, ssize_t p1y, ssize_t p1z, ssize_t p2x, ssiz
       }
     }
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -3282,6 +3582,7 @@ void vvVolDesc::drawSphere(ssize_t p1x, ssize_t p1y, ssize_t p1z, ssize_t radius
       }
     }
   }
+  dataChanged(currentFrame);
 }
 
 //----------------------------------------------------------------------------
@@ -3299,6 +3600,7 @@ void vvVolDesc::drawLine(ssize_t p1x, ssize_t p1y, ssize_t p1z, ssize_t p2x, ssi
   raw = getRaw(currentFrame);
   vvToolshed::draw3DLine(p1x, p1y, p1z, p2x, p2y, p2z, val,
     raw, getBPV(), vox[0], vox[1], vox[2]);
+  dataChanged(currentFrame);
 }
 
 //----------------------------------------------------------------------------
@@ -3446,6 +3748,7 @@ void vvVolDesc::drawBoundaries(uchar* color, int frame)
         color, raw, getBPV(), vox[0], vox[1], vox[2]);
     }
   }
+  dataChanged(frame);
 }
 
 //----------------------------------------------------------------------------
@@ -3767,6 +4070,7 @@ void vvVolDesc::setSliceData(uint8_t* newData, int slice, int frame)
     sliceSize = getSliceBytes();
     dst = getRaw(frame) + slice * sliceSize;
     memcpy(dst, newData, sliceSize);
+    dataChanged(frame);
   }
 }
 
@@ -3786,13 +4090,13 @@ void vvVolDesc::extractSliceData(int frame, virvo::cartesian_axis< 3 > axis, siz
 {
     typedef virvo::cartesian_axis< 3 > axis_type;
 
-  uint8_t* raw;                                   // raw volume data of current frame
+  const uint8_t* raw;                             // raw volume data of current frame
   size_t sliceSize;                               // bytes per volume slice (z-axis view)
   size_t lineSize;                                // bytes per voxel line
 
   sliceSize = getSliceBytes();
   lineSize  = vox[0] * getBPV();
-  raw = getRaw(frame);
+  raw = getConstRaw(frame);
   switch (axis)
   {
     case axis_type::X:                                       // x axis
@@ -3918,6 +4222,7 @@ void vvVolDesc::deinterlace()
   frameSize = getFrameBytes();
   volBuf = new uint8_t[frameSize];
   assert(volBuf);
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -3937,6 +4242,7 @@ void vvVolDesc::deinterlace()
     raw.next();
   }
   delete[] volBuf;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -3946,33 +4252,34 @@ void vvVolDesc::deinterlace()
 */
 void vvVolDesc::findMinMax(int channel, float& scalarMin, float& scalarMax) const
 {
-  (void)channel;
-  int mi, ma;
-  float fMin, fMax;
-
   vvDebugMsg::msg(2, "vvVolDesc::findMinMax()");
 
-  // TODO: make search channel dependent
+  if (frames==0 || channel<0 || channel>=chan) return;
+
+  float fMin = FLT_MAX;
+  float fMax = -FLT_MAX;
   for (size_t f=0; f<frames; ++f)
   {
-    switch(bpc)
-    {
-      case 1: vvToolshed::getMinMax(getRaw(f), getFrameBytes(), &mi, &ma);
-        fMin = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(mi) / 255);
-        fMax = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(ma) / 255);
-        break;
-      case 2: vvToolshed::getMinMax16bitHost(getRaw(f), getFrameVoxels(), &mi, &ma);
-        fMin = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(mi) / 65535);
-        fMax = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(ma) / 65535);
-        break;
-      case 4:
-        vvToolshed::getMinMax((float*)getRaw(f), getFrameVoxels(), &fMin, &fMax);
-        break;
-      default: assert(0); break;
-    }
+    const virvo::ChannelStatistics& stats = getStatistics(f, channel);
+    fMin = ts_min(fMin, stats.min);
+    fMax = ts_max(fMax, stats.max);
+  }
 
-    scalarMin = fMin;
-    scalarMax = fMax;
+  switch(bpc)
+  {
+    case 1:
+      scalarMin = lerp(mapping(channel)[0], mapping(channel)[1], fMin / 255);
+      scalarMax = lerp(mapping(channel)[0], mapping(channel)[1], fMax / 255);
+      break;
+    case 2:
+      scalarMin = lerp(mapping(channel)[0], mapping(channel)[1], fMin / 65535);
+      scalarMax = lerp(mapping(channel)[0], mapping(channel)[1], fMax / 65535);
+      break;
+    case 4:
+      scalarMin = fMin;
+      scalarMax = fMax;
+      break;
+    default: assert(0); break;
   }
 }
 
@@ -4030,17 +4337,25 @@ float vvVolDesc::findClampValue(int frame, int channel, float threshold) const
 */
 int vvVolDesc::findNumValue(int frame, float val)
 {
-  uint8_t* raw;
+  const uint8_t* raw;
   int num = 0;
   int sval;
   bool allEqual;
 
   vvDebugMsg::msg(2, "vvVolDesc::findNumValue()");
 
+  // Single channel integer data: look up the value in the histogram
+  if (chan==1 && bpc<4)
+  {
+    const std::vector<uint64_t>& hist = getStatistics((frame == -1) ? currentFrame : size_t(frame), 0).histogram;
+    if (val < 0.0f || val >= float(hist.size()) || float(int(val)) != val) return 0;
+    return int(hist[int(val)]);
+  }
+
   size_t frameVoxels = getFrameVoxels();
 
   // Search volume:
-  raw = getRaw(frame);
+  raw = getConstRaw(frame);
   for (size_t i=0; i<frameVoxels; ++i)
   {
     allEqual = true;
@@ -4115,7 +4430,7 @@ void vvVolDesc::findDataBounds(ssize_t &x, ssize_t &y, ssize_t &z, ssize_t &w, s
 
   for (size_t f=0; f<frames; ++f)
   {
-    const uint8_t *rRaw = getRaw(f);
+    const uint8_t *rRaw = getConstRaw(f);
     if (!rRaw)
       continue;
     switch (bpc)
@@ -4156,53 +4471,22 @@ void vvVolDesc::findDataBounds(ssize_t &x, ssize_t &y, ssize_t &z, ssize_t &w, s
 */
 int vvVolDesc::findNumUsed(int channel)
 {
-  bool* used;                                     // true = scalar value occurs in array
-  uint8_t* raw;
-  size_t numValues;
-  int numUsed = 0;
-  int value;
-
   vvDebugMsg::msg(2, "vvVolDesc::findNumUsed()");
 
   if (bpc>=3) return -1;     // doesn't work with floats
 
-  size_t frameVoxels = getFrameVoxels();
-  numValues = (bpc==2) ? 65536 : 256;
-  used = new bool[numValues];
-
-  // Initialize occurrence array:
-  for (size_t i=0; i<numValues; ++i)
-  {
-    used[i] = false;
-  }
-
-  // Fill occurrence array:
+  // Combine the occurrence of values over all frames:
+  std::vector<bool> used((bpc==2) ? 65536 : 256, false);
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
-    for (size_t i=0; i<frameVoxels; ++i)
+    const std::vector<uint64_t>& hist = getStatistics(f, channel).histogram;
+    for (size_t i=0; i<hist.size(); ++i)
     {
-      switch (bpc)
-      {
-        case 1:
-          used[raw[i*chan+channel]] = true;
-          break;
-        case 2:
-          value = (int(raw[i*2*chan+channel]) << 8) | int(raw[i*2*chan+channel+1]);
-          used[value] = true;
-          break;
-      }
+      if (hist[i] > 0) used[i] = true;
     }
   }
 
-  // Count number of 'true' entries in occurrence array:
-  for (size_t i=0; i<numValues; ++i)
-  {
-    if (used[i]==true) ++numUsed;
-  }
-
-  delete[] used;
-  return numUsed;
+  return int(std::count(used.begin(), used.end(), true));
 }
 
 //----------------------------------------------------------------------------
@@ -4214,18 +4498,14 @@ int vvVolDesc::findNumUsed(int channel)
 int vvVolDesc::findNumTransparent(int frame)
 {
   float* rgba = NULL;
-  uint8_t* raw;
   int numTransparent = 0;
   int lutEntries = 0;
-  int scalar;
   bool noTF;                                      // true = no TF present in file
 
   vvDebugMsg::msg(2, "vvVolDesc::findNumTransparent()");
 
   if (bpc==4) return 0;                           // TODO: implement for floats
 
-  size_t frameSize = getFrameBytes();
-
   noTF = tf[0]._widgets.empty();
 
   if (!noTF)
@@ -4242,27 +4522,18 @@ int vvVolDesc::findNumTransparent(int frame)
     tf[0].computeTFTexture(lutEntries, 1, 1, rgba, range(0)[0], range(0)[1]);
   }
 
-  // Search volume:
-  raw = getRaw(frame);
-  switch (bpc)
+  // Look up the scalar values of the first channel in the histogram:
+  const std::vector<uint64_t>& hist = getStatistics((frame == -1) ? currentFrame : size_t(frame), 0).histogram;
+  for (size_t scalar=0; scalar<hist.size(); ++scalar)
   {
-    case 1:
-    case 2:
-    case 4:
-      for (size_t i=bpc-1; i<frameSize; i += getBPV())
-      {
-        if (bpc==2) scalar = (int(raw[i-1]) << 8) | int(raw[i]);
-        else scalar = raw[i];
-        if (noTF)
-        {
-          if (scalar==0) ++numTransparent;
-        }
-        else
-        {
-          if (rgba[scalar * 4 + 3]==0.0f) ++numTransparent;
-        }
-      }
-      break;
+    if (noTF)
+    {
+      if (scalar==0) numTransparent += hist[scalar];
+    }
+    else
+    {
+      if (rgba[scalar * 4 + 3]==0.0f) numTransparent += hist[scalar];
+    }
   }
 
   if (!noTF) delete[] rgba;
@@ -4276,37 +4547,10 @@ int vvVolDesc::findNumTransparent(int frame)
 */
 float vvVolDesc::calculateMean(int frame)
 {
-  uint8_t* raw;
-  float scalar = 0.f;
-  float mean;
-  double sum = 0.0;
-
   vvDebugMsg::msg(2, "vvVolDesc::calculateMean()");
 
-  size_t frameSize = getFrameBytes();
-  size_t bpv = getBPV();
-
-  // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=0; i<frameSize; i += bpv)
-  {
-    switch (bpc)
-    {
-      case 1:
-        scalar = float(raw[i]);
-        break;
-      case 2:
-        scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-        break;
-      case 4:
-        scalar = *((float*)(raw+i));
-        break;
-      default: assert(0); break;
-    }
-    sum += scalar;
-  }
-  mean = float(sum / double(getFrameVoxels()));
-  return mean;
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  return float(getStatistics(f, 0).mean());
 }
 
 //----------------------------------------------------------------------------
@@ -4317,38 +4561,12 @@ float vvVolDesc::calculateMean(int frame)
 */
 void vvVolDesc::calculateDistribution(int frame, int chan, float& mean, float& variance, float& stdev)
 {
-  uint8_t* raw;
-  double sumSquares = 0.0;
-  float scalar = 0.f;
-  float diff;
-
   vvDebugMsg::msg(2, "vvVolDesc::calculateDistribution()");
 
-  size_t frameSize = getFrameBytes();
-  size_t bpv = getBPV();
-  mean = calculateMean(frame);
-
-  // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=chan*bpc; i<frameSize; i += bpv)
-  {
-    switch (bpc)
-    {
-      case 1:
-        scalar = float(raw[i]);
-        break;
-      case 2:
-        scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-        break;
-      case 4:
-        scalar = *((float*)(raw+i));
-        break;
-      default: assert(0); break;
-    }
-    diff = scalar - mean;
-    sumSquares += diff * diff;
-  }
-  variance = float(sumSquares / double(getFrameVoxels()));
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  const virvo::ChannelStatistics& stats = getStatistics(f, chan);
+  mean = float(stats.mean());
+  variance = float(stats.variance());
   stdev = sqrtf(variance);
 }
 
@@ -4438,6 +4656,7 @@ void vvVolDesc::zoomDataRange(int channel, int low, int high, bool verbose)
     if (verbose) vvToolshed::printProgress(f);
   }
   if (verbose) cerr << endl;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -4471,6 +4690,7 @@ void vvVolDesc::applyMask(vvVolDesc* maskVD)
       }
     }
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -4488,7 +4708,7 @@ void vvVolDesc::applyMask(vvVolDesc* maskVD)
 void vvVolDesc::blend(vvVolDesc* blendVD, int method, bool verbose)
 {
   uint8_t* raw;                                   // raw volume data
-  uint8_t* rawBlend;                              // raw volume data of file to blend
+  const uint8_t* rawBlend;                        // raw volume data of file to blend
   size_t frameSize;                               // bytes per frame
   size_t fBlend;
   float val1, val2;
@@ -4512,7 +4732,7 @@ void vvVolDesc::blend(vvVolDesc* blendVD, int method, bool verbose)
   for (size_t f=0; f<frames; ++f)
   {
     raw = getRaw(f);
-    rawBlend = blendVD->getRaw(fBlend);
+    rawBlend = blendVD->getConstRaw(fBlend);
     for (size_t i=0; i<frameSize; ++i)                   // step through all voxel bytes
     {
       switch(bpc)
@@ -4559,6 +4779,7 @@ void vvVolDesc::blend(vvVolDesc* blendVD, int method, bool verbose)
     if (fBlend>=blendVD->frames) fBlend = 0;
   }
   if (verbose) cerr << endl;
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -4581,6 +4802,7 @@ void vvVolDesc::swapChannels(size_t ch0, size_t ch1, bool verbose)
   assert(bpc<=4);                                 // determines buffer size
 
   sliceSize = getSliceBytes();
+  densify();
   raw.first();
   if (verbose) vvToolshed::initProgress(frames * vox[2]);
   for (size_t f=0; f<frames; ++f)
@@ -4611,6 +4833,7 @@ void vvVolDesc::swapChannels(size_t ch0, size_t ch1, bool verbose)
 
   // Adjust channel names:
   std::swap(channelNames[ch0], channelNames[ch1]);
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -4638,6 +4861,7 @@ void vvVolDesc::extractChannel(float weights[3], bool verbose)
   newSliceSize = vox[0] * vox[1] * 4;
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
 
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -4691,6 +4915,7 @@ void vvVolDesc::extractChannel(float weights[3], bool verbose)
 
   // Adjust channel names:
   channelNames.push_back("");
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -4834,6 +5059,7 @@ void vvVolDesc::computeVolume(int algorithm, size_t vx, size_t vy, size_t vz)
     }
     default: assert(0); break;
   }
+  dataChanged();
 }
 
 vec3f vvVolDesc::getSize() const
@@ -4894,16 +5120,25 @@ void vvVolDesc::resizeEdgeMax(float len)
 //----------------------------------------------------------------------------
 float vvVolDesc::getChannelValue(int frame, size_t indexXYZ, int channel) const
 {
-  uint8_t* data = getRaw(frame);
+  const uint8_t* data;
   float fval;
   size_t index;
   size_t bpv = getBPV();
 
-  index = bpv * indexXYZ + channel * bpc;
-  switch(bpc)
+  if (const virvo::SparseFrame* sf = getSparseFrame(frame))
   {
-    case 1:
-    {
+    data = sf->getVoxel(indexXYZ);                // look up block instead of densifying the frame
+    index = channel * bpc;
+  }
+  else
+  {
+    data = getConstRaw(frame);
+    index = bpv * indexXYZ + channel * bpc;
+  }
+  switch(bpc)
+  {
+    case 1:
+    {
       fval = float(data[index]);
       fval = lerp(mapping(channel)[0], mapping(channel)[1], fval / 255);
       break;
@@ -4961,7 +5196,7 @@ std::vector< std::vector< float > >& resArray)
   int dx, dy, dz;
   int index;
 
-  uint8_t* data = getRaw();                         //raw.getData();
+  const uint8_t* data = getConstRaw();              //raw.getData();
   size_t bpv = getBPV();
 
   x0 = ts_clamp(x0, 0, (int)vox[0]-1);
@@ -5182,6 +5417,7 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
 
   newFrameSize = vox[0] * vox[1] * slices * bpc;
   if (verbose) vvToolshed::initProgress(slices * frames);
+  densify();
   raw.first();
   for (size_t f=0; f<frames; ++f)
   {
@@ -5228,6 +5464,7 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
     raw.next();
   }
   vox[2] = slices;
+  dataChanged();
   return true;
 }
 
@@ -5242,26 +5479,14 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
 */
 void vvVolDesc::addGradient(size_t srcChan, GradientType gradType)
 {
-  const float SQRT3 = float(sqrt(3.0));
   const char* GRADIENT_MAGNITUDE_CHANNEL_NAME = "GRADMAG";
   const char* GRADIENT_X_CHANNEL_NAME = "GRADIENT_X";
   const char* GRADIENT_Y_CHANNEL_NAME = "GRADIENT_Y";
   const char* GRADIENT_Z_CHANNEL_NAME = "GRADIENT_Z";
-  uint8_t* src;                                   // pointer to current source channel
-  uint8_t* dst;                                   // pointer to current destination channel (first of three if gradient vectors)
-  uint8_t* surrPtr[6];                            // pointers to surrounding voxels: next and previous values along coordinate axes
-  float surr[6];                                  // values of surrounding voxels
-  float diff[3];                                  // differences along coordinate axes
-  float grad;                                     // gradient value as floating point
-  int iGrad;                                      // gradient value as integer
-  size_t sliceVoxels;                             // number of voxels per slice
-  size_t sliceBytes;                              // number of bytes per slice
-  size_t lineBytes;                               // number of bytes per volume line
-  size_t bpv;                                     // bytes per voxel
-  size_t offset;                                  // offset from source channel to destination channel
-
   size_t numNewChannels;
 
+  vvDebugMsg::msg(2, "vvVolDesc::addGradient()");
+
   // Add new channels and name them:
   numNewChannels = (gradType==GRADIENT_MAGNITUDE) ? 1 : 3;
   convertChannels(chan + numNewChannels);
@@ -5276,96 +5501,23 @@ void vvVolDesc::addGradient(size_t srcChan, GradientType gradType)
     setChannelName(chan-1, GRADIENT_Z_CHANNEL_NAME);
   }
 
-  sliceVoxels = getSliceVoxels();
-  sliceBytes = getSliceBytes();
-  bpv = bpc * chan;
-  lineBytes = bpv * vox[0];
-  offset = bpc * (chan - srcChan - numNewChannels);
-
   float minGradientMagnitude = 1.0f;
   float maxGradientMagnitude = 0.0f;
 
-  // Add gradient magnitudes to every frame:
+  // Add gradients to every frame, slabs of slices are processed in parallel:
   for (size_t f=0; f<frames; ++f)
   {
-    // Calculate gradient magnitudes for non-edge voxels:
-    src = getRaw(f) + bpv * (1 + vox[0] + sliceVoxels) + bpc * srcChan;
-    for(ssize_t z=1; z<vox[2]-1; ++z)
+    if (gradType==GRADIENT_MAGNITUDE)
     {
-      for(ssize_t y=1; y<vox[1]-1; ++y)
-      {
-        for(ssize_t x=1; x<vox[0]-1; ++x)
-        {
-          // Calculate gradient from surrounding voxels:
-          surrPtr[0] = src - bpv;
-          surrPtr[1] = src + bpv;
-          surrPtr[2] = src - lineBytes;
-          surrPtr[3] = src + lineBytes;
-          surrPtr[4] = src - sliceBytes;
-          surrPtr[5] = src + sliceBytes;
-          for (int i=0; i<6; ++i)
-          {
-            switch(bpc)
-            {
-              case 1: surr[i] = float(*surrPtr[i]) / 255.0f; break;
-              case 2: surr[i] = float((int(*surrPtr[i]) << 8) | int(*(surrPtr[i]+1))) / 65535.0f; break;
-              case 4: surr[i] = *((float*)surrPtr[i]); break;
-              default: surr[i] = 0.0f; assert(0); break;
-            }
-          }
-
-          diff[0] = surr[1] - surr[0];
-          diff[1] = surr[3] - surr[2];
-          diff[2] = surr[5] - surr[4];
-
-          // Store gradient in new channels:
-          dst = src + offset;
-          if (gradType==GRADIENT_MAGNITUDE)
-          {
-                                                  // reduce value to range 0..1
-            grad = float(sqrt(diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2])) / SQRT3;
-            grad = ts_clamp(grad, 0.0f, 1.0f);
-            switch(bpc)
-            {
-              case 1: *dst = int(grad * 255.0f); break;
-              case 2: iGrad = int(grad * 65535.0f);
-              *dst = iGrad >> 8; *(dst+1) = iGrad & 0xff; break;
-              case 4: *((float*)dst) = grad; break;
-              default: assert(0); break;
-            }
-
-            minGradientMagnitude = ts_min(grad, minGradientMagnitude);
-            maxGradientMagnitude = ts_max(grad, maxGradientMagnitude);
-          }
-          else
-          {
-            for (int i=0; i<3; ++i)
-            {
-              switch(bpc)
-              {
-                case 1:
-                  iGrad = int((diff[i] + 1.0f) * 127.5f);
-                  *(dst+i) = ts_clamp(iGrad, 0, 255);
-                  break;
-                case 2:
-                  iGrad = int((diff[i] + 1.0f) * 32767.5f);
-                  *(dst+2*i) = iGrad >> 8;
-                  *(dst+2*i+1) = iGrad & 0xff;
-                  break;
-                case 4:
-                  *((float*)(dst+i*4)) = diff[i];
-                  break;
-                default: assert(0); break;
-              }
-            }
-          }
-          src += bpv;
-        }
-        src += 2 * bpv;
-      }
-      src += 2 * lineBytes;
+      virvo::computeGradientMagnitudes(getRaw(f), vox, bpc, chan, srcChan, chan - 1,
+                                       minGradientMagnitude, maxGradientMagnitude);
+    }
+    else
+    {
+      virvo::computeGradientVectors(getRaw(f), vox, bpc, chan, srcChan, chan - 3);
     }
   }
+  dataChanged();
 
   if (gradType==GRADIENT_MAGNITUDE)
   {
@@ -5381,7 +5533,7 @@ void vvVolDesc::addGradient(size_t srcChan, GradientType gradType)
 */
 void vvVolDesc::voxelStatistics(size_t frame, size_t c, ssize_t x, ssize_t y, ssize_t z, float& mean, float& variance)
 {
-  uint8_t* raw;
+  const uint8_t* raw;
   double sumSquares = 0.0;
   double sum = 0.0;
   float diff;
@@ -5393,7 +5545,7 @@ void vvVolDesc::voxelStatistics(size_t frame, size_t c, ssize_t x, ssize_t y, ss
   size_t i;
   size_t numSummed;
 
-  raw = getRaw(frame);
+  raw = getConstRaw(frame);
   bpv = bpc * chan;
   offset = bpv * (x + y * vox[0] + z * vox[0] * vox[1]) + bpc * c;
   for (mode=0; mode<2; ++mode)
@@ -5449,50 +5601,19 @@ void vvVolDesc::voxelStatistics(size_t frame, size_t c, ssize_t x, ssize_t y, ss
 void vvVolDesc::addVariance(size_t srcChan)
 {
   const char* VARIANCE_CHANNEL_NAME = "VARIANCE";
-  uint8_t* src;                                   // pointer to current source channel
-  uint8_t* dst;                                   // pointer to current destination channel (first of three if gradient vectors)
-  float mean;                                     // mean data value in a frame
-  float variance;
-  int iVar;                                       // variance as integer
-  size_t bpv;                                     // bytes per voxel
-  size_t voxelOffset;                             // offset from source channel to destination channel [bytes]
+
+  vvDebugMsg::msg(2, "vvVolDesc::addVariance()");
 
   // Add new channel and name it:
   convertChannels(chan + 1);
   setChannelName(chan-1, VARIANCE_CHANNEL_NAME);
 
-  bpv = bpc * chan;
-  voxelOffset = bpc * (chan - srcChan - 1);
-
-  // Add variance to every frame:
+  // Add variance to every frame, including edge voxels:
   for (size_t f=0; f<frames; ++f)
   {
-    // Calculate variance for all voxels, including edge voxels:
-    src = getRaw(f) + bpc * srcChan;
-    for(ssize_t z=0; z<vox[2]; ++z)
-    {
-      for(ssize_t y=0; y<vox[1]; ++y)
-      {
-        for(ssize_t x=0; x<vox[0]; ++x)
-        {
-          voxelStatistics(f, srcChan, x, y, z, mean, variance);
-          dst = src + voxelOffset;
-          switch(bpc)
-          {
-            case 1: *dst = int(variance * 255.0f);
-                    break;
-            case 2: iVar = int(variance * 65535.0f);
-                    *dst = iVar >> 8; *(dst+1) = iVar & 0xff;
-                    break;
-            case 4: *((float*)dst) = variance;
-                    break;
-            default: assert(0); break;
-          }
-          src += bpv;
-        }
-      }
-    }
+    virvo::computeVariance(getRaw(f), vox, bpc, chan, srcChan, chan - 1);
   }
+  dataChanged();
 }
 
 //----------------------------------------------------------------------------
@@ -5507,17 +5628,17 @@ void vvVolDesc::addVariance(size_t srcChan)
 void vvVolDesc::updateHDRBins(size_t numValues, bool skipWidgets, bool cullDup, bool lockRange, BinningType binning, bool transOp)
 {
   vvTFSkip* sw;
-  uint8_t* srcData;
-  float* sortedData;
-  float* sortedTmp;
-  float* opacities=NULL;
-  double sumOpacities=0.;    // sum of all opacities
-  double opacityPerBin;
-  double localSum;
-  float min,max;
-  float valuesPerBin;
+  const float* srcData;
+  std::vector<float> sortedData;
+  std::vector<float> extra;
+  std::vector<double> targets(NUM_HDR_BINS);
+  std::vector<float> limits;
+  std::unique_ptr<virvo::CompiledTF> compiled;
+  std::mutex weightMutex;
+  virvo::QuantileFilter filter;
+  virvo::QuantileWeight weight;
+  virvo::QuantileResult result;
   size_t numVoxels;
-  size_t index, minIndex, maxIndex, numSkip;
   size_t before;
 
   assert(binning!=LINEAR);    // this routine supports only iso-data and opacity-weighted binning
@@ -5532,195 +5653,136 @@ void vvVolDesc::updateHDRBins(size_t numValues, bool skipWidgets, bool cullDup,
   vvStopwatch stop;
   stop.start();
   cerr << endl << "Starting HDR timer" << endl;
-  cerr << "Creating HDR data array...";
   assert(_hdrBinLimits);
-  srcData = getRaw();
+  srcData = reinterpret_cast<const float*>(getConstRaw());
   numVoxels = getFrameVoxels();
-  if (numValues>0) numVoxels = ts_min(numVoxels, numValues);
-  sortedData = new float[numVoxels+2];    // +2 for min/max of data range
-  if (numVoxels == getFrameVoxels())  // can the entire data array be sorted?
-  {
-    memcpy(sortedData, srcData, getFrameBytes());
-  }
-  else  // create monte carlo volume
-  {
-    for (size_t i=0; i<numVoxels; ++i)
-    {
-      index = size_t(numVoxels * float(rand()) / float(RAND_MAX));
-      sortedData[i] = *((float*)(srcData + (sizeof(float) * index)));
-    }
-  }
-  cerr << stop.getDiff() << " sec" << endl;
-
-  // Make sure min and max of data range are included in data:
-  if (lockRange)
-  {
-    sortedData[numVoxels]   = range(0)[0];
-    sortedData[numVoxels+1] = range(0)[1];
-    numVoxels += 2;
-  }
-
-  // Sort data:
-  cerr << "Sorting data array...";
-  sort(sortedData, sortedData+numVoxels);   // requires #include <algorithm>
-  cerr << stop.getDiff() << " sec" << endl;
 
-  // Trim beginning and end of sorted data array to remove values below/above realMin/realMax:
+  // Values outside of the data range and under skip widgets are filtered
+  // out while scanning the data, rather than removed from a sorted copy:
   if (lockRange)
   {
-    cerr << "Trimming values to maintain range...";
+    filter.clamp = true;
+    filter.lo = range(0)[0];
+    filter.hi = range(0)[1];
 
-    // Trim values below realMin:
-    size_t i;
-    for(i=0; i<numVoxels && sortedData[i] < range(0)[0]; ++i)
-    {
-      minIndex = i;  // find index of realMin
-    }
-    minIndex = ts_clamp(i, size_t(0), numVoxels-1);
-    if (minIndex > 0)
-    {
-      memcpy(&sortedData[0], &sortedData[minIndex], sizeof(float) * (numVoxels - minIndex));
-      numVoxels -= minIndex;
-    }
-
-    // Trim values above realMax:
-    // find index of realMax
-    for(i=numVoxels-1; i>0 && sortedData[i] > range(0)[1]; --i)
-       ;
-    maxIndex = ts_clamp(i, size_t(0), numVoxels-1);
-    numVoxels -= (numVoxels-1-maxIndex);
-    cerr << stop.getDiff() << " sec" << endl;
+    // Make sure min and max of data range are included in data:
+    extra.push_back(range(0)[0]);
+    extra.push_back(range(0)[1]);
   }
 
-  // Remove areas covered by TFSkip widgets:
   if (skipWidgets)
   {
-    cerr << "Removing skipped regions from data array...";
-    before = numVoxels;
-    numSkip = 0;
     for (std::vector<vvTFWidget*>::const_iterator it = tf[0]._widgets.begin();
          it != tf[0]._widgets.end(); ++it)
     {
       if ((sw=dynamic_cast<vvTFSkip*>(*it))!=NULL)
       {
-        min = sw->_pos[0] - sw->_size[0] / 2.0f;
-        max = sw->_pos[0] + sw->_size[0] / 2.0f;
-
-        // Find index of beginning of skip area:
-        size_t i;
-        for(i=0; i<numVoxels && sortedData[i] < min; ++i)
-           ;
-        if (i<numVoxels)   // is skip region outside of data array?
-        {
-          minIndex = i;
-
-          // Find index of end of skip area:
-          for(i=minIndex; i<numVoxels && sortedData[i] < max; ++i)
-             ;
-          maxIndex = ts_clamp(i, size_t(0), numVoxels-1);
-
-          // Cut values:
-          numSkip = maxIndex - minIndex + 1;
-          if (maxIndex<numVoxels-1)
-          {
-            memcpy(&sortedData[minIndex], &sortedData[maxIndex+1], sizeof(float) * (numVoxels - maxIndex - 1));
-          }
-          numVoxels -= numSkip;
-        }
+        filter.exclude.push_back(std::make_pair(sw->_pos[0] - sw->_size[0] / 2.0f,
+                                                sw->_pos[0] + sw->_size[0] / 2.0f));
       }
     }
-    cerr << stop.getDiff() << " sec" << endl;
-    cerr << (before - numVoxels) << " voxels removed (" << (100.0f * float(numSkip) / float(getFrameVoxels())) << "%)" << endl;
   }
 
-  // Remove duplicate values from array:
-  if (cullDup)
+  // Bin limits are quantiles of the data values, weighted by opacity for opacity binning:
+  for (size_t i=0; i<NUM_HDR_BINS; ++i)
+  {
+    targets[i] = (binning==OPACITY) ? double(i+1) / double(NUM_HDR_BINS) : double(i) / double(NUM_HDR_BINS);
+  }
+  if (binning==OPACITY)
   {
-    before = numVoxels;
-    cerr << "Removing duplicate values...";
-    sortedTmp = new float[numVoxels];
-    sortedTmp[0] = sortedData[0];
-    size_t j=0;
-    for (size_t i=1; i<numVoxels; ++i)
+    // The weight is evaluated on the worker threads. The compiled transfer
+    // function gives the same opacities as vvTransFunc::computeOpacity(); if
+    // it has to call widgets that update internal state lazily, the calls
+    // are serialized instead
+    compiled.reset(new virvo::CompiledTF(tf[0]._widgets, tf[0].getDiscreteColors()));
+    if (compiled->isThreadSafe())
     {
-      if (sortedData[i] != sortedTmp[j])
+      const virvo::CompiledTF* ctf = compiled.get();
+      weight = [ctf](float v)
       {
-        ++j;
-        sortedTmp[j] = sortedData[i];
-      }
+        float rgba[4];
+        ctf->evaluate(&v, 1, -1.0f, -1.0f, rgba);
+        return rgba[3];
+      };
+    }
+    else
+    {
+      weight = [this, &weightMutex](float v)
+      {
+        std::lock_guard<std::mutex> lock(weightMutex);
+        return tf[0].computeOpacity(v);
+      };
     }
-    numVoxels = j+1;
-    memcpy(sortedData, sortedTmp, numVoxels * sizeof(float));
-    delete[] sortedTmp;
-    cerr << stop.getDiff() << " sec" << endl;
-    cerr << (before - numVoxels) << " voxels removed" << endl;
   }
 
-  // Create array with opacity values for the data values:
-  if (binning==OPACITY)
+  if ((numValues>0 && numValues<numVoxels) || cullDup)
   {
-    cerr << "Creating opacity array...";
-    sumOpacities = 0.0;
-    opacities = new float[numVoxels * sizeof(float)];
-    for (size_t i=0; i<numVoxels; ++i)
+    // Sampling and duplicate removal need a sorted copy of the values
+    if (numValues>0 && numValues<numVoxels)   // create monte carlo volume
+    {
+      cerr << "Creating HDR data array...";
+      std::vector<float> sample(numValues);
+      virvo::reservoirSample(srcData, numVoxels, numValues, &sample[0], unsigned(rand()));
+      virvo::gatherFiltered(&sample[0], sample.size(), filter, sortedData);
+      before = sample.size() + extra.size();
+    }
+    else
     {
-      opacities[i] = tf[0].computeOpacity(sortedData[i]);
-      sumOpacities += opacities[i];
+      cerr << "Filtering data array...";
+      virvo::gatherFiltered(srcData, numVoxels, filter, sortedData);
+      before = numVoxels + extra.size();
+    }
+    for (size_t i=0; i<extra.size(); ++i)
+    {
+      if (filter.accept(extra[i])) sortedData.push_back(extra[i]);
     }
     cerr << stop.getDiff() << " sec" << endl;
-  }
+    if (skipWidgets || lockRange)
+    {
+      cerr << (before - sortedData.size()) << " voxels removed" << endl;
+    }
+
+    cerr << "Sorting data array...";
+    if (!sortedData.empty()) virvo::radixSort(&sortedData[0], sortedData.size());
+    cerr << stop.getDiff() << " sec" << endl;
 
-  // Determine bin limits:
-  cerr << "Determining bin limits...";
-  switch (binning)
+    // Remove duplicate values from array:
+    if (cullDup)
+    {
+      before = sortedData.size();
+      cerr << "Removing duplicate values...";
+      sortedData.erase(std::unique(sortedData.begin(), sortedData.end()), sortedData.end());
+      cerr << stop.getDiff() << " sec" << endl;
+      cerr << (before - sortedData.size()) << " voxels removed" << endl;
+    }
+
+    cerr << "Determining bin limits...";
+    result = virvo::selectQuantilesSorted(sortedData.empty() ? NULL : &sortedData[0], sortedData.size(),
+                                          targets, true, limits, weight);
+    cerr << stop.getDiff() << " sec" << endl;
+  }
+  else
   {
-    case ISO_DATA:
-      valuesPerBin = float(numVoxels) / float(NUM_HDR_BINS);
-      for (size_t i=0; i<NUM_HDR_BINS; ++i)
-      {
-        index = size_t(float(i) * valuesPerBin);
-        index = ts_clamp(index, size_t(0), numVoxels-1);
-        _hdrBinLimits[i] = sortedData[index];
-      }
-      break;
-    case OPACITY:
+    cerr << "Determining bin limits...";
+    result = virvo::selectQuantiles(srcData, numVoxels, filter, targets, true, limits, weight, extra);
+    cerr << stop.getDiff() << " sec" << endl;
+    if (skipWidgets || lockRange)
     {
-      opacityPerBin = sumOpacities / NUM_HDR_BINS;
-      localSum = 0.0;
-      size_t j = 0;    // index to current voxel
-      for (size_t i=0; i<NUM_HDR_BINS; ++i)
-      {
-        while (localSum<opacityPerBin)
-        {
-          if (j<numVoxels)
-          {
-            localSum += opacities[j];
-            ++j;
-            if (localSum>=opacityPerBin)
-            {
-              _hdrBinLimits[i] = sortedData[j-1];
-              localSum = 0.0;
-              break;
-            }
-          }
-          else
-          {
-            _hdrBinLimits[i] = sortedData[numVoxels-1];
-            localSum = 0.0;
-            break;
-          }
-        }
-      }
-      break;
+      cerr << (numVoxels + extra.size() - result.count) << " voxels removed" << endl;
     }
-    case LINEAR:
-      // cannot happen
-      break;
   }
-  cerr << stop.getDiff() << " sec" << endl;
+
+  if (result.count == 0)
+  {
+    cerr << "no data values left for HDR binning" << endl;
+    cerr << "Total HDR execution time: " << stop.getTime() << " sec" << endl << endl;
+    return;
+  }
+
+  std::copy(limits.begin(), limits.end(), _hdrBinLimits);
 
   // Do first and last data entries differ?
-  if (sortedData[0] == sortedData[numVoxels-1])
+  if (result.min == result.max)
   {
     cerr << "volume too sparse for HDR monte carlo sampling" << endl;
   }
@@ -5728,14 +5790,11 @@ void vvVolDesc::updateHDRBins(size_t numValues, bool skipWidgets, bool cullDup,
   {
     if (!lockRange)
     {
-      range(0)[0] = sortedData[0];
-      range(0)[1] = sortedData[numVoxels-1];
+      range(0)[0] = result.min;
+      range(0)[1] = result.max;
     }
   }
 
-  delete[] opacities;
-  delete[] sortedData;
-
   cerr << "Total HDR execution time: " << stop.getTime() << " sec" << endl << endl;
 }
 
@@ -5867,7 +5926,7 @@ void vvVolDesc::computeMinMaxArrays(uchar *minArray, uint8_t *maxArray, ssize_t
   ssize_t v1 = (vox[1]+downsample-1)/downsample;
   ssize_t v2 = (vox[2]+downsample-1)/downsample;
 
-  uint8_t *raw = const_cast<vvVolDesc *>(this)->getRaw(frame);
+  const uint8_t *raw = getConstRaw(frame);
   for(ssize_t k=0; k<vox[2]; k += downsample)
   {
     for(ssize_t j=0; j<vox[1]; j += downsample)
@@ -5943,5 +6002,748 @@ vec3f vvVolDesc::objectCoords(virvo::vector< 3, ssize_t > const& voxCoords) cons
     return result;
 }
 
+//----------------------------------------------------------------------------
+// Level of detail
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+/** Return the number of levels of the level-of-detail pyramid.
+  Level 0 is the volume itself, each further level halves the previous one
+  in each dimension, the last level consists of a single voxel.
+*/
+size_t vvVolDesc::getNumLODLevels() const
+{
+  if (vox[0] <= 0 || vox[1] <= 0 || vox[2] <= 0)
+    return 0;
+
+  size_t levels = 1;
+  virvo::vector< 3, ssize_t > v = vox;
+  while (v[0] > 1 || v[1] > 1 || v[2] > 1)
+  {
+    for (size_t i = 0; i < 3; ++i)
+      v[i] = (v[i] + 1) / 2;
+    ++levels;
+  }
+  return levels;
+}
+
+//----------------------------------------------------------------------------
+/** Return the volume dimensions of a level of the LOD pyramid.
+  @param level  pyramid level (0 = full resolution)
+*/
+virvo::vector< 3, ssize_t > vvVolDesc::getLODVox(size_t level) const
+{
+  virvo::vector< 3, ssize_t > v = vox;
+  for (size_t l = 0; l < level; ++l)
+  {
+    for (size_t i = 0; i < 3; ++i)
+      v[i] = std::max(ssize_t(1), (v[i] + 1) / 2);
+  }
+  return v;
+}
+
+//----------------------------------------------------------------------------
+/** Return the voxel data of a level of the LOD pyramid.
+  Levels are built on demand from the next finer level using the filter set
+  with setLODFilter() and are cached per frame. The cache is discarded
+  automatically when the frame data or the data format changes. Changes made
+  to the voxel data in place have to be announced with invalidateLOD().
+  The data layout is the same as for getRaw(), with getLODVox() dimensions.
+  Levels are resampled with the BOX or MAXIMUM filter of resize().
+  @param level  pyramid level (0 = full resolution, same as getRaw(frame))
+  @param frame  frame index (-1 for current frame)
+  @return pointer to the level data, or NULL if frame or level do not exist
+*/
+const uint8_t* vvVolDesc::getLODRaw(size_t level, int frame) const
+{
+  vvDebugMsg::msg(3, "vvVolDesc::getLODRaw()");
+
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  if (f >= frames || level >= getNumLODLevels())
+    return NULL;
+
+  if (level == 0)
+    return getConstRaw(f);
+
+  // Discard everything that was built for a different data format
+  virvo::vector< 4, ssize_t > format(vox[0], vox[1], vox[2], ssize_t(getBPV()));
+  if (format != lodFormat_)
+  {
+    lodData_.clear();
+    lodRevision_.clear();
+    lodFormat_ = format;
+  }
+
+  if (lodData_.size() < frames)
+  {
+    lodData_.resize(frames);
+    lodRevision_.resize(frames, 0);
+  }
+
+  // Discard the pyramid if the frame data changed
+  if (lodRevision_[f] != getRevision(f))
+  {
+    lodData_[f].clear();
+    lodRevision_[f] = getRevision(f);
+  }
+
+  std::vector< std::vector< uint8_t > >& levels = lodData_[f];
+  while (levels.size() < level)
+  {
+    size_t l = levels.size() + 1;
+    virvo::vector< 3, ssize_t > srcVox = getLODVox(l - 1);
+    virvo::vector< 3, ssize_t > dstVox = getLODVox(l);
+    const uint8_t* src = (l == 1) ? getConstRaw(f) : &levels.back()[0];
+    if (src == NULL)
+      return NULL;
+
+    std::vector< uint8_t > dst(dstVox[0] * dstVox[1] * dstVox[2] * getBPV());
+    virvo::resample(src, srcVox, &dst[0], dstVox, bpc, chan,
+        lodFilter_ == LOD_MAX ? virvo::RESAMPLE_MAX : virvo::RESAMPLE_BOX);
+
+    levels.push_back(std::vector< uint8_t >());
+    levels.back().swap(dst);
+  }
+
+  return &levels[level - 1][0];
+}
+
+//----------------------------------------------------------------------------
+/** Set the filter used to build the LOD pyramid.
+  Cached levels are discarded if the filter changes.
+*/
+void vvVolDesc::setLODFilter(LODFilter filter)
+{
+  if (filter == lodFilter_)
+    return;
+
+  lodFilter_ = filter;
+  lodData_.clear();
+  lodRevision_.clear();
+}
+
+//----------------------------------------------------------------------------
+vvVolDesc::LODFilter vvVolDesc::getLODFilter() const
+{
+  return lodFilter_;
+}
+
+//----------------------------------------------------------------------------
+/** Discard cached LOD levels, e.g. after voxel data was modified in place.
+  Also changes the revision of the frames (see getRevision()).
+  @param frame  frame index, -1 for all frames
+*/
+void vvVolDesc::invalidateLOD(int frame)
+{
+  newRevision(frame);
+
+  if (frame == -1)
+  {
+    lodData_.clear();
+    lodRevision_.clear();
+  }
+  else if (size_t(frame) < lodData_.size())
+  {
+    lodData_[frame].clear();
+    lodRevision_[frame] = 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Return the number of bytes currently held by the LOD cache.
+size_t vvVolDesc::getLODBytes() const
+{
+  size_t bytes = 0;
+  for (size_t f = 0; f < lodData_.size(); ++f)
+  {
+    for (size_t l = 0; l < lodData_[f].size(); ++l)
+      bytes += lodData_[f][l].size();
+  }
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+/** Convert all frames to sparse block storage. Only blocks that contain
+  at least one voxel different from the background value are kept.
+  Dense frame data is released according to its deletion type, data that
+  was added with NO_DELETE remains owned by the caller.
+  getConstRaw() decodes sparse frames into the cache of decompressed frames
+  and leaves them sparse, like compressed frames (see compressFrames()).
+  getRaw() and operations that modify the data convert frames back to
+  dense frames.
+  @param blockSize  edge length of blocks [voxels]
+  @param background getBPV() bytes with the background value, NULL for 0
+  @param verbose    true = print progress and memory savings
+*/
+void vvVolDesc::makeSparse(size_t blockSize, const uint8_t* background, bool verbose)
+{
+  vvDebugMsg::msg(2, "vvVolDesc::makeSparse()");
+
+  if (blockSize == 0) blockSize = virvo::SparseFrame::DEFAULT_BLOCK_SIZE;
+
+  sparse_.resize(raw.count());
+  size_t denseBytes = 0;
+  if (verbose) vvToolshed::initProgress(frames);
+  for (size_t f=0; f<frames; ++f)
+  {
+    if (sparse_[f] && sparse_[f]->getBlockSize() == blockSize) continue;
+
+    const uint8_t* data = getConstRaw(f);
+    sparse_[f].reset(new virvo::SparseFrame(data, vox, getBPV(), blockSize, background));
+    denseBytes += getFrameBytes();
+
+    releaseFrame(f);
+    if (verbose) vvToolshed::printProgress(f);
+  }
+  updateFrameCache();
+  if (verbose)
+  {
+    cerr << endl;
+    cerr << "Dense data bytes:  " << denseBytes << endl;
+    cerr << "Sparse data bytes: " << getSparseBytes() << endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Convert all sparse and compressed frames back to dense frames.
+void vvVolDesc::makeDense()
+{
+  vvDebugMsg::msg(2, "vvVolDesc::makeDense()");
+  densify();
+}
+
+//----------------------------------------------------------------------------
+/** @return true if the frame is stored as a sparse frame
+  @param frame  frame index, -1 for current frame
+*/
+bool vvVolDesc::isSparse(int frame) const
+{
+  return getSparseFrame(frame) != NULL;
+}
+
+//----------------------------------------------------------------------------
+/** @return sparse storage of a frame, NULL if the frame is stored dense
+  @param frame  frame index, -1 for current frame
+*/
+const virvo::SparseFrame* vvVolDesc::getSparseFrame(int frame) const
+{
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  if (f >= sparse_.size()) return NULL;
+  return sparse_[f].get();
+}
+
+//----------------------------------------------------------------------------
+/** Adds a sparse frame to the animation sequence, see addFrame().
+  The frame must match the volume dimensions and bytes per voxel.
+  @param frame  sparse frame, will be deleted by vvVolDesc
+*/
+void vvVolDesc::addSparseFrame(virvo::SparseFrame* frame)
+{
+  assert(frame->getVox() == vox && frame->getBPV() == getBPV());
+
+  raw.append(NULL, vvSLNode<uint8_t*>::NO_DELETE);
+  rawFrameNumber.push_back(-1);
+  sparse_.resize(raw.count());
+  sparse_.back().reset(frame);
+
+  // Make sure channel names exist:
+  if (channelNames.size() == 0)
+  {
+    channelNames.resize(chan);
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Return the number of bytes occupied by sparse frames.
+size_t vvVolDesc::getSparseBytes() const
+{
+  size_t bytes = 0;
+  for (size_t f = 0; f < sparse_.size(); ++f)
+  {
+    if (sparse_[f]) bytes += sparse_[f]->getBytes();
+  }
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+/// Return the frame source that decodes a sparse frame, create it if necessary.
+const virvo::FrameSource* vvVolDesc::sparseSource(size_t frame) const
+{
+  if (sparseSource_.size() < sparse_.size())
+    sparseSource_.resize(sparse_.size());
+
+  if (!sparseSource_[frame])
+    sparseSource_[frame].reset(new SparseSource(sparse_[frame]));
+  return sparseSource_[frame].get();
+}
+
+//----------------------------------------------------------------------------
+/** Convert all sparse and compressed frames to dense frames and take
+  exclusive ownership of shared frames. Called by all operations that access
+  the frame list directly. These cannot skip frames, so lazily loaded frames
+  that cannot be read are replaced by empty frames.
+*/
+void vvVolDesc::densify() const
+{
+  for (size_t f = 0; f < sparse_.size(); ++f)
+  {
+    if (sparse_[f]) densifyFrame(f);
+  }
+  sparse_.clear();
+
+  for (size_t f = 0; f < compressed_.size(); ++f)
+  {
+    if (compressed_[f] && decompressFrame(f) == NULL)
+    {
+      cerr << "Frame " << f << " is replaced by an empty frame" << endl;
+      uint8_t* data = new uint8_t[getFrameBytes()];
+      memset(data, 0, getFrameBytes());
+      compressed_[f].reset();
+      raw.makeCurrent(f);
+      raw.setData(data);
+      raw.setDeleteData(vvSLNode<uint8_t*>::ARRAY_DELETE);
+    }
+  }
+  if (frameCache_) frameCache_->clear();
+  compressed_.clear();
+
+  for (size_t f = 0; f < shared_.size(); ++f)
+  {
+    if (shared_[f]) unshareFrame(f);
+  }
+  shared_.clear();
+}
+
+//----------------------------------------------------------------------------
+/** Replace a sparse frame by a dense frame.
+  @return pointer to the dense frame data
+*/
+uint8_t* vvVolDesc::densifyFrame(size_t frame) const
+{
+  vvDebugMsg::msg(3, "vvVolDesc::densifyFrame()");
+
+  uint8_t* data = new uint8_t[getFrameBytes()];
+  sparse_[frame]->toDense(data);
+  if (frameCache_) frameCache_->release(frame);
+  if (frame < sparseSource_.size()) sparseSource_[frame].reset();
+  sparse_[frame].reset();
+
+  raw.makeCurrent(frame);
+  raw.setData(data);
+  raw.setDeleteData(vvSLNode<uint8_t*>::ARRAY_DELETE);
+  return data;
+}
+
+//----------------------------------------------------------------------------
+// Copy-on-write frame sharing
+//----------------------------------------------------------------------------
+
+/** Return true if the data of a frame is shared with copies of this volume.
+  @param frame  frame index, -1 for current frame
+*/
+bool vvVolDesc::isShared(int frame) const
+{
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  if (f < sparse_.size() && sparse_[f]) return sparse_[f].use_count() > 1;
+  if (f < compressed_.size() && compressed_[f]) return compressed_[f].use_count() > 1;
+  return f < shared_.size() && shared_[f] && shared_[f].use_count() > 1;
+}
+
+//----------------------------------------------------------------------------
+/** Move ownership of a frame from the frame list to shared_, so that
+  copies of this volume can reference it. Frames the frame list does not
+  own (NO_DELETE) are left alone, they have to be copied.
+*/
+void vvVolDesc::shareFrame(size_t frame) const
+{
+  if (frame < shared_.size() && shared_[frame]) return;
+
+  raw.makeCurrent(frame);
+  if (raw.getDeleteType() != vvSLNode<uint8_t*>::ARRAY_DELETE) return;
+
+  shared_.resize(raw.count());
+  shared_[frame].reset(raw.getData(), FrameDeleter());
+  raw.setDeleteData(vvSLNode<uint8_t*>::NO_DELETE);
+}
+
+//----------------------------------------------------------------------------
+/** Give a shared frame back to the frame list, duplicate it if it is
+  still referenced by other volumes.
+  @return pointer to the now exclusively owned frame data
+*/
+uint8_t* vvVolDesc::unshareFrame(size_t frame) const
+{
+  uint8_t* data = shared_[frame].get();
+
+  if (shared_[frame].unique())
+  {
+    boost::get_deleter<FrameDeleter>(shared_[frame])->released = true;
+  }
+  else
+  {
+    vvDebugMsg::msg(3, "vvVolDesc::unshareFrame(): copying frame");
+    uint8_t* copy = new uint8_t[getFrameBytes()];
+    memcpy(copy, data, getFrameBytes());
+    data = copy;
+  }
+  shared_[frame].reset();
+
+  raw.makeCurrent(frame);
+  raw.setData(data);
+  raw.setDeleteData(vvSLNode<uint8_t*>::ARRAY_DELETE);
+  return data;
+}
+
+//----------------------------------------------------------------------------
+// Compressed frames
+//----------------------------------------------------------------------------
+
+/** Compress all dense frames in memory, for time series that do not fit into
+  memory uncompressed. Frames are compressed with Snappy in bricks of whole
+  slices. Only the current frame and the next getPrefetchFrames() frames are
+  kept decompressed, they are decompressed on background threads whenever the
+  current frame changes. Other frames are decompressed on access.
+  <BR>
+  getConstRaw() returns decompressed data without modifying the frame, the
+  pointer remains valid as long as the frame is the current frame or within
+  the prefetch window, or, for other frames, until getResidentFrames() other
+  frames outside of the window were accessed. getRaw() and operations that modify the data
+  convert frames back to dense frames.
+  <BR>
+  Frames that do not get smaller, e.g. because the library was built without
+  Snappy, and sparse frames remain unchanged. Dense frame data is released
+  according to its deletion type, see makeSparse().
+  @param verbose  true = print progress and memory savings
+*/
+void vvVolDesc::compressFrames(bool verbose)
+{
+  vvDebugMsg::msg(2, "vvVolDesc::compressFrames()");
+
+  compressed_.resize(raw.count());
+  size_t denseBytes = 0;
+  if (verbose) vvToolshed::initProgress(frames);
+  for (size_t f=0; f<frames; ++f)
+  {
+    if (isSparse(f) || compressed_[f]) continue;
+
+    boost::shared_ptr< const virvo::FrameSource > cf(
+        new virvo::CompressedFrame(getConstRaw(f), getFrameBytes(), getSliceBytes()));
+    if (cf->getBytes() >= getFrameBytes()) continue;
+    denseBytes += getFrameBytes();
+
+    releaseFrame(f);
+    compressed_[f] = cf;
+    if (verbose) vvToolshed::printProgress(f);
+  }
+  updateFrameCache();
+  if (verbose)
+  {
+    cerr << endl;
+    cerr << "Dense data bytes:      " << denseBytes << endl;
+    cerr << "Compressed data bytes: " << getCompressedBytes() << endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** @return true if the frame is stored compressed
+  @param frame  frame index, -1 for current frame
+*/
+bool vvVolDesc::isCompressed(int frame) const
+{
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  return f < compressed_.size() && compressed_[f] && !compressed_[f]->isLazy();
+}
+
+//----------------------------------------------------------------------------
+/** Set the number of compressed frames after the current frame that are
+  decompressed in advance.
+*/
+void vvVolDesc::setPrefetchFrames(size_t num)
+{
+  prefetchFrames_ = num;
+  updateFrameCache();
+}
+
+//----------------------------------------------------------------------------
+size_t vvVolDesc::getPrefetchFrames() const
+{
+  return prefetchFrames_;
+}
+
+//----------------------------------------------------------------------------
+/** Set the number of recently accessed compressed or lazily loaded frames
+  outside of the prefetch window that are kept decompressed (at least 1).
+  At most getPrefetchFrames() + 1 + num frames are resident in memory.
+*/
+void vvVolDesc::setResidentFrames(size_t num)
+{
+  residentFrames_ = std::max(num, size_t(1));
+  if (frameCache_) frameCache_->setCapacity(residentFrames_);
+}
+
+//----------------------------------------------------------------------------
+size_t vvVolDesc::getResidentFrames() const
+{
+  return residentFrames_;
+}
+
+//----------------------------------------------------------------------------
+/// Return the number of bytes occupied by compressed frames.
+size_t vvVolDesc::getCompressedBytes() const
+{
+  size_t bytes = 0;
+  for (size_t f = 0; f < compressed_.size(); ++f)
+  {
+    if (compressed_[f] && !compressed_[f]->isLazy()) bytes += compressed_[f]->getBytes();
+  }
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+/** Return the number of bytes occupied by decompressed copies of compressed
+  frames, including frames that are being decompressed in the background.
+*/
+size_t vvVolDesc::getDecompressedBytes() const
+{
+  return frameCache_ ? frameCache_->getBytes() : 0;
+}
+
+//----------------------------------------------------------------------------
+/** Replace a compressed frame by a dense frame.
+  If a lazily loaded frame cannot be read, it stays lazy so that
+  the next access tries again.
+  @return pointer to the dense frame data, NULL on read error
+*/
+uint8_t* vvVolDesc::decompressFrame(size_t frame) const
+{
+  vvDebugMsg::msg(3, "vvVolDesc::decompressFrame()");
+
+  uint8_t* data = new uint8_t[getFrameBytes()];
+  if (!compressed_[frame]->decompress(data))
+  {
+    cerr << "Error: cannot read frame " << frame << " of " << (filename ? filename : "volume") << endl;
+    delete[] data;
+    return NULL;
+  }
+  frameCache().release(frame);
+  compressed_[frame].reset();
+
+  raw.makeCurrent(frame);
+  raw.setData(data);
+  raw.setDeleteData(vvSLNode<uint8_t*>::ARRAY_DELETE);
+  return data;
+}
+
+//----------------------------------------------------------------------------
+/** Release the dense data of a frame after it was converted to sparse or
+  compressed storage. The frame list holds NULL for the frame afterwards.
+*/
+void vvVolDesc::releaseFrame(size_t frame)
+{
+  if (frame < shared_.size()) shared_[frame].reset();
+  if (frameCache_) frameCache_->release(frame);
+  if (frame < sparseSource_.size()) sparseSource_[frame].reset();
+  if (frame < compressed_.size()) compressed_[frame].reset();
+
+  raw.makeCurrent(frame);
+  raw.remove();
+  if (frame==0) raw.insertBefore(NULL, vvSLNode<uint8_t*>::NO_DELETE);
+  else raw.insertAfter(NULL, vvSLNode<uint8_t*>::NO_DELETE);
+}
+
+//----------------------------------------------------------------------------
+/// Return the cache of decompressed frames, create it if necessary.
+virvo::FrameCache& vvVolDesc::frameCache() const
+{
+  if (!frameCache_)
+  {
+    frameCache_.reset(new virvo::FrameCache);
+    frameCache_->setCapacity(residentFrames_);
+  }
+  return *frameCache_;
+}
+
+//----------------------------------------------------------------------------
+/** Move the window of decompressed frames to the current frame and start
+  decompressing the compressed and sparse frames in the window. The window
+  wraps around at the end of the animation.
+*/
+void vvVolDesc::updateFrameCache() const
+{
+  if ((compressed_.empty() && sparse_.empty()) || frames == 0) return;
+
+  std::vector<size_t> window;
+  for (size_t i=0; i<=prefetchFrames_ && i<frames; ++i)
+  {
+    window.push_back((currentFrame + i) % frames);
+  }
+  frameCache().setWindow(window);
+
+  for (size_t i=0; i<window.size(); ++i)
+  {
+    size_t f = window[i];
+    if (f < compressed_.size() && compressed_[f]) frameCache().prefetch(f, compressed_[f].get());
+    else if (f < sparse_.size() && sparse_[f]) frameCache().prefetch(f, sparseSource(f));
+  }
+}
+
+//----------------------------------------------------------------------------
+// Lazily loaded frames
+//----------------------------------------------------------------------------
+
+/** Add a frame whose data is read from a file when it is accessed, e.g.
+  by vvFileIO in lazy mode (see vvFileIO::setLazyFrames()). The frame is
+  handled like a compressed frame: getConstRaw() and setCurrentFrame() read
+  frames into the cache of decompressed frames (see compressFrames(),
+  setResidentFrames()), getRaw() reads the frame and keeps it as a dense frame.
+  The frames variable is not adjusted, this must be done separately.
+  @param source  location of the frame, the volume takes ownership
+*/
+void vvVolDesc::addLazyFrame(virvo::FrameSource* source)
+{
+  raw.append(NULL, vvSLNode<uint8_t*>::NO_DELETE);
+  rawFrameNumber.push_back(-1);
+  compressed_.resize(raw.count());
+  compressed_.back().reset(source);
+  if (channelNames.size() == 0) channelNames.resize(chan);
+}
+
+//----------------------------------------------------------------------------
+/** @return true if the frame was not read from its file yet
+  @param frame  frame index, -1 for current frame
+*/
+bool vvVolDesc::isLazy(int frame) const
+{
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  return f < compressed_.size() && compressed_[f] && compressed_[f]->isLazy();
+}
+
+//----------------------------------------------------------------------------
+// Statistics
+//----------------------------------------------------------------------------
+
+/** Return the statistics of a data channel of an animation frame.
+  All channels of the frame are computed in a single parallel pass over the
+  voxel data when first requested, and the results are cached until the data
+  changes. Call invalidateStatistics() after modifying voxel data in place.
+  @param frame    frame index (0 for first frame)
+  @param channel  channel index (0 for first channel)
+*/
+const virvo::ChannelStatistics& vvVolDesc::getStatistics(size_t frame, int channel) const
+{
+  vvDebugMsg::msg(3, "vvVolDesc::getStatistics()");
+  assert(frame < frames && channel >= 0 && channel < chan);
+
+  // Discard everything that was computed for a different data format
+  virvo::vector< 3, ssize_t > format(static_cast<ssize_t>(getFrameVoxels()), static_cast<ssize_t>(bpc), static_cast<ssize_t>(chan));
+  if (format != statsFormat_)
+  {
+    stats_.clear();
+    statsRevision_.clear();
+    statsFormat_ = format;
+  }
+
+  if (stats_.size() < frames)
+  {
+    stats_.resize(frames);
+    statsRevision_.resize(frames, 0);
+  }
+
+  // Recompute if the frame data changed
+  if (statsRevision_[frame] != getRevision(frame) || stats_[frame].empty())
+  {
+    std::vector<uint8_t> tmp;
+    stats_[frame].resize(chan);
+    virvo::computeStatistics(getFrameData(frame, tmp), getFrameVoxels(), bpc, chan, &stats_[frame][0]);
+    statsRevision_[frame] = getRevision(frame);
+  }
+
+  return stats_[frame][channel];
+}
+
+//----------------------------------------------------------------------------
+/** Discard cached statistics, e.g. after voxel data was modified in place.
+  Also changes the revision of the frames (see getRevision()).
+  @param frame  frame index, -1 for all frames
+*/
+void vvVolDesc::invalidateStatistics(int frame)
+{
+  newRevision(frame);
+
+  if (frame == -1)
+  {
+    stats_.clear();
+    statsRevision_.clear();
+  }
+  else if (size_t(frame) < stats_.size())
+  {
+    stats_[frame].clear();
+    statsRevision_[frame] = 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Return the revision of the data of a frame. The revision changes whenever
+  the frame data is replaced or modified by vvVolDesc, it does not change when
+  only the storage of the frame changes (sparse, compressed, shared frames).
+  Revisions are unique among all volumes, so they identify frame contents
+  even if memory is reused. Caches of data derived from voxel data should be
+  keyed on the revision rather than on the frame data pointer.
+  @param frame  frame index, -1 for current frame
+  @return revision, 0 if the frame does not exist
+*/
+size_t vvVolDesc::getRevision(int frame) const
+{
+  size_t f = (frame == -1) ? currentFrame : size_t(frame);
+  if (f >= frames)
+    return 0;
+
+  if (revision_.size() < frames)
+    revision_.resize(frames, 0);
+
+  if (revision_[f] == 0)
+    revision_[f] = ++nextRevision;
+  return revision_[f];
+}
+
+//----------------------------------------------------------------------------
+/** Assign new revisions to frames whose data changed.
+  @param frame  frame index, -1 for all frames
+*/
+void vvVolDesc::newRevision(int frame) const
+{
+  if (frame == -1)
+    revision_.clear();
+  else if (size_t(frame) < revision_.size())
+    revision_[frame] = 0;
+}
+
+//----------------------------------------------------------------------------
+/** Return the voxel data of a frame without converting sparse frames.
+  @param tmp  receives the dense copy of sparse frames
+*/
+const uint8_t* vvVolDesc::getFrameData(size_t frame, std::vector<uint8_t>& tmp) const
+{
+  if (const virvo::SparseFrame* sf = getSparseFrame(frame))
+  {
+    tmp.resize(getFrameBytes());
+    sf->toDense(&tmp[0]);
+    return &tmp[0];
+  }
+  return getConstRaw(frame);
+}
+
+//----------------------------------------------------------------------------
+/** Discard all data derived from the voxel data.
+  Called by all operations that modify voxel data, after the modification.
+  Operations that return without changing anything don't call it, so the
+  caches survive no-op calls.
+*/
+void vvVolDesc::dataChanged(int frame)
+{
+  invalidateLOD(frame);
+  invalidateStatistics(frame);
+}
+
 ///// EOF /////
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -23,6 +23,7 @@
 
 #include <boost/serialization/binary_object.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <stdlib.h>
 #include <string>
@@ -32,9 +33,17 @@
 
 #include "vvexport.h"
 #include "vvinttypes.h"
+#include "vvsparseframe.h"
+#include "vvstatistics.h"
 #include "vvtransfunc.h"
 #include "vvsllist.h"
 
+namespace virvo
+{
+  class FrameCache;
+  class FrameSource;
+}
+
 //============================================================================
 // Class Definition
 //============================================================================
@@ -71,7 +80,10 @@ class VIRVO_FILEIOEXPORT vvVolDesc
     enum InterpolationType                        ///  interpolation types to use for resampling
     {
       NEAREST,                                    ///< nearest neighbor
-      TRILINEAR                                   ///< trilinear
+      TRILINEAR,                                  ///< trilinear
+      BOX,                                        ///< average over the footprint of each new voxel
+      LANCZOS,                                    ///< Lanczos windowed sinc (a=3), sharp downsampling
+      MAXIMUM                                     ///< maximum over the footprint of each new voxel
     };
     enum DeleteType                               /// types for data deletion
     {
@@ -123,6 +135,12 @@ class VIRVO_FILEIOEXPORT vvVolDesc
       ISO_DATA,
       OPACITY
     };
+
+    enum LODFilter                                /// filter used to build the level-of-detail pyramid
+    {
+      LOD_AVERAGE,                                ///< average of the source voxels covered, 2x2x2 for even sizes
+      LOD_MAX                                     ///< maximum of the source voxels covered, preserves thin bright features
+    };
     
     static const size_t DEFAULT_ICON_SIZE;        ///< system default for icon size if not otherwise specified (only stored in XVF files)
     static const size_t NUM_HDR_BINS;             ///< constant value for HDR transfer functions
@@ -185,7 +203,7 @@ public:
 
       for (size_t k = 0; k < frames; k++)
       {
-        a & boost::serialization::make_binary_object(getRaw(k), size);
+        a & boost::serialization::make_binary_object(const_cast<uint8_t*>(getConstRaw(k)), size);
       }
     }
 
@@ -248,6 +266,8 @@ public:
      @param  default to -1 in the past meant current frame */
     uint8_t* getRaw(int frame = -1) const;
     uint8_t* getRaw(size_t) const;
+    const uint8_t* getConstRaw(int frame = -1) const;
+    const uint8_t* getConstRaw(size_t) const;
     const char* getFilename() const;
     void   setFilename(const char*);
     void   setEntry(int entry); //< entry to read from DICOMDIR (<0: entry with largest number of slices)
@@ -304,7 +324,8 @@ public:
     ErrorType merge(vvVolDesc*, vvVolDesc::MergeType);
     ErrorType mergeFrames(ssize_t slicesPerFrame=-1);
     void   addFrame(uint8_t*, DeleteType, int fd=-1);
-    void   copyFrame(uint8_t*);
+    void   copyFrame(const uint8_t*);
+    uint8_t* takeFrame(size_t frame);
     void   removeSequence();
     void   makeHistogram(int frame, int chan1, int numChan, int*, int*, float, float) const;
     void   normalizeHistogram(int, int*, float*, NormalizationType);
@@ -366,6 +387,47 @@ public:
     virvo::vector< 3, ssize_t > voxelCoords(virvo::vec3f const& objCoords) const;
     virvo::vec3f objectCoords(virvo::vector< 3, ssize_t > const& voxCoords) const;
 
+    // Level of detail:
+    size_t getNumLODLevels() const;
+    virvo::vector< 3, ssize_t > getLODVox(size_t level) const;
+    const uint8_t* getLODRaw(size_t level, int frame = -1) const;
+    void   setLODFilter(LODFilter filter);
+    LODFilter getLODFilter() const;
+    void   invalidateLOD(int frame = -1);
+    size_t getLODBytes() const;
+
+    // Sparse storage:
+    void   makeSparse(size_t blockSize = virvo::SparseFrame::DEFAULT_BLOCK_SIZE, const uint8_t* background = NULL, bool verbose = false);
+    void   makeDense();
+    bool   isSparse(int frame = -1) const;
+    const virvo::SparseFrame* getSparseFrame(int frame = -1) const;
+    void   addSparseFrame(virvo::SparseFrame* frame);
+    size_t getSparseBytes() const;
+
+    // Copy-on-write frame sharing:
+    bool   isShared(int frame = -1) const;
+
+    // Compressed frames:
+    void   compressFrames(bool verbose = false);
+    bool   isCompressed(int frame = -1) const;
+    void   setPrefetchFrames(size_t num);
+    size_t getPrefetchFrames() const;
+    size_t getCompressedBytes() const;
+    size_t getDecompressedBytes() const;
+    void   setResidentFrames(size_t num);
+    size_t getResidentFrames() const;
+
+    // Lazily loaded frames:
+    void   addLazyFrame(virvo::FrameSource* source);
+    bool   isLazy(int frame = -1) const;
+
+    // Data revisions:
+    size_t getRevision(int frame = -1) const;
+
+    // Statistics:
+    const virvo::ChannelStatistics& getStatistics(size_t frame, int channel) const;
+    void   invalidateStatistics(int frame = -1);
+
   private:
     char*  filename;                              ///< name of volume data file, including extension, excluding path ("" if undefined)
     int entry;                                    ///< number of entry to read from a DICOMDIR file (<0: entry with largest number of slices)
@@ -374,9 +436,36 @@ public:
     mutable vvSLList<uint8_t*> raw;               ///< pointer list to raw volume data - mutable because of Java style iterators
     std::vector<int> rawFrameNumber;           ///< frame numbers (if frames do not come in sequence)
     std::vector< std::string > channelNames;      ///< names of data channels
+    LODFilter lodFilter_;                         ///< filter used to build the level-of-detail pyramid
+    mutable std::vector< std::vector< std::vector< uint8_t > > > lodData_; ///< per frame: levels 1..n-1 of the LOD pyramid, built on demand
+    mutable std::vector< size_t > revision_;     ///< per frame: revision of the voxel data, 0 = not assigned yet
+    mutable std::vector< size_t > lodRevision_;  ///< per frame: revision of the data the cached pyramid was built from
+    mutable virvo::vector< 4, ssize_t > lodFormat_; ///< vox[0..2] and bpv the cached pyramid was built for
+    mutable std::vector< boost::shared_ptr< virvo::SparseFrame > > sparse_; ///< per frame: sparse storage, the raw list holds NULL for these frames
+    mutable std::vector< boost::shared_ptr< const virvo::FrameSource > > sparseSource_; ///< per frame: decodes sparse frames into the frame cache, created on demand
+    mutable std::vector< boost::shared_ptr< uint8_t > > shared_; ///< per frame: ownership of frames shared with copies of this volume, the raw list does not delete these frames
+    mutable std::vector< boost::shared_ptr< const virvo::FrameSource > > compressed_; ///< per frame: compressed storage or location in a file, the raw list holds NULL for these frames
+    mutable boost::shared_ptr< virvo::FrameCache > frameCache_; ///< decompressed copies of compressed frames around the current frame, created on demand
+    size_t prefetchFrames_;                       ///< number of compressed frames after the current frame that are decompressed in advance
+    size_t residentFrames_;                       ///< number of recently accessed compressed frames outside the prefetch window that stay decompressed
+    mutable std::vector< std::vector< virvo::ChannelStatistics > > stats_; ///< per frame and channel: statistics, computed on demand
+    mutable std::vector< size_t > statsRevision_; ///< per frame: revision of the data the cached statistics were computed from
+    mutable virvo::vector< 3, ssize_t > statsFormat_; ///< voxels per frame, bpc and channels the cached statistics were computed for
 
     void initialize();
     void setDefaults();
+    void densify() const;
+    uint8_t* densifyFrame(size_t frame) const;
+    const virvo::FrameSource* sparseSource(size_t frame) const;
+    void shareFrame(size_t frame) const;
+    uint8_t* unshareFrame(size_t frame) const;
+    uint8_t* decompressFrame(size_t frame) const;
+    void releaseFrame(size_t frame);
+    virvo::FrameCache& frameCache() const;
+    void updateFrameCache() const;
+    const uint8_t* getFrameData(size_t frame, std::vector< uint8_t >& tmp) const;
+    void dataChanged(int frame = -1);
+    void newRevision(int frame = -1) const;
     void makeLineIntensDiag(int channel, std::vector< std::vector< float > > const& data, size_t numValues, int*);
     bool isChannelOn(size_t num, unsigned char);
 };
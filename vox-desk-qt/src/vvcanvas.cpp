@@ -25,6 +25,7 @@
 #include "vvcanvas.h"
 #include "vvlightinteractor.h"
 
+#include <virvo/vvasyncfileio.h>
 #include <virvo/vvdebugmsg.h>
 #include <virvo/vvfileio.h>
 
@@ -37,6 +38,9 @@
 #include <QVector3D>
 
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
 
 using virvo::mat4;
 using virvo::vec2f;
@@ -49,10 +53,96 @@ namespace gl = virvo::gl;
 
 struct vvCanvas::Impl
 {
+  Impl()
+    : loadedHeader(NULL)
+    , loadedPreview(NULL)
+    , loadingDone(false)
+    , loadingError(vvFileIO::OK)
+    , loadingVd(NULL)
+    , loadingFrames(0)
+    , loadingShown(false)
+  {
+  }
+
+  ~Impl()
+  {
+    clearLoadedData();
+    clearPendingFrames();
+    delete loadingVd;
+  }
+
+  // discard everything the loader has delivered, but was not processed yet
+  void clearLoadedData()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    delete loadedHeader;
+    delete loadedPreview;
+    for (size_t i = 0; i < loadedFrames.size(); ++i)
+    {
+      delete[] loadedFrames[i];
+    }
+    loadedHeader = NULL;
+    loadedPreview = NULL;
+    loadedFrames.clear();
+    loadingDone = false;
+  }
+
+  // discard the frames that were not yet added to the displayed volume
+  void clearPendingFrames()
+  {
+    for (size_t i = 0; i < pendingFrames.size(); ++i)
+    {
+      delete[] pendingFrames[i];
+    }
+    pendingFrames.clear();
+  }
+
   vvRenderState renderState;
   mat4 last_rotation;
+
+  // file to load when the canvas is initialized
+  QString initialFile;
+
+  // loads volume files in the background
+  vvAsyncFileIO loader;
+
+  // data delivered by the loader thread, guarded by mutex
+  std::mutex mutex;
+  vvVolDesc* loadedHeader;
+  vvVolDesc* loadedPreview;
+  std::vector<uint8_t*> loadedFrames;
+  bool loadingDone;
+  vvFileIO::ErrorType loadingError;
+
+  // volume that is assembled from the loaded frames until its first frame is there
+  QString loadingFile;
+  vvVolDesc* loadingVd;
+  size_t loadingFrames;
+  bool loadingShown;
+
+  // frames that were loaded after the volume was shown, they are added in
+  // batches so that the renderer does not upload the whole animation per frame
+  std::vector<uint8_t*> pendingFrames;
 };
 
+namespace
+{
+// use the data range and a default TF if the file does not specify them
+void setDefaultTransferFunction(vvVolDesc* vd)
+{
+  if (vd->range(0)[0] == 0.0f && vd->range(0)[1] == 1.0f)
+  {
+    vd->findAndSetRange();
+  }
+
+  if (vd->tf[0].isEmpty())
+  {
+    vd->tf[0].setDefaultAlpha(0, vd->range(0)[0], vd->range(0)[1]);
+    vd->tf[0].setDefaultColors((vd->getChan() == 1) ? 0 : 2, vd->range(0)[0], vd->range(0)[1]);
+  }
+}
+}
+
 vvCanvas::vvCanvas(const QGLFormat& format, const QString& filename, QWidget* parent)
   : QGLWidget(format, parent)
   , impl(new Impl)
@@ -74,19 +164,13 @@ vvCanvas::vvCanvas(const QGLFormat& format, const QString& filename, QWidget* pa
 {
   vvDebugMsg::msg(1, "vvCanvas::vvCanvas()");
 
-  if (filename != "")
-  {
-    _vd = new vvVolDesc(filename.toStdString().c_str());
-  }
-  else
-  {
-    // load default volume
-    _vd = new vvVolDesc;
-    _vd->vox[0] = 32;
-    _vd->vox[1] = 32;
-    _vd->vox[2] = 32;
-    _vd->frames = 0;
-  }
+  // show default volume, the file is loaded in the background by init()
+  impl->initialFile = filename;
+  _vd = new vvVolDesc;
+  _vd->vox[0] = 32;
+  _vd->vox[1] = 32;
+  _vd->vox[2] = 32;
+  _vd->frames = 0;
 
   // init ui
   setMouseTracking(true);
@@ -128,6 +212,9 @@ vvCanvas::~vvCanvas()
 {
   vvDebugMsg::msg(1, "vvCanvas::~vvCanvas()");
 
+  impl->loader.cancel();
+  impl->loader.wait();
+
   delete _renderer;
   delete _vd;
 }
@@ -195,6 +282,63 @@ const QList<vvInteractor*>& vvCanvas::getInteractors() const
   return _interactors;
 }
 
+void vvCanvas::loadVolumeFile(const QString& filename)
+{
+  vvDebugMsg::msg(3, "vvCanvas::loadVolumeFile()");
+
+  // discard a load that is still running
+  impl->loader.cancel();
+  impl->loader.wait();
+  impl->clearLoadedData();
+  impl->clearPendingFrames();
+  delete impl->loadingVd;
+  impl->loadingVd = NULL;
+  impl->loadingShown = false;
+  impl->loadingFile = filename;
+
+  // the loader thread stores what it has read and lets the gui thread
+  // process it, the volume is displayed as soon as its first frame is there
+  vvAsyncFileIO::Callbacks callbacks;
+  callbacks.header = [this](vvVolDesc* vd)
+  {
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->loadedHeader = vd;
+    }
+    QMetaObject::invokeMethod(this, "processLoadedData", Qt::QueuedConnection);
+  };
+  callbacks.preview = [this](vvVolDesc* vd)
+  {
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->loadedPreview = vd;
+    }
+    QMetaObject::invokeMethod(this, "processLoadedData", Qt::QueuedConnection);
+  };
+  callbacks.frame = [this](size_t /*index*/, uint8_t* data)
+  {
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->loadedFrames.push_back(data);
+    }
+    QMetaObject::invokeMethod(this, "processLoadedData", Qt::QueuedConnection);
+  };
+  callbacks.finished = [this](vvFileIO::ErrorType err)
+  {
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->loadingDone = true;
+      impl->loadingError = err;
+    }
+    QMetaObject::invokeMethod(this, "processLoadedData", Qt::QueuedConnection);
+  };
+
+  if (!impl->loader.load(filename.toStdString(), callbacks))
+  {
+    emit loadingFinished(filename, vvFileIO::FILE_NOT_FOUND);
+  }
+}
+
 void vvCanvas::loadCamera(const QString& filename)
 {
   vvDebugMsg::msg(3, "vvCanvas::loadCamera()");
@@ -437,6 +581,11 @@ void vvCanvas::init()
   }
 
   emit newVolDesc(_vd);
+
+  if (!impl->initialFile.isEmpty())
+  {
+    loadVolumeFile(impl->initialFile);
+  }
 }
 
 void vvCanvas::createRenderer()
@@ -1017,4 +1166,104 @@ void vvCanvas::setLightPos(vec3f const& pos)
 
   updateGL();
 }
+
+void vvCanvas::processLoadedData()
+{
+  vvDebugMsg::msg(3, "vvCanvas::processLoadedData()");
+
+  vvVolDesc* header = NULL;
+  vvVolDesc* preview = NULL;
+  std::vector<uint8_t*> frames;
+  bool done = false;
+  vvFileIO::ErrorType err = vvFileIO::OK;
+  {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    std::swap(header, impl->loadedHeader);
+    std::swap(preview, impl->loadedPreview);
+    frames.swap(impl->loadedFrames);
+    std::swap(done, impl->loadingDone);
+    err = impl->loadingError;
+  }
+
+  if (header != NULL)
+  {
+    delete impl->loadingVd;
+    impl->loadingVd = header;
+    impl->loadingFrames = header->frames;
+    header->frames = 0;
+  }
+
+  // coarse version of the volume to show until the first frame is there
+  if (preview != NULL && !impl->loadingShown)
+  {
+    setDefaultTransferFunction(preview);
+    setVolDesc(preview);
+  }
+  else
+  {
+    delete preview;
+  }
+
+  if (!frames.empty() && impl->loadingShown)
+  {
+    impl->pendingFrames.insert(impl->pendingFrames.end(), frames.begin(), frames.end());
+  }
+  else if (!frames.empty() && impl->loadingVd != NULL)
+  {
+    vvVolDesc* vd = impl->loadingVd;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+      vd->addFrame(frames[i], vvVolDesc::ARRAY_DELETE);
+      ++vd->frames;
+    }
+    impl->loadingVd = NULL;
+    impl->loadingShown = true;
+    setDefaultTransferFunction(vd);
+    setVolDesc(vd);
+  }
+  else
+  {
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+      delete[] frames[i];
+    }
+  }
+
+  // updateVolumeData() uploads all frames: only update when the number of
+  // frames has doubled, and once when loading is done, so that the uploads
+  // stay linear in the number of frames
+  if (impl->loadingShown && !impl->pendingFrames.empty()
+   && (done || impl->pendingFrames.size() >= _vd->frames))
+  {
+    for (size_t i = 0; i < impl->pendingFrames.size(); ++i)
+    {
+      _vd->addFrame(impl->pendingFrames[i], vvVolDesc::ARRAY_DELETE);
+      ++_vd->frames;
+    }
+    impl->pendingFrames.clear();
+    _renderer->updateVolumeData();
+    emit newVolDesc(_vd);
+    updateGL();
+  }
+
+  if (impl->loadingShown && _vd->frames + impl->pendingFrames.size() < impl->loadingFrames)
+  {
+    std::ostringstream str;
+    str << "Loading frame " << _vd->frames + impl->pendingFrames.size() << " of " << impl->loadingFrames;
+    emit statusMessage(str.str());
+  }
+
+  if (done)
+  {
+    delete impl->loadingVd;
+    impl->loadingVd = NULL;
+    if (impl->loadingShown)
+    {
+      std::string str;
+      _vd->makeInfoString(&str);
+      emit statusMessage(str);
+    }
+    emit loadingFinished(impl->loadingFile, err);
+  }
+}
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
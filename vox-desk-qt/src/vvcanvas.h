@@ -59,6 +59,7 @@ public:
   vvRenderer* getRenderer() const;
   const QList<vvInteractor*>& getInteractors() const;
 
+  void loadVolumeFile(const QString& filename);
   void loadCamera(const QString& filename);
   void saveCamera(const QString& filename);
 protected:
@@ -157,12 +158,14 @@ public slots:
 private slots:
   void repeatLastRotation();
   void setLightPos(virvo::vec3f const& pos);
+  void processLoadedData();
 signals:
   void rendererChanged(vvRenderer* renderer);
   void newVolDesc(vvVolDesc* vd);
   void statusMessage(const std::string& str);
   void currentFrame(int frame);
   void resized(const QSize& size);
+  void loadingFinished(const QString& filename, int error);
 };
 
 #endif
@@ -247,6 +247,7 @@ vvMainWindow::vvMainWindow(const QString& filename, QWidget* parent)
   // misc.
   connect(impl_->canvas, SIGNAL(newVolDesc(vvVolDesc*)), this, SLOT(onNewVolDesc(vvVolDesc*)));
   connect(impl_->canvas, SIGNAL(statusMessage(const std::string&)), this, SLOT(onStatusMessage(const std::string&)));
+  connect(impl_->canvas, SIGNAL(loadingFinished(const QString&, int)), this, SLOT(onLoadingFinished(const QString&, int)));
 
   connect(impl_->tfDialog, SIGNAL(newWidget(vvTFWidget*)), impl_->canvas, SLOT(addTFWidget(vvTFWidget*)));
   connect(impl_->tfDialog, SIGNAL(newTransferFunction()), impl_->canvas, SLOT(updateTransferFunction()));
@@ -378,27 +379,20 @@ void vvMainWindow::lateInitialization()
 }
 
 void vvMainWindow::loadVolumeFile(const QString& filename)
+{
+  // the canvas loads in the background and reports with loadingFinished()
+  impl_->canvas->loadVolumeFile(filename);
+}
+
+void vvMainWindow::onLoadingFinished(const QString& filename, int error)
 {
   QByteArray ba = filename.toLatin1();
-  vvVolDesc* vd = new vvVolDesc(ba.data());
-  vvFileIO fio;
-  switch (fio.loadVolumeData(vd, vvFileIO::ALL_DATA))
+  switch (error)
   {
   case vvFileIO::OK:
   {
     vvDebugMsg::msg(2, "Loaded file: ", ba.data());
-    if (vd->range(0)[0] == 0.0f && vd->range(0)[1] == 1.0f)
-    {
-      vd->findAndSetRange();
-    }
-    // use default TF if none stored
-    if (vd->tf[0].isEmpty())
-    {
-      vd->tf[0].setDefaultAlpha(0, vd->range(0)[0], vd->range(0)[1]);
-      vd->tf[0].setDefaultColors((vd->getChan() == 1) ? 0 : 2, vd->range(0)[0], vd->range(0)[1]);
-    }
-    impl_->canvas->setVolDesc(vd);
-    impl_->dimensionDialog->setInitialDist(vd->getDist());
+    impl_->dimensionDialog->setInitialDist(impl_->canvas->getVolDesc()->getDist());
 
     impl_->ui->menuRecentVolumes->clear();
     std::vector<std::string> recents = getRecentFiles();
@@ -412,14 +406,15 @@ void vvMainWindow::loadVolumeFile(const QString& filename)
     addRecentFile(filename);
     break;
   }
+  case vvFileIO::CANCELLED:
+    vvDebugMsg::msg(2, "Loading cancelled: ", ba.data());
+    break;
   case vvFileIO::FILE_NOT_FOUND:
     vvDebugMsg::msg(2, "File not found: ", ba.data());
-    delete vd;
     QMessageBox::warning(this, tr("Error loading file"), tr("File not found: ") + filename, QMessageBox::Ok);
     break;
   default:
     vvDebugMsg::msg(2, "Cannot load file: ", ba.data());
-    delete vd;
     QMessageBox::warning(this, tr("Error loading file"), tr("Cannot load file: ") + filename, QMessageBox::Ok);
     break;
   }
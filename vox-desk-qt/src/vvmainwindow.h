@@ -102,6 +102,7 @@ private slots:
   // misc.
   void onNewVolDesc(vvVolDesc* vd);
   void onStatusMessage(const std::string& str);
+  void onLoadingFinished(const QString& filename, int error);
 };
 
 #endif